@@ -0,0 +1,260 @@
+//***************************************************************************************
+// AssetRegistry.h
+//
+// Assets (geometry, shaders, PSOs, submeshes, ...) stored in a dense array and referred
+// to by generational handles instead of by string.
+//
+// Names are hashed at compile time with 64 bit FNV-1a (ASSET_NAME("box")), so even
+// lookups by name never hash or compare characters at run time; they probe a small open
+// addressing table of hashes.  Code that runs every frame should look an asset up once
+// and keep the Handle.  A handle is a slot index plus the generation the slot had when
+// the asset was added; removing the asset bumps the generation, so stale handles are
+// detected instead of silently pointing at whatever took the slot next.
+//***************************************************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Compile time 64 bit FNV-1a.
+constexpr std::uint64_t HashAssetName(const char* text)
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	for(; *text != '\0'; ++text)
+		hash = (hash ^ (unsigned char)*text) * 1099511628211ull;
+	return hash;
+}
+
+struct AssetName
+{
+	std::uint64_t Hash;
+
+	// Kept for logging only; never compared.
+	const char* Text;
+};
+
+// Forces the hash to be computed by the compiler.
+#define ASSET_NAME(text) AssetName{ std::integral_constant<std::uint64_t, HashAssetName(text)>::value, text }
+
+template<typename T>
+class AssetRegistry
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Handle
+	{
+		uint32 Index = ~0u;
+		uint32 Generation = 0;
+
+		bool IsValid()const { return Index != ~0u; }
+		bool operator==(const Handle& rhs)const { return Index == rhs.Index && Generation == rhs.Generation; }
+		bool operator!=(const Handle& rhs)const { return !(*this == rhs); }
+	};
+
+	///<summary>
+	/// Adds an asset under name, reusing a free slot if there is one.  Names must be
+	/// unique within the registry.
+	///</summary>
+	Handle Add(const AssetName& name, T asset)
+	{
+		assert(!Find(name).IsValid() && "asset name already registered (or hash collision)");
+
+		uint32 index;
+		if(!mFree.empty())
+		{
+			index = mFree.back();
+			mFree.pop_back();
+		}
+		else
+		{
+			index = (uint32)mSlots.size();
+			mSlots.emplace_back();
+		}
+
+		Insert(name.Hash, index);
+
+		Slot& slot = mSlots[index];
+		slot.Asset = std::move(asset);
+		slot.Name = name;
+		slot.Alive = true;
+		++mCount;
+
+		return { index, slot.Generation };
+	}
+
+	// Invalid handle when nothing is registered under name.
+	Handle Find(const AssetName& name)const
+	{
+		if(mTable.empty())
+			return Handle();
+
+		size_t mask = mTable.size() - 1;
+		for(size_t i = (size_t)name.Hash & mask;; i = (i + 1) & mask)
+		{
+			const TableEntry& e = mTable[i];
+			if(e.Slot == EmptyEntry)
+				return Handle();
+			if(e.Slot != RemovedEntry && e.Hash == name.Hash)
+				return { e.Slot, mSlots[e.Slot].Generation };
+		}
+	}
+
+	// nullptr for invalid and stale handles.
+	T* Get(Handle handle)
+	{
+		return IsAlive(handle) ? &mSlots[handle.Index].Asset : nullptr;
+	}
+
+	const T* Get(Handle handle)const
+	{
+		return IsAlive(handle) ? &mSlots[handle.Index].Asset : nullptr;
+	}
+
+	T& operator[](Handle handle)
+	{
+		assert(IsAlive(handle));
+		return mSlots[handle.Index].Asset;
+	}
+
+	const T& operator[](Handle handle)const
+	{
+		assert(IsAlive(handle));
+		return mSlots[handle.Index].Asset;
+	}
+
+	// Looks a name up and asserts it exists.  For setup code.
+	T& operator[](const AssetName& name)
+	{
+		return (*this)[Find(name)];
+	}
+
+	bool IsAlive(Handle handle)const
+	{
+		return handle.Index < mSlots.size() && mSlots[handle.Index].Alive &&
+			mSlots[handle.Index].Generation == handle.Generation;
+	}
+
+	// Destroys the asset.  Its handles go stale and its slot is reused by a later Add.
+	bool Remove(Handle handle)
+	{
+		if(!IsAlive(handle))
+			return false;
+
+		Slot& slot = mSlots[handle.Index];
+		Erase(slot.Name.Hash);
+
+		slot.Asset = T();
+		slot.Alive = false;
+		++slot.Generation;
+		--mCount;
+
+		mFree.push_back(handle.Index);
+		return true;
+	}
+
+	const char* GetName(Handle handle)const
+	{
+		return IsAlive(handle) ? mSlots[handle.Index].Name.Text : nullptr;
+	}
+
+	uint32 Count()const
+	{
+		return mCount;
+	}
+
+	// Calls func(handle, asset) for every live asset, in slot order.
+	template<typename Func>
+	void ForEach(Func func)
+	{
+		for(uint32 i = 0; i < (uint32)mSlots.size(); ++i)
+		{
+			if(mSlots[i].Alive)
+				func(Handle{ i, mSlots[i].Generation }, mSlots[i].Asset);
+		}
+	}
+
+private:
+	static const uint32 EmptyEntry = ~0u;
+	static const uint32 RemovedEntry = ~0u - 1;
+
+	struct Slot
+	{
+		T Asset = T();
+		AssetName Name = { 0, nullptr };
+		uint32 Generation = 0;
+		bool Alive = false;
+	};
+
+	struct TableEntry
+	{
+		uint64 Hash = 0;
+		uint32 Slot = EmptyEntry;
+	};
+
+	void Insert(uint64 hash, uint32 slot)
+	{
+		// Keep the table at most half full, counting removed entries, so probes stay short.
+		if((mTableUsed + 1) * 2 > mTable.size())
+			Rehash(std::max<size_t>(16, (mCount + 1) * 4));
+
+		size_t mask = mTable.size() - 1;
+		size_t i = (size_t)hash & mask;
+		while(mTable[i].Slot != EmptyEntry && mTable[i].Slot != RemovedEntry)
+			i = (i + 1) & mask;
+
+		if(mTable[i].Slot == EmptyEntry)
+			++mTableUsed;
+		mTable[i] = { hash, slot };
+	}
+
+	void Erase(uint64 hash)
+	{
+		size_t mask = mTable.size() - 1;
+		for(size_t i = (size_t)hash & mask; mTable[i].Slot != EmptyEntry; i = (i + 1) & mask)
+		{
+			if(mTable[i].Slot != RemovedEntry && mTable[i].Hash == hash)
+			{
+				mTable[i].Slot = RemovedEntry;
+				return;
+			}
+		}
+	}
+
+	void Rehash(size_t minSize)
+	{
+		size_t size = 16;
+		while(size < minSize)
+			size *= 2;
+
+		mTable.assign(size, TableEntry());
+		mTableUsed = 0;
+
+		size_t mask = size - 1;
+		for(uint32 s = 0; s < (uint32)mSlots.size(); ++s)
+		{
+			if(!mSlots[s].Alive)
+				continue;
+
+			size_t i = (size_t)mSlots[s].Name.Hash & mask;
+			while(mTable[i].Slot != EmptyEntry)
+				i = (i + 1) & mask;
+			mTable[i] = { mSlots[s].Name.Hash, s };
+			++mTableUsed;
+		}
+	}
+
+private:
+	std::vector<Slot> mSlots;
+	std::vector<uint32> mFree;
+	uint32 mCount = 0;
+
+	// Open addressing table from name hash to slot, linear probing.
+	std::vector<TableEntry> mTable;
+	size_t mTableUsed = 0;
+};
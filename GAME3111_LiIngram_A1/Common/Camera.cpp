@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "Camera.h"
+#include "MeshLod.h"
 
 using namespace DirectX;
 
@@ -103,6 +104,14 @@ float Camera::GetNearWindowHeight()const
 	return mNearWindowHeight;
 }
 
+float Camera::ProjectedScreenSize(const XMFLOAT3& centerW, float radius)const
+{
+	XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&centerW), XMLoadFloat3(&mPosition));
+	float distance = XMVectorGetX(XMVector3Length(toCenter));
+
+	return LodSelector::ProjectedScreenSize(radius, distance, 1.0f / tanf(0.5f*mFovY));
+}
+
 float Camera::GetFarWindowWidth()const
 {
 	return mAspect * mFarWindowHeight;
@@ -46,6 +46,9 @@ public:
 	float GetNearWindowHeight()const;
 	float GetFarWindowWidth()const;
 	float GetFarWindowHeight()const;
+
+	// Fraction of the viewport height covered by a world space sphere; used for LOD selection.
+	float ProjectedScreenSize(const DirectX::XMFLOAT3& centerW, float radius)const;
 	
 	// Set frustum.
 	void SetLens(float fovY, float aspect, float zn, float zf);
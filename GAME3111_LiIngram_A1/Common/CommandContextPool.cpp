@@ -0,0 +1,275 @@
+//***************************************************************************************
+// CommandContextPool.cpp
+//***************************************************************************************
+
+#include "CommandContextPool.h"
+#include <algorithm>
+#include <cassert>
+
+CommandContextPool::CommandContextPool(CommandBackend& backend)
+	: mBackend(backend)
+{
+}
+
+CommandContextPool::Context CommandContextPool::Acquire(uint32 thread)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	RecycleLocked();
+
+	Context context;
+	context.Thread = thread;
+
+	// Prefer an allocator this thread used last; its memory is sized for its work.
+	auto it = std::find_if(mFreeAllocators.begin(), mFreeAllocators.end(), [&](uint32 a)
+	{
+		return mAllocators[a].LastThread == thread;
+	});
+	if(it == mFreeAllocators.end() && !mFreeAllocators.empty())
+		it = mFreeAllocators.begin();
+
+	if(it != mFreeAllocators.end())
+	{
+		context.Allocator = *it;
+		mFreeAllocators.erase(it);
+
+		++mStats.AllocatorsReused;
+		if(mAllocators[context.Allocator].LastThread == thread)
+			++mStats.ThreadHits;
+	}
+	else
+	{
+		context.Allocator = (uint32)mAllocators.size();
+		mAllocators.push_back(Allocator());
+		mBackend.CreateAllocator(context.Allocator);
+	}
+
+	Allocator& allocator = mAllocators[context.Allocator];
+	allocator.LastThread = thread;
+	allocator.Recording = true;
+	++allocator.Stats.Uses;
+
+	if(!mFreeLists.empty())
+	{
+		context.List = mFreeLists.back();
+		mFreeLists.pop_back();
+		mBackend.ResetList(context.List, context.Allocator);
+	}
+	else
+	{
+		context.List = mListCount++;
+		mBackend.CreateList(context.List, context.Allocator);
+	}
+
+	++mStats.Acquires;
+	return context;
+}
+
+void CommandContextPool::AddRecordedBytes(const Context& context, uint64 bytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	AllocatorStats& stats = mAllocators[context.Allocator].Stats;
+	stats.Bytes += bytes;
+	stats.PeakBytes = std::max(stats.PeakBytes, stats.Bytes);
+}
+
+void CommandContextPool::Close(const Context& context)
+{
+	mBackend.CloseList(context.List);
+}
+
+void CommandContextPool::Release(const Context& context, uint64 fence)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	Allocator& allocator = mAllocators[context.Allocator];
+	assert(allocator.Recording);
+
+	allocator.Recording = false;
+	allocator.InFlight = true;
+	allocator.Fence = fence;
+	mInFlight.push_back(context.Allocator);
+
+	// A submitted list may be reset right away; only its allocator has to wait.
+	mFreeLists.push_back(context.List);
+}
+
+void CommandContextPool::Recycle()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	RecycleLocked();
+}
+
+void CommandContextPool::RecycleLocked()
+{
+	if(mInFlight.empty())
+		return;
+
+	uint64 completed = mBackend.CompletedFence();
+
+	// Releases from different threads can arrive slightly out of fence order, so check
+	// every allocator rather than stopping at the first one still pending.
+	auto done = std::stable_partition(mInFlight.begin(), mInFlight.end(), [&](uint32 a)
+	{
+		return mAllocators[a].Fence > completed;
+	});
+
+	for(auto it = done; it != mInFlight.end(); ++it)
+	{
+		Allocator& allocator = mAllocators[*it];
+		mBackend.ResetAllocator(*it);
+
+		allocator.InFlight = false;
+		allocator.Stats.Bytes = 0;
+		++allocator.Stats.Resets;
+		mFreeAllocators.push_back(*it);
+	}
+
+	mInFlight.erase(done, mInFlight.end());
+}
+
+CommandContextPool::uint32 CommandContextPool::AllocatorCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return (uint32)mAllocators.size();
+}
+
+CommandContextPool::uint32 CommandContextPool::ListCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mListCount;
+}
+
+CommandContextPool::AllocatorStats CommandContextPool::GetAllocatorStats(uint32 allocator)const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mAllocators[allocator].Stats;
+}
+
+CommandContextPool::Stats CommandContextPool::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	Stats stats = mStats;
+	stats.AllocatorCount = (uint32)mAllocators.size();
+	stats.ListCount = mListCount;
+	stats.InFlight = (uint32)mInFlight.size();
+	for(const Allocator& a : mAllocators)
+	{
+		stats.PeakBytes = std::max(stats.PeakBytes, a.Stats.PeakBytes);
+		stats.TotalPeakBytes += a.Stats.PeakBytes;
+	}
+
+	return stats;
+}
+
+void NullCommandBackend::CreateAllocator(uint32 allocator)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if(allocator != mAllocators.size())
+		Violation("allocator " + std::to_string(allocator) + " created out of order");
+	mAllocators.resize(std::max<size_t>(mAllocators.size(), allocator + 1));
+
+	mCalls.push_back({ Call::Kind::CreateAllocator, ~0u, allocator });
+}
+
+void NullCommandBackend::ResetAllocator(uint32 allocator)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const AllocatorState& state = mAllocators[allocator];
+	if(state.OpenLists > 0)
+		Violation("allocator " + std::to_string(allocator) + " reset while a list is recording");
+	if(state.PendingFence > mCompletedFence)
+		Violation("allocator " + std::to_string(allocator) + " reset while the GPU may still use it");
+
+	mCalls.push_back({ Call::Kind::ResetAllocator, ~0u, allocator });
+}
+
+void NullCommandBackend::CreateList(uint32 list, uint32 allocator)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if(list != mLists.size())
+		Violation("list " + std::to_string(list) + " created out of order");
+	mLists.resize(std::max<size_t>(mLists.size(), list + 1));
+
+	if(mAllocators[allocator].OpenLists > 0)
+		Violation("allocator " + std::to_string(allocator) + " has two lists recording");
+
+	mLists[list].Allocator = allocator;
+	mLists[list].Open = true;
+	++mAllocators[allocator].OpenLists;
+
+	mCalls.push_back({ Call::Kind::CreateList, list, allocator });
+}
+
+void NullCommandBackend::ResetList(uint32 list, uint32 allocator)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if(mLists[list].Open)
+		Violation("list " + std::to_string(list) + " reset while recording");
+	if(mAllocators[allocator].OpenLists > 0)
+		Violation("allocator " + std::to_string(allocator) + " has two lists recording");
+
+	mLists[list].Allocator = allocator;
+	mLists[list].Open = true;
+	++mAllocators[allocator].OpenLists;
+
+	mCalls.push_back({ Call::Kind::ResetList, list, allocator });
+}
+
+void NullCommandBackend::CloseList(uint32 list)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	ListState& state = mLists[list];
+	if(!state.Open)
+		Violation("list " + std::to_string(list) + " closed twice");
+	else
+		--mAllocators[state.Allocator].OpenLists;
+	state.Open = false;
+
+	mCalls.push_back({ Call::Kind::CloseList, list, state.Allocator });
+}
+
+NullCommandBackend::uint64 NullCommandBackend::CompletedFence()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mCompletedFence;
+}
+
+void NullCommandBackend::Submit(uint32 list, uint64 fence)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if(mLists[list].Open)
+		Violation("list " + std::to_string(list) + " submitted while recording");
+
+	AllocatorState& state = mAllocators[mLists[list].Allocator];
+	state.PendingFence = std::max(state.PendingFence, fence);
+}
+
+void NullCommandBackend::SetCompletedFence(uint64 fence)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCompletedFence = fence;
+}
+
+const std::vector<NullCommandBackend::Call>& NullCommandBackend::GetCalls()const
+{
+	return mCalls;
+}
+
+const std::vector<std::string>& NullCommandBackend::GetViolations()const
+{
+	return mViolations;
+}
+
+void NullCommandBackend::Violation(const std::string& what)
+{
+	mViolations.push_back(what);
+}
@@ -0,0 +1,201 @@
+//***************************************************************************************
+// CommandContextPool.h
+//
+// Pool of command allocators and command lists shared by every thread that records
+// commands.  Acquire hands out an open list on an allocator nobody else is recording
+// into; Release returns both once the list has been submitted, with the fence value the
+// queue will signal after it.  The list is reusable straight away, the allocator only
+// once the GPU has passed that fence, at which point it is reset and handed out again.
+//
+// Allocators remember the thread that last used them and are preferably handed back to
+// it, so a thread that records the same work every frame keeps reusing allocator memory
+// that has already grown to the right size.  The pool tracks how much each allocator
+// was asked to hold between resets and keeps the peak.
+//
+// The pool only deals in allocator and list indices.  The objects behind them live in a
+// CommandBackend: D3D12CommandBackend creates real ones, NullCommandBackend records the
+// calls and checks the allocator/list rules so the pooling can be exercised headless.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CommandBackend
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	virtual ~CommandBackend() = default;
+
+	// Indices are dense and handed out in increasing order.
+	virtual void CreateAllocator(uint32 allocator) = 0;
+	virtual void ResetAllocator(uint32 allocator) = 0;
+
+	// Creates the list open for recording on the allocator.
+	virtual void CreateList(uint32 list, uint32 allocator) = 0;
+	virtual void ResetList(uint32 list, uint32 allocator) = 0;
+	virtual void CloseList(uint32 list) = 0;
+
+	// Last fence value the GPU has completed.
+	virtual uint64 CompletedFence()const = 0;
+};
+
+class CommandContextPool
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// An open list and the allocator behind it, owned by one thread until Release.
+	struct Context
+	{
+		uint32 List = ~0u;
+		uint32 Allocator = ~0u;
+		uint32 Thread = 0;
+	};
+
+	struct AllocatorStats
+	{
+		uint32 Uses = 0;          // times handed out
+		uint32 Resets = 0;
+		uint64 Bytes = 0;         // recorded since the last reset
+		uint64 PeakBytes = 0;
+	};
+
+	struct Stats
+	{
+		uint32 AllocatorCount = 0;
+		uint32 ListCount = 0;
+		uint32 Acquires = 0;
+		uint32 AllocatorsReused = 0;   // acquires served by a reset allocator, not a new one
+		uint32 ThreadHits = 0;         // ... that last ran on the acquiring thread
+		uint32 InFlight = 0;           // allocators waiting on their fence
+		uint64 PeakBytes = 0;          // largest AllocatorStats::PeakBytes
+		uint64 TotalPeakBytes = 0;     // sum of them, i.e. the memory the pool holds on to
+	};
+
+	explicit CommandContextPool(CommandBackend& backend);
+	CommandContextPool(const CommandContextPool& rhs) = delete;
+	CommandContextPool& operator=(const CommandContextPool& rhs) = delete;
+
+	// Open list for the calling thread.  thread is any small id the caller uses to tell
+	// its threads apart (a ThreadPool slot, for instance).
+	Context Acquire(uint32 thread = 0);
+
+	// Adds to the bytes recorded into the context's allocator.  The backend cannot always
+	// tell (D3D12 does not expose allocator sizes), so callers report what they know.
+	void AddRecordedBytes(const Context& context, uint64 bytes);
+
+	void Close(const Context& context);
+
+	///<summary>
+	/// Gives back a closed list after it has been submitted.  The allocator stays out of
+	/// the pool until CompletedFence() reaches fence.
+	///</summary>
+	void Release(const Context& context, uint64 fence);
+
+	// Resets every allocator whose fence has completed.  Acquire does this on its own;
+	// call it to reclaim memory without acquiring.
+	void Recycle();
+
+	uint32 AllocatorCount()const;
+	uint32 ListCount()const;
+	AllocatorStats GetAllocatorStats(uint32 allocator)const;
+	Stats GetStats()const;
+
+private:
+	struct Allocator
+	{
+		AllocatorStats Stats;
+		uint64 Fence = 0;
+		uint32 LastThread = ~0u;
+		bool InFlight = false;
+		bool Recording = false;
+	};
+
+	void RecycleLocked();
+
+private:
+	CommandBackend& mBackend;
+
+	mutable std::mutex mMutex;
+
+	std::vector<Allocator> mAllocators;
+	std::vector<uint32> mFreeAllocators;
+	std::vector<uint32> mInFlight;   // in release order, so fences are increasing
+
+	uint32 mListCount = 0;
+	std::vector<uint32> mFreeLists;
+
+	Stats mStats;
+};
+
+///<summary>
+/// Backend without a GPU.  Every call is appended to a log and checked against the rules
+/// D3D12 enforces; breaking one counts a violation instead of crashing the driver.
+/// The completed fence only moves when SetCompletedFence is called.
+///</summary>
+class NullCommandBackend : public CommandBackend
+{
+public:
+	struct Call
+	{
+		enum class Kind
+		{
+			CreateAllocator,
+			ResetAllocator,
+			CreateList,
+			ResetList,
+			CloseList
+		};
+
+		Kind Type;
+		uint32 List;
+		uint32 Allocator;
+	};
+
+	void CreateAllocator(uint32 allocator)override;
+	void ResetAllocator(uint32 allocator)override;
+	void CreateList(uint32 list, uint32 allocator)override;
+	void ResetList(uint32 list, uint32 allocator)override;
+	void CloseList(uint32 list)override;
+	uint64 CompletedFence()const override;
+
+	///<summary>
+	/// Marks the allocator's commands as submitted up to fence.  Resetting it before
+	/// the completed fence reaches that value is a violation.
+	///</summary>
+	void Submit(uint32 list, uint64 fence);
+	void SetCompletedFence(uint64 fence);
+
+	const std::vector<Call>& GetCalls()const;
+	const std::vector<std::string>& GetViolations()const;
+
+private:
+	void Violation(const std::string& what);
+
+private:
+	struct AllocatorState
+	{
+		uint32 OpenLists = 0;
+		uint64 PendingFence = 0;
+	};
+
+	struct ListState
+	{
+		uint32 Allocator = ~0u;
+		bool Open = false;
+	};
+
+	mutable std::mutex mMutex;
+	std::vector<AllocatorState> mAllocators;
+	std::vector<ListState> mLists;
+	std::vector<Call> mCalls;
+	std::vector<std::string> mViolations;
+	uint64 mCompletedFence = 0;
+};
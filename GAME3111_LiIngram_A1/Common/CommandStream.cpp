@@ -0,0 +1,743 @@
+//***************************************************************************************
+// CommandStream.cpp
+//***************************************************************************************
+
+#include "CommandStream.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+const CommandSink::uint32 CommandCapture::Magic;
+const CommandSink::uint32 CommandCapture::Version;
+
+namespace
+{
+	// Reads arguments back in the order CommandCapture wrote them.  Reading past the end
+	// clears Ok and returns zeros, so a truncated stream is caught after the command.
+	class Reader
+	{
+	public:
+		Reader(const std::uint8_t* data, size_t size) : mPos(data), mEnd(data + size) {}
+
+		template<typename T>
+		T Get()
+		{
+			T value = T();
+			if(!Ok || (size_t)(mEnd - mPos) < sizeof(T))
+			{
+				Ok = false;
+				return value;
+			}
+			memcpy(&value, mPos, sizeof(T));
+			mPos += sizeof(T);
+			return value;
+		}
+
+		const std::uint8_t* Bytes(size_t size)
+		{
+			if(!Ok || (size_t)(mEnd - mPos) < size)
+			{
+				Ok = false;
+				return nullptr;
+			}
+			const std::uint8_t* p = mPos;
+			mPos += size;
+			return p;
+		}
+
+		bool AtEnd()const
+		{
+			return mPos == mEnd;
+		}
+
+		size_t Remaining()const
+		{
+			return (size_t)(mEnd - mPos);
+		}
+
+		bool Ok = true;
+
+	private:
+		const std::uint8_t* mPos;
+		const std::uint8_t* mEnd;
+	};
+
+	// The exact bit pattern, so values that differ in any bit give different checksums.
+	std::uint64_t Bits(float value)
+	{
+		std::uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+}
+
+//
+// NullCommandSink
+//
+
+void NullCommandSink::Mix(uint64 value)
+{
+	mChecksum = (mChecksum ^ value) * 1099511628211ull;
+}
+
+void NullCommandSink::BeginFrame(uint64 frame) { ++mCommands; Mix(frame); }
+void NullCommandSink::EndFrame() { ++mCommands; }
+void NullCommandSink::SetPipelineState(uint32 pso) { ++mCommands; Mix(pso); }
+void NullCommandSink::SetRootSignature(uint32 rootSignature) { ++mCommands; Mix(rootSignature); }
+void NullCommandSink::SetDescriptorHeap(uint32 heap) { ++mCommands; Mix(heap); }
+
+void NullCommandSink::SetViewport(const Viewport& viewport)
+{
+	++mCommands;
+	Mix(Bits(viewport.X) ^ (Bits(viewport.Y) << 32));
+	Mix(Bits(viewport.Width) ^ (Bits(viewport.Height) << 32));
+	Mix(Bits(viewport.MinDepth) ^ (Bits(viewport.MaxDepth) << 32));
+}
+
+void NullCommandSink::SetScissorRect(const Rect& rect)
+{
+	++mCommands;
+	Mix((uint64)(uint32)rect.Left ^ ((uint64)(uint32)rect.Top << 32));
+	Mix((uint64)(uint32)rect.Right ^ ((uint64)(uint32)rect.Bottom << 32));
+}
+
+void NullCommandSink::ResourceBarriers(const Barrier* barriers, uint32 count)
+{
+	++mCommands;
+	Mix(count);
+	for(uint32 i = 0; i < count; ++i)
+	{
+		Mix((uint64)barriers[i].Type ^ ((uint64)barriers[i].Resource << 32));
+		Mix(barriers[i].Other);
+		Mix(barriers[i].Before ^ ((uint64)barriers[i].After << 32));
+	}
+}
+
+void NullCommandSink::ClearRenderTarget(uint32 renderTarget, const float color[4])
+{
+	++mCommands;
+	Mix(renderTarget);
+	Mix(Bits(color[0]) ^ (Bits(color[1]) << 32));
+	Mix(Bits(color[2]) ^ (Bits(color[3]) << 32));
+}
+
+void NullCommandSink::ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)
+{
+	++mCommands;
+	Mix(depthStencil ^ ((uint64)stencil << 32));
+	Mix(Bits(depth));
+}
+
+void NullCommandSink::SetRenderTarget(uint32 renderTarget, uint32 depthStencil)
+{
+	++mCommands;
+	Mix(renderTarget ^ ((uint64)depthStencil << 32));
+}
+
+void NullCommandSink::SetDescriptorTable(uint32 parameter, uint32 descriptor)
+{
+	++mCommands;
+	Mix(parameter ^ ((uint64)descriptor << 32));
+}
+
+void NullCommandSink::SetRootConstant(uint32 parameter, uint32 value)
+{
+	++mCommands;
+	Mix(parameter ^ ((uint64)value << 32));
+}
+
+void NullCommandSink::SetRootShaderResource(uint32 parameter, uint32 buffer)
+{
+	++mCommands;
+	Mix(parameter ^ ((uint64)buffer << 32));
+}
+
+void NullCommandSink::SetVertexBuffer(uint32 geometry) { ++mCommands; Mix(geometry); }
+void NullCommandSink::SetIndexBuffer(uint32 geometry) { ++mCommands; Mix(geometry); }
+void NullCommandSink::SetTopology(uint32 topology) { ++mCommands; Mix(topology); }
+
+void NullCommandSink::DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+	int32 baseVertex, uint32 startInstance)
+{
+	++mCommands;
+	++mDraws;
+	Mix(indexCount ^ ((uint64)startIndex << 32));
+	Mix((uint32)baseVertex ^ ((uint64)instanceCount << 32));
+	Mix(startInstance);
+}
+
+void NullCommandSink::UploadContents(uint32 buffer, const void* data, uint32 size)
+{
+	++mCommands;
+	mUploadBytes += size;
+
+	// Touch every byte, as a real upload would.
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	uint64 sum = buffer;
+	for(uint32 i = 0; i < size; ++i)
+		sum = sum * 31 + bytes[i];
+	Mix(sum);
+}
+
+NullCommandSink::uint64 NullCommandSink::CommandCount()const
+{
+	return mCommands;
+}
+
+NullCommandSink::uint64 NullCommandSink::DrawCount()const
+{
+	return mDraws;
+}
+
+NullCommandSink::uint64 NullCommandSink::UploadBytes()const
+{
+	return mUploadBytes;
+}
+
+NullCommandSink::uint64 NullCommandSink::Checksum()const
+{
+	return mChecksum;
+}
+
+//
+// CommandCapture
+//
+
+CommandCapture::CommandCapture(uint32 frameCount, CommandSink* next)
+	: mFrameCount(frameCount), mNext(next)
+{
+}
+
+bool CommandCapture::Recording()const
+{
+	return mInFrame;
+}
+
+void CommandCapture::Op(CommandOp op)
+{
+	mStream.push_back((uint8)op);
+}
+
+template<typename T>
+void CommandCapture::Put(T value)
+{
+	size_t offset = mStream.size();
+	mStream.resize(offset + sizeof(T));
+	memcpy(&mStream[offset], &value, sizeof(T));
+}
+
+void CommandCapture::BeginFrame(uint64 frame)
+{
+	mInFrame = mCapturedFrames < mFrameCount;
+	if(Recording())
+	{
+		Op(CommandOp::BeginFrame);
+		Put(frame);
+	}
+	if(mNext != nullptr)
+		mNext->BeginFrame(frame);
+}
+
+void CommandCapture::EndFrame()
+{
+	if(Recording())
+	{
+		Op(CommandOp::EndFrame);
+		++mCapturedFrames;
+		mInFrame = false;
+	}
+	if(mNext != nullptr)
+		mNext->EndFrame();
+}
+
+void CommandCapture::SetPipelineState(uint32 pso)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetPipelineState);
+		Put(pso);
+	}
+	if(mNext != nullptr)
+		mNext->SetPipelineState(pso);
+}
+
+void CommandCapture::SetRootSignature(uint32 rootSignature)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetRootSignature);
+		Put(rootSignature);
+	}
+	if(mNext != nullptr)
+		mNext->SetRootSignature(rootSignature);
+}
+
+void CommandCapture::SetDescriptorHeap(uint32 heap)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetDescriptorHeap);
+		Put(heap);
+	}
+	if(mNext != nullptr)
+		mNext->SetDescriptorHeap(heap);
+}
+
+void CommandCapture::SetViewport(const Viewport& viewport)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetViewport);
+		Put(viewport.X);
+		Put(viewport.Y);
+		Put(viewport.Width);
+		Put(viewport.Height);
+		Put(viewport.MinDepth);
+		Put(viewport.MaxDepth);
+	}
+	if(mNext != nullptr)
+		mNext->SetViewport(viewport);
+}
+
+void CommandCapture::SetScissorRect(const Rect& rect)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetScissorRect);
+		Put(rect.Left);
+		Put(rect.Top);
+		Put(rect.Right);
+		Put(rect.Bottom);
+	}
+	if(mNext != nullptr)
+		mNext->SetScissorRect(rect);
+}
+
+void CommandCapture::ResourceBarriers(const Barrier* barriers, uint32 count)
+{
+	if(Recording())
+	{
+		Op(CommandOp::ResourceBarriers);
+		Put(count);
+		for(uint32 i = 0; i < count; ++i)
+		{
+			Put((uint8)barriers[i].Type);
+			Put(barriers[i].Resource);
+			Put(barriers[i].Other);
+			Put(barriers[i].Before);
+			Put(barriers[i].After);
+		}
+	}
+	if(mNext != nullptr)
+		mNext->ResourceBarriers(barriers, count);
+}
+
+void CommandCapture::ClearRenderTarget(uint32 renderTarget, const float color[4])
+{
+	if(Recording())
+	{
+		Op(CommandOp::ClearRenderTarget);
+		Put(renderTarget);
+		for(int i = 0; i < 4; ++i)
+			Put(color[i]);
+	}
+	if(mNext != nullptr)
+		mNext->ClearRenderTarget(renderTarget, color);
+}
+
+void CommandCapture::ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)
+{
+	if(Recording())
+	{
+		Op(CommandOp::ClearDepthStencil);
+		Put(depthStencil);
+		Put(depth);
+		Put(stencil);
+	}
+	if(mNext != nullptr)
+		mNext->ClearDepthStencil(depthStencil, depth, stencil);
+}
+
+void CommandCapture::SetRenderTarget(uint32 renderTarget, uint32 depthStencil)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetRenderTarget);
+		Put(renderTarget);
+		Put(depthStencil);
+	}
+	if(mNext != nullptr)
+		mNext->SetRenderTarget(renderTarget, depthStencil);
+}
+
+void CommandCapture::SetDescriptorTable(uint32 parameter, uint32 descriptor)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetDescriptorTable);
+		Put(parameter);
+		Put(descriptor);
+	}
+	if(mNext != nullptr)
+		mNext->SetDescriptorTable(parameter, descriptor);
+}
+
+void CommandCapture::SetRootConstant(uint32 parameter, uint32 value)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetRootConstant);
+		Put(parameter);
+		Put(value);
+	}
+	if(mNext != nullptr)
+		mNext->SetRootConstant(parameter, value);
+}
+
+void CommandCapture::SetRootShaderResource(uint32 parameter, uint32 buffer)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetRootShaderResource);
+		Put(parameter);
+		Put(buffer);
+	}
+	if(mNext != nullptr)
+		mNext->SetRootShaderResource(parameter, buffer);
+}
+
+void CommandCapture::SetVertexBuffer(uint32 geometry)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetVertexBuffer);
+		Put(geometry);
+	}
+	if(mNext != nullptr)
+		mNext->SetVertexBuffer(geometry);
+}
+
+void CommandCapture::SetIndexBuffer(uint32 geometry)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetIndexBuffer);
+		Put(geometry);
+	}
+	if(mNext != nullptr)
+		mNext->SetIndexBuffer(geometry);
+}
+
+void CommandCapture::SetTopology(uint32 topology)
+{
+	if(Recording())
+	{
+		Op(CommandOp::SetTopology);
+		Put(topology);
+	}
+	if(mNext != nullptr)
+		mNext->SetTopology(topology);
+}
+
+void CommandCapture::DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+	int32 baseVertex, uint32 startInstance)
+{
+	if(Recording())
+	{
+		Op(CommandOp::DrawIndexed);
+		Put(indexCount);
+		Put(instanceCount);
+		Put(startIndex);
+		Put(baseVertex);
+		Put(startInstance);
+	}
+	if(mNext != nullptr)
+		mNext->DrawIndexed(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void CommandCapture::UploadContents(uint32 buffer, const void* data, uint32 size)
+{
+	if(Recording())
+	{
+		Op(CommandOp::UploadContents);
+		Put(buffer);
+		Put(size);
+		const uint8* bytes = static_cast<const uint8*>(data);
+		mStream.insert(mStream.end(), bytes, bytes + size);
+	}
+	if(mNext != nullptr)
+		mNext->UploadContents(buffer, data, size);
+}
+
+bool CommandCapture::IsComplete()const
+{
+	return mCapturedFrames >= mFrameCount;
+}
+
+CommandCapture::uint32 CommandCapture::CapturedFrames()const
+{
+	return mCapturedFrames;
+}
+
+std::vector<CommandSink::uint8> CommandCapture::GetData()const
+{
+	// The header as one array of uint32s, copied in native order like every other scalar.
+	uint32 header[3] = { Magic, Version, mCapturedFrames };
+	const uint8* headerBytes = reinterpret_cast<const uint8*>(header);
+
+	std::vector<uint8> data;
+	data.reserve(sizeof(header) + mStream.size());
+	data.insert(data.end(), headerBytes, headerBytes + sizeof(header));
+	data.insert(data.end(), mStream.begin(), mStream.end());
+	return data;
+}
+
+bool CommandCapture::Save(const std::string& path)const
+{
+	std::vector<uint8> data = GetData();
+
+	std::ofstream fout(path, std::ios::binary);
+	fout.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return (bool)fout;
+}
+
+//
+// CommandReplay
+//
+
+std::vector<std::uint8_t> CommandReplay::Load(const std::string& path, std::string* error)
+{
+	std::vector<std::uint8_t> data;
+
+	std::ifstream fin(path, std::ios::binary);
+	if(!fin)
+	{
+		if(error != nullptr)
+			*error = "cannot open " + path;
+		return data;
+	}
+
+	fin.seekg(0, std::ios_base::end);
+	data.resize((size_t)fin.tellg());
+	fin.seekg(0, std::ios_base::beg);
+	fin.read(reinterpret_cast<char*>(data.data()), data.size());
+
+	Reader reader(data.data(), data.size());
+	std::uint32_t magic = reader.Get<std::uint32_t>();
+	std::uint32_t version = reader.Get<std::uint32_t>();
+	if(!reader.Ok || magic != CommandCapture::Magic || version != CommandCapture::Version)
+	{
+		if(error != nullptr)
+			*error = path + " is not a version " + std::to_string(CommandCapture::Version) + " command capture";
+		data.clear();
+	}
+
+	return data;
+}
+
+bool CommandReplay::Replay(const std::vector<std::uint8_t>& data, CommandSink& sink, Stats& stats,
+	std::string* error)
+{
+	using Clock = std::chrono::steady_clock;
+	using uint8 = CommandSink::uint8;
+	using uint32 = CommandSink::uint32;
+	using uint64 = CommandSink::uint64;
+	using int32 = CommandSink::int32;
+
+	stats = Stats();
+
+	Reader reader(data.data(), data.size());
+	reader.Get<uint32>();
+	reader.Get<uint32>();
+	stats.Frames = reader.Get<uint32>();
+
+	std::vector<CommandSink::Barrier> barriers;
+	Clock::time_point frameStart;
+	Clock::time_point start = Clock::now();
+
+	while(reader.Ok && !reader.AtEnd())
+	{
+		CommandOp op = (CommandOp)reader.Get<uint8>();
+		Clock::time_point opStart = Clock::now();
+
+		switch(op)
+		{
+		case CommandOp::BeginFrame:
+			frameStart = opStart;
+			sink.BeginFrame(reader.Get<uint64>());
+			break;
+		case CommandOp::EndFrame:
+			sink.EndFrame();
+			stats.FrameMilliseconds.push_back(
+				std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+			break;
+		case CommandOp::SetPipelineState:
+			sink.SetPipelineState(reader.Get<uint32>());
+			break;
+		case CommandOp::SetRootSignature:
+			sink.SetRootSignature(reader.Get<uint32>());
+			break;
+		case CommandOp::SetDescriptorHeap:
+			sink.SetDescriptorHeap(reader.Get<uint32>());
+			break;
+		case CommandOp::SetViewport:
+		{
+			CommandSink::Viewport viewport;
+			viewport.X = reader.Get<float>();
+			viewport.Y = reader.Get<float>();
+			viewport.Width = reader.Get<float>();
+			viewport.Height = reader.Get<float>();
+			viewport.MinDepth = reader.Get<float>();
+			viewport.MaxDepth = reader.Get<float>();
+			sink.SetViewport(viewport);
+			break;
+		}
+		case CommandOp::SetScissorRect:
+		{
+			CommandSink::Rect rect;
+			rect.Left = reader.Get<int32>();
+			rect.Top = reader.Get<int32>();
+			rect.Right = reader.Get<int32>();
+			rect.Bottom = reader.Get<int32>();
+			sink.SetScissorRect(rect);
+			break;
+		}
+		case CommandOp::ResourceBarriers:
+		{
+			// 17 bytes per barrier; checked first so a corrupt count cannot allocate gigabytes.
+			uint32 count = reader.Get<uint32>();
+			if(count > reader.Remaining() / 17)
+				reader.Ok = false;
+			barriers.resize(reader.Ok ? count : 0);
+			for(CommandSink::Barrier& b : barriers)
+			{
+				b.Type = (CommandSink::Barrier::Kind)reader.Get<uint8>();
+				b.Resource = reader.Get<uint32>();
+				b.Other = reader.Get<uint32>();
+				b.Before = reader.Get<uint32>();
+				b.After = reader.Get<uint32>();
+			}
+			if(reader.Ok)
+				sink.ResourceBarriers(barriers.data(), count);
+			break;
+		}
+		case CommandOp::ClearRenderTarget:
+		{
+			uint32 renderTarget = reader.Get<uint32>();
+			float color[4];
+			for(int i = 0; i < 4; ++i)
+				color[i] = reader.Get<float>();
+			sink.ClearRenderTarget(renderTarget, color);
+			break;
+		}
+		case CommandOp::ClearDepthStencil:
+		{
+			uint32 depthStencil = reader.Get<uint32>();
+			float depth = reader.Get<float>();
+			sink.ClearDepthStencil(depthStencil, depth, reader.Get<uint8>());
+			break;
+		}
+		case CommandOp::SetRenderTarget:
+		{
+			uint32 renderTarget = reader.Get<uint32>();
+			sink.SetRenderTarget(renderTarget, reader.Get<uint32>());
+			break;
+		}
+		case CommandOp::SetDescriptorTable:
+		{
+			uint32 parameter = reader.Get<uint32>();
+			sink.SetDescriptorTable(parameter, reader.Get<uint32>());
+			break;
+		}
+		case CommandOp::SetRootConstant:
+		{
+			uint32 parameter = reader.Get<uint32>();
+			sink.SetRootConstant(parameter, reader.Get<uint32>());
+			break;
+		}
+		case CommandOp::SetRootShaderResource:
+		{
+			uint32 parameter = reader.Get<uint32>();
+			sink.SetRootShaderResource(parameter, reader.Get<uint32>());
+			break;
+		}
+		case CommandOp::SetVertexBuffer:
+			sink.SetVertexBuffer(reader.Get<uint32>());
+			break;
+		case CommandOp::SetIndexBuffer:
+			sink.SetIndexBuffer(reader.Get<uint32>());
+			break;
+		case CommandOp::SetTopology:
+			sink.SetTopology(reader.Get<uint32>());
+			break;
+		case CommandOp::DrawIndexed:
+		{
+			uint32 indexCount = reader.Get<uint32>();
+			uint32 instanceCount = reader.Get<uint32>();
+			uint32 startIndex = reader.Get<uint32>();
+			int32 baseVertex = reader.Get<int32>();
+			uint32 startInstance = reader.Get<uint32>();
+			if(reader.Ok)
+				sink.DrawIndexed(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+			break;
+		}
+		case CommandOp::UploadContents:
+		{
+			uint32 buffer = reader.Get<uint32>();
+			uint32 size = reader.Get<uint32>();
+			const std::uint8_t* bytes = reader.Bytes(size);
+			if(bytes != nullptr)
+				sink.UploadContents(buffer, bytes, size);
+			break;
+		}
+		default:
+			if(error != nullptr)
+				*error = "unknown command " + std::to_string((int)op);
+			return false;
+		}
+
+		OpStats& opStats = stats.Ops[(size_t)op];
+		++opStats.Count;
+		opStats.Microseconds += std::chrono::duration<double, std::micro>(Clock::now() - opStart).count();
+		++stats.Commands;
+	}
+
+	stats.Milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	if(!reader.Ok)
+	{
+		if(error != nullptr)
+			*error = "stream truncated";
+		return false;
+	}
+	return true;
+}
+
+const char* CommandReplay::OpName(CommandOp op)
+{
+	static const char* const names[] =
+	{
+		"BeginFrame",
+		"EndFrame",
+		"SetPipelineState",
+		"SetRootSignature",
+		"SetDescriptorHeap",
+		"SetViewport",
+		"SetScissorRect",
+		"ResourceBarriers",
+		"ClearRenderTarget",
+		"ClearDepthStencil",
+		"SetRenderTarget",
+		"SetDescriptorTable",
+		"SetRootConstant",
+		"SetRootShaderResource",
+		"SetVertexBuffer",
+		"SetIndexBuffer",
+		"SetTopology",
+		"DrawIndexed",
+		"UploadContents"
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == (size_t)CommandOp::Count, "name every command");
+
+	return (size_t)op < (size_t)CommandOp::Count ? names[(size_t)op] : "Unknown";
+}
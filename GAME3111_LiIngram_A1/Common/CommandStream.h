@@ -0,0 +1,249 @@
+//***************************************************************************************
+// CommandStream.h
+//
+// The commands a frame records, as calls on a CommandSink with every object named by a
+// small integer id instead of a pointer.  D3D12CommandSink turns them into calls on a
+// real command list; the classes here never touch Direct3D and build anywhere.
+//
+// CommandCapture is a sink that appends each command to a compact binary stream and
+// passes it on to the next sink, for a fixed number of frames.  Besides the commands, the
+// stream holds the upload buffer contents each frame reported with UploadContents.
+//
+// CommandReplay reads such a stream back and calls the same commands on any sink, timing
+// each one, so the submission side of captured frames can be profiled offline against
+// NullCommandSink and two builds compared on exactly the same workload.
+//
+// File layout: three uint32s (Magic, Version, frame count), then per command a one byte
+// CommandOp and its arguments, each scalar little endian at its natural size, unpadded.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class CommandOp : std::uint8_t
+{
+	BeginFrame,
+	EndFrame,
+	SetPipelineState,
+	SetRootSignature,
+	SetDescriptorHeap,
+	SetViewport,
+	SetScissorRect,
+	ResourceBarriers,
+	ClearRenderTarget,
+	ClearDepthStencil,
+	SetRenderTarget,
+	SetDescriptorTable,
+	SetRootConstant,
+	SetRootShaderResource,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetTopology,
+	DrawIndexed,
+	UploadContents,
+
+	Count
+};
+
+class CommandSink
+{
+public:
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+	using int32 = std::int32_t;
+
+	struct Viewport
+	{
+		float X, Y, Width, Height, MinDepth, MaxDepth;
+	};
+
+	struct Rect
+	{
+		int32 Left, Top, Right, Bottom;
+	};
+
+	struct Barrier
+	{
+		enum class Kind : uint8
+		{
+			Transition,
+			Aliasing,
+			UnorderedAccess
+		};
+
+		Kind Type = Kind::Transition;
+		uint32 Resource = 0;
+		uint32 Other = ~0u;       // aliasing: the resource aliased before, ~0u for any
+		uint32 Before = 0;        // transition states
+		uint32 After = 0;
+	};
+
+	virtual ~CommandSink() = default;
+
+	virtual void BeginFrame(uint64 frame) = 0;
+	virtual void EndFrame() = 0;
+
+	virtual void SetPipelineState(uint32 pso) = 0;
+	virtual void SetRootSignature(uint32 rootSignature) = 0;
+	virtual void SetDescriptorHeap(uint32 heap) = 0;
+	virtual void SetViewport(const Viewport& viewport) = 0;
+	virtual void SetScissorRect(const Rect& rect) = 0;
+	virtual void ResourceBarriers(const Barrier* barriers, uint32 count) = 0;
+	virtual void ClearRenderTarget(uint32 renderTarget, const float color[4]) = 0;
+	virtual void ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil) = 0;
+	virtual void SetRenderTarget(uint32 renderTarget, uint32 depthStencil) = 0;
+
+	// descriptor is an index into the heap set with SetDescriptorHeap.
+	virtual void SetDescriptorTable(uint32 parameter, uint32 descriptor) = 0;
+	virtual void SetRootConstant(uint32 parameter, uint32 value) = 0;
+	virtual void SetRootShaderResource(uint32 parameter, uint32 buffer) = 0;
+
+	virtual void SetVertexBuffer(uint32 geometry) = 0;
+	virtual void SetIndexBuffer(uint32 geometry) = 0;
+	virtual void SetTopology(uint32 topology) = 0;
+	virtual void DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+		int32 baseVertex, uint32 startInstance) = 0;
+
+	///<summary>
+	/// Reports what the CPU wrote to an upload buffer for this frame.  The data is already
+	/// in the buffer, so live sinks ignore it; captures keep it for replay.
+	///</summary>
+	virtual void UploadContents(uint32 buffer, const void* data, uint32 size) = 0;
+};
+
+// Counts commands and reads every uploaded byte, and does nothing else.
+class NullCommandSink : public CommandSink
+{
+public:
+	void BeginFrame(uint64 frame)override;
+	void EndFrame()override;
+	void SetPipelineState(uint32 pso)override;
+	void SetRootSignature(uint32 rootSignature)override;
+	void SetDescriptorHeap(uint32 heap)override;
+	void SetViewport(const Viewport& viewport)override;
+	void SetScissorRect(const Rect& rect)override;
+	void ResourceBarriers(const Barrier* barriers, uint32 count)override;
+	void ClearRenderTarget(uint32 renderTarget, const float color[4])override;
+	void ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)override;
+	void SetRenderTarget(uint32 renderTarget, uint32 depthStencil)override;
+	void SetDescriptorTable(uint32 parameter, uint32 descriptor)override;
+	void SetRootConstant(uint32 parameter, uint32 value)override;
+	void SetRootShaderResource(uint32 parameter, uint32 buffer)override;
+	void SetVertexBuffer(uint32 geometry)override;
+	void SetIndexBuffer(uint32 geometry)override;
+	void SetTopology(uint32 topology)override;
+	void DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+		int32 baseVertex, uint32 startInstance)override;
+	void UploadContents(uint32 buffer, const void* data, uint32 size)override;
+
+	uint64 CommandCount()const;
+	uint64 DrawCount()const;
+	uint64 UploadBytes()const;
+
+	// Mixes in every argument, floats by their exact bits, so two replays of one capture
+	// give the same value and a change to any argument changes it.
+	uint64 Checksum()const;
+
+private:
+	void Mix(uint64 value);
+
+private:
+	uint64 mCommands = 0;
+	uint64 mDraws = 0;
+	uint64 mUploadBytes = 0;
+	uint64 mChecksum = 14695981039346656037ull;
+};
+
+class CommandCapture : public CommandSink
+{
+public:
+	static const uint32 Magic = 0x53444d43;    // "CMDS"
+	static const uint32 Version = 1;
+
+	// Captures the next frameCount frames; every command is also passed on to next,
+	// which may be nullptr.
+	CommandCapture(uint32 frameCount, CommandSink* next = nullptr);
+
+	void BeginFrame(uint64 frame)override;
+	void EndFrame()override;
+	void SetPipelineState(uint32 pso)override;
+	void SetRootSignature(uint32 rootSignature)override;
+	void SetDescriptorHeap(uint32 heap)override;
+	void SetViewport(const Viewport& viewport)override;
+	void SetScissorRect(const Rect& rect)override;
+	void ResourceBarriers(const Barrier* barriers, uint32 count)override;
+	void ClearRenderTarget(uint32 renderTarget, const float color[4])override;
+	void ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)override;
+	void SetRenderTarget(uint32 renderTarget, uint32 depthStencil)override;
+	void SetDescriptorTable(uint32 parameter, uint32 descriptor)override;
+	void SetRootConstant(uint32 parameter, uint32 value)override;
+	void SetRootShaderResource(uint32 parameter, uint32 buffer)override;
+	void SetVertexBuffer(uint32 geometry)override;
+	void SetIndexBuffer(uint32 geometry)override;
+	void SetTopology(uint32 topology)override;
+	void DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+		int32 baseVertex, uint32 startInstance)override;
+	void UploadContents(uint32 buffer, const void* data, uint32 size)override;
+
+	// True once frameCount frames have ended.
+	bool IsComplete()const;
+	uint32 CapturedFrames()const;
+
+	// The file header followed by the captured commands.
+	std::vector<uint8> GetData()const;
+	bool Save(const std::string& path)const;
+
+private:
+	bool Recording()const;
+	void Op(CommandOp op);
+
+	template<typename T>
+	void Put(T value);
+
+private:
+	uint32 mFrameCount;
+	CommandSink* mNext;
+
+	std::vector<uint8> mStream;
+	uint32 mCapturedFrames = 0;
+	bool mInFrame = false;
+};
+
+class CommandReplay
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct OpStats
+	{
+		uint64 Count = 0;
+		double Microseconds = 0.0;
+	};
+
+	struct Stats
+	{
+		uint32 Frames = 0;
+		uint64 Commands = 0;
+		double Milliseconds = 0.0;               // whole replay, including the timing
+		std::vector<double> FrameMilliseconds;   // BeginFrame to EndFrame
+		OpStats Ops[(size_t)CommandOp::Count];
+	};
+
+	// Empty with error set if the file is missing or not a version we read.
+	static std::vector<std::uint8_t> Load(const std::string& path, std::string* error = nullptr);
+
+	///<summary>
+	/// Calls the captured commands on sink, timing each one.  Returns false (with error
+	/// set) if the stream is truncated or holds an unknown command; the commands before
+	/// that point have been replayed.
+	///</summary>
+	static bool Replay(const std::vector<std::uint8_t>& data, CommandSink& sink, Stats& stats,
+		std::string* error = nullptr);
+
+	static const char* OpName(CommandOp op);
+};
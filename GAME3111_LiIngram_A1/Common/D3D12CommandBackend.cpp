@@ -0,0 +1,78 @@
+//***************************************************************************************
+// D3D12CommandBackend.cpp
+//***************************************************************************************
+
+#include "D3D12CommandBackend.h"
+
+using Microsoft::WRL::ComPtr;
+
+D3D12CommandBackend::D3D12CommandBackend(ID3D12Device* device, ID3D12Fence* fence, D3D12_COMMAND_LIST_TYPE type)
+	: mDevice(device), mFence(fence), mType(type)
+{
+}
+
+void D3D12CommandBackend::CreateAllocator(uint32 allocator)
+{
+	ComPtr<ID3D12CommandAllocator> alloc;
+	ThrowIfFailed(mDevice->CreateCommandAllocator(mType, IID_PPV_ARGS(alloc.GetAddressOf())));
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	assert(allocator == mAllocators.size());
+	mAllocators.push_back(alloc);
+}
+
+void D3D12CommandBackend::ResetAllocator(uint32 allocator)
+{
+	ID3D12CommandAllocator* alloc;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		alloc = mAllocators[allocator].Get();
+	}
+
+	ThrowIfFailed(alloc->Reset());
+}
+
+void D3D12CommandBackend::CreateList(uint32 list, uint32 allocator)
+{
+	ID3D12CommandAllocator* alloc;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		alloc = mAllocators[allocator].Get();
+	}
+
+	ComPtr<ID3D12GraphicsCommandList> cmdList;
+	ThrowIfFailed(mDevice->CreateCommandList(0, mType, alloc, nullptr, IID_PPV_ARGS(cmdList.GetAddressOf())));
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	assert(list == mLists.size());
+	mLists.push_back(cmdList);
+}
+
+void D3D12CommandBackend::ResetList(uint32 list, uint32 allocator)
+{
+	ID3D12GraphicsCommandList* cmdList;
+	ID3D12CommandAllocator* alloc;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		cmdList = mLists[list].Get();
+		alloc = mAllocators[allocator].Get();
+	}
+
+	ThrowIfFailed(cmdList->Reset(alloc, nullptr));
+}
+
+void D3D12CommandBackend::CloseList(uint32 list)
+{
+	ThrowIfFailed(GetList(list)->Close());
+}
+
+D3D12CommandBackend::uint64 D3D12CommandBackend::CompletedFence()const
+{
+	return mFence->GetCompletedValue();
+}
+
+ID3D12GraphicsCommandList* D3D12CommandBackend::GetList(uint32 list)const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mLists[list].Get();
+}
@@ -0,0 +1,38 @@
+//***************************************************************************************
+// D3D12CommandBackend.h
+//
+// CommandBackend over real D3D12 command allocators and graphics command lists of one
+// type, with the pool's allocator and list indices mapping straight onto its arrays.
+//***************************************************************************************
+
+#pragma once
+
+#include "CommandContextPool.h"
+#include "d3dUtil.h"
+
+class D3D12CommandBackend : public CommandBackend
+{
+public:
+	// fence is the one the queue signals with the values passed to Release.
+	D3D12CommandBackend(ID3D12Device* device, ID3D12Fence* fence,
+		D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+	void CreateAllocator(uint32 allocator)override;
+	void ResetAllocator(uint32 allocator)override;
+	void CreateList(uint32 list, uint32 allocator)override;
+	void ResetList(uint32 list, uint32 allocator)override;
+	void CloseList(uint32 list)override;
+	uint64 CompletedFence()const override;
+
+	ID3D12GraphicsCommandList* GetList(uint32 list)const;
+
+private:
+	ID3D12Device* mDevice;
+	ID3D12Fence* mFence;
+	D3D12_COMMAND_LIST_TYPE mType;
+
+	// Lists are looked up from recording threads while others are being created.
+	mutable std::mutex mMutex;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mAllocators;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> mLists;
+};
@@ -0,0 +1,186 @@
+//***************************************************************************************
+// D3D12CommandSink.cpp
+//***************************************************************************************
+
+#include "D3D12CommandSink.h"
+
+D3D12CommandSink::uint32 D3D12CommandSink::AddPipelineState(ID3D12PipelineState* pso)
+{
+	mPsos.push_back(pso);
+	return (uint32)mPsos.size() - 1;
+}
+
+D3D12CommandSink::uint32 D3D12CommandSink::AddRootSignature(ID3D12RootSignature* rootSignature)
+{
+	mRootSignatures.push_back(rootSignature);
+	return (uint32)mRootSignatures.size() - 1;
+}
+
+D3D12CommandSink::uint32 D3D12CommandSink::AddDescriptorHeap(ID3D12DescriptorHeap* heap, UINT descriptorSize)
+{
+	mHeaps.push_back({ heap, descriptorSize });
+	return (uint32)mHeaps.size() - 1;
+}
+
+D3D12CommandSink::uint32 D3D12CommandSink::AddResource(ID3D12Resource* resource)
+{
+	mResources.push_back(resource);
+	return (uint32)mResources.size() - 1;
+}
+
+D3D12CommandSink::uint32 D3D12CommandSink::AddRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv)
+{
+	mRenderTargets.push_back(rtv);
+	return (uint32)mRenderTargets.size() - 1;
+}
+
+D3D12CommandSink::uint32 D3D12CommandSink::AddDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+{
+	mDepthStencils.push_back(dsv);
+	return (uint32)mDepthStencils.size() - 1;
+}
+
+D3D12CommandSink::uint32 D3D12CommandSink::AddGeometry(const MeshGeometry* geometry)
+{
+	mGeometries.push_back(geometry);
+	return (uint32)mGeometries.size() - 1;
+}
+
+void D3D12CommandSink::SetResource(uint32 id, ID3D12Resource* resource)
+{
+	mResources[id] = resource;
+}
+
+void D3D12CommandSink::SetList(ID3D12GraphicsCommandList* list)
+{
+	mList = list;
+}
+
+void D3D12CommandSink::BeginFrame(uint64 frame)
+{
+	mCurrentHeap = ~0u;
+}
+
+void D3D12CommandSink::EndFrame()
+{
+}
+
+void D3D12CommandSink::SetPipelineState(uint32 pso)
+{
+	mList->SetPipelineState(mPsos[pso]);
+}
+
+void D3D12CommandSink::SetRootSignature(uint32 rootSignature)
+{
+	mList->SetGraphicsRootSignature(mRootSignatures[rootSignature]);
+}
+
+void D3D12CommandSink::SetDescriptorHeap(uint32 heap)
+{
+	mCurrentHeap = heap;
+
+	ID3D12DescriptorHeap* heaps[] = { mHeaps[heap].Heap };
+	mList->SetDescriptorHeaps(_countof(heaps), heaps);
+}
+
+void D3D12CommandSink::SetViewport(const Viewport& viewport)
+{
+	D3D12_VIEWPORT vp = { viewport.X, viewport.Y, viewport.Width, viewport.Height,
+		viewport.MinDepth, viewport.MaxDepth };
+	mList->RSSetViewports(1, &vp);
+}
+
+void D3D12CommandSink::SetScissorRect(const Rect& rect)
+{
+	D3D12_RECT r = { rect.Left, rect.Top, rect.Right, rect.Bottom };
+	mList->RSSetScissorRects(1, &r);
+}
+
+void D3D12CommandSink::ResourceBarriers(const Barrier* barriers, uint32 count)
+{
+	mBarriers.resize(count);
+	for(uint32 i = 0; i < count; ++i)
+	{
+		const Barrier& b = barriers[i];
+		switch(b.Type)
+		{
+		case Barrier::Kind::Transition:
+			mBarriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(mResources[b.Resource],
+				(D3D12_RESOURCE_STATES)b.Before, (D3D12_RESOURCE_STATES)b.After);
+			break;
+		case Barrier::Kind::Aliasing:
+			mBarriers[i] = CD3DX12_RESOURCE_BARRIER::Aliasing(
+				b.Other == ~0u ? nullptr : mResources[b.Other], mResources[b.Resource]);
+			break;
+		case Barrier::Kind::UnorderedAccess:
+			mBarriers[i] = CD3DX12_RESOURCE_BARRIER::UAV(mResources[b.Resource]);
+			break;
+		}
+	}
+
+	mList->ResourceBarrier(count, mBarriers.data());
+}
+
+void D3D12CommandSink::ClearRenderTarget(uint32 renderTarget, const float color[4])
+{
+	mList->ClearRenderTargetView(mRenderTargets[renderTarget], color, 0, nullptr);
+}
+
+void D3D12CommandSink::ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)
+{
+	mList->ClearDepthStencilView(mDepthStencils[depthStencil], D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
+		depth, stencil, 0, nullptr);
+}
+
+void D3D12CommandSink::SetRenderTarget(uint32 renderTarget, uint32 depthStencil)
+{
+	mList->OMSetRenderTargets(1, &mRenderTargets[renderTarget], true,
+		depthStencil == ~0u ? nullptr : &mDepthStencils[depthStencil]);
+}
+
+void D3D12CommandSink::SetDescriptorTable(uint32 parameter, uint32 descriptor)
+{
+	const DescriptorHeap& heap = mHeaps[mCurrentHeap];
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE handle(heap.Heap->GetGPUDescriptorHandleForHeapStart());
+	handle.Offset(descriptor, heap.DescriptorSize);
+	mList->SetGraphicsRootDescriptorTable(parameter, handle);
+}
+
+void D3D12CommandSink::SetRootConstant(uint32 parameter, uint32 value)
+{
+	mList->SetGraphicsRoot32BitConstant(parameter, value, 0);
+}
+
+void D3D12CommandSink::SetRootShaderResource(uint32 parameter, uint32 buffer)
+{
+	mList->SetGraphicsRootShaderResourceView(parameter, mResources[buffer]->GetGPUVirtualAddress());
+}
+
+void D3D12CommandSink::SetVertexBuffer(uint32 geometry)
+{
+	D3D12_VERTEX_BUFFER_VIEW view = mGeometries[geometry]->VertexBufferView();
+	mList->IASetVertexBuffers(0, 1, &view);
+}
+
+void D3D12CommandSink::SetIndexBuffer(uint32 geometry)
+{
+	D3D12_INDEX_BUFFER_VIEW view = mGeometries[geometry]->IndexBufferView();
+	mList->IASetIndexBuffer(&view);
+}
+
+void D3D12CommandSink::SetTopology(uint32 topology)
+{
+	mList->IASetPrimitiveTopology((D3D12_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D12CommandSink::DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+	int32 baseVertex, uint32 startInstance)
+{
+	mList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D12CommandSink::UploadContents(uint32 buffer, const void* data, uint32 size)
+{
+	// Already in the upload buffer.
+}
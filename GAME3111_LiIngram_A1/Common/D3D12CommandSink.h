@@ -0,0 +1,73 @@
+//***************************************************************************************
+// D3D12CommandSink.h
+//
+// CommandSink that records into a real graphics command list.  Objects are registered
+// once and referred to by the ids the Add functions return; ids are dense per kind and
+// start at 0.  Resources that are recreated (the swap chain buffers on resize) keep
+// their id and are re-pointed with SetResource.
+//***************************************************************************************
+
+#pragma once
+
+#include "CommandStream.h"
+#include "d3dUtil.h"
+
+class D3D12CommandSink : public CommandSink
+{
+public:
+	uint32 AddPipelineState(ID3D12PipelineState* pso);
+	uint32 AddRootSignature(ID3D12RootSignature* rootSignature);
+	uint32 AddDescriptorHeap(ID3D12DescriptorHeap* heap, UINT descriptorSize);
+	uint32 AddResource(ID3D12Resource* resource);
+	uint32 AddRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv);
+	uint32 AddDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv);
+	uint32 AddGeometry(const MeshGeometry* geometry);
+
+	void SetResource(uint32 id, ID3D12Resource* resource);
+
+	// The list the following commands go to.
+	void SetList(ID3D12GraphicsCommandList* list);
+
+	void BeginFrame(uint64 frame)override;
+	void EndFrame()override;
+	void SetPipelineState(uint32 pso)override;
+	void SetRootSignature(uint32 rootSignature)override;
+	void SetDescriptorHeap(uint32 heap)override;
+	void SetViewport(const Viewport& viewport)override;
+	void SetScissorRect(const Rect& rect)override;
+	void ResourceBarriers(const Barrier* barriers, uint32 count)override;
+	void ClearRenderTarget(uint32 renderTarget, const float color[4])override;
+	void ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)override;
+	void SetRenderTarget(uint32 renderTarget, uint32 depthStencil)override;
+	void SetDescriptorTable(uint32 parameter, uint32 descriptor)override;
+	void SetRootConstant(uint32 parameter, uint32 value)override;
+	void SetRootShaderResource(uint32 parameter, uint32 buffer)override;
+	void SetVertexBuffer(uint32 geometry)override;
+	void SetIndexBuffer(uint32 geometry)override;
+	void SetTopology(uint32 topology)override;
+	void DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+		int32 baseVertex, uint32 startInstance)override;
+	void UploadContents(uint32 buffer, const void* data, uint32 size)override;
+
+private:
+	struct DescriptorHeap
+	{
+		ID3D12DescriptorHeap* Heap;
+		UINT DescriptorSize;
+	};
+
+	ID3D12GraphicsCommandList* mList = nullptr;
+
+	std::vector<ID3D12PipelineState*> mPsos;
+	std::vector<ID3D12RootSignature*> mRootSignatures;
+	std::vector<DescriptorHeap> mHeaps;
+	std::vector<ID3D12Resource*> mResources;
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mRenderTargets;
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mDepthStencils;
+	std::vector<const MeshGeometry*> mGeometries;
+
+	uint32 mCurrentHeap = ~0u;
+
+	// Reused so translating barriers does not allocate every frame.
+	std::vector<D3D12_RESOURCE_BARRIER> mBarriers;
+};
@@ -24,6 +24,7 @@
 #include <wrl.h>
 
 #include "DDSTextureLoader.h" 
+#include "d3dUtil.h"
 
 using namespace Microsoft::WRL;
 
@@ -2176,6 +2177,9 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 
 	if (SUCCEEDED(hr))
 	{
+		d3dUtil::TrackResource(texture.Get(), MemoryTag::Textures);
+		d3dUtil::TrackResource(textureUploadHeap.Get(), MemoryTag::Uploaders);
+
 /*
 #if !defined(NO_D3D11_DEBUG_NAME) && ( defined(_DEBUG) || defined(PROFILE) )
 		if (texture != 0 || textureView != 0)
@@ -0,0 +1,265 @@
+//***************************************************************************************
+// FrameArena.cpp
+//***************************************************************************************
+
+#include "FrameArena.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+
+const size_t LinearArena::DefaultBlockBytes;
+const size_t FrameArena::DefaultFrameBytes;
+const size_t FrameArena::DefaultScratchBytes;
+
+namespace
+{
+	// Forwards to the global heap and counts the calls.  Used by the benchmark's heap run.
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		std::atomic<std::uint64_t> Allocations{ 0 };
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment)override
+		{
+			++Allocations;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment)override
+		{
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	std::atomic<std::uint64_t> NextFrameArenaId{ 1 };
+
+	LinearArena::Stats& operator+=(LinearArena::Stats& lhs, const LinearArena::Stats& rhs)
+	{
+		lhs.Allocations += rhs.Allocations;
+		lhs.Bytes += rhs.Bytes;
+		lhs.UpstreamAllocations += rhs.UpstreamAllocations;
+		lhs.PeakBytes += rhs.PeakBytes;
+		lhs.Capacity += rhs.Capacity;
+		lhs.TotalUpstreamAllocations += rhs.TotalUpstreamAllocations;
+		return lhs;
+	}
+}
+
+LinearArena::LinearArena(size_t blockBytes, std::pmr::memory_resource* upstream)
+	: mUpstream(upstream), mBlockBytes(std::max<size_t>(blockBytes, 1024))
+{
+}
+
+LinearArena::~LinearArena()
+{
+	ReleaseBlocks();
+}
+
+void* LinearArena::do_allocate(size_t bytes, size_t alignment)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	++mStats.Allocations;
+	mStats.Bytes += bytes;
+	mStats.PeakBytes = std::max(mStats.PeakBytes, mStats.Bytes);
+
+	for(;;)
+	{
+		if(mCurrentBlock < mBlocks.size())
+		{
+			const Block& block = mBlocks[mCurrentBlock];
+
+			// Align the address, not the offset, so alignments past the block's own work too.
+			std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.Data);
+			std::uintptr_t p = (base + mOffset + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+			if(p + bytes <= base + block.Size)
+			{
+				mOffset = (size_t)(p - base) + bytes;
+				return reinterpret_cast<void*>(p);
+			}
+
+			// The rest of this block is wasted until the next Reset.
+			++mCurrentBlock;
+			mOffset = 0;
+			continue;
+		}
+
+		AddBlock(std::max(mBlockBytes, bytes + alignment));
+	}
+}
+
+void LinearArena::do_deallocate(void*, size_t, size_t)
+{
+	// Memory comes back all at once in Reset.
+}
+
+bool LinearArena::do_is_equal(const std::pmr::memory_resource& other)const noexcept
+{
+	return this == &other;
+}
+
+void LinearArena::AddBlock(size_t size)
+{
+	char* data = static_cast<char*>(mUpstream->allocate(size, alignof(std::max_align_t)));
+	mBlocks.push_back({ data, size });
+
+	++mStats.UpstreamAllocations;
+	++mStats.TotalUpstreamAllocations;
+	mStats.Capacity += size;
+}
+
+void LinearArena::ReleaseBlocks()
+{
+	for(const Block& block : mBlocks)
+		mUpstream->deallocate(block.Data, block.Size, alignof(std::max_align_t));
+
+	mBlocks.clear();
+	mStats.Capacity = 0;
+}
+
+void LinearArena::Reset()
+{
+	// A frame that spilled into further blocks gets one block big enough for all of them,
+	// so the next frame of the same size makes no upstream calls.  The merge counts
+	// towards TotalUpstreamAllocations only, not the frame about to start.
+	if(mBlocks.size() > 1)
+	{
+		size_t capacity = (size_t)mStats.Capacity;
+		ReleaseBlocks();
+		AddBlock(capacity);
+	}
+
+	mStats.Allocations = 0;
+	mStats.Bytes = 0;
+	mStats.UpstreamAllocations = 0;
+
+	mCurrentBlock = 0;
+	mOffset = 0;
+}
+
+const LinearArena::Stats& LinearArena::GetStats()const
+{
+	return mStats;
+}
+
+FrameArena::FrameArena(size_t frameBytes, size_t scratchBytes, std::pmr::memory_resource* upstream)
+	: mId(NextFrameArenaId++), mUpstream(upstream), mScratchBytes(scratchBytes), mFrame(frameBytes, upstream)
+{
+}
+
+LinearArena& FrameArena::Frame()
+{
+	return mFrame;
+}
+
+LinearArena& FrameArena::Scratch()
+{
+	// Workers usually ask the same FrameArena for every range of a frame, so remember the
+	// last answer and skip the lock.
+	struct CachedScratch
+	{
+		uint64 ArenaId = 0;
+		LinearArena* Scratch = nullptr;
+	};
+	thread_local CachedScratch cached;
+	if(cached.ArenaId == mId)
+		return *cached.Scratch;
+
+	std::lock_guard<std::mutex> lock(mScratchMutex);
+	std::unique_ptr<LinearArena>& scratch = mScratch[std::this_thread::get_id()];
+	if(!scratch)
+		scratch = std::make_unique<LinearArena>(mScratchBytes, mUpstream);
+
+	cached = { mId, scratch.get() };
+	return *scratch;
+}
+
+FrameArena::uint32 FrameArena::ScratchCount()const
+{
+	std::lock_guard<std::mutex> lock(mScratchMutex);
+	return (uint32)mScratch.size();
+}
+
+void FrameArena::Reset()
+{
+	mLastFrame = GetStats();
+
+	mFrame.Reset();
+
+	std::lock_guard<std::mutex> lock(mScratchMutex);
+	for(auto& scratch : mScratch)
+		scratch.second->Reset();
+}
+
+LinearArena::Stats FrameArena::GetStats()const
+{
+	LinearArena::Stats stats = mFrame.GetStats();
+
+	std::lock_guard<std::mutex> lock(mScratchMutex);
+	for(const auto& scratch : mScratch)
+		stats += scratch.second->GetStats();
+	return stats;
+}
+
+const LinearArena::Stats& FrameArena::GetLastFrameStats()const
+{
+	return mLastFrame;
+}
+
+FrameArena::BenchmarkResult FrameArena::Benchmark(uint32 itemCount, uint32 frames, ThreadPool& pool)
+{
+	BenchmarkResult result;
+	result.Frames = frames;
+
+	// Each item builds a short list without reserving, the way gather loops usually do.
+	auto buildLists = [itemCount, &pool](auto resourceForThread)
+	{
+		std::atomic<std::uint64_t> checksum{ 0 };
+		pool.ParallelFor(itemCount, 64, [&](uint32 begin, uint32 end, uint32)
+		{
+			std::pmr::memory_resource* resource = resourceForThread();
+			std::uint64_t sum = 0;
+			for(uint32 i = begin; i < end; ++i)
+			{
+				std::pmr::vector<uint32> list(resource);
+				for(uint32 j = 0; j < 1 + i % 24; ++j)
+					list.push_back(i + j);
+				sum += list.back();
+			}
+			checksum += sum;
+		});
+		return checksum.load();
+	};
+
+	CountingResource heap;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32 frame = 0; frame < frames; ++frame)
+	{
+		std::uint64_t before = heap.Allocations.load();
+		buildLists([&heap]() -> std::pmr::memory_resource* { return &heap; });
+		result.HeapCallsPerFrame = heap.Allocations.load() - before;
+	}
+	auto middle = std::chrono::steady_clock::now();
+
+	// Small blocks on purpose, so the numbers include warming up.
+	FrameArena arena(4 * 1024, 4 * 1024);
+	for(uint32 frame = 0; frame < frames; ++frame)
+	{
+		arena.Reset();
+		buildLists([&arena]() -> std::pmr::memory_resource* { return &arena.Scratch(); });
+		result.ArenaCallsPerFrame = arena.GetStats().UpstreamAllocations;
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	result.HeapMilliseconds = std::chrono::duration<double, std::milli>(middle - start).count();
+	result.ArenaMilliseconds = std::chrono::duration<double, std::milli>(end - middle).count();
+	return result;
+}
@@ -0,0 +1,149 @@
+//***************************************************************************************
+// FrameArena.h
+//
+// Memory for data that lives exactly one frame.
+//
+// LinearArena is a std::pmr::memory_resource that bumps a pointer through blocks taken
+// from an upstream resource.  Deallocation does nothing; Reset rewinds the whole arena at
+// once.  If a frame needed more than one block, Reset replaces them with a single block
+// of their combined size, so after a frame or two of warming up the arena stops calling
+// the upstream resource altogether.
+//
+// FrameArena bundles one LinearArena for the render thread with one scratch arena per
+// thread that asks for one, and lives in a FrameResource.  It is reset when the GPU has finished
+// the frame resource's previous frame, so anything allocated from it may be read by the
+// GPU-facing code of the frame that allocated it (barrier arrays, draw lists, ...) but
+// must not be kept past it.  Pass the arenas to std::pmr containers:
+//
+//     std::pmr::vector<RenderItem*> drawList(&frameResource->Arena.Frame());
+//
+// Neither arena is thread safe; worker threads use Scratch(), which hands every thread
+// its own arena.  Scratch arenas are keyed by thread rather than by ParallelFor slot
+// because slots repeat across concurrent and nested ParallelFor calls.
+//***************************************************************************************
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class LinearArena : public std::pmr::memory_resource
+{
+public:
+	using uint64 = std::uint64_t;
+
+	static const size_t DefaultBlockBytes = 64 * 1024;
+
+	struct Stats
+	{
+		uint64 Allocations = 0;            // since the last Reset
+		uint64 Bytes = 0;                  // requested since the last Reset
+		uint64 UpstreamAllocations = 0;    // since the last Reset; 0 once warmed up
+		uint64 PeakBytes = 0;              // most bytes requested in one frame
+		uint64 Capacity = 0;               // bytes held from upstream
+		uint64 TotalUpstreamAllocations = 0;
+	};
+
+	explicit LinearArena(size_t blockBytes = DefaultBlockBytes,
+		std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+	LinearArena(const LinearArena& rhs) = delete;
+	LinearArena& operator=(const LinearArena& rhs) = delete;
+	~LinearArena();
+
+	// Invalidates everything allocated since the last Reset.
+	void Reset();
+
+	const Stats& GetStats()const;
+
+private:
+	struct Block
+	{
+		char* Data;
+		size_t Size;
+	};
+
+	void* do_allocate(size_t bytes, size_t alignment)override;
+	void do_deallocate(void* p, size_t bytes, size_t alignment)override;
+	bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override;
+
+	void AddBlock(size_t size);
+	void ReleaseBlocks();
+
+private:
+	std::pmr::memory_resource* mUpstream;
+	size_t mBlockBytes;
+
+	std::vector<Block> mBlocks;
+	size_t mCurrentBlock = 0;
+	size_t mOffset = 0;
+
+	Stats mStats;
+};
+
+class FrameArena
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const size_t DefaultFrameBytes = 256 * 1024;
+	static const size_t DefaultScratchBytes = 64 * 1024;
+
+	struct BenchmarkResult
+	{
+		uint32 Frames = 0;
+		double HeapMilliseconds = 0.0;     // total over all frames
+		double ArenaMilliseconds = 0.0;
+		uint64 HeapCallsPerFrame = 0;      // upstream calls of the heap run's last frame
+		uint64 ArenaCallsPerFrame = 0;     // upstream calls of the arena run's last frame
+	};
+
+	// Every arena takes its blocks from upstream.
+	explicit FrameArena(size_t frameBytes = DefaultFrameBytes, size_t scratchBytes = DefaultScratchBytes,
+		std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+	FrameArena(const FrameArena& rhs) = delete;
+	FrameArena& operator=(const FrameArena& rhs) = delete;
+
+	// Render thread allocations.
+	LinearArena& Frame();
+
+	// Allocations of the calling thread.  The first call from a thread creates its arena.
+	LinearArena& Scratch();
+
+	// Number of threads that have asked for a scratch arena.
+	uint32 ScratchCount()const;
+
+	// Call once the GPU has finished the frame that last used this arena, and not while
+	// another thread may be allocating from it.
+	void Reset();
+
+	// Counters summed over the frame arena and every scratch arena, for the frame in
+	// progress and for the one before the last Reset.
+	LinearArena::Stats GetStats()const;
+	const LinearArena::Stats& GetLastFrameStats()const;
+
+	///<summary>
+	/// Runs frames frames of itemCount small per-item list builds split over pool, once
+	/// with the scratch vectors on the heap and once on scratch arenas.
+	///</summary>
+	static BenchmarkResult Benchmark(uint32 itemCount, uint32 frames, ThreadPool& pool = ThreadPool::Get());
+
+private:
+	// Tells FrameArenas apart in the per-thread lookup cache, where addresses can be reused.
+	const uint64 mId;
+	std::pmr::memory_resource* mUpstream;
+	size_t mScratchBytes;
+
+	LinearArena mFrame;
+
+	mutable std::mutex mScratchMutex;
+	std::unordered_map<std::thread::id, std::unique_ptr<LinearArena>> mScratch;
+
+	LinearArena::Stats mLastFrame;
+};
@@ -0,0 +1,216 @@
+//***************************************************************************************
+// FramePacer.cpp
+//***************************************************************************************
+
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+const FramePacer::Duration FramePacer::SleepQuantum = std::chrono::milliseconds(1);
+
+namespace
+{
+	// Weight of each new sleep measurement in the running estimate.
+	const double SleepEstimateWeight = 0.05;
+
+	double ToSeconds(FramePacer::Duration d)
+	{
+		return std::chrono::duration<double>(d).count();
+	}
+
+	double ToMilliseconds(FramePacer::Duration d)
+	{
+		return std::chrono::duration<double, std::milli>(d).count();
+	}
+}
+
+FramePacer::Hooks FramePacer::DefaultHooks()
+{
+	Hooks hooks;
+	hooks.Now = []() { return Clock::now(); };
+	hooks.Sleep = [](Duration d) { std::this_thread::sleep_for(d); };
+	return hooks;
+}
+
+FramePacer::FramePacer(double targetRate, Hooks hooks)
+	: mHooks(std::move(hooks)), mSleepMean(ToSeconds(SleepQuantum))
+{
+	SetTargetRate(targetRate);
+}
+
+void FramePacer::SetTargetRate(double rate)
+{
+	mTargetRate = std::max(rate, 0.0);
+	mPeriod = mTargetRate > 0.0 ?
+		std::chrono::duration_cast<Duration>(std::chrono::duration<double>(1.0 / mTargetRate)) : Duration::zero();
+
+	mStats.TargetMilliseconds = ToMilliseconds(mPeriod);
+	Restart();
+}
+
+double FramePacer::GetTargetRate()const
+{
+	return mTargetRate;
+}
+
+bool FramePacer::IsPaced()const
+{
+	return mTargetRate > 0.0;
+}
+
+void FramePacer::SetWaitMode(WaitMode mode)
+{
+	mMode = mode;
+}
+
+FramePacer::WaitMode FramePacer::GetWaitMode()const
+{
+	return mMode;
+}
+
+void FramePacer::Restart()
+{
+	mHasDeadline = false;
+	mHasLastStart = false;
+}
+
+void FramePacer::WaitForNextFrame()
+{
+	TimePoint now = mHooks.Now();
+	if(!IsPaced())
+	{
+		RecordFrame(now, now);
+		return;
+	}
+
+	if(!mHasDeadline)
+	{
+		mNextDeadline = now;
+		mHasDeadline = true;
+	}
+	else if(now - mNextDeadline > mPeriod)
+	{
+		++mStats.MissedFrames;
+		mNextDeadline = now;
+	}
+	else if(now < mNextDeadline)
+	{
+		Wait(mNextDeadline);
+	}
+
+	RecordFrame(mHooks.Now(), mNextDeadline);
+	mNextDeadline += mPeriod;
+}
+
+void FramePacer::SleepFor(Duration duration)
+{
+	TimePoint start = mHooks.Now();
+	mHooks.Sleep(duration);
+	Duration slept = mHooks.Now() - start;
+	mStats.SleepMilliseconds += ToMilliseconds(slept);
+
+	// Only quantum sleeps feed the estimate, so it stays the cost of one such sleep.
+	if(duration == SleepQuantum)
+	{
+		double x = ToSeconds(slept);
+		double delta = x - mSleepMean;
+		mSleepMean += SleepEstimateWeight * delta;
+		mSleepVariance = (1.0 - SleepEstimateWeight) * (mSleepVariance + SleepEstimateWeight * delta * delta);
+	}
+}
+
+void FramePacer::Wait(TimePoint deadline)
+{
+	if(mMode == WaitMode::SleepOnly)
+	{
+		SleepFor(deadline - mHooks.Now());
+		return;
+	}
+
+	if(mMode == WaitMode::Hybrid)
+	{
+		// Sleep while even a slow sleep would still wake before the deadline.
+		for(;;)
+		{
+			double estimate = mSleepMean + std::sqrt(mSleepVariance);
+			if(ToSeconds(deadline - mHooks.Now()) <= estimate)
+				break;
+			SleepFor(SleepQuantum);
+		}
+	}
+
+	TimePoint spinStart = mHooks.Now();
+	TimePoint now = spinStart;
+	while(now < deadline)
+	{
+		std::this_thread::yield();
+		now = mHooks.Now();
+	}
+	mStats.SpinMilliseconds += ToMilliseconds(now - spinStart);
+}
+
+void FramePacer::RecordFrame(TimePoint start, TimePoint deadline)
+{
+	++mStats.Frames;
+	mStats.MaxErrorMilliseconds = std::max(mStats.MaxErrorMilliseconds, std::abs(ToMilliseconds(start - deadline)));
+
+	if(mHasLastStart)
+	{
+		double interval = ToMilliseconds(start - mLastStart);
+		++mIntervals;
+		double delta = interval - mIntervalMean;
+		mIntervalMean += delta / mIntervals;
+		mIntervalM2 += delta * (interval - mIntervalMean);
+	}
+	mLastStart = start;
+	mHasLastStart = true;
+}
+
+FramePacer::Stats FramePacer::GetStats()const
+{
+	Stats stats = mStats;
+	if(mIntervals > 0)
+	{
+		stats.MeanIntervalMilliseconds = mIntervalMean;
+		stats.JitterMilliseconds = std::sqrt(mIntervalM2 / mIntervals);
+	}
+	stats.SleepEstimateMilliseconds = (mSleepMean + std::sqrt(mSleepVariance)) * 1000.0;
+	return stats;
+}
+
+void FramePacer::ResetStats()
+{
+	mStats = Stats();
+	mStats.TargetMilliseconds = ToMilliseconds(mPeriod);
+	mIntervals = 0;
+	mIntervalMean = 0.0;
+	mIntervalM2 = 0.0;
+	mHasLastStart = false;
+}
+
+FramePacer::BenchmarkResult FramePacer::Benchmark(double targetRate, uint32 frames, double workMilliseconds)
+{
+	auto run = [=](WaitMode mode)
+	{
+		FramePacer pacer(targetRate);
+		pacer.SetWaitMode(mode);
+
+		Duration work = std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::milli>(workMilliseconds));
+		for(uint32 i = 0; i < frames; ++i)
+		{
+			pacer.WaitForNextFrame();
+
+			TimePoint end = Clock::now() + work;
+			while(Clock::now() < end)
+			{
+			}
+		}
+		return pacer.GetStats();
+	};
+
+	BenchmarkResult result;
+	result.Hybrid = run(WaitMode::Hybrid);
+	result.SleepOnly = run(WaitMode::SleepOnly);
+	return result;
+}
@@ -0,0 +1,121 @@
+//***************************************************************************************
+// FramePacer.h
+//
+// Holds the frame loop to a target rate.  Each WaitForNextFrame returns at the next
+// deadline on a fixed grid of period 1/rate: most of the wait is spent asleep, in short
+// sleeps while the time left exceeds what a sleep is expected to take, and the last
+// stretch is spun so the deadline is hit to within the clock's resolution.  The sleep
+// estimate is the running mean plus one standard deviation of measured sleeps, so it
+// adapts to the scheduler's granularity and corrects oversleep.
+//
+// A frame that starts more than a whole period late puts the grid back at the current
+// time instead of rendering several frames back to back to catch up.
+//
+// The clock and the sleep are hooks, so the pacer runs headless against a fake clock.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+class FramePacer
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+	using Clock = std::chrono::steady_clock;
+	using TimePoint = Clock::time_point;
+	using Duration = std::chrono::nanoseconds;
+
+	enum class WaitMode
+	{
+		Hybrid,       // sleep, then spin the last stretch
+		SleepOnly,    // one sleep for the whole wait; cheapest, least precise
+		SpinOnly      // most precise, keeps a core busy
+	};
+
+	struct Hooks
+	{
+		std::function<TimePoint()> Now;
+		std::function<void(Duration)> Sleep;
+	};
+
+	struct Stats
+	{
+		uint64 Frames = 0;
+		double TargetMilliseconds = 0.0;     // 0 when unpaced
+		double MeanIntervalMilliseconds = 0.0;
+		double JitterMilliseconds = 0.0;     // standard deviation of the frame interval
+		double MaxErrorMilliseconds = 0.0;   // largest distance of a frame start from its deadline
+		uint64 MissedFrames = 0;             // frames more than a period late
+		double SleepMilliseconds = 0.0;
+		double SpinMilliseconds = 0.0;
+		double SleepEstimateMilliseconds = 0.0;
+	};
+
+	struct BenchmarkResult
+	{
+		Stats Hybrid;
+		Stats SleepOnly;
+	};
+
+	// Sleep length the estimate is measured for; the hybrid wait sleeps in these steps.
+	static const Duration SleepQuantum;
+
+	// std::this_thread::sleep_for and steady_clock.
+	static Hooks DefaultHooks();
+
+	// A rate of 0 leaves the loop unpaced; WaitForNextFrame then only records intervals.
+	explicit FramePacer(double targetRate = 0.0, Hooks hooks = DefaultHooks());
+
+	void SetTargetRate(double rate);
+	double GetTargetRate()const;
+	bool IsPaced()const;
+
+	void SetWaitMode(WaitMode mode);
+	WaitMode GetWaitMode()const;
+
+	// Call once per frame, before the frame's work.
+	void WaitForNextFrame();
+
+	// Forgets the deadline grid, e.g. after the loop was paused.
+	void Restart();
+
+	Stats GetStats()const;
+	void ResetStats();
+
+	///<summary>
+	/// Paces frames frames of workMilliseconds of busy work at targetRate with the real
+	/// clock, once with the hybrid wait and once sleeping only.
+	///</summary>
+	static BenchmarkResult Benchmark(double targetRate, uint32 frames, double workMilliseconds);
+
+private:
+	void Wait(TimePoint deadline);
+	void SleepFor(Duration duration);
+	void RecordFrame(TimePoint start, TimePoint deadline);
+
+private:
+	Hooks mHooks;
+	Duration mPeriod = Duration::zero();
+	double mTargetRate = 0.0;
+	WaitMode mMode = WaitMode::Hybrid;
+
+	TimePoint mNextDeadline;
+	TimePoint mLastStart;
+	bool mHasDeadline = false;
+	bool mHasLastStart = false;
+
+	// Expected duration of one SleepQuantum sleep, in seconds.
+	double mSleepMean;
+	double mSleepVariance = 0.0;
+
+	// Running mean and sum of squared deviations of the frame interval (Welford), which
+	// stays accurate where sum-of-squares minus squared mean cancels out.
+	uint64 mIntervals = 0;
+	double mIntervalMean = 0.0;
+	double mIntervalM2 = 0.0;
+	Stats mStats;
+};
@@ -0,0 +1,342 @@
+//***************************************************************************************
+// FrameStats.cpp
+//***************************************************************************************
+
+#include "FrameStats.h"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+const FrameStats::uint32 FrameStats::DefaultHistoryLength;
+const FrameStats::uint32 FrameStats::DefaultBucketCount;
+const CommandSink::uint32 FrameStatsSink::TriangleList;
+const CommandSink::uint32 FrameStatsSink::TriangleStrip;
+
+//
+// FrameStats
+//
+
+FrameStats::FrameStats(uint32 historyLength)
+	: mHistory(std::max<uint32>(historyLength, 1))
+{
+}
+
+void FrameStats::Add(FrameCounter counter, uint64 value)
+{
+	mCurrent.Values[(size_t)counter] += value;
+}
+
+const FrameStats::Frame& FrameStats::Current()const
+{
+	return mCurrent;
+}
+
+void FrameStats::EndFrame()
+{
+	auto now = std::chrono::steady_clock::now();
+	if(mHasLastEnd)
+	{
+		mCurrent.Values[(size_t)FrameCounter::FrameMicroseconds] =
+			(uint64)std::chrono::duration_cast<std::chrono::microseconds>(now - mLastEnd).count();
+	}
+	mLastEnd = now;
+	mHasLastEnd = true;
+
+	uint64 index = mCurrent.Index;
+	mHistory[mNext] = mCurrent;
+	mNext = (mNext + 1) % (uint32)mHistory.size();
+	mCount = std::min(mCount + 1, (uint32)mHistory.size());
+
+	mCurrent = Frame();
+	mCurrent.Index = index + 1;
+}
+
+FrameStats::uint32 FrameStats::FrameCount()const
+{
+	return mCount;
+}
+
+const FrameStats::Frame& FrameStats::GetFrame(uint32 i)const
+{
+	assert(i < mCount);
+	uint32 size = (uint32)mHistory.size();
+	return mHistory[(mNext + size - mCount + i) % size];
+}
+
+const FrameStats::Frame& FrameStats::GetLastFrame()const
+{
+	return GetFrame(mCount - 1);
+}
+
+void FrameStats::GetValues(FrameCounter counter, std::vector<uint64>& values)const
+{
+	values.resize(mCount);
+	for(uint32 i = 0; i < mCount; ++i)
+		values[i] = GetFrame(i)[counter];
+}
+
+FrameStats::Summary FrameStats::GetSummary(FrameCounter counter)const
+{
+	Summary summary;
+	if(mCount == 0)
+		return summary;
+
+	std::vector<uint64> values;
+	GetValues(counter, values);
+	std::sort(values.begin(), values.end());
+
+	double sum = 0.0;
+	for(uint64 v : values)
+		sum += (double)v;
+
+	// Nearest rank.
+	auto percentile = [&values](double p)
+	{
+		size_t rank = (size_t)(p * (values.size() - 1) + 0.5);
+		return values[rank];
+	};
+
+	summary.Min = values.front();
+	summary.Max = values.back();
+	summary.Mean = sum / values.size();
+	summary.P50 = percentile(0.50);
+	summary.P95 = percentile(0.95);
+	summary.P99 = percentile(0.99);
+	return summary;
+}
+
+FrameStats::Histogram FrameStats::GetHistogram(FrameCounter counter, uint32 bucketCount)const
+{
+	Histogram histogram;
+	bucketCount = std::max<uint32>(bucketCount, 1);
+	histogram.Counts.assign(bucketCount, 0);
+	if(mCount == 0)
+		return histogram;
+
+	std::vector<uint64> values;
+	GetValues(counter, values);
+	auto range = std::minmax_element(values.begin(), values.end());
+	histogram.Min = *range.first;
+	histogram.Max = *range.second;
+
+	// A constant counter puts everything in the first bucket.
+	histogram.BucketWidth = (double)(histogram.Max - histogram.Min) / bucketCount;
+	for(uint64 v : values)
+	{
+		uint32 bucket = 0;
+		if(histogram.BucketWidth > 0.0)
+			bucket = std::min((uint32)((v - histogram.Min) / histogram.BucketWidth), bucketCount - 1);
+		++histogram.Counts[bucket];
+	}
+	return histogram;
+}
+
+bool FrameStats::WriteCsv(const std::string& path)const
+{
+	std::ofstream fout(path);
+	if(!fout)
+		return false;
+
+	fout << "Frame";
+	for(size_t c = 0; c < (size_t)FrameCounter::Count; ++c)
+		fout << ',' << CounterName((FrameCounter)c);
+	fout << '\n';
+
+	for(uint32 i = 0; i < mCount; ++i)
+	{
+		const Frame& frame = GetFrame(i);
+		fout << frame.Index;
+		for(size_t c = 0; c < (size_t)FrameCounter::Count; ++c)
+			fout << ',' << frame.Values[c];
+		fout << '\n';
+	}
+
+	return (bool)fout;
+}
+
+bool FrameStats::WriteJson(const std::string& path)const
+{
+	std::ofstream fout(path);
+	if(!fout)
+		return false;
+
+	fout << "{\n  \"frames\": " << mCount << ",\n  \"counters\": {\n";
+	for(size_t c = 0; c < (size_t)FrameCounter::Count; ++c)
+	{
+		FrameCounter counter = (FrameCounter)c;
+		Summary s = GetSummary(counter);
+		Histogram h = GetHistogram(counter);
+
+		fout << "    \"" << CounterName(counter) << "\": {\n"
+			<< "      \"min\": " << s.Min << ", \"max\": " << s.Max << ", \"mean\": " << s.Mean
+			<< ", \"p50\": " << s.P50 << ", \"p95\": " << s.P95 << ", \"p99\": " << s.P99 << ",\n"
+			<< "      \"histogram\": { \"min\": " << h.Min << ", \"bucketWidth\": " << h.BucketWidth
+			<< ", \"counts\": [";
+		for(size_t b = 0; b < h.Counts.size(); ++b)
+			fout << (b == 0 ? "" : ", ") << h.Counts[b];
+		fout << "] },\n      \"values\": [";
+		for(uint32 i = 0; i < mCount; ++i)
+			fout << (i == 0 ? "" : ", ") << GetFrame(i)[counter];
+		fout << "]\n    }" << (c + 1 < (size_t)FrameCounter::Count ? "," : "") << '\n';
+	}
+	fout << "  }\n}\n";
+
+	return (bool)fout;
+}
+
+const char* FrameStats::CounterName(FrameCounter counter)
+{
+	switch(counter)
+	{
+	case FrameCounter::Draws: return "Draws";
+	case FrameCounter::Triangles: return "Triangles";
+	case FrameCounter::StateChanges: return "StateChanges";
+	case FrameCounter::RedundantStateChanges: return "RedundantStateChanges";
+	case FrameCounter::DescriptorsWritten: return "DescriptorsWritten";
+	case FrameCounter::UploadBytes: return "UploadBytes";
+	case FrameCounter::DirtyObjects: return "DirtyObjects";
+	case FrameCounter::FenceWaitMicroseconds: return "FenceWaitMicroseconds";
+	case FrameCounter::FrameMicroseconds: return "FrameMicroseconds";
+	default: return "Unknown";
+	}
+}
+
+//
+// FrameStatsSink
+//
+
+FrameStatsSink::FrameStatsSink(FrameStats& stats, CommandSink* next)
+	: mStats(stats), mNext(next)
+{
+}
+
+void FrameStatsSink::SetNext(CommandSink* next)
+{
+	mNext = next;
+}
+
+void FrameStatsSink::SetState(uint64& state, uint64 value)
+{
+	if(state == value)
+	{
+		mStats.Add(FrameCounter::RedundantStateChanges, 1);
+	}
+	else
+	{
+		state = value;
+		mStats.Add(FrameCounter::StateChanges, 1);
+	}
+}
+
+void FrameStatsSink::BeginFrame(uint64 frame)
+{
+	mPso = mRootSignature = mHeap = mTargets = ~0ull;
+	mVertexBuffer = mIndexBuffer = mTopology = ~0ull;
+	mNext->BeginFrame(frame);
+}
+
+void FrameStatsSink::EndFrame()
+{
+	mNext->EndFrame();
+}
+
+void FrameStatsSink::SetPipelineState(uint32 pso)
+{
+	SetState(mPso, pso);
+	mNext->SetPipelineState(pso);
+}
+
+void FrameStatsSink::SetRootSignature(uint32 rootSignature)
+{
+	SetState(mRootSignature, rootSignature);
+	mNext->SetRootSignature(rootSignature);
+}
+
+void FrameStatsSink::SetDescriptorHeap(uint32 heap)
+{
+	SetState(mHeap, heap);
+	mNext->SetDescriptorHeap(heap);
+}
+
+void FrameStatsSink::SetViewport(const Viewport& viewport)
+{
+	mNext->SetViewport(viewport);
+}
+
+void FrameStatsSink::SetScissorRect(const Rect& rect)
+{
+	mNext->SetScissorRect(rect);
+}
+
+void FrameStatsSink::ResourceBarriers(const Barrier* barriers, uint32 count)
+{
+	mNext->ResourceBarriers(barriers, count);
+}
+
+void FrameStatsSink::ClearRenderTarget(uint32 renderTarget, const float color[4])
+{
+	mNext->ClearRenderTarget(renderTarget, color);
+}
+
+void FrameStatsSink::ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)
+{
+	mNext->ClearDepthStencil(depthStencil, depth, stencil);
+}
+
+void FrameStatsSink::SetRenderTarget(uint32 renderTarget, uint32 depthStencil)
+{
+	SetState(mTargets, renderTarget | ((uint64)depthStencil << 32));
+	mNext->SetRenderTarget(renderTarget, depthStencil);
+}
+
+void FrameStatsSink::SetDescriptorTable(uint32 parameter, uint32 descriptor)
+{
+	mNext->SetDescriptorTable(parameter, descriptor);
+}
+
+void FrameStatsSink::SetRootConstant(uint32 parameter, uint32 value)
+{
+	mNext->SetRootConstant(parameter, value);
+}
+
+void FrameStatsSink::SetRootShaderResource(uint32 parameter, uint32 buffer)
+{
+	mNext->SetRootShaderResource(parameter, buffer);
+}
+
+void FrameStatsSink::SetVertexBuffer(uint32 geometry)
+{
+	SetState(mVertexBuffer, geometry);
+	mNext->SetVertexBuffer(geometry);
+}
+
+void FrameStatsSink::SetIndexBuffer(uint32 geometry)
+{
+	SetState(mIndexBuffer, geometry);
+	mNext->SetIndexBuffer(geometry);
+}
+
+void FrameStatsSink::SetTopology(uint32 topology)
+{
+	SetState(mTopology, topology);
+	mNext->SetTopology(topology);
+}
+
+void FrameStatsSink::DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+	int32 baseVertex, uint32 startInstance)
+{
+	uint64 triangles = 0;
+	if(mTopology == TriangleList)
+		triangles = indexCount / 3;
+	else if(mTopology == TriangleStrip && indexCount >= 3)
+		triangles = indexCount - 2;
+
+	mStats.Add(FrameCounter::Draws, 1);
+	mStats.Add(FrameCounter::Triangles, triangles * instanceCount);
+	mNext->DrawIndexed(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void FrameStatsSink::UploadContents(uint32 buffer, const void* data, uint32 size)
+{
+	mNext->UploadContents(buffer, data, size);
+}
@@ -0,0 +1,166 @@
+//***************************************************************************************
+// FrameStats.h
+//
+// Per frame rendering counters.  The frame loop adds to the counters of the frame in
+// progress and calls EndFrame once the frame is submitted; finished frames go into a
+// fixed size history that can be summarised, turned into histograms and written out as
+// CSV or JSON.  Anything added before the first EndFrame (start up work) counts towards
+// the first frame.
+//
+// FrameStatsSink counts the draw side (draws, triangles, state changes) by sitting in
+// front of the sink that does the recording.
+//
+// Nothing here touches Direct3D, so it builds and runs headless.
+//***************************************************************************************
+
+#pragma once
+
+#include "CommandStream.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class FrameCounter : std::uint8_t
+{
+	Draws,
+	Triangles,
+	StateChanges,            // pipeline, root signature, heap, targets, buffers, topology
+	RedundantStateChanges,   // the same calls when they set what was already set
+	DescriptorsWritten,
+	UploadBytes,             // bytes the CPU copied into upload buffers
+	DirtyObjects,            // objects whose constants were rewritten
+	FenceWaitMicroseconds,   // CPU time spent waiting for a frame resource
+	FrameMicroseconds,       // EndFrame to EndFrame
+
+	Count
+};
+
+class FrameStats
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint32 DefaultHistoryLength = 600;
+	static const uint32 DefaultBucketCount = 16;
+
+	struct Frame
+	{
+		uint64 Index = 0;
+		uint64 Values[(size_t)FrameCounter::Count] = {};
+
+		uint64 operator[](FrameCounter counter)const { return Values[(size_t)counter]; }
+	};
+
+	struct Summary
+	{
+		uint64 Min = 0;
+		uint64 Max = 0;
+		double Mean = 0.0;
+		uint64 P50 = 0;
+		uint64 P95 = 0;
+		uint64 P99 = 0;
+	};
+
+	// Bucket i counts the frames with values in [Min + i*BucketWidth, Min + (i+1)*BucketWidth),
+	// the last bucket also holding Max.
+	struct Histogram
+	{
+		uint64 Min = 0;
+		uint64 Max = 0;
+		double BucketWidth = 0.0;
+		std::vector<uint32> Counts;
+	};
+
+	explicit FrameStats(uint32 historyLength = DefaultHistoryLength);
+
+	void Add(FrameCounter counter, uint64 value);
+
+	// The frame being counted.
+	const Frame& Current()const;
+
+	// Stamps the frame time, moves the frame into the history and starts the next one.
+	void EndFrame();
+
+	// Finished frames kept, at most the history length.
+	uint32 FrameCount()const;
+
+	// i = 0 is the oldest frame kept, FrameCount() - 1 the last one finished.
+	const Frame& GetFrame(uint32 i)const;
+	const Frame& GetLastFrame()const;
+
+	Summary GetSummary(FrameCounter counter)const;
+	Histogram GetHistogram(FrameCounter counter, uint32 bucketCount = DefaultBucketCount)const;
+
+	// One row per kept frame, oldest first.
+	bool WriteCsv(const std::string& path)const;
+
+	// The summary and histogram of every counter followed by the per frame values.
+	bool WriteJson(const std::string& path)const;
+
+	static const char* CounterName(FrameCounter counter);
+
+private:
+	void GetValues(FrameCounter counter, std::vector<uint64>& values)const;
+
+private:
+	std::vector<Frame> mHistory;
+	uint32 mNext = 0;
+	uint32 mCount = 0;
+
+	Frame mCurrent;
+	std::chrono::steady_clock::time_point mLastEnd;
+	bool mHasLastEnd = false;
+};
+
+class FrameStatsSink : public CommandSink
+{
+public:
+	// Topology values as in D3D_PRIMITIVE_TOPOLOGY, for counting triangles.
+	static const uint32 TriangleList = 4;
+	static const uint32 TriangleStrip = 5;
+
+	// Counts into stats and passes every command on to next.
+	FrameStatsSink(FrameStats& stats, CommandSink* next);
+
+	void SetNext(CommandSink* next);
+
+	void BeginFrame(uint64 frame)override;
+	void EndFrame()override;
+	void SetPipelineState(uint32 pso)override;
+	void SetRootSignature(uint32 rootSignature)override;
+	void SetDescriptorHeap(uint32 heap)override;
+	void SetViewport(const Viewport& viewport)override;
+	void SetScissorRect(const Rect& rect)override;
+	void ResourceBarriers(const Barrier* barriers, uint32 count)override;
+	void ClearRenderTarget(uint32 renderTarget, const float color[4])override;
+	void ClearDepthStencil(uint32 depthStencil, float depth, uint8 stencil)override;
+	void SetRenderTarget(uint32 renderTarget, uint32 depthStencil)override;
+	void SetDescriptorTable(uint32 parameter, uint32 descriptor)override;
+	void SetRootConstant(uint32 parameter, uint32 value)override;
+	void SetRootShaderResource(uint32 parameter, uint32 buffer)override;
+	void SetVertexBuffer(uint32 geometry)override;
+	void SetIndexBuffer(uint32 geometry)override;
+	void SetTopology(uint32 topology)override;
+	void DrawIndexed(uint32 indexCount, uint32 instanceCount, uint32 startIndex,
+		int32 baseVertex, uint32 startInstance)override;
+	void UploadContents(uint32 buffer, const void* data, uint32 size)override;
+
+private:
+	// Counts a state change, or a redundant one if state already holds value.
+	void SetState(uint64& state, uint64 value);
+
+private:
+	FrameStats& mStats;
+	CommandSink* mNext;
+
+	// Everything a command list forgets between frames; ~0 is "not set".
+	uint64 mPso = ~0ull;
+	uint64 mRootSignature = ~0ull;
+	uint64 mHeap = ~0ull;
+	uint64 mTargets = ~0ull;
+	uint64 mVertexBuffer = ~0ull;
+	uint64 mIndexBuffer = ~0ull;
+	uint64 mTopology = ~0ull;
+};
@@ -4,12 +4,102 @@
 
 #include "GeometryGenerator.h"
 #include <algorithm>
+#include <chrono>
 
 using namespace DirectX;
 
-GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
+namespace
 {
-    MeshData meshData;
+	// Forwards to the global heap and counts the calls and bytes.
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		std::uint64_t Allocations = 0;
+		std::uint64_t Bytes = 0;
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment)override
+		{
+			++Allocations;
+			Bytes += bytes;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment)override
+		{
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	// Subdivide turns every triangle into six vertices and four triangles.
+	GeometryGenerator::MeshSize SubdividedSize(GeometryGenerator::uint32 vertexCount,
+		GeometryGenerator::uint32 triangleCount, GeometryGenerator::uint32 numSubdivisions)
+	{
+		GeometryGenerator::MeshSize size;
+		size.VertexCount = vertexCount;
+		for(GeometryGenerator::uint32 i = 0; i < numSubdivisions; ++i)
+		{
+			size.VertexCount = triangleCount*6;
+			triangleCount *= 4;
+		}
+		size.IndexCount = triangleCount*3;
+		return size;
+	}
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 numSubdivisions)
+{
+	return SubdividedSize(24, 12, std::min<uint32>(numSubdivisions, 6u));
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
+{
+	// Two poles plus stackCount-1 rings; a fan at each pole and quads in between.
+	MeshSize size;
+	size.VertexCount = 2 + (stackCount-1)*(sliceCount+1);
+	size.IndexCount = 6*sliceCount*(stackCount-1);
+	return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions)
+{
+	return SubdividedSize(12, 20, std::min<uint32>(numSubdivisions, 6u));
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+	// stackCount+1 rings of sliceCount+1 vertices, and per cap a ring plus its center.
+	MeshSize size;
+	size.VertexCount = (stackCount+1)*(sliceCount+1) + 2*(sliceCount+2);
+	size.IndexCount = 6*sliceCount*stackCount + 6*sliceCount;
+	return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+	MeshSize size;
+	size.VertexCount = m*n;
+	size.IndexCount = (m-1)*(n-1)*6;
+	return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::QuadSize()
+{
+	MeshSize size;
+	size.VertexCount = 4;
+	size.IndexCount = 6;
+	return size;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions,
+	std::pmr::memory_resource* resource)
+{
+    MeshData meshData(resource);
 
     //
 	// Create the vertices.
@@ -100,9 +190,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
     return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount,
+	std::pmr::memory_resource* resource)
 {
-    MeshData meshData;
+    MeshData meshData(resource);
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -114,6 +205,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
+	MeshSize size = SphereSize(sliceCount, stackCount);
+	meshData.Vertices.reserve(size.VertexCount);
+	meshData.Indices32.reserve(size.IndexCount);
+
 	meshData.Vertices.push_back( topVertex );
 
 	float phiStep   = XM_PI/stackCount;
@@ -213,12 +308,9 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+	// Build the result next to the input, with the input's memory resource, instead of
+	// copying the input and refilling it.
+	MeshData output(meshData.Vertices.get_allocator().resource());
 
 	//       v1
 	//       *
@@ -230,12 +322,15 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
+	uint32 numTris = (uint32)meshData.Indices32.size()/3;
+	output.Vertices.reserve(numTris*6);
+	output.Indices32.reserve(numTris*12);
+
 	for(uint32 i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
+		Vertex v0 = meshData.Vertices[ meshData.Indices32[i*3+0] ];
+		Vertex v1 = meshData.Vertices[ meshData.Indices32[i*3+1] ];
+		Vertex v2 = meshData.Vertices[ meshData.Indices32[i*3+2] ];
 
 		//
 		// Generate the midpoints.
@@ -249,29 +344,32 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 		// Add new geometry.
 		//
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
+		output.Vertices.push_back(v0); // 0
+		output.Vertices.push_back(v1); // 1
+		output.Vertices.push_back(v2); // 2
+		output.Vertices.push_back(m0); // 3
+		output.Vertices.push_back(m1); // 4
+		output.Vertices.push_back(m2); // 5
  
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+		output.Indices32.push_back(i*6+0);
+		output.Indices32.push_back(i*6+3);
+		output.Indices32.push_back(i*6+5);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+		output.Indices32.push_back(i*6+3);
+		output.Indices32.push_back(i*6+4);
+		output.Indices32.push_back(i*6+5);
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+		output.Indices32.push_back(i*6+5);
+		output.Indices32.push_back(i*6+4);
+		output.Indices32.push_back(i*6+2);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		output.Indices32.push_back(i*6+3);
+		output.Indices32.push_back(i*6+1);
+		output.Indices32.push_back(i*6+4);
 	}
+
+	// Same resource on both sides, so this moves the arrays without copying them.
+	meshData = std::move(output);
 }
 
 GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
@@ -304,9 +402,10 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
     return v;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
+GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions,
+	std::pmr::memory_resource* resource)
 {
-    MeshData meshData;
+    MeshData meshData(resource);
 
 	// Put a cap on the number of subdivisions.
     numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
@@ -379,9 +478,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
+GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+	std::pmr::memory_resource* resource)
 {
-    MeshData meshData;
+    MeshData meshData(resource);
 
 	//
 	// Build Stacks.
@@ -394,6 +494,11 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	uint32 ringCount = stackCount+1;
 
+	// The caps are included, so neither array grows after this.
+	MeshSize size = CylinderSize(sliceCount, stackCount);
+	meshData.Vertices.reserve(size.VertexCount);
+	meshData.Indices32.reserve(size.IndexCount);
+
 	// Compute vertices for each stack ring starting at the bottom and moving up.
 	for(uint32 i = 0; i < ringCount; ++i)
 	{
@@ -548,9 +653,10 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 	}
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
+GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n,
+	std::pmr::memory_resource* resource)
 {
-    MeshData meshData;
+    MeshData meshData(resource);
 
 	uint32 vertexCount = m*n;
 	uint32 faceCount   = (m-1)*(n-1)*2;
@@ -613,9 +719,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
     return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
+GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth,
+	std::pmr::memory_resource* resource)
 {
-    MeshData meshData;
+    MeshData meshData(resource);
 
 	meshData.Vertices.resize(4);
 	meshData.Indices32.resize(6);
@@ -655,3 +762,27 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 
     return meshData;
 }
+
+GeometryGenerator::BenchmarkResult GeometryGenerator::Benchmark(uint32 meshCount)
+{
+	GeometryGenerator geoGen;
+	CountingResource counter;
+	BenchmarkResult result;
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32 i = 0; i < meshCount; ++i)
+	{
+		// Vary the tessellation a little so every mesh is a different size.
+		uint32 t = 8 + i % 16;
+		MeshData sphere = geoGen.CreateSphere(0.5f, t, t, &counter);
+		MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, t, t, &counter);
+		MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, t, t, &counter);
+		MeshData quad = geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, &counter);
+		result.MeshCount += 4;
+	}
+	result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	result.Allocations = counter.Allocations;
+	result.Bytes = counter.Bytes;
+	return result;
+}
@@ -10,12 +10,18 @@
 //   1. Change the Direct3D cull mode or manually reverse the winding order.
 //   2. Invert the normal.
 //   3. Update the texture coordinates and tangent vectors.
+//
+// Every generator takes an optional std::pmr::memory_resource for the mesh's arrays and
+// reserves their exact final size before filling them, so a mesh costs one allocation
+// per array (per subdivision level for boxes and geospheres).  The *Size functions give
+// the same counts up front, for sizing an arena that holds many meshes.
 //***************************************************************************************
 
 #pragma once
 
 #include <cstdint>
 #include <DirectXMath.h>
+#include <memory_resource>
 #include <vector>
 
 class GeometryGenerator
@@ -55,61 +61,117 @@ public:
 
 	struct MeshData
 	{
-		std::vector<Vertex> Vertices;
-        std::vector<uint32> Indices32;
+		MeshData() = default;
+
+		// Vertices, Indices32 and the 16 bit index copy all allocate from resource.
+		explicit MeshData(std::pmr::memory_resource* resource) :
+			Vertices(resource),
+			Indices32(resource),
+			mIndices16(resource){}
+
+		std::pmr::vector<Vertex> Vertices;
+        std::pmr::vector<uint32> Indices32;
 
-        std::vector<uint16>& GetIndices16()
+        std::pmr::vector<uint16>& GetIndices16()
         {
 			if(mIndices16.empty())
 			{
 				mIndices16.resize(Indices32.size());
-				for(size_t i = 0; i < Indices32.size(); ++i)
-					mIndices16[i] = static_cast<uint16>(Indices32[i]);
+				CopyIndices16(mIndices16.data());
 			}
 
 			return mIndices16;
         }
 
+		// Writes Indices32.size() 16 bit indices to dst without keeping a copy.
+		void CopyIndices16(uint16* dst)const
+		{
+			for(size_t i = 0; i < Indices32.size(); ++i)
+				dst[i] = static_cast<uint16>(Indices32[i]);
+		}
+
 	private:
-		std::vector<uint16> mIndices16;
+		std::pmr::vector<uint16> mIndices16;
+	};
+
+	struct MeshSize
+	{
+		uint32 VertexCount = 0;
+		uint32 IndexCount = 0;
 	};
 
+	struct BenchmarkResult
+	{
+		uint32 MeshCount = 0;
+		double Milliseconds = 0.0;
+		std::uint64_t Allocations = 0;    // upstream calls for all meshes
+		std::uint64_t Bytes = 0;
+
+		double AllocationsPerMesh()const { return MeshCount > 0 ? (double)Allocations / MeshCount : 0.0; }
+	};
+
+	// Exact sizes of the meshes the matching Create functions build.
+	static MeshSize BoxSize(uint32 numSubdivisions);
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GeosphereSize(uint32 numSubdivisions);
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n);
+	static MeshSize QuadSize();
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
 	///</summary>
-    MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
-    MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
 	/// depth controls the level of tessellation.
 	///</summary>
-    MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    MeshData CreateGeosphere(float radius, uint32 numSubdivisions,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
 	/// The bottom and top radius can vary to form various cone shapes rather than true
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
-    MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+    MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 	/// at the origin with the specified width and depth.
 	///</summary>
-    MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    MeshData CreateGrid(float width, float depth, uint32 m, uint32 n,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
-    MeshData CreateQuad(float x, float y, float w, float h, float depth);
+    MeshData CreateQuad(float x, float y, float w, float h, float depth,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	///<summary>
+	/// Splits every triangle into four.  The new arrays come from the resource of
+	/// meshData's own arrays.
+	///</summary>
 	void Subdivide(MeshData& meshData);
+
+	///<summary>
+	/// Builds meshCount meshes of each generator type with a counting resource and
+	/// reports how many allocations that took.
+	///</summary>
+	static BenchmarkResult Benchmark(uint32 meshCount);
+
 private:
 	
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
@@ -0,0 +1,519 @@
+//***************************************************************************************
+// HeightQuadtree.cpp
+//***************************************************************************************
+
+#include "HeightQuadtree.h"
+#include "MathHelper.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Deepest tree the fixed traversal stack can hold: 2^30 cells on a side.
+	const int MaxLevels = 31;
+
+	// Rays Benchmark also tests against every cell; each costs a pass over the whole grid.
+	const HeightQuadtree::uint32 BenchmarkCheckedRays = 32;
+
+	struct StackNode
+	{
+		HeightQuadtree::uint32 Level;
+		HeightQuadtree::uint32 I;
+		HeightQuadtree::uint32 J;
+		float Enter; // distance at which the ray enters the node's box
+	};
+
+	// Slab test against an axis aligned box; returns the entry distance or -1 on a miss.
+	float IntersectBox(const XMFLOAT3& origin, const XMFLOAT3& invDir,
+		const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, float maxDistance)
+	{
+		float tx0 = (boxMin.x - origin.x) * invDir.x;
+		float tx1 = (boxMax.x - origin.x) * invDir.x;
+		float ty0 = (boxMin.y - origin.y) * invDir.y;
+		float ty1 = (boxMax.y - origin.y) * invDir.y;
+		float tz0 = (boxMin.z - origin.z) * invDir.z;
+		float tz1 = (boxMax.z - origin.z) * invDir.z;
+
+		float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+		float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), maxDistance));
+
+		return tNear <= tFar ? tNear : -1.0f;
+	}
+
+	// Two sided Moller-Trumbore ray/triangle test.
+	bool IntersectTriangle(const XMFLOAT3& origin, const XMFLOAT3& dir,
+		const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2, float* t)
+	{
+		XMFLOAT3 e1(v1.x - v0.x, v1.y - v0.y, v1.z - v0.z);
+		XMFLOAT3 e2(v2.x - v0.x, v2.y - v0.y, v2.z - v0.z);
+
+		XMFLOAT3 p(dir.y * e2.z - dir.z * e2.y, dir.z * e2.x - dir.x * e2.z, dir.x * e2.y - dir.y * e2.x);
+		float det = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+		if(std::fabs(det) < 1e-12f)
+			return false;
+
+		float invDet = 1.0f / det;
+		XMFLOAT3 s(origin.x - v0.x, origin.y - v0.y, origin.z - v0.z);
+
+		float u = (s.x * p.x + s.y * p.y + s.z * p.z) * invDet;
+		if(u < 0.0f || u > 1.0f)
+			return false;
+
+		XMFLOAT3 q(s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x);
+		float v = (dir.x * q.x + dir.y * q.y + dir.z * q.z) * invDet;
+		if(v < 0.0f || u + v > 1.0f)
+			return false;
+
+		*t = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * invDet;
+		return *t >= 0.0f;
+	}
+}
+
+double HeightQuadtree::BenchmarkResult::RaysPerSecond()const
+{
+	return Milliseconds > 0.0 ? RayCount * 1000.0 / Milliseconds : 0.0;
+}
+
+HeightQuadtree::HeightQuadtree(const GeometryGenerator::MeshData& grid, uint32 m, uint32 n)
+	: mNumRows(m), mNumCols(n)
+{
+	assert(m >= 2 && n >= 2);
+	assert(grid.Vertices.size() == (size_t)m*n);
+
+	const XMFLOAT3& first = grid.Vertices[0].Position;
+	mOriginX = first.x;
+	mOriginZ = first.z;
+	mDx = grid.Vertices[1].Position.x - first.x;
+	mDz = first.z - grid.Vertices[n].Position.z;
+
+	mHeights.resize((size_t)m*n);
+	for(size_t k = 0; k < mHeights.size(); ++k)
+		mHeights[k] = grid.Vertices[k].Position.y;
+
+	BuildLevels();
+}
+
+HeightQuadtree::HeightQuadtree(std::vector<float> heights, uint32 m, uint32 n,
+	float originX, float originZ, float dx, float dz)
+	: mNumRows(m), mNumCols(n), mOriginX(originX), mOriginZ(originZ), mDx(dx), mDz(dz),
+	mHeights(std::move(heights))
+{
+	assert(m >= 2 && n >= 2);
+	assert(mHeights.size() == (size_t)m*n);
+
+	BuildLevels();
+}
+
+HeightQuadtree::uint32 HeightQuadtree::RowCount()const
+{
+	return mNumRows;
+}
+
+HeightQuadtree::uint32 HeightQuadtree::ColumnCount()const
+{
+	return mNumCols;
+}
+
+HeightQuadtree::uint32 HeightQuadtree::LevelCount()const
+{
+	return (uint32)mRanges.size();
+}
+
+HeightQuadtree::uint32 HeightQuadtree::NodeRows(uint32 level)const
+{
+	return mLevelRows[level];
+}
+
+HeightQuadtree::uint32 HeightQuadtree::NodeColumns(uint32 level)const
+{
+	return mLevelCols[level];
+}
+
+void HeightQuadtree::BuildLevels()
+{
+	mRanges.clear();
+	mLevelRows.clear();
+	mLevelCols.clear();
+
+	uint32 rows = mNumRows - 1;
+	uint32 cols = mNumCols - 1;
+	while(true)
+	{
+		mLevelRows.push_back(rows);
+		mLevelCols.push_back(cols);
+		mRanges.emplace_back((size_t)rows * cols);
+
+		if(rows == 1 && cols == 1)
+			break;
+
+		rows = (rows + 1) / 2;
+		cols = (cols + 1) / 2;
+	}
+	assert(mRanges.size() <= (size_t)MaxLevels);
+
+	RefitCells(0, mNumRows - 1, 0, mNumCols - 1);
+}
+
+void HeightQuadtree::RefitCells(uint32 i0, uint32 i1, uint32 j0, uint32 j1)
+{
+	// Cells take the range of their four corners.
+	auto& cells = mRanges[0];
+	for(uint32 i = i0; i < i1; ++i)
+	{
+		for(uint32 j = j0; j < j1; ++j)
+		{
+			float h00 = mHeights[i*mNumCols + j];
+			float h01 = mHeights[i*mNumCols + j + 1];
+			float h10 = mHeights[(i + 1)*mNumCols + j];
+			float h11 = mHeights[(i + 1)*mNumCols + j + 1];
+
+			cells[i*mLevelCols[0] + j] = XMFLOAT2(
+				std::min(std::min(h00, h01), std::min(h10, h11)),
+				std::max(std::max(h00, h01), std::max(h10, h11)));
+		}
+	}
+
+	// Every other node takes the range of its (up to four) children.
+	for(size_t level = 1; level < mRanges.size(); ++level)
+	{
+		i0 /= 2;
+		j0 /= 2;
+		i1 = (i1 + 1) / 2;
+		j1 = (j1 + 1) / 2;
+
+		const auto& below = mRanges[level - 1];
+		const uint32 belowRows = mLevelRows[level - 1];
+		const uint32 belowCols = mLevelCols[level - 1];
+		auto& nodes = mRanges[level];
+
+		for(uint32 i = i0; i < i1; ++i)
+		{
+			for(uint32 j = j0; j < j1; ++j)
+			{
+				XMFLOAT2 range(FLT_MAX, -FLT_MAX);
+				for(uint32 ci = 2*i; ci < std::min(2*i + 2, belowRows); ++ci)
+				{
+					for(uint32 cj = 2*j; cj < std::min(2*j + 2, belowCols); ++cj)
+					{
+						const XMFLOAT2& child = below[ci*belowCols + cj];
+						range.x = std::min(range.x, child.x);
+						range.y = std::max(range.y, child.y);
+					}
+				}
+				nodes[i*mLevelCols[level] + j] = range;
+			}
+		}
+	}
+}
+
+void HeightQuadtree::Refit(const GeometryGenerator::MeshData& grid, const GridRegion& region)
+{
+	assert(grid.Vertices.size() == mHeights.size());
+	if(region.Empty())
+		return;
+
+	for(uint32 i = region.RowBegin; i < region.RowEnd; ++i)
+	{
+		for(uint32 j = region.ColBegin; j < region.ColEnd; ++j)
+			mHeights[i*mNumCols + j] = grid.Vertices[i*mNumCols + j].Position.y;
+	}
+
+	// A vertex is a corner of the cells up and to the left of it as well as its own.
+	uint32 i0 = region.RowBegin > 0 ? region.RowBegin - 1 : 0;
+	uint32 j0 = region.ColBegin > 0 ? region.ColBegin - 1 : 0;
+	uint32 i1 = std::min(region.RowEnd, mNumRows - 1);
+	uint32 j1 = std::min(region.ColEnd, mNumCols - 1);
+
+	RefitCells(i0, i1, j0, j1);
+}
+
+GridRegion HeightQuadtree::GetNodeRegion(uint32 level, uint32 i, uint32 j)const
+{
+	GridRegion r;
+	r.RowBegin = i << level;
+	r.RowEnd = std::min((i + 1) << level, mNumRows - 1) + 1;
+	r.ColBegin = j << level;
+	r.ColEnd = std::min((j + 1) << level, mNumCols - 1) + 1;
+	return r;
+}
+
+void HeightQuadtree::GetNodeMinMax(uint32 level, uint32 i, uint32 j, XMFLOAT3& boxMin, XMFLOAT3& boxMax)const
+{
+	GridRegion r = GetNodeRegion(level, i, j);
+	const XMFLOAT2& range = mRanges[level][i*mLevelCols[level] + j];
+
+	boxMin = XMFLOAT3(mOriginX + r.ColBegin * mDx, range.x, mOriginZ - (r.RowEnd - 1) * mDz);
+	boxMax = XMFLOAT3(mOriginX + (r.ColEnd - 1) * mDx, range.y, mOriginZ - r.RowBegin * mDz);
+}
+
+BoundingBox HeightQuadtree::GetNodeBounds(uint32 level, uint32 i, uint32 j)const
+{
+	XMFLOAT3 boxMin, boxMax;
+	GetNodeMinMax(level, i, j, boxMin, boxMax);
+
+	BoundingBox box;
+	BoundingBox::CreateFromPoints(box, XMLoadFloat3(&boxMin), XMLoadFloat3(&boxMax));
+	return box;
+}
+
+BoundingBox HeightQuadtree::GetBounds()const
+{
+	return GetNodeBounds(LevelCount() - 1, 0, 0);
+}
+
+float HeightQuadtree::GetHeight(float x, float z)const
+{
+	float fx = MathHelper::Clamp((x - mOriginX) / mDx, 0.0f, (float)(mNumCols - 1));
+	float fz = MathHelper::Clamp((mOriginZ - z) / mDz, 0.0f, (float)(mNumRows - 1));
+
+	uint32 j = std::min((uint32)fx, mNumCols - 2);
+	uint32 i = std::min((uint32)fz, mNumRows - 2);
+	float s = fx - j;
+	float t = fz - i;
+
+	float h00 = mHeights[i*mNumCols + j];
+	float h01 = mHeights[i*mNumCols + j + 1];
+	float h10 = mHeights[(i + 1)*mNumCols + j];
+	float h11 = mHeights[(i + 1)*mNumCols + j + 1];
+
+	return MathHelper::Lerp(MathHelper::Lerp(h00, h01, s), MathHelper::Lerp(h10, h11, s), t);
+}
+
+bool HeightQuadtree::IntersectCell(uint32 i, uint32 j, const XMFLOAT3& origin,
+	const XMFLOAT3& dir, float* distance)const
+{
+	float x0 = mOriginX + j * mDx;
+	float x1 = x0 + mDx;
+	float z0 = mOriginZ - i * mDz;
+	float z1 = z0 - mDz;
+
+	XMFLOAT3 v00(x0, mHeights[i*mNumCols + j], z0);
+	XMFLOAT3 v01(x1, mHeights[i*mNumCols + j + 1], z0);
+	XMFLOAT3 v10(x0, mHeights[(i + 1)*mNumCols + j], z1);
+	XMFLOAT3 v11(x1, mHeights[(i + 1)*mNumCols + j + 1], z1);
+
+	// Same split as CreateGrid's index buffer.
+	float t0 = FLT_MAX;
+	float t1 = FLT_MAX;
+	bool hit0 = IntersectTriangle(origin, dir, v00, v01, v10, &t0);
+	bool hit1 = IntersectTriangle(origin, dir, v10, v01, v11, &t1);
+	if(!hit0 && !hit1)
+		return false;
+
+	*distance = std::min(hit0 ? t0 : FLT_MAX, hit1 ? t1 : FLT_MAX);
+	return true;
+}
+
+bool HeightQuadtree::Raycast(const XMFLOAT3& origin, const XMFLOAT3& dir,
+	float* distance, float maxDistance)const
+{
+	// Zero components become huge instead of infinite so the slab test never sees 0*inf.
+	auto safeInverse = [](float d) { return std::fabs(d) > 1e-20f ? 1.0f / d : (d < 0.0f ? -1e30f : 1e30f); };
+	XMFLOAT3 invDir(safeInverse(dir.x), safeInverse(dir.y), safeInverse(dir.z));
+
+	float best = maxDistance;
+	bool hit = false;
+
+	// A single cell grid has no levels to walk.
+	if(LevelCount() == 1)
+	{
+		if(IntersectCell(0, 0, origin, dir, &best) && best < maxDistance)
+		{
+			*distance = best;
+			return true;
+		}
+		return false;
+	}
+
+	StackNode stack[3 * MaxLevels + 1];
+	int top = 0;
+
+	// Boxes are tested when a node is pushed, and children are pushed far to near so the
+	// nearest is popped first; once a hit is found, everything entered behind it is skipped.
+	XMFLOAT3 boxMin, boxMax;
+	GetNodeMinMax(LevelCount() - 1, 0, 0, boxMin, boxMax);
+	float rootEnter = IntersectBox(origin, invDir, boxMin, boxMax, best);
+	if(rootEnter < 0.0f)
+		return false;
+	stack[top++] = { LevelCount() - 1, 0, 0, rootEnter };
+
+	while(top > 0)
+	{
+		StackNode node = stack[--top];
+		if(node.Enter >= best)
+			continue;
+
+		const uint32 childLevel = node.Level - 1;
+
+		StackNode children[4];
+		int childCount = 0;
+		for(uint32 ci = 2 * node.I; ci < std::min(2 * node.I + 2, mLevelRows[childLevel]); ++ci)
+		{
+			for(uint32 cj = 2 * node.J; cj < std::min(2 * node.J + 2, mLevelCols[childLevel]); ++cj)
+			{
+				GetNodeMinMax(childLevel, ci, cj, boxMin, boxMax);
+
+				float tEnter = IntersectBox(origin, invDir, boxMin, boxMax, best);
+				if(tEnter < 0.0f)
+					continue;
+
+				// Insertion sort by entry distance, farthest first.
+				int k = childCount++;
+				for(; k > 0 && children[k - 1].Enter < tEnter; --k)
+					children[k] = children[k - 1];
+				children[k] = { childLevel, ci, cj, tEnter };
+			}
+		}
+
+		if(childLevel == 0)
+		{
+			// Cells are tested right away, nearest first.
+			for(int k = childCount - 1; k >= 0 && children[k].Enter < best; --k)
+			{
+				float t;
+				if(IntersectCell(children[k].I, children[k].J, origin, dir, &t) && t < best)
+				{
+					best = t;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		for(int k = 0; k < childCount; ++k)
+			stack[top++] = children[k];
+	}
+
+	if(hit)
+		*distance = best;
+	return hit;
+}
+
+HeightQuadtree::uint32 HeightQuadtree::RaycastMany(const Ray* rays, uint32 count, float* distances,
+	ThreadPool& pool)const
+{
+	std::atomic<uint32> hits{ 0 };
+
+	pool.ParallelFor(count, 256, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		uint32 localHits = 0;
+		for(uint32 k = begin; k < end; ++k)
+		{
+			float t;
+			if(Raycast(rays[k].Origin, rays[k].Direction, &t))
+			{
+				distances[k] = t;
+				++localHits;
+			}
+			else
+			{
+				distances[k] = -1.0f;
+			}
+		}
+		hits += localHits;
+	});
+
+	return hits;
+}
+
+void HeightQuadtree::FindVisibleNodes(const BoundingFrustum& frustum, uint32 level,
+	std::vector<GridRegion>& regions)const
+{
+	assert(level < LevelCount());
+	CollectNodes(LevelCount() - 1, 0, 0, level, frustum, false, regions);
+}
+
+void HeightQuadtree::CollectNodes(uint32 level, uint32 i, uint32 j, uint32 targetLevel,
+	const BoundingFrustum& frustum, bool inside, std::vector<GridRegion>& regions)const
+{
+	if(!inside)
+	{
+		ContainmentType containment = frustum.Contains(GetNodeBounds(level, i, j));
+		if(containment == DISJOINT)
+			return;
+
+		inside = containment == CONTAINS;
+	}
+
+	if(level == targetLevel)
+	{
+		regions.push_back(GetNodeRegion(level, i, j));
+		return;
+	}
+
+	for(uint32 ci = 2 * i; ci < std::min(2 * i + 2, mLevelRows[level - 1]); ++ci)
+	{
+		for(uint32 cj = 2 * j; cj < std::min(2 * j + 2, mLevelCols[level - 1]); ++cj)
+			CollectNodes(level - 1, ci, cj, targetLevel, frustum, inside, regions);
+	}
+}
+
+HeightQuadtree::BenchmarkResult HeightQuadtree::Benchmark(const HeightQuadtree& tree, uint32 rayCount,
+	ThreadPool& pool)
+{
+	BoundingBox bounds = tree.GetBounds();
+
+	// Rays start in a band above the terrain and aim at random points at its lowest height,
+	// so they come in at all angles and most of them hit.
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> unitX(-1.0f, 1.0f);
+
+	std::vector<Ray> rays(rayCount);
+	for(auto& ray : rays)
+	{
+		ray.Origin = XMFLOAT3(
+			bounds.Center.x + unitX(rng) * bounds.Extents.x,
+			bounds.Center.y + bounds.Extents.y + 10.0f,
+			bounds.Center.z + unitX(rng) * bounds.Extents.z);
+
+		XMFLOAT3 target(
+			bounds.Center.x + unitX(rng) * bounds.Extents.x,
+			bounds.Center.y - bounds.Extents.y,
+			bounds.Center.z + unitX(rng) * bounds.Extents.z);
+
+		ray.Direction = XMFLOAT3(target.x - ray.Origin.x, target.y - ray.Origin.y, target.z - ray.Origin.z);
+	}
+
+	std::vector<float> distances(rayCount);
+
+	BenchmarkResult result;
+	result.RayCount = rayCount;
+
+	auto start = std::chrono::steady_clock::now();
+	result.HitCount = tree.RaycastMany(rays.data(), rayCount, distances.data(), pool);
+	result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	ThreadPool serial(0);
+	start = std::chrono::steady_clock::now();
+	tree.RaycastMany(rays.data(), rayCount, distances.data(), serial);
+	result.SerialMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// The tree may only skip cells the ray cannot hit, so it must find the same nearest
+	// hit as trying them all.
+	result.CheckedRays = std::min(rayCount, BenchmarkCheckedRays);
+	for(uint32 k = 0; k < result.CheckedRays; ++k)
+	{
+		float nearest = FLT_MAX;
+		for(uint32 i = 0; i + 1 < tree.mNumRows; ++i)
+		{
+			for(uint32 j = 0; j + 1 < tree.mNumCols; ++j)
+			{
+				float t;
+				if(tree.IntersectCell(i, j, rays[k].Origin, rays[k].Direction, &t))
+					nearest = std::min(nearest, t);
+			}
+		}
+
+		float expected = nearest < FLT_MAX ? nearest : -1.0f;
+		if(std::fabs(distances[k] - expected) > 1e-5f)
+			++result.Mismatches;
+	}
+
+	return result;
+}
@@ -0,0 +1,143 @@
+//***************************************************************************************
+// HeightQuadtree.h
+//
+// Min/max quadtree (a mip pyramid of height ranges) over a grid height field laid out
+// like GeometryGenerator::CreateGrid.  Level 0 holds the lowest and highest corner of
+// every grid cell and each level above covers 2x2 nodes of the one below, up to a single
+// root.  That gives every node a tight bounding box, so:
+//
+//  - ray casts skip whole empty regions and only test the grid triangles of the few
+//    cells the ray actually gets close to, instead of marching the full grid;
+//  - frustum culling can work on terrain chunks of any size;
+//  - a local edit only refits the nodes above the changed cells.
+//
+// The tree keeps its own copy of the heights, and every query is const, so any number of
+// threads can query it at once.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "TerrainEditor.h"
+#include "ThreadPool.h"
+#include <DirectXCollision.h>
+#include <cfloat>
+
+class HeightQuadtree
+{
+public:
+	using uint32 = GeometryGenerator::uint32;
+
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Direction = { 0.0f, 0.0f, 1.0f };
+	};
+
+	struct BenchmarkResult
+	{
+		uint32 RayCount = 0;
+		uint32 HitCount = 0;
+		double Milliseconds = 0.0;         // RaycastMany on the pool
+		double SerialMilliseconds = 0.0;   // RaycastMany on one thread
+		uint32 CheckedRays = 0;            // compared against every cell of the grid
+		uint32 Mismatches = 0;
+
+		double RaysPerSecond()const;
+	};
+
+	// From a grid built by CreateGrid with m rows and n columns.
+	HeightQuadtree(const GeometryGenerator::MeshData& grid, uint32 m, uint32 n);
+
+	///<summary>
+	/// From m rows of n heights.  Vertex (0, 0) sits at (originX, originZ); columns step
+	/// dx along +x and rows step dz along -z, as in CreateGrid.
+	///</summary>
+	HeightQuadtree(std::vector<float> heights, uint32 m, uint32 n,
+		float originX, float originZ, float dx, float dz);
+
+	uint32 RowCount()const;
+	uint32 ColumnCount()const;
+
+	// Level 0 has one node per grid cell; the last level is the single root.
+	uint32 LevelCount()const;
+	uint32 NodeRows(uint32 level)const;
+	uint32 NodeColumns(uint32 level)const;
+
+	// Box around node (i, j) of a level, in the grid's local space.
+	DirectX::BoundingBox GetNodeBounds(uint32 level, uint32 i, uint32 j)const;
+	DirectX::BoundingBox GetBounds()const;
+
+	// Grid vertices covered by node (i, j) of a level.
+	GridRegion GetNodeRegion(uint32 level, uint32 i, uint32 j)const;
+
+	// Bilinearly interpolated height at (x, z), clamped to the edges of the grid.
+	float GetHeight(float x, float z)const;
+
+	///<summary>
+	/// Nearest hit of the ray with the grid triangles closer than maxDistance.  dir does
+	/// not need to be normalized; *distance is in units of dir.
+	///</summary>
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& dir,
+		float* distance, float maxDistance = FLT_MAX)const;
+
+	///<summary>
+	/// Casts many rays on the pool.  distances[i] is the hit distance of rays[i], or a
+	/// negative value on a miss.  Returns the number of hits.
+	///</summary>
+	uint32 RaycastMany(const Ray* rays, uint32 count, float* distances,
+		ThreadPool& pool = ThreadPool::Get())const;
+
+	///<summary>
+	/// Collects the regions of the level's nodes that are inside or intersect frustum,
+	/// which must be in the grid's local space.  Whole subtrees are accepted or rejected
+	/// at once, so only nodes straddling the frustum planes are tested on every level.
+	///</summary>
+	void FindVisibleNodes(const DirectX::BoundingFrustum& frustum, uint32 level,
+		std::vector<GridRegion>& regions)const;
+
+	///<summary>
+	/// Copies the heights of region from grid and refits every node above it.  grid must
+	/// be the grid the tree was built from.
+	///</summary>
+	void Refit(const GeometryGenerator::MeshData& grid, const GridRegion& region);
+
+	///<summary>
+	/// Casts rayCount pseudo-random rays from above the terrain down onto it with
+	/// RaycastMany and times them, on the pool and on one thread.  The first few rays are
+	/// also tested against every cell, and any that disagree with the tree are counted.
+	///</summary>
+	static BenchmarkResult Benchmark(const HeightQuadtree& tree, uint32 rayCount,
+		ThreadPool& pool = ThreadPool::Get());
+
+private:
+	void BuildLevels();
+
+	void GetNodeMinMax(uint32 level, uint32 i, uint32 j,
+		DirectX::XMFLOAT3& boxMin, DirectX::XMFLOAT3& boxMax)const;
+
+	// Recomputes level 0 cells in rows [i0, i1) and columns [j0, j1) and the nodes above them.
+	void RefitCells(uint32 i0, uint32 i1, uint32 j0, uint32 j1);
+
+	bool IntersectCell(uint32 i, uint32 j, const DirectX::XMFLOAT3& origin,
+		const DirectX::XMFLOAT3& dir, float* distance)const;
+
+	void CollectNodes(uint32 level, uint32 i, uint32 j, uint32 targetLevel,
+		const DirectX::BoundingFrustum& frustum, bool inside, std::vector<GridRegion>& regions)const;
+
+private:
+	uint32 mNumRows = 0;
+	uint32 mNumCols = 0;
+
+	float mOriginX = 0.0f;
+	float mOriginZ = 0.0f;
+	float mDx = 1.0f;
+	float mDz = 1.0f;
+
+	std::vector<float> mHeights;
+
+	// mRanges[level][i*mLevelCols[level] + j] = (min height, max height).
+	std::vector<std::vector<DirectX::XMFLOAT2>> mRanges;
+	std::vector<uint32> mLevelRows;
+	std::vector<uint32> mLevelCols;
+};
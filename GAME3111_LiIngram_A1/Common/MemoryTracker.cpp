@@ -0,0 +1,203 @@
+//***************************************************************************************
+// MemoryTracker.cpp
+//***************************************************************************************
+
+#include "MemoryTracker.h"
+#include <cassert>
+
+//
+// MemoryTracker
+//
+
+MemoryTracker& MemoryTracker::Get()
+{
+	static MemoryTracker tracker;
+	return tracker;
+}
+
+MemoryTracker::MemoryTracker()
+{
+	for(size_t i = 0; i < (size_t)MemoryTag::Count; ++i)
+		mResources[i] = std::make_unique<TrackingResource>(*this, (MemoryTag)i);
+}
+
+MemoryTracker::AtomicCounter& MemoryTracker::At(MemoryTag tag, MemoryKind kind)
+{
+	return mCounters[(size_t)tag][(size_t)kind];
+}
+
+void MemoryTracker::Allocate(MemoryTag tag, MemoryKind kind, uint64 bytes)
+{
+	AtomicCounter& c = At(tag, kind);
+	++c.Allocations;
+	++c.TotalAllocations;
+
+	uint64 before = c.Bytes.fetch_add(bytes);
+	uint64 after = before + bytes;
+
+	uint64 peak = c.PeakBytes.load();
+	while(after > peak && !c.PeakBytes.compare_exchange_weak(peak, after))
+	{
+	}
+
+	uint64 budget = c.Budget.load();
+	if(budget != 0 && before <= budget && after > budget)
+	{
+		std::lock_guard<std::mutex> lock(mWarningMutex);
+		if(mWarningFunc)
+			mWarningFunc({ tag, kind, after, budget });
+	}
+}
+
+void MemoryTracker::Free(MemoryTag tag, MemoryKind kind, uint64 bytes)
+{
+	AtomicCounter& c = At(tag, kind);
+	assert(c.Bytes.load() >= bytes && c.Allocations.load() > 0);
+
+	--c.Allocations;
+	c.Bytes -= bytes;
+}
+
+void MemoryTracker::SetBudget(MemoryTag tag, MemoryKind kind, uint64 budget)
+{
+	At(tag, kind).Budget = budget;
+}
+
+void MemoryTracker::SetWarningFunc(WarningFunc func)
+{
+	std::lock_guard<std::mutex> lock(mWarningMutex);
+	mWarningFunc = std::move(func);
+}
+
+MemoryTracker::Snapshot MemoryTracker::GetSnapshot()const
+{
+	// Each counter is read atomically, but not all of them at one instant.
+	Snapshot snapshot;
+	for(size_t t = 0; t < (size_t)MemoryTag::Count; ++t)
+	{
+		for(size_t k = 0; k < (size_t)MemoryKind::Count; ++k)
+		{
+			const AtomicCounter& from = mCounters[t][k];
+			Counter& to = snapshot.Counters[t][k];
+			to.Bytes = from.Bytes.load();
+			to.PeakBytes = from.PeakBytes.load();
+			to.Allocations = from.Allocations.load();
+			to.TotalAllocations = from.TotalAllocations.load();
+			to.Budget = from.Budget.load();
+
+			snapshot.TotalBytes[k] += to.Bytes;
+		}
+	}
+	return snapshot;
+}
+
+void MemoryTracker::ResetPeaks()
+{
+	for(auto& tag : mCounters)
+	{
+		for(AtomicCounter& c : tag)
+			c.PeakBytes = c.Bytes.load();
+	}
+}
+
+std::pmr::memory_resource* MemoryTracker::Resource(MemoryTag tag)
+{
+	return mResources[(size_t)tag].get();
+}
+
+const char* MemoryTracker::TagName(MemoryTag tag)
+{
+	switch(tag)
+	{
+	case MemoryTag::Geometry: return "Geometry";
+	case MemoryTag::Uploaders: return "Uploaders";
+	case MemoryTag::FrameResources: return "FrameResources";
+	case MemoryTag::DescriptorHeaps: return "DescriptorHeaps";
+	case MemoryTag::Textures: return "Textures";
+	case MemoryTag::RenderTargets: return "RenderTargets";
+	case MemoryTag::FrameArenas: return "FrameArenas";
+	case MemoryTag::Other: return "Other";
+	default: return "Unknown";
+	}
+}
+
+const char* MemoryTracker::KindName(MemoryKind kind)
+{
+	return kind == MemoryKind::Cpu ? "CPU" : "GPU";
+}
+
+//
+// MemoryTracker::TrackingResource
+//
+
+MemoryTracker::TrackingResource::TrackingResource(MemoryTracker& tracker, MemoryTag tag)
+	: mTracker(tracker), mTag(tag)
+{
+}
+
+void* MemoryTracker::TrackingResource::do_allocate(size_t bytes, size_t alignment)
+{
+	void* p = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	mTracker.Allocate(mTag, MemoryKind::Cpu, bytes);
+	return p;
+}
+
+void MemoryTracker::TrackingResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+	mTracker.Free(mTag, MemoryKind::Cpu, bytes);
+	std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool MemoryTracker::TrackingResource::do_is_equal(const std::pmr::memory_resource& other)const noexcept
+{
+	return this == &other;
+}
+
+//
+// TrackedMemory
+//
+
+TrackedMemory::TrackedMemory(MemoryTag tag, MemoryKind kind, std::uint64_t bytes)
+	: mTag(tag), mKind(kind), mBytes(bytes)
+{
+	if(mBytes != 0)
+		MemoryTracker::Get().Allocate(mTag, mKind, mBytes);
+}
+
+TrackedMemory::TrackedMemory(TrackedMemory&& rhs)
+	: mTag(rhs.mTag), mKind(rhs.mKind), mBytes(rhs.mBytes)
+{
+	rhs.mBytes = 0;
+}
+
+TrackedMemory& TrackedMemory::operator=(TrackedMemory&& rhs)
+{
+	if(this != &rhs)
+	{
+		Reset();
+		mTag = rhs.mTag;
+		mKind = rhs.mKind;
+		mBytes = rhs.mBytes;
+		rhs.mBytes = 0;
+	}
+	return *this;
+}
+
+TrackedMemory::~TrackedMemory()
+{
+	Reset();
+}
+
+void TrackedMemory::Reset()
+{
+	if(mBytes != 0)
+	{
+		MemoryTracker::Get().Free(mTag, mKind, mBytes);
+		mBytes = 0;
+	}
+}
+
+std::uint64_t TrackedMemory::Bytes()const
+{
+	return mBytes;
+}
@@ -0,0 +1,171 @@
+//***************************************************************************************
+// MemoryTracker.h
+//
+// Tagged memory accounting.  Every subsystem that owns a sizeable allocation reports it
+// under a tag, as CPU bytes (heap memory, counted exactly through the tracked allocators
+// from Resource) or GPU bytes (an estimate of what the driver reserves for a resource).
+// The tracker keeps the live bytes and the high-water mark per tag and kind, hands out
+// snapshots, and calls a warning function when a tag crosses its budget.
+//
+// Counters are atomics, so allocations may be reported from any thread.  Direct3D
+// objects are tracked for their whole lifetime with d3dUtil::TrackResource; the tracker
+// itself never touches Direct3D.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+
+enum class MemoryTag : std::uint8_t
+{
+	Geometry,          // mesh CPU copies and default vertex/index buffers
+	Uploaders,         // staging buffers waiting for a copy
+	FrameResources,    // per frame constant and structured buffers
+	DescriptorHeaps,
+	Textures,
+	RenderTargets,     // swap chain and depth buffers
+	FrameArenas,
+	Other,
+
+	Count
+};
+
+enum class MemoryKind : std::uint8_t
+{
+	Cpu,
+	Gpu,
+
+	Count
+};
+
+class MemoryTracker
+{
+public:
+	using uint64 = std::uint64_t;
+
+	struct Counter
+	{
+		uint64 Bytes = 0;
+		uint64 PeakBytes = 0;
+		uint64 Allocations = 0;         // live
+		uint64 TotalAllocations = 0;
+		uint64 Budget = 0;              // 0 for none
+	};
+
+	struct Snapshot
+	{
+		Counter Counters[(size_t)MemoryTag::Count][(size_t)MemoryKind::Count];
+		uint64 TotalBytes[(size_t)MemoryKind::Count] = {};
+
+		const Counter& Get(MemoryTag tag, MemoryKind kind)const
+		{
+			return Counters[(size_t)tag][(size_t)kind];
+		}
+
+		bool OverBudget(MemoryTag tag, MemoryKind kind)const
+		{
+			const Counter& c = Get(tag, kind);
+			return c.Budget != 0 && c.Bytes > c.Budget;
+		}
+	};
+
+	struct BudgetWarning
+	{
+		MemoryTag Tag;
+		MemoryKind Kind;
+		uint64 Bytes;
+		uint64 Budget;
+	};
+
+	using WarningFunc = std::function<void(const BudgetWarning& warning)>;
+
+	static MemoryTracker& Get();
+
+	MemoryTracker();
+	MemoryTracker(const MemoryTracker& rhs) = delete;
+	MemoryTracker& operator=(const MemoryTracker& rhs) = delete;
+
+	void Allocate(MemoryTag tag, MemoryKind kind, uint64 bytes);
+	void Free(MemoryTag tag, MemoryKind kind, uint64 bytes);
+
+	///<summary>
+	/// Warns when the tag's live bytes go above budget; 0 removes the budget.  The
+	/// warning fires once per crossing, on the thread whose allocation crossed, and again
+	/// only after the bytes have come back under the budget.
+	///</summary>
+	void SetBudget(MemoryTag tag, MemoryKind kind, uint64 budget);
+	void SetWarningFunc(WarningFunc func);
+
+	Snapshot GetSnapshot()const;
+
+	// Restarts the high-water marks from the live bytes.
+	void ResetPeaks();
+
+	// Heap allocator that counts as CPU bytes under tag.  Lives as long as the tracker.
+	std::pmr::memory_resource* Resource(MemoryTag tag);
+
+	static const char* TagName(MemoryTag tag);
+	static const char* KindName(MemoryKind kind);
+
+private:
+	struct AtomicCounter
+	{
+		std::atomic<uint64> Bytes{ 0 };
+		std::atomic<uint64> PeakBytes{ 0 };
+		std::atomic<uint64> Allocations{ 0 };
+		std::atomic<uint64> TotalAllocations{ 0 };
+		std::atomic<uint64> Budget{ 0 };
+	};
+
+	class TrackingResource : public std::pmr::memory_resource
+	{
+	public:
+		TrackingResource(MemoryTracker& tracker, MemoryTag tag);
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment)override;
+		void do_deallocate(void* p, size_t bytes, size_t alignment)override;
+		bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override;
+
+	private:
+		MemoryTracker& mTracker;
+		MemoryTag mTag;
+	};
+
+	AtomicCounter& At(MemoryTag tag, MemoryKind kind);
+
+private:
+	AtomicCounter mCounters[(size_t)MemoryTag::Count][(size_t)MemoryKind::Count];
+
+	std::mutex mWarningMutex;
+	WarningFunc mWarningFunc;
+
+	std::unique_ptr<TrackingResource> mResources[(size_t)MemoryTag::Count];
+};
+
+///<summary>
+/// Reports bytes to the global tracker for as long as it lives.  Move-only; a default
+/// constructed one tracks nothing.
+///</summary>
+class TrackedMemory
+{
+public:
+	TrackedMemory() = default;
+	TrackedMemory(MemoryTag tag, MemoryKind kind, std::uint64_t bytes);
+	TrackedMemory(TrackedMemory&& rhs);
+	TrackedMemory& operator=(TrackedMemory&& rhs);
+	~TrackedMemory();
+
+	void Reset();
+	std::uint64_t Bytes()const;
+
+private:
+	MemoryTag mTag = MemoryTag::Other;
+	MemoryKind mKind = MemoryKind::Cpu;
+	std::uint64_t mBytes = 0;
+};
@@ -0,0 +1,63 @@
+//***************************************************************************************
+// MeshLod.cpp
+//***************************************************************************************
+
+#include "MeshLod.h"
+
+using namespace DirectX;
+
+void LodTable::AddLevel(const SubmeshGeometry& submesh, float minScreenSize)
+{
+	assert(MinScreenSize.empty() || minScreenSize <= MinScreenSize.back());
+
+	Levels.push_back(submesh);
+	MinScreenSize.push_back(minScreenSize);
+}
+
+UINT LodTable::LevelCount()const
+{
+	return (UINT)Levels.size();
+}
+
+float LodSelector::ProjectedScreenSize(float radius, float distance, float projScaleY)
+{
+	// Inside (or touching) the sphere: it covers the whole view.
+	if(distance <= radius)
+		return 1.0f;
+
+	// Projected radius in NDC is radius*projScaleY/distance, and NDC spans 2 units of
+	// height, so the diameter covers exactly that fraction of the viewport.
+	return radius * projScaleY / distance;
+}
+
+float LodSelector::ProjectedScreenSize(const BoundingBox& localBounds,
+	const XMFLOAT4X4& world, const XMFLOAT3& eyePosW, float projScaleY)
+{
+	XMMATRIX W = XMLoadFloat4x4(&world);
+
+	XMVECTOR centerW = XMVector3Transform(XMLoadFloat3(&localBounds.Center), W);
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(centerW, XMLoadFloat3(&eyePosW))));
+
+	float scale = XMVectorGetX(XMVectorMax(XMVector3Length(W.r[0]),
+		XMVectorMax(XMVector3Length(W.r[1]), XMVector3Length(W.r[2]))));
+	float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&localBounds.Extents))) * scale;
+
+	return ProjectedScreenSize(radius, distance, projScaleY);
+}
+
+UINT LodSelector::SelectLevel(const LodTable& table, UINT currentLevel, float screenSize)
+{
+	UINT levelCount = table.LevelCount();
+	if(levelCount == 0)
+		return 0;
+
+	UINT level = MathHelper::Min(currentLevel, levelCount - 1);
+
+	while(level + 1 < levelCount && screenSize < table.MinScreenSize[level] * (1.0f - table.Hysteresis))
+		++level;
+
+	while(level > 0 && screenSize >= table.MinScreenSize[level - 1] * (1.0f + table.Hysteresis))
+		--level;
+
+	return level;
+}
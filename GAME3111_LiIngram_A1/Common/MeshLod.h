@@ -0,0 +1,52 @@
+//***************************************************************************************
+// MeshLod.h
+//
+// Level of detail tables for render items.  Each table lists the submeshes of one
+// primitive from finest to coarsest, together with the projected screen size needed to
+// use each level.  Levels are picked once per frame with a hysteresis band so an object
+// sitting right on a threshold does not flicker between two tessellations.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct LodTable
+{
+	// Submeshes from finest (level 0) to coarsest.
+	std::vector<SubmeshGeometry> Levels;
+
+	// Fraction of the viewport height an object must cover to use each level.  Must be
+	// decreasing; the coarsest level should use 0 so something is always selected.
+	std::vector<float> MinScreenSize;
+
+	// Relative band around each threshold that has to be crossed before switching.
+	float Hysteresis = 0.15f;
+
+	void AddLevel(const SubmeshGeometry& submesh, float minScreenSize);
+	UINT LevelCount()const;
+};
+
+class LodSelector
+{
+public:
+	///<summary>
+	/// Fraction of the viewport height covered by a sphere at the given distance from the eye.
+	/// projScaleY is element (1,1) of the projection matrix, i.e. 1/tan(fovY/2).
+	///</summary>
+	static float ProjectedScreenSize(float radius, float distance, float projScaleY);
+
+	///<summary>
+	/// Projected size of a submesh drawn with the given world matrix.  Uses the bounding
+	/// sphere of the local space box, scaled by the largest axis scale of the world matrix.
+	///</summary>
+	static float ProjectedScreenSize(const DirectX::BoundingBox& localBounds,
+		const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& eyePosW, float projScaleY);
+
+	///<summary>
+	/// Returns the level to draw.  Starting from currentLevel, moves to a coarser level only
+	/// once the size drops below the threshold by the hysteresis band, and to a finer level
+	/// only once it rises above the finer threshold by the same band.
+	///</summary>
+	static UINT SelectLevel(const LodTable& table, UINT currentLevel, float screenSize);
+};
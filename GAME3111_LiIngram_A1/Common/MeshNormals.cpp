@@ -0,0 +1,226 @@
+//***************************************************************************************
+// MeshNormals.cpp
+//***************************************************************************************
+
+#include "MeshNormals.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace
+{
+	// Fewer triangles than this per range and the partial buffers cost more than they save.
+	const MeshNormals::uint32 MinTrianglesPerRange = 4096;
+	const MeshNormals::uint32 VertexGrainSize = 4096;
+
+	struct PartialSums
+	{
+		MeshNormals::uint32 First = 0;
+		std::vector<XMFLOAT3> Normals;
+		std::vector<XMFLOAT3> Tangents;
+	};
+
+	// Builds a unit tangent perpendicular to n, preferring the direction of t.
+	XMVECTOR OrthogonalTangent(FXMVECTOR n, FXMVECTOR t)
+	{
+		XMVECTOR ortho = XMVectorSubtract(t, XMVectorMultiply(n, XMVector3Dot(n, t)));
+		if(XMVectorGetX(XMVector3LengthSq(ortho)) > 1e-12f)
+			return XMVector3Normalize(ortho);
+
+		// No usable texture mapping; any direction in the tangent plane will do.
+		XMVECTOR axis = fabsf(XMVectorGetX(n)) < 0.9f ?
+			XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+		return XMVector3Normalize(XMVector3Cross(XMVector3Cross(n, axis), n));
+	}
+}
+
+void MeshNormals::ComputeNormalsAndTangents(GeometryGenerator::MeshData& meshData, ThreadPool& pool)
+{
+	auto& vertices = meshData.Vertices;
+	const auto& indices = meshData.Indices32;
+
+	uint32 vertexCount = (uint32)vertices.size();
+	uint32 triCount = (uint32)indices.size() / 3;
+	if(vertexCount == 0 || triCount == 0)
+		return;
+
+	uint32 rangeCount = std::min(pool.SlotCount(), std::max(1u, triCount / MinTrianglesPerRange));
+	std::vector<PartialSums> partials(rangeCount);
+
+	//
+	// Accumulate area weighted face normals and tangents into one partial per range.
+	//
+
+	pool.ParallelFor(rangeCount, 1, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 r = begin; r < end; ++r)
+		{
+			uint32 triBegin = (uint32)((uint64_t)triCount * r / rangeCount);
+			uint32 triEnd = (uint32)((uint64_t)triCount * (r + 1) / rangeCount);
+
+			uint32 first = ~0u;
+			uint32 last = 0;
+			for(uint32 i = triBegin * 3; i < triEnd * 3; ++i)
+			{
+				first = std::min(first, indices[i]);
+				last = std::max(last, indices[i]);
+			}
+
+			PartialSums& partial = partials[r];
+			if(first > last)
+				continue;
+
+			partial.First = first;
+			partial.Normals.assign(last - first + 1, XMFLOAT3(0.0f, 0.0f, 0.0f));
+			partial.Tangents.assign(last - first + 1, XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+			for(uint32 t = triBegin; t < triEnd; ++t)
+			{
+				uint32 i0 = indices[t*3+0];
+				uint32 i1 = indices[t*3+1];
+				uint32 i2 = indices[t*3+2];
+
+				const auto& v0 = vertices[i0];
+				const auto& v1 = vertices[i1];
+				const auto& v2 = vertices[i2];
+
+				XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+				XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&v1.Position), p0);
+				XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&v2.Position), p0);
+
+				// The cross product has length 2*area, which gives the area weighting for free.
+				XMVECTOR faceNormal = XMVector3Cross(e1, e2);
+
+				float du1 = v1.TexC.x - v0.TexC.x;
+				float dv1 = v1.TexC.y - v0.TexC.y;
+				float du2 = v2.TexC.x - v0.TexC.x;
+				float dv2 = v2.TexC.y - v0.TexC.y;
+				float det = du1*dv2 - du2*dv1;
+
+				XMVECTOR faceTangent = XMVectorZero();
+				if(fabsf(det) > 1e-12f)
+				{
+					float weight = XMVectorGetX(XMVector3Length(faceNormal)) / det;
+					faceTangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e1, dv2), XMVectorScale(e2, dv1)), weight);
+				}
+
+				uint32 corners[3] = { i0 - first, i1 - first, i2 - first };
+				for(uint32 c : corners)
+				{
+					XMStoreFloat3(&partial.Normals[c], XMVectorAdd(XMLoadFloat3(&partial.Normals[c]), faceNormal));
+					XMStoreFloat3(&partial.Tangents[c], XMVectorAdd(XMLoadFloat3(&partial.Tangents[c]), faceTangent));
+				}
+			}
+		}
+	});
+
+	//
+	// Sum the partials for each vertex and orthonormalize.
+	//
+
+	pool.ParallelFor(vertexCount, VertexGrainSize, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 v = begin; v < end; ++v)
+		{
+			XMVECTOR n = XMVectorZero();
+			XMVECTOR t = XMVectorZero();
+
+			for(const auto& partial : partials)
+			{
+				if(v < partial.First || v - partial.First >= (uint32)partial.Normals.size())
+					continue;
+
+				n = XMVectorAdd(n, XMLoadFloat3(&partial.Normals[v - partial.First]));
+				t = XMVectorAdd(t, XMLoadFloat3(&partial.Tangents[v - partial.First]));
+			}
+
+			// Vertices not referenced by any triangle keep whatever they had.
+			if(XMVectorGetX(XMVector3LengthSq(n)) <= 1e-20f)
+				continue;
+
+			n = XMVector3Normalize(n);
+			XMStoreFloat3(&vertices[v].Normal, n);
+			XMStoreFloat3(&vertices[v].TangentU, OrthogonalTangent(n, t));
+		}
+	});
+}
+
+void MeshNormals::ComputeGridNormalsAndTangents(GeometryGenerator::MeshData& meshData,
+	uint32 m, uint32 n, ThreadPool& pool)
+{
+	ComputeGridNormalsAndTangents(meshData, m, n, 0, m, 0, n, pool);
+}
+
+void MeshNormals::ComputeGridNormalsAndTangents(GeometryGenerator::MeshData& meshData,
+	uint32 m, uint32 n, uint32 rowBegin, uint32 rowEnd, uint32 colBegin, uint32 colEnd,
+	ThreadPool& pool)
+{
+	auto& vertices = meshData.Vertices;
+	assert(m >= 2 && n >= 2);
+	assert(vertices.size() == (size_t)m*n);
+	assert(rowBegin <= rowEnd && rowEnd <= m);
+	assert(colBegin <= colEnd && colEnd <= n);
+
+	if(rowBegin == rowEnd || colBegin == colEnd)
+		return;
+
+	// Split by rows; each row only writes its own vertices.
+	uint32 rowGrain = std::max(1u, VertexGrainSize / (colEnd - colBegin));
+
+	pool.ParallelFor(rowEnd - rowBegin, rowGrain, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 i = rowBegin + begin; i < rowBegin + end; ++i)
+		{
+			// Row i-1 is further along +z than row i (see CreateGrid).
+			uint32 up = i > 0 ? i - 1 : i;
+			uint32 down = i < m - 1 ? i + 1 : i;
+
+			for(uint32 j = colBegin; j < colEnd; ++j)
+			{
+				uint32 left = j > 0 ? j - 1 : j;
+				uint32 right = j < n - 1 ? j + 1 : j;
+
+				XMVECTOR dPdx = XMVectorSubtract(
+					XMLoadFloat3(&vertices[i*n + right].Position),
+					XMLoadFloat3(&vertices[i*n + left].Position));
+				XMVECTOR dPdz = XMVectorSubtract(
+					XMLoadFloat3(&vertices[up*n + j].Position),
+					XMLoadFloat3(&vertices[down*n + j].Position));
+
+				XMVECTOR normal = XMVector3Normalize(XMVector3Cross(dPdz, dPdx));
+
+				auto& v = vertices[i*n + j];
+				XMStoreFloat3(&v.Normal, normal);
+				XMStoreFloat3(&v.TangentU, OrthogonalTangent(normal, dPdx));
+			}
+		}
+	});
+}
+
+MeshNormals::BenchmarkResult MeshNormals::Benchmark(uint32 m, uint32 n, ThreadPool& pool)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, m, n);
+	for(auto& v : grid.Vertices)
+		v.Position.y = 0.3f * (v.Position.z * sinf(0.1f * v.Position.x) + v.Position.x * cosf(0.1f * v.Position.z));
+
+	BenchmarkResult result;
+	result.VertexCount = (uint32)grid.Vertices.size();
+	result.TriangleCount = (uint32)grid.Indices32.size() / 3;
+
+	auto time = [&grid](auto&& compute)
+	{
+		auto start = std::chrono::steady_clock::now();
+		compute(grid);
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	ThreadPool serial(0);
+	result.Milliseconds = time([&](GeometryGenerator::MeshData& mesh) { ComputeNormalsAndTangents(mesh, pool); });
+	result.SerialMilliseconds = time([&](GeometryGenerator::MeshData& mesh) { ComputeNormalsAndTangents(mesh, serial); });
+	result.GridMilliseconds = time([&](GeometryGenerator::MeshData& mesh) { ComputeGridNormalsAndTangents(mesh, m, n, pool); });
+	result.GridSerialMilliseconds = time([&](GeometryGenerator::MeshData& mesh) { ComputeGridNormalsAndTangents(mesh, m, n, serial); });
+	return result;
+}
@@ -0,0 +1,59 @@
+//***************************************************************************************
+// MeshNormals.h
+//
+// Regenerates per-vertex normals and tangents for a GeometryGenerator::MeshData after its
+// positions have been changed, e.g. a grid displaced by a height function.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "ThreadPool.h"
+
+class MeshNormals
+{
+public:
+	using uint32 = GeometryGenerator::uint32;
+
+	struct BenchmarkResult
+	{
+		uint32 VertexCount = 0;
+		uint32 TriangleCount = 0;
+		double Milliseconds = 0.0;             // ComputeNormalsAndTangents on the pool
+		double SerialMilliseconds = 0.0;       // ComputeNormalsAndTangents on one thread
+		double GridMilliseconds = 0.0;         // ComputeGridNormalsAndTangents on the pool
+		double GridSerialMilliseconds = 0.0;   // ComputeGridNormalsAndTangents on one thread
+	};
+
+	///<summary>
+	/// Computes smooth normals for an arbitrary triangle list by summing the face normals
+	/// around each vertex, weighted by face area.  Tangents are derived from the texture
+	/// coordinates and made orthogonal to the new normal.
+	///
+	/// Faces are split into one contiguous range per pool slot.  Each range accumulates into
+	/// its own partial buffer covering only the vertex indices it touches, and the partials
+	/// are summed per vertex afterwards, so no atomics are needed.
+	///</summary>
+	static void ComputeNormalsAndTangents(GeometryGenerator::MeshData& meshData,
+		ThreadPool& pool = ThreadPool::Get());
+
+	///<summary>
+	/// Fast path for meshes laid out by GeometryGenerator::CreateGrid with m rows and n
+	/// columns.  Normals and tangents come from central differences of the neighbouring
+	/// positions, which needs no index buffer and no accumulation pass.
+	///</summary>
+	static void ComputeGridNormalsAndTangents(GeometryGenerator::MeshData& meshData,
+		uint32 m, uint32 n, ThreadPool& pool = ThreadPool::Get());
+
+	// Same as above, but only rewrites the vertices in rows [rowBegin, rowEnd) and columns
+	// [colBegin, colEnd); used to patch a grid after a local height edit.
+	static void ComputeGridNormalsAndTangents(GeometryGenerator::MeshData& meshData,
+		uint32 m, uint32 n, uint32 rowBegin, uint32 rowEnd, uint32 colBegin, uint32 colEnd,
+		ThreadPool& pool = ThreadPool::Get());
+
+	///<summary>
+	/// Regenerates the normals of an m x n grid displaced by a height function with both
+	/// paths, on pool and on the calling thread alone.
+	///</summary>
+	static BenchmarkResult Benchmark(uint32 m, uint32 n, ThreadPool& pool = ThreadPool::Get());
+};
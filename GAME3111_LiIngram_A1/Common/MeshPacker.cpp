@@ -0,0 +1,141 @@
+//***************************************************************************************
+// MeshPacker.cpp
+//***************************************************************************************
+
+#include "MeshPacker.h"
+
+using namespace DirectX;
+
+MeshPacker::uint32 MeshPacker::Add(const std::string& name, const GeometryGenerator::MeshData& meshData)
+{
+	uint32 meshIndex = (uint32)mMeshes.size();
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)meshData.Indices32.size();
+	submesh.StartIndexLocation = mIndexOffsets.back();
+	submesh.BaseVertexLocation = (INT)mVertexOffsets.back();
+
+	mMeshes.push_back(&meshData);
+	mNames.push_back(name);
+	mSubmeshes.push_back(submesh);
+
+	mVertexOffsets.push_back(mVertexOffsets.back() + (uint32)meshData.Vertices.size());
+	mIndexOffsets.push_back(mIndexOffsets.back() + (uint32)meshData.Indices32.size());
+
+	mBoundsValid = false;
+
+	return meshIndex;
+}
+
+void MeshPacker::Reserve(size_t meshCount)
+{
+	mMeshes.reserve(meshCount);
+	mNames.reserve(meshCount);
+	mSubmeshes.reserve(meshCount);
+	mVertexOffsets.reserve(meshCount + 1);
+	mIndexOffsets.reserve(meshCount + 1);
+}
+
+MeshPacker::uint32 MeshPacker::MeshCount()const
+{
+	return (uint32)mMeshes.size();
+}
+
+MeshPacker::uint32 MeshPacker::TotalVertexCount()const
+{
+	return mVertexOffsets.back();
+}
+
+MeshPacker::uint32 MeshPacker::TotalIndexCount()const
+{
+	return mIndexOffsets.back();
+}
+
+const SubmeshGeometry& MeshPacker::GetSubmesh(uint32 meshIndex)const
+{
+	return mSubmeshes[meshIndex];
+}
+
+const std::string& MeshPacker::GetName(uint32 meshIndex)const
+{
+	return mNames[meshIndex];
+}
+
+std::vector<MeshPacker::uint16> MeshPacker::PackIndices16(ThreadPool& pool)const
+{
+#if defined(DEBUG) || defined(_DEBUG)
+	// 16-bit indices are local to each mesh, so only the per-mesh vertex count matters.
+	for(auto mesh : mMeshes)
+		assert(mesh->Vertices.size() <= 0x10000 && "Mesh too large for 16-bit indices.");
+#endif
+
+	return PackIndices<uint16>(pool);
+}
+
+std::vector<MeshPacker::uint32> MeshPacker::PackIndices32(ThreadPool& pool)const
+{
+	return PackIndices<uint32>(pool);
+}
+
+template<typename TIndex>
+std::vector<TIndex> MeshPacker::PackIndices(ThreadPool& pool)const
+{
+	std::vector<TIndex> indices(TotalIndexCount());
+
+	// Convert straight from Indices32 rather than through MeshData::GetIndices16,
+	// which would build (and keep) another copy of every index array.
+	pool.ParallelFor(TotalIndexCount(), PackGrainSize, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 mesh = FindMesh(mIndexOffsets, begin); begin < end; ++mesh)
+		{
+			uint32 meshStart = mIndexOffsets[mesh];
+			uint32 meshEnd = std::min(mIndexOffsets[mesh + 1], end);
+
+			const auto& src = mMeshes[mesh]->Indices32;
+			for(uint32 k = begin; k < meshEnd; ++k)
+				indices[k] = static_cast<TIndex>(src[k - meshStart]);
+
+			begin = meshEnd;
+		}
+	});
+
+	return indices;
+}
+
+void MeshPacker::ComputeBounds(ThreadPool& pool)
+{
+	if(mBoundsValid)
+		return;
+
+	pool.ParallelFor(MeshCount(), 16, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 i = begin; i < end; ++i)
+		{
+			const auto& vertices = mMeshes[i]->Vertices;
+			if(vertices.empty())
+				continue;
+
+			BoundingBox::CreateFromPoints(mSubmeshes[i].Bounds, vertices.size(),
+				&vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+		}
+	});
+
+	mBoundsValid = true;
+}
+
+void MeshPacker::FillDrawArgs(MeshGeometry& geo, ThreadPool& pool)
+{
+	ComputeBounds(pool);
+
+	geo.DrawArgs.reserve(geo.DrawArgs.size() + MeshCount());
+	for(uint32 i = 0; i < MeshCount(); ++i)
+		geo.DrawArgs[mNames[i]] = mSubmeshes[i];
+}
+
+MeshPacker::uint32 MeshPacker::FindMesh(const std::vector<uint32>& offsets, uint32 offset)const
+{
+	// Last mesh whose start is <= offset.  Empty meshes share their start with the next
+	// one, and upper_bound skips past them.
+	auto it = std::upper_bound(offsets.begin(), offsets.end() - 1, offset);
+	return (uint32)(it - offsets.begin()) - 1;
+}
@@ -0,0 +1,101 @@
+//***************************************************************************************
+// MeshPacker.h
+//
+// Concatenates many GeometryGenerator::MeshData into one shared vertex buffer and one
+// shared index buffer, and fills in the MeshGeometry::DrawArgs that describe where each
+// mesh ended up.
+//
+// Offsets are running totals updated by Add, so packing N meshes costs one allocation
+// per output array no matter how large N gets.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GeometryGenerator.h"
+#include "ThreadPool.h"
+
+class MeshPacker
+{
+public:
+	using uint16 = GeometryGenerator::uint16;
+	using uint32 = GeometryGenerator::uint32;
+
+	// Meshes are referenced, not copied, so they must outlive the packer.
+	uint32 Add(const std::string& name, const GeometryGenerator::MeshData& meshData);
+
+	void Reserve(size_t meshCount);
+
+	uint32 MeshCount()const;
+	uint32 TotalVertexCount()const;
+	uint32 TotalIndexCount()const;
+
+	// Offsets and index count of a mesh inside the packed buffers.  Bounds are only valid
+	// after FillDrawArgs or ComputeBounds.
+	const SubmeshGeometry& GetSubmesh(uint32 meshIndex)const;
+	const std::string& GetName(uint32 meshIndex)const;
+
+	///<summary>
+	/// Converts every vertex with convert(const GeometryGenerator::Vertex&, uint32 meshIndex)
+	/// and writes it to its packed position.  The work is split over the flat vertex range,
+	/// so one huge mesh parallelizes as well as thousands of small ones.
+	///</summary>
+	template<typename TVertex, typename ConvertFunc>
+	std::vector<TVertex> PackVertices(ConvertFunc convert, ThreadPool& pool = ThreadPool::Get())const;
+
+	///<summary>
+	/// Packs the indices.  They stay local to each mesh because the submeshes use
+	/// BaseVertexLocation, which is what lets 16-bit indices address the whole buffer.
+	///</summary>
+	std::vector<uint16> PackIndices16(ThreadPool& pool = ThreadPool::Get())const;
+	std::vector<uint32> PackIndices32(ThreadPool& pool = ThreadPool::Get())const;
+
+	// Computes the local space bounding box of every mesh.
+	void ComputeBounds(ThreadPool& pool = ThreadPool::Get());
+
+	// Computes the bounds if needed and writes one DrawArgs entry per mesh.
+	void FillDrawArgs(MeshGeometry& geo, ThreadPool& pool = ThreadPool::Get());
+
+private:
+	// Index of the mesh containing the packed element at 'offset'.
+	uint32 FindMesh(const std::vector<uint32>& offsets, uint32 offset)const;
+
+	template<typename TIndex>
+	std::vector<TIndex> PackIndices(ThreadPool& pool)const;
+
+private:
+	static const uint32 PackGrainSize = 16384;
+
+	std::vector<const GeometryGenerator::MeshData*> mMeshes;
+	std::vector<std::string> mNames;
+	std::vector<SubmeshGeometry> mSubmeshes;
+
+	// Running starts of each mesh; one extra entry holds the totals.
+	std::vector<uint32> mVertexOffsets = { 0 };
+	std::vector<uint32> mIndexOffsets = { 0 };
+
+	bool mBoundsValid = false;
+};
+
+template<typename TVertex, typename ConvertFunc>
+std::vector<TVertex> MeshPacker::PackVertices(ConvertFunc convert, ThreadPool& pool)const
+{
+	std::vector<TVertex> vertices(TotalVertexCount());
+
+	pool.ParallelFor(TotalVertexCount(), PackGrainSize, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 mesh = FindMesh(mVertexOffsets, begin); begin < end; ++mesh)
+		{
+			uint32 meshStart = mVertexOffsets[mesh];
+			uint32 meshEnd = std::min(mVertexOffsets[mesh + 1], end);
+
+			const auto& src = mMeshes[mesh]->Vertices;
+			for(uint32 k = begin; k < meshEnd; ++k)
+				vertices[k] = convert(src[k - meshStart], mesh);
+
+			begin = meshEnd;
+		}
+	});
+
+	return vertices;
+}
@@ -0,0 +1,712 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = MeshSimplifier::uint32;
+
+	const uint32 InvalidIndex = ~0u;
+	const double InfiniteCost = DBL_MAX;
+
+	// Symmetric 4x4 error quadric, stored as its upper triangle.
+	struct Quadric
+	{
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+		double b2 = 0.0, bc = 0.0, bd = 0.0;
+		double c2 = 0.0, cd = 0.0;
+		double d2 = 0.0;
+
+		// Squared distance to the plane ax + by + cz + d = 0, scaled by w.
+		static Quadric FromPlane(double a, double b, double c, double d, double w)
+		{
+			Quadric q;
+			q.a2 = w*a*a; q.ab = w*a*b; q.ac = w*a*c; q.ad = w*a*d;
+			q.b2 = w*b*b; q.bc = w*b*c; q.bd = w*b*d;
+			q.c2 = w*c*c; q.cd = w*c*d;
+			q.d2 = w*d*d;
+			return q;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		double Evaluate(const XMFLOAT3& p)const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			return a2*x*x + 2.0*ab*x*y + 2.0*ac*x*z + 2.0*ad*x
+				+ b2*y*y + 2.0*bc*y*z + 2.0*bd*y
+				+ c2*z*z + 2.0*cd*z
+				+ d2;
+		}
+	};
+
+	bool SameAttributes(const GeometryGenerator::Vertex& a, const GeometryGenerator::Vertex& b)
+	{
+		return a.Normal.x == b.Normal.x && a.Normal.y == b.Normal.y && a.Normal.z == b.Normal.z &&
+			a.TangentU.x == b.TangentU.x && a.TangentU.y == b.TangentU.y && a.TangentU.z == b.TangentU.z &&
+			a.TexC.x == b.TexC.x && a.TexC.y == b.TexC.y;
+	}
+
+	struct Candidate
+	{
+		double Cost;
+		uint32 From;
+		uint32 To;
+		uint32 FromVersion;
+		uint32 ToVersion;
+
+		bool operator>(const Candidate& rhs)const { return Cost > rhs.Cost; }
+	};
+
+	// The simplifier works on two levels.  Wedges are the vertices of the source mesh;
+	// positions are groups of wedges closer than the weld distance.  Topology, quadrics
+	// and collapses are per position, while triangles keep referring to wedges so that
+	// each side of a seam keeps its own attributes.
+	class Collapser
+	{
+	public:
+		Collapser(const MeshSimplifier::MeshData& meshData, const MeshSimplifier::Settings& settings);
+
+		uint32 LiveTriangles()const { return mLiveTriangles; }
+		uint32 Collapses()const { return mCollapses; }
+		double MaxCost()const { return mMaxCost; }
+
+		void Run(uint32 targetTriangles, double maxCost);
+		MeshSimplifier::MeshData Extract()const;
+
+	private:
+		void WeldPositions();
+		void BuildTopology();
+		void AddPlaneQuadrics();
+		void PushEdges(uint32 p);
+
+		bool IsLive(uint32 tri)const { return mTriangleAlive[tri] != 0; }
+		uint32 PositionOf(uint32 tri, uint32 corner)const { return mWedgePosition[mTriangles[tri*3 + corner]]; }
+		bool ContainsPosition(uint32 tri, uint32 p)const;
+
+		void GatherNeighbours(uint32 p, std::vector<uint32>& out)const;
+		bool FindPartners(uint32 from, uint32 to, std::vector<std::pair<uint32, uint32>>& partners)const;
+		bool IsBorderEdge(uint32 a, uint32 b)const;
+		bool LinkConditionHolds(uint32 from, uint32 to);
+		bool CollapseFlipsTriangle(uint32 from, uint32 to)const;
+
+		double EvaluateCollapse(uint32 from, uint32 to);
+		void Collapse(uint32 from, uint32 to);
+
+	private:
+		const MeshSimplifier::MeshData& mMesh;
+		const MeshSimplifier::Settings& mSettings;
+
+		std::vector<uint32> mWedgePosition;
+		std::vector<uint32> mCanonicalWedge;
+		std::vector<XMFLOAT3> mPositions;
+		std::vector<std::vector<uint32>> mPositionWedges;
+		std::vector<std::vector<uint32>> mPositionTriangles;
+		std::vector<Quadric> mQuadrics;
+		std::vector<uint32> mVersion;
+		std::vector<uint8_t> mPositionAlive;
+		std::vector<uint8_t> mBorder;
+
+		std::vector<uint32> mTriangles;
+		std::vector<uint8_t> mTriangleAlive;
+		uint32 mLiveTriangles = 0;
+
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> mHeap;
+
+		uint32 mCollapses = 0;
+		double mMaxCost = 0.0;
+
+		// Scratch buffers reused across collapses.
+		std::vector<uint32> mScratchA;
+		std::vector<uint32> mScratchB;
+		std::vector<std::pair<uint32, uint32>> mScratchPartners;
+	};
+
+	Collapser::Collapser(const MeshSimplifier::MeshData& meshData, const MeshSimplifier::Settings& settings) :
+		mMesh(meshData),
+		mSettings(settings)
+	{
+		WeldPositions();
+		BuildTopology();
+		AddPlaneQuadrics();
+
+		for(uint32 p = 0; p < (uint32)mPositions.size(); ++p)
+			PushEdges(p);
+	}
+
+	void Collapser::WeldPositions()
+	{
+		const auto& vertices = mMesh.Vertices;
+		const uint32 wedgeCount = (uint32)vertices.size();
+		const float weld = mSettings.WeldDistance;
+
+		// Sort by x and only compare wedges inside a weld-distance window.
+		std::vector<uint32> order(wedgeCount);
+		for(uint32 i = 0; i < wedgeCount; ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b)
+		{
+			return vertices[a].Position.x < vertices[b].Position.x;
+		});
+
+		mWedgePosition.assign(wedgeCount, InvalidIndex);
+		for(uint32 i = 0; i < wedgeCount; ++i)
+		{
+			uint32 a = order[i];
+			if(mWedgePosition[a] != InvalidIndex)
+				continue;
+
+			uint32 p = (uint32)mPositions.size();
+			mPositions.push_back(vertices[a].Position);
+			mPositionWedges.emplace_back(1, a);
+			mWedgePosition[a] = p;
+
+			XMVECTOR pa = XMLoadFloat3(&vertices[a].Position);
+			for(uint32 j = i + 1; j < wedgeCount; ++j)
+			{
+				uint32 b = order[j];
+				if(vertices[b].Position.x - vertices[a].Position.x > weld)
+					break;
+
+				if(mWedgePosition[b] == InvalidIndex &&
+					XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&vertices[b].Position), pa))) <= weld*weld)
+				{
+					mWedgePosition[b] = p;
+					mPositionWedges[p].push_back(b);
+				}
+			}
+		}
+
+		// Some generators (e.g. CreateGeosphere) repeat identical vertices per triangle.
+		// Wedges with the same attributes at a position are merged so the output shares them.
+		mCanonicalWedge.resize(wedgeCount);
+		for(auto& wedges : mPositionWedges)
+		{
+			size_t kept = 0;
+			for(size_t i = 0; i < wedges.size(); ++i)
+			{
+				uint32 w = wedges[i];
+				mCanonicalWedge[w] = w;
+				for(size_t j = 0; j < kept; ++j)
+				{
+					if(SameAttributes(vertices[w], vertices[wedges[j]]))
+					{
+						mCanonicalWedge[w] = wedges[j];
+						break;
+					}
+				}
+				if(mCanonicalWedge[w] == w)
+					wedges[kept++] = w;
+			}
+			wedges.resize(kept);
+		}
+
+		const uint32 positionCount = (uint32)mPositions.size();
+		mPositionTriangles.resize(positionCount);
+		mQuadrics.resize(positionCount);
+		mVersion.assign(positionCount, 0);
+		mPositionAlive.assign(positionCount, 1);
+		mBorder.assign(positionCount, 0);
+	}
+
+	void Collapser::BuildTopology()
+	{
+		const auto& indices = mMesh.Indices32;
+		const uint32 triCount = (uint32)indices.size() / 3;
+
+		mTriangles.reserve(triCount * 3);
+		for(uint32 t = 0; t < triCount; ++t)
+		{
+			uint32 w0 = mCanonicalWedge[indices[t*3 + 0]];
+			uint32 w1 = mCanonicalWedge[indices[t*3 + 1]];
+			uint32 w2 = mCanonicalWedge[indices[t*3 + 2]];
+
+			uint32 p0 = mWedgePosition[w0];
+			uint32 p1 = mWedgePosition[w1];
+			uint32 p2 = mWedgePosition[w2];
+
+			// Triangles degenerate after welding cover no area; drop them up front.
+			if(p0 == p1 || p1 == p2 || p2 == p0)
+				continue;
+
+			uint32 tri = (uint32)mTriangles.size() / 3;
+			mTriangles.push_back(w0);
+			mTriangles.push_back(w1);
+			mTriangles.push_back(w2);
+			mPositionTriangles[p0].push_back(tri);
+			mPositionTriangles[p1].push_back(tri);
+			mPositionTriangles[p2].push_back(tri);
+		}
+
+		mLiveTriangles = (uint32)mTriangles.size() / 3;
+		mTriangleAlive.assign(mLiveTriangles, 1);
+	}
+
+	void Collapser::AddPlaneQuadrics()
+	{
+		// Each position edge remembers the first triangle using it.  A second triangle
+		// with the same wedges closes the edge; different wedges mean an attribute seam.
+		struct EdgeUse
+		{
+			uint32 Triangle;
+			uint32 WedgeA;
+			uint32 WedgeB;
+			uint32 Count;
+			bool Seam;
+		};
+		std::unordered_map<uint64_t, EdgeUse> edges;
+		edges.reserve(mTriangles.size());
+
+		const uint32 triCount = (uint32)mTriangles.size() / 3;
+		std::vector<XMFLOAT3> faceNormals(triCount);
+
+		for(uint32 t = 0; t < triCount; ++t)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&mPositions[PositionOf(t, 0)]);
+			XMVECTOR v1 = XMLoadFloat3(&mPositions[PositionOf(t, 1)]);
+			XMVECTOR v2 = XMLoadFloat3(&mPositions[PositionOf(t, 2)]);
+
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(v1, v0), XMVectorSubtract(v2, v0));
+			if(XMVectorGetX(XMVector3LengthSq(n)) > 1e-20f)
+			{
+				n = XMVector3Normalize(n);
+				float d = -XMVectorGetX(XMVector3Dot(n, v0));
+				Quadric q = Quadric::FromPlane(XMVectorGetX(n), XMVectorGetY(n), XMVectorGetZ(n), d, 1.0);
+				for(uint32 k = 0; k < 3; ++k)
+					mQuadrics[PositionOf(t, k)].Add(q);
+			}
+			XMStoreFloat3(&faceNormals[t], n);
+
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 wa = mTriangles[t*3 + k];
+				uint32 wb = mTriangles[t*3 + (k + 1) % 3];
+				uint32 pa = mWedgePosition[wa];
+				uint32 pb = mWedgePosition[wb];
+				if(pa > pb)
+				{
+					std::swap(pa, pb);
+					std::swap(wa, wb);
+				}
+
+				uint64_t key = ((uint64_t)pa << 32) | pb;
+				auto it = edges.find(key);
+				if(it == edges.end())
+					edges.emplace(key, EdgeUse{ t, wa, wb, 1, false });
+				else
+				{
+					it->second.Count++;
+					if(it->second.WedgeA != wa || it->second.WedgeB != wb)
+						it->second.Seam = true;
+				}
+			}
+		}
+
+		// Open edges and seams get a plane through the edge, perpendicular to the face, so
+		// moving a vertex off the edge is expensive.
+		for(const auto& e : edges)
+		{
+			if(e.second.Count != 1 && !e.second.Seam)
+				continue;
+
+			uint32 pa = (uint32)(e.first >> 32);
+			uint32 pb = (uint32)(e.first & 0xffffffff);
+
+			XMVECTOR a = XMLoadFloat3(&mPositions[pa]);
+			XMVECTOR edgeDir = XMVectorSubtract(XMLoadFloat3(&mPositions[pb]), a);
+			XMVECTOR n = XMVector3Cross(edgeDir, XMLoadFloat3(&faceNormals[e.second.Triangle]));
+			if(XMVectorGetX(XMVector3LengthSq(n)) > 1e-20f)
+			{
+				n = XMVector3Normalize(n);
+				float d = -XMVectorGetX(XMVector3Dot(n, a));
+				Quadric q = Quadric::FromPlane(XMVectorGetX(n), XMVectorGetY(n), XMVectorGetZ(n), d,
+					mSettings.BoundaryWeight);
+				mQuadrics[pa].Add(q);
+				mQuadrics[pb].Add(q);
+			}
+
+			mBorder[pa] = 1;
+			mBorder[pb] = 1;
+		}
+	}
+
+	bool Collapser::ContainsPosition(uint32 tri, uint32 p)const
+	{
+		return PositionOf(tri, 0) == p || PositionOf(tri, 1) == p || PositionOf(tri, 2) == p;
+	}
+
+	void Collapser::GatherNeighbours(uint32 p, std::vector<uint32>& out)const
+	{
+		out.clear();
+		for(uint32 tri : mPositionTriangles[p])
+		{
+			if(!IsLive(tri))
+				continue;
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 q = PositionOf(tri, k);
+				if(q != p)
+					out.push_back(q);
+			}
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+
+	void Collapser::PushEdges(uint32 p)
+	{
+		GatherNeighbours(p, mScratchA);
+
+		// Copy: evaluating a collapse reuses the scratch buffers.
+		std::vector<uint32> neighbours = mScratchA;
+		for(uint32 q : neighbours)
+		{
+			// Every edge is seen from both ends during the initial pass; only push it once.
+			// After a collapse the edges around the surviving position are all new.
+			if(mCollapses == 0 && q < p)
+				continue;
+
+			double costPQ = EvaluateCollapse(p, q);
+			double costQP = EvaluateCollapse(q, p);
+			if(costPQ == InfiniteCost && costQP == InfiniteCost)
+				continue;
+
+			if(costPQ <= costQP)
+				mHeap.push({ costPQ, p, q, mVersion[p], mVersion[q] });
+			else
+				mHeap.push({ costQP, q, p, mVersion[q], mVersion[p] });
+		}
+	}
+
+	bool Collapser::FindPartners(uint32 from, uint32 to, std::vector<std::pair<uint32, uint32>>& partners)const
+	{
+		// Every wedge still in use at 'from' must share a triangle with a wedge at 'to'.
+		// That wedge takes its place, which keeps both sides of a seam stitched together.
+		partners.clear();
+		for(uint32 wedge : mPositionWedges[from])
+		{
+			bool used = false;
+			uint32 partner = InvalidIndex;
+			for(uint32 tri : mPositionTriangles[from])
+			{
+				if(!IsLive(tri))
+					continue;
+
+				const uint32* w = &mTriangles[tri*3];
+				if(w[0] != wedge && w[1] != wedge && w[2] != wedge)
+					continue;
+
+				used = true;
+				for(uint32 k = 0; k < 3; ++k)
+				{
+					if(mWedgePosition[w[k]] == to)
+					{
+						partner = w[k];
+						break;
+					}
+				}
+				if(partner != InvalidIndex)
+					break;
+			}
+
+			if(!used)
+				continue;
+			if(partner == InvalidIndex)
+				return false;
+
+			partners.emplace_back(wedge, partner);
+		}
+
+		return !partners.empty();
+	}
+
+	bool Collapser::IsBorderEdge(uint32 a, uint32 b)const
+	{
+		uint32 shared = 0;
+		uint32 wedgeA = InvalidIndex;
+		for(uint32 tri : mPositionTriangles[a])
+		{
+			if(!IsLive(tri) || !ContainsPosition(tri, b))
+				continue;
+
+			// Triangles on the two sides of a seam use different wedges at 'a'.
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				if(PositionOf(tri, k) != a)
+					continue;
+
+				uint32 w = mTriangles[tri*3 + k];
+				if(wedgeA != InvalidIndex && wedgeA != w)
+					return true;
+				wedgeA = w;
+			}
+			++shared;
+		}
+		return shared == 1;
+	}
+
+	bool Collapser::LinkConditionHolds(uint32 from, uint32 to)
+	{
+		// The positions adjacent to both ends must be exactly the opposite corners of the
+		// triangles on the edge, otherwise the collapse would pinch the surface.
+		GatherNeighbours(from, mScratchA);
+		GatherNeighbours(to, mScratchB);
+
+		uint32 common = 0;
+		for(size_t i = 0, j = 0; i < mScratchA.size() && j < mScratchB.size(); )
+		{
+			if(mScratchA[i] < mScratchB[j]) ++i;
+			else if(mScratchB[j] < mScratchA[i]) ++j;
+			else { ++common; ++i; ++j; }
+		}
+
+		uint32 edgeTriangles = 0;
+		for(uint32 tri : mPositionTriangles[from])
+		{
+			if(IsLive(tri) && ContainsPosition(tri, to))
+				++edgeTriangles;
+		}
+
+		return common == edgeTriangles;
+	}
+
+	bool Collapser::CollapseFlipsTriangle(uint32 from, uint32 to)const
+	{
+		XMVECTOR target = XMLoadFloat3(&mPositions[to]);
+
+		for(uint32 tri : mPositionTriangles[from])
+		{
+			if(!IsLive(tri) || ContainsPosition(tri, to))
+				continue;
+
+			XMVECTOR v[3];
+			uint32 moved = 0;
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 p = PositionOf(tri, k);
+				v[k] = XMLoadFloat3(&mPositions[p]);
+				if(p == from)
+					moved = k;
+			}
+
+			XMVECTOR before = XMVector3Cross(XMVectorSubtract(v[1], v[0]), XMVectorSubtract(v[2], v[0]));
+			v[moved] = target;
+			XMVECTOR after = XMVector3Cross(XMVectorSubtract(v[1], v[0]), XMVectorSubtract(v[2], v[0]));
+
+			// Reject both flipped and collapsed-to-a-sliver results.
+			float dot = XMVectorGetX(XMVector3Dot(before, after));
+			float lengths = sqrtf(XMVectorGetX(XMVector3LengthSq(before)) * XMVectorGetX(XMVector3LengthSq(after)));
+			if(dot <= 0.05f * lengths)
+				return true;
+		}
+
+		return false;
+	}
+
+	double Collapser::EvaluateCollapse(uint32 from, uint32 to)
+	{
+		// A border vertex may only move along its border.
+		if(mBorder[from] && !IsBorderEdge(from, to))
+			return InfiniteCost;
+
+		if(!FindPartners(from, to, mScratchPartners))
+			return InfiniteCost;
+
+		Quadric q = mQuadrics[from];
+		q.Add(mQuadrics[to]);
+		double cost = std::max(0.0, q.Evaluate(mPositions[to]));
+
+		const auto& vertices = mMesh.Vertices;
+		for(const auto& wp : mScratchPartners)
+		{
+			const auto& a = vertices[wp.first];
+			const auto& b = vertices[wp.second];
+
+			XMVECTOR dn = XMVectorSubtract(XMLoadFloat3(&a.Normal), XMLoadFloat3(&b.Normal));
+			XMVECTOR duv = XMVectorSubtract(XMLoadFloat2(&a.TexC), XMLoadFloat2(&b.TexC));
+			cost += mSettings.NormalWeight * XMVectorGetX(XMVector3LengthSq(dn))
+				+ mSettings.TexCWeight * XMVectorGetX(XMVector2LengthSq(duv));
+		}
+
+		return cost;
+	}
+
+	void Collapser::Collapse(uint32 from, uint32 to)
+	{
+		FindPartners(from, to, mScratchPartners);
+
+		auto& toTriangles = mPositionTriangles[to];
+		for(uint32 tri : mPositionTriangles[from])
+		{
+			if(!IsLive(tri))
+				continue;
+
+			// Triangles on the collapsed edge vanish.
+			if(ContainsPosition(tri, to))
+			{
+				mTriangleAlive[tri] = 0;
+				--mLiveTriangles;
+				continue;
+			}
+
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32& w = mTriangles[tri*3 + k];
+				for(const auto& wp : mScratchPartners)
+				{
+					if(w == wp.first)
+					{
+						w = wp.second;
+						break;
+					}
+				}
+			}
+			toTriangles.push_back(tri);
+		}
+
+		toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(),
+			[&](uint32 tri) { return !IsLive(tri); }), toTriangles.end());
+
+		mPositionTriangles[from].clear();
+		mPositionTriangles[from].shrink_to_fit();
+		mPositionAlive[from] = 0;
+
+		mQuadrics[to].Add(mQuadrics[from]);
+		++mVersion[to];
+		++mCollapses;
+	}
+
+	void Collapser::Run(uint32 targetTriangles, double maxCost)
+	{
+		while(mLiveTriangles > targetTriangles && !mHeap.empty())
+		{
+			Candidate c = mHeap.top();
+			mHeap.pop();
+
+			// Lazy invalidation: entries for positions that have since changed are stale.
+			if(!mPositionAlive[c.From] || !mPositionAlive[c.To] ||
+				mVersion[c.From] != c.FromVersion || mVersion[c.To] != c.ToVersion)
+				continue;
+
+			// Every entry that survives the checks above is up to date, so nothing cheaper is left.
+			if(c.Cost > maxCost)
+				break;
+
+			if(!LinkConditionHolds(c.From, c.To) || CollapseFlipsTriangle(c.From, c.To))
+				continue;
+
+			Collapse(c.From, c.To);
+			mMaxCost = std::max(mMaxCost, c.Cost);
+
+			PushEdges(c.To);
+		}
+	}
+
+	MeshSimplifier::MeshData Collapser::Extract()const
+	{
+		MeshSimplifier::MeshData result;
+		result.Indices32.reserve(mLiveTriangles * 3);
+
+		std::vector<uint32> remap(mMesh.Vertices.size(), InvalidIndex);
+		for(uint32 tri = 0; tri < (uint32)mTriangleAlive.size(); ++tri)
+		{
+			if(!IsLive(tri))
+				continue;
+
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 w = mTriangles[tri*3 + k];
+				if(remap[w] == InvalidIndex)
+				{
+					remap[w] = (uint32)result.Vertices.size();
+					result.Vertices.push_back(mMesh.Vertices[w]);
+				}
+				result.Indices32.push_back(remap[w]);
+			}
+		}
+
+		return result;
+	}
+}
+
+double MeshSimplifier::Stats::TrianglesPerSecond()const
+{
+	return Milliseconds > 0.0 ? SourceTriangles * 1000.0 / Milliseconds : 0.0;
+}
+
+MeshSimplifier::MeshData MeshSimplifier::Simplify(const MeshData& meshData, const Settings& settings, Stats* stats)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const uint32 sourceTriangles = (uint32)meshData.Indices32.size() / 3;
+	uint32 target = settings.TargetTriangleCount;
+	if(target == 0)
+		target = (uint32)(sourceTriangles * settings.TargetTriangleRatio);
+
+	// Errors are compared as squared distances, which is what the quadrics measure.
+	double maxCost = settings.MaxError < FLT_MAX ? (double)settings.MaxError * settings.MaxError : InfiniteCost;
+
+	Collapser collapser(meshData, settings);
+	collapser.Run(target, maxCost);
+	MeshData result = collapser.Extract();
+
+	if(stats)
+	{
+		stats->SourceTriangles = sourceTriangles;
+		stats->ResultTriangles = (uint32)result.Indices32.size() / 3;
+		stats->SourceVertices = (uint32)meshData.Vertices.size();
+		stats->ResultVertices = (uint32)result.Vertices.size();
+		stats->Collapses = collapser.Collapses();
+		stats->MaxError = (float)sqrt(collapser.MaxCost());
+		stats->Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	return result;
+}
+
+MeshSimplifier::LodChain MeshSimplifier::BuildLodChain(const MeshData& meshData, const std::vector<Settings>& levels)
+{
+	LodChain chain;
+	chain.Levels.reserve(levels.size() + 1);
+	chain.LevelStats.resize(levels.size());
+
+	chain.Levels.push_back(meshData);
+	for(size_t i = 0; i < levels.size(); ++i)
+	{
+		MeshData next = Simplify(chain.Levels.back(), levels[i], &chain.LevelStats[i]);
+		chain.Levels.push_back(std::move(next));
+	}
+
+	return chain;
+}
+
+std::vector<MeshSimplifier::LodChain> MeshSimplifier::BuildLodChains(const std::vector<const MeshData*>& meshes,
+	const std::vector<Settings>& levels, ThreadPool& pool)
+{
+	std::vector<LodChain> chains(meshes.size());
+
+	// Meshes are independent and vary a lot in size, so hand them out one at a time.
+	pool.ParallelFor((uint32)meshes.size(), 1, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 i = begin; i < end; ++i)
+			chains[i] = BuildLodChain(*meshes[i], levels);
+	});
+
+	return chains;
+}
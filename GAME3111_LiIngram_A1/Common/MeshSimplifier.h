@@ -0,0 +1,95 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Quadric error metric simplification (Garland & Heckbert) of GeometryGenerator::MeshData,
+// for building LOD chains of meshes whose tessellation cannot simply be lowered, such as a
+// displaced land grid.
+//
+// Edges are collapsed onto one of their endpoints, so surviving vertices keep their
+// original normals, tangents and texture coordinates and no new vertices are made up.
+// Vertices that share a position but not their attributes (the seams GeometryGenerator
+// leaves on spheres, cylinders and boxes) are collapsed together, so seams never crack.
+// Open edges and attribute seams add constraint planes to the quadrics, and a vertex on
+// one may only slide along it.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "ThreadPool.h"
+#include <cfloat>
+
+class MeshSimplifier
+{
+public:
+	using uint32 = GeometryGenerator::uint32;
+	using MeshData = GeometryGenerator::MeshData;
+
+	struct Settings
+	{
+		// Stop once the mesh has this many triangles or fewer.  When zero,
+		// TargetTriangleRatio of the source triangle count is used instead.
+		uint32 TargetTriangleCount = 0;
+		float TargetTriangleRatio = 0.5f;
+
+		// Stop before any collapse whose error is larger than this.  Errors are in mesh
+		// units: roughly the distance the surface moves.
+		float MaxError = FLT_MAX;
+
+		// Weight of the planes that hold open edges and attribute seams in place.
+		float BoundaryWeight = 100.0f;
+
+		// Cost added per unit squared difference in normal / texture coordinate between
+		// the two ends of a collapsed edge.
+		float NormalWeight = 0.5f;
+		float TexCWeight = 0.5f;
+
+		// Vertices closer than this are treated as the same position.
+		float WeldDistance = 1e-5f;
+	};
+
+	struct Stats
+	{
+		uint32 SourceTriangles = 0;
+		uint32 ResultTriangles = 0;
+		uint32 SourceVertices = 0;
+		uint32 ResultVertices = 0;
+		uint32 Collapses = 0;
+
+		// Largest error of any collapse performed, in the units of Settings::MaxError.
+		float MaxError = 0.0f;
+
+		double Milliseconds = 0.0;
+
+		// Source triangles processed per second.
+		double TrianglesPerSecond()const;
+	};
+
+	struct LodChain
+	{
+		// Levels[0] is a copy of the source mesh; each later level is simplified from
+		// the one before it.
+		std::vector<MeshData> Levels;
+
+		// LevelStats[i] describes building Levels[i + 1].
+		std::vector<Stats> LevelStats;
+	};
+
+	///<summary>
+	/// Simplifies a triangle list.  Fills stats, if given, with the triangle counts, the
+	/// largest error introduced and the time taken.
+	///</summary>
+	static MeshData Simplify(const MeshData& meshData, const Settings& settings, Stats* stats = nullptr);
+
+	///<summary>
+	/// Builds one level per entry of levels.  Targets given as ratios are relative to the
+	/// previous level, so {0.5, 0.5} gives half and then a quarter of the source triangles.
+	///</summary>
+	static LodChain BuildLodChain(const MeshData& meshData, const std::vector<Settings>& levels);
+
+	///<summary>
+	/// Builds the chains of several independent meshes at once, one mesh per task.
+	///</summary>
+	static std::vector<LodChain> BuildLodChains(const std::vector<const MeshData*>& meshes,
+		const std::vector<Settings>& levels, ThreadPool& pool = ThreadPool::Get());
+};
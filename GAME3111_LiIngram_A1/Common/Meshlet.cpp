@@ -0,0 +1,362 @@
+//***************************************************************************************
+// Meshlet.cpp
+//***************************************************************************************
+
+#include "Meshlet.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = MeshletBuilder::uint32;
+
+	const uint32 InvalidIndex = ~0u;
+
+	// Bit pattern of a position; only exactly equal positions are joined.
+	using PositionKey = std::array<uint32, 3>;
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& k)const
+		{
+			return (size_t)k[0] * 73856093u ^ (size_t)k[1] * 19349663u ^ (size_t)k[2] * 83492791u;
+		}
+	};
+
+	PositionKey MakePositionKey(const XMFLOAT3& p)
+	{
+		PositionKey key;
+		std::memcpy(key.data(), &p, sizeof(XMFLOAT3));
+		return key;
+	}
+
+	// Rotates a triangle so its smallest index comes first, keeping the winding.
+	std::array<uint32, 3> CanonicalTriangle(uint32 a, uint32 b, uint32 c)
+	{
+		if(b < a && b <= c)
+			return { b, c, a };
+		if(c < a && c < b)
+			return { c, a, b };
+		return { a, b, c };
+	}
+
+	void ComputeBounds(const GeometryGenerator::MeshData& meshData, const MeshletData& data,
+		const Meshlet& meshlet, MeshletBounds& bounds)
+	{
+		const auto& vertices = meshData.Vertices;
+
+		// One byte local indices cap a meshlet at 256 vertices.
+		XMFLOAT3 positions[256];
+		for(uint32 i = 0; i < meshlet.VertexCount; ++i)
+			positions[i] = vertices[data.VertexIndices[meshlet.VertexOffset + i]].Position;
+
+		BoundingSphere::CreateFromPoints(bounds.Sphere, meshlet.VertexCount, positions, sizeof(XMFLOAT3));
+
+		// The cone axis is the average face normal; its spread is the widest angle between
+		// the axis and any face.
+		const uint8_t* prims = &data.PrimitiveIndices[meshlet.TriangleOffset * 3];
+		XMVECTOR normalSum = XMVectorZero();
+		for(uint32 t = 0; t < meshlet.TriangleCount; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&positions[prims[t*3 + 0]]);
+			XMVECTOR p1 = XMLoadFloat3(&positions[prims[t*3 + 1]]);
+			XMVECTOR p2 = XMLoadFloat3(&positions[prims[t*3 + 2]]);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			if(XMVectorGetX(XMVector3LengthSq(n)) > 1e-20f)
+				normalSum = XMVectorAdd(normalSum, XMVector3Normalize(n));
+		}
+
+		bounds.ConeCutoff = 2.0f;
+		if(XMVectorGetX(XMVector3LengthSq(normalSum)) < 1e-12f)
+			return;
+
+		XMVECTOR axis = XMVector3Normalize(normalSum);
+		XMVECTOR center = XMLoadFloat3(&bounds.Sphere.Center);
+
+		float minDot = 1.0f;
+		float maxT = 0.0f;
+		for(uint32 t = 0; t < meshlet.TriangleCount; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&positions[prims[t*3 + 0]]);
+			XMVECTOR p1 = XMLoadFloat3(&positions[prims[t*3 + 1]]);
+			XMVECTOR p2 = XMLoadFloat3(&positions[prims[t*3 + 2]]);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			if(XMVectorGetX(XMVector3LengthSq(n)) <= 1e-20f)
+				continue;
+			n = XMVector3Normalize(n);
+
+			float d = XMVectorGetX(XMVector3Dot(axis, n));
+			minDot = std::min(minDot, d);
+			if(d <= 0.0f)
+				break;
+
+			// Distance back along the axis from the sphere centre to this face's plane.  The
+			// apex goes behind every face so the cone test stays conservative.
+			float t0 = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, p0), n)) / d;
+			maxT = std::max(maxT, t0);
+		}
+
+		// Faces spread over a hemisphere or more: some face is visible from anywhere.
+		if(minDot <= 0.0f)
+			return;
+
+		XMStoreFloat3(&bounds.ConeAxis, axis);
+		XMStoreFloat3(&bounds.ConeApex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+		bounds.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+MeshletData MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData,
+	uint32 maxVertices, uint32 maxTriangles, ThreadPool& pool)
+{
+	assert(maxVertices >= 3 && maxVertices <= 256 && "Local indices are one byte.");
+	assert(maxTriangles >= 1);
+
+	const auto& indices = meshData.Indices32;
+	const uint32 vertexCount = (uint32)meshData.Vertices.size();
+	const uint32 triCount = (uint32)indices.size() / 3;
+
+	// Adjacency goes through positions rather than vertex indices: CreateGeosphere and
+	// subdivided boxes give every triangle its own vertices, and clusters still have to
+	// grow across those splits.
+	std::vector<uint32> vertexPosition(vertexCount);
+	uint32 positionCount = 0;
+	{
+		std::unordered_map<PositionKey, uint32, PositionKeyHash> positions;
+		positions.reserve(vertexCount);
+		for(uint32 v = 0; v < vertexCount; ++v)
+		{
+			auto it = positions.emplace(MakePositionKey(meshData.Vertices[v].Position), positionCount);
+			if(it.second)
+				++positionCount;
+			vertexPosition[v] = it.first->second;
+		}
+	}
+
+	// Position -> triangle adjacency, in compressed rows.
+	std::vector<uint32> adjOffsets(positionCount + 1, 0);
+	for(uint32 i = 0; i < triCount * 3; ++i)
+		adjOffsets[vertexPosition[indices[i]] + 1]++;
+	for(uint32 p = 0; p < positionCount; ++p)
+		adjOffsets[p + 1] += adjOffsets[p];
+
+	std::vector<uint32> adjTriangles(triCount * 3);
+	{
+		std::vector<uint32> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+		for(uint32 i = 0; i < triCount * 3; ++i)
+			adjTriangles[fill[vertexPosition[indices[i]]]++] = i / 3;
+	}
+
+	MeshletData data;
+	data.Meshlets.reserve(triCount / maxTriangles + 1);
+	data.VertexIndices.reserve(vertexCount + vertexCount / 2);
+	data.PrimitiveIndices.reserve(triCount * 3);
+
+	std::vector<uint8_t> triangleUsed(triCount, 0);
+	std::vector<uint32> localIndex(vertexCount, InvalidIndex);
+	std::vector<uint32> candidateStamp(triCount, InvalidIndex);
+	std::vector<uint32> candidates;
+
+	uint32 seed = 0;
+	while(true)
+	{
+		while(seed < triCount && triangleUsed[seed])
+			++seed;
+		if(seed == triCount)
+			break;
+
+		const uint32 meshletIndex = (uint32)data.Meshlets.size();
+
+		Meshlet meshlet;
+		meshlet.VertexOffset = (uint32)data.VertexIndices.size();
+		meshlet.TriangleOffset = (uint32)data.PrimitiveIndices.size() / 3;
+
+		uint32 next = seed;
+		while(next != InvalidIndex)
+		{
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 v = indices[next*3 + k];
+				if(localIndex[v] == InvalidIndex)
+				{
+					localIndex[v] = meshlet.VertexCount++;
+					data.VertexIndices.push_back(v);
+
+					// Triangles around a newly added vertex become candidates.
+					uint32 p = vertexPosition[v];
+					for(uint32 a = adjOffsets[p]; a < adjOffsets[p + 1]; ++a)
+					{
+						uint32 tri = adjTriangles[a];
+						if(!triangleUsed[tri] && candidateStamp[tri] != meshletIndex)
+						{
+							candidateStamp[tri] = meshletIndex;
+							candidates.push_back(tri);
+						}
+					}
+				}
+				data.PrimitiveIndices.push_back((uint8_t)localIndex[v]);
+			}
+			triangleUsed[next] = 1;
+			meshlet.TriangleCount++;
+
+			if(meshlet.TriangleCount == maxTriangles)
+				break;
+
+			// Pick the candidate that adds the fewest vertices; ties go to the oldest, which
+			// keeps the meshlet growing outward from its seed.
+			next = InvalidIndex;
+			uint32 bestNew = 4;
+			size_t kept = 0;
+			for(size_t c = 0; c < candidates.size(); ++c)
+			{
+				uint32 tri = candidates[c];
+				if(triangleUsed[tri])
+					continue;
+				candidates[kept++] = tri;
+
+				uint32 newVertices = 0;
+				for(uint32 k = 0; k < 3; ++k)
+				{
+					uint32 v = indices[tri*3 + k];
+					if(localIndex[v] == InvalidIndex)
+						++newVertices;
+				}
+				if(newVertices < bestNew && meshlet.VertexCount + newVertices <= maxVertices)
+				{
+					bestNew = newVertices;
+					next = tri;
+				}
+			}
+			candidates.resize(kept);
+		}
+
+		for(uint32 i = 0; i < meshlet.VertexCount; ++i)
+			localIndex[data.VertexIndices[meshlet.VertexOffset + i]] = InvalidIndex;
+		candidates.clear();
+
+		data.Meshlets.push_back(meshlet);
+	}
+
+	data.Bounds.resize(data.Meshlets.size());
+	pool.ParallelFor((uint32)data.Meshlets.size(), 64, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 i = begin; i < end; ++i)
+			ComputeBounds(meshData, data, data.Meshlets[i], data.Bounds[i]);
+	});
+
+	return data;
+}
+
+std::vector<MeshletBuilder::uint32> MeshletBuilder::BuildIndexBuffer(const MeshletData& meshlets)
+{
+	std::vector<uint32> indices(meshlets.PrimitiveIndices.size());
+
+	for(const auto& m : meshlets.Meshlets)
+	{
+		const uint32* vertexIndices = &meshlets.VertexIndices[m.VertexOffset];
+		for(uint32 i = m.TriangleOffset * 3; i < (m.TriangleOffset + m.TriangleCount) * 3; ++i)
+			indices[i] = vertexIndices[meshlets.PrimitiveIndices[i]];
+	}
+
+	return indices;
+}
+
+bool MeshletBuilder::Validate(const GeometryGenerator::MeshData& meshData, const MeshletData& meshlets,
+	uint32 maxVertices, uint32 maxTriangles, std::string* error)
+{
+	auto fail = [&](const std::string& message)
+	{
+		if(error)
+			*error = message;
+		return false;
+	};
+
+	const auto& vertices = meshData.Vertices;
+	const uint32 vertexCount = (uint32)vertices.size();
+
+	if(meshlets.Bounds.size() != meshlets.Meshlets.size())
+		return fail("bounds count does not match meshlet count");
+
+	std::vector<std::array<uint32, 3>> built;
+	built.reserve(meshlets.PrimitiveIndices.size() / 3);
+
+	for(size_t mi = 0; mi < meshlets.Meshlets.size(); ++mi)
+	{
+		const Meshlet& m = meshlets.Meshlets[mi];
+		const MeshletBounds& b = meshlets.Bounds[mi];
+
+		if(m.VertexCount == 0 || m.VertexCount > maxVertices)
+			return fail("meshlet " + std::to_string(mi) + ": vertex count out of range");
+		if(m.TriangleCount == 0 || m.TriangleCount > maxTriangles)
+			return fail("meshlet " + std::to_string(mi) + ": triangle count out of range");
+		if((size_t)m.VertexOffset + m.VertexCount > meshlets.VertexIndices.size() ||
+			((size_t)m.TriangleOffset + m.TriangleCount) * 3 > meshlets.PrimitiveIndices.size())
+			return fail("meshlet " + std::to_string(mi) + ": range runs past the end of the meshlet arrays");
+
+		XMVECTOR center = XMLoadFloat3(&b.Sphere.Center);
+		float radius = b.Sphere.Radius * 1.0001f + 1e-5f;
+		for(uint32 i = 0; i < m.VertexCount; ++i)
+		{
+			uint32 v = meshlets.VertexIndices[m.VertexOffset + i];
+			if(v >= vertexCount)
+				return fail("meshlet " + std::to_string(mi) + ": vertex index out of range");
+
+			XMVECTOR p = XMLoadFloat3(&vertices[v].Position);
+			if(XMVectorGetX(XMVector3Length(XMVectorSubtract(p, center))) > radius)
+				return fail("meshlet " + std::to_string(mi) + ": bounding sphere does not contain a vertex");
+		}
+
+		float minDot = b.ConeCutoff <= 1.0f ? sqrtf(1.0f - b.ConeCutoff * b.ConeCutoff) : -1.0f;
+		XMVECTOR axis = XMLoadFloat3(&b.ConeAxis);
+
+		for(uint32 t = 0; t < m.TriangleCount; ++t)
+		{
+			uint32 corner[3];
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 local = meshlets.PrimitiveIndices[(m.TriangleOffset + t) * 3 + k];
+				if(local >= m.VertexCount)
+					return fail("meshlet " + std::to_string(mi) + ": local index out of range");
+				corner[k] = meshlets.VertexIndices[m.VertexOffset + local];
+			}
+			built.push_back(CanonicalTriangle(corner[0], corner[1], corner[2]));
+
+			XMVECTOR p0 = XMLoadFloat3(&vertices[corner[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[corner[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[corner[2]].Position);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			if(XMVectorGetX(XMVector3LengthSq(n)) > 1e-20f &&
+				XMVectorGetX(XMVector3Dot(XMVector3Normalize(n), axis)) < minDot - 1e-4f)
+				return fail("meshlet " + std::to_string(mi) + ": normal cone does not contain a face");
+		}
+	}
+
+	// Every source triangle must come out exactly once, with the same winding.
+	const auto& indices = meshData.Indices32;
+	std::vector<std::array<uint32, 3>> source;
+	source.reserve(indices.size() / 3);
+	for(size_t i = 0; i + 2 < indices.size(); i += 3)
+		source.push_back(CanonicalTriangle(indices[i], indices[i + 1], indices[i + 2]));
+
+	std::sort(built.begin(), built.end());
+	std::sort(source.begin(), source.end());
+	if(built != source)
+		return fail("triangles do not match the source mesh");
+
+	return true;
+}
+
+bool MeshletBuilder::IsBackfacing(const MeshletBounds& bounds, const XMFLOAT3& eyePos)
+{
+	if(bounds.ConeCutoff > 1.0f)
+		return false;
+
+	XMVECTOR toApex = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&bounds.ConeApex), XMLoadFloat3(&eyePos)));
+	return XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&bounds.ConeAxis))) >= bounds.ConeCutoff;
+}
@@ -0,0 +1,88 @@
+//***************************************************************************************
+// Meshlet.h
+//
+// Splits a GeometryGenerator::MeshData into meshlets: small clusters of at most 64
+// vertices and 124 triangles, each with its own list of mesh vertices and a local index
+// buffer of one byte per corner.  Every meshlet also gets a bounding sphere and a normal
+// cone so whole clusters can be frustum or backface culled on the CPU or the GPU.
+//
+// Nothing here touches Direct3D, so building and validation can run headless.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "ThreadPool.h"
+#include <DirectXCollision.h>
+#include <string>
+
+struct Meshlet
+{
+	// Range in MeshletData::VertexIndices.
+	GeometryGenerator::uint32 VertexOffset = 0;
+	GeometryGenerator::uint32 VertexCount = 0;
+
+	// Range of triangles in MeshletData::PrimitiveIndices (three entries per triangle).
+	GeometryGenerator::uint32 TriangleOffset = 0;
+	GeometryGenerator::uint32 TriangleCount = 0;
+};
+
+struct MeshletBounds
+{
+	DirectX::BoundingSphere Sphere;
+
+	// Every triangle faces within the cone around ConeAxis.  The whole meshlet is
+	// backfacing when seen from inside the negative cone anchored at ConeApex; see
+	// MeshletBuilder::IsBackfacing.  ConeCutoff > 1 means the cone is too wide to cull.
+	DirectX::XMFLOAT3 ConeApex = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 1.0f };
+	float ConeCutoff = 2.0f;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> Meshlets;
+	std::vector<MeshletBounds> Bounds;
+
+	// Meshlet-local vertex -> mesh vertex.
+	std::vector<GeometryGenerator::uint32> VertexIndices;
+
+	// Three meshlet-local vertex indices per triangle.
+	std::vector<std::uint8_t> PrimitiveIndices;
+};
+
+class MeshletBuilder
+{
+public:
+	using uint8 = std::uint8_t;
+	using uint32 = GeometryGenerator::uint32;
+
+	static const uint32 MaxVertices = 64;
+	static const uint32 MaxTriangles = 124;
+
+	///<summary>
+	/// Greedily grows each meshlet from a seed triangle, always adding the neighbouring
+	/// triangle that brings in the fewest new vertices, so meshlets stay compact and share
+	/// vertices well.  Bounds and cones are computed in parallel once the split is known.
+	///</summary>
+	static MeshletData Build(const GeometryGenerator::MeshData& meshData,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles,
+		ThreadPool& pool = ThreadPool::Get());
+
+	///<summary>
+	/// Expands the meshlets back into a mesh index list ordered meshlet by meshlet, so
+	/// meshlet i can be drawn as the index range [TriangleOffset*3, (TriangleOffset+TriangleCount)*3).
+	///</summary>
+	static std::vector<uint32> BuildIndexBuffer(const MeshletData& meshlets);
+
+	///<summary>
+	/// Checks the meshlet limits, that every local index is in range, that each source
+	/// triangle appears exactly once with its winding, and that the bounds contain their
+	/// vertices.  On failure returns false and describes the first problem in error.
+	///</summary>
+	static bool Validate(const GeometryGenerator::MeshData& meshData, const MeshletData& meshlets,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles, std::string* error = nullptr);
+
+	// True when every triangle of the meshlet faces away from the eye.
+	static bool IsBackfacing(const MeshletBounds& bounds, const DirectX::XMFLOAT3& eyePos);
+};
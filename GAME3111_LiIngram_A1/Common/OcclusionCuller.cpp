@@ -0,0 +1,432 @@
+//***************************************************************************************
+// OcclusionCuller.cpp
+//***************************************************************************************
+
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Fewer occluder triangles than this per task and the per-slot setup lists cost more
+	// than they save.
+	const OcclusionCuller::uint32 SetupGrainSize = 256;
+
+	// Clips a polygon against the near plane z >= 0 of D3D clip space.
+	OcclusionCuller::uint32 ClipNear(const XMFLOAT4* in, OcclusionCuller::uint32 count, XMFLOAT4* out)
+	{
+		OcclusionCuller::uint32 outCount = 0;
+		for(OcclusionCuller::uint32 i = 0; i < count; ++i)
+		{
+			const XMFLOAT4& a = in[i];
+			const XMFLOAT4& b = in[(i + 1) % count];
+			bool aInside = a.z >= 0.0f;
+			bool bInside = b.z >= 0.0f;
+
+			if(aInside)
+				out[outCount++] = a;
+
+			if(aInside != bInside)
+			{
+				float t = a.z / (a.z - b.z);
+				out[outCount++] = XMFLOAT4(
+					a.x + (b.x - a.x) * t,
+					a.y + (b.y - a.y) * t,
+					0.0f,
+					a.w + (b.w - a.w) * t);
+			}
+		}
+		return outCount;
+	}
+}
+
+OcclusionCuller::OcclusionCuller(uint32 width, uint32 height)
+{
+	mViewProj = XMFLOAT4X4(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	Resize(width, height);
+}
+
+void OcclusionCuller::Resize(uint32 width, uint32 height)
+{
+	mWidth = (std::max(width, 4u) + 3) & ~3u;
+	mHeight = std::max(height, 1u);
+
+	mHiZ.clear();
+	mHiZWidth.clear();
+	mHiZHeight.clear();
+
+	uint32 w = mWidth;
+	uint32 h = mHeight;
+	while(true)
+	{
+		mHiZ.emplace_back(w * h, 1.0f);
+		mHiZWidth.push_back(w);
+		mHiZHeight.push_back(h);
+
+		if(w == 1 && h == 1)
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+}
+
+OcclusionCuller::uint32 OcclusionCuller::Width()const
+{
+	return mWidth;
+}
+
+OcclusionCuller::uint32 OcclusionCuller::Height()const
+{
+	return mHeight;
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProj)
+{
+	mViewProj = viewProj;
+	mOccluders.clear();
+
+	for(auto& level : mHiZ)
+		std::fill(level.begin(), level.end(), 1.0f);
+
+	mOccluderTriangles = 0;
+	mRasterizedTriangles = 0;
+	mRasterMilliseconds = 0.0;
+
+	mTested = 0;
+	mFrustumCulled = 0;
+	mOccluded = 0;
+	mVisible = 0;
+	mTestNanoseconds = 0;
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, uint32 stride,
+	const uint16* indices, uint32 indexCount, const XMFLOAT4X4& world)
+{
+	mOccluders.push_back({ positions, stride, indices, true, indexCount, world });
+	mOccluderTriangles += indexCount / 3;
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, uint32 stride,
+	const uint32* indices, uint32 indexCount, const XMFLOAT4X4& world)
+{
+	mOccluders.push_back({ positions, stride, indices, false, indexCount, world });
+	mOccluderTriangles += indexCount / 3;
+}
+
+void OcclusionCuller::RasterizeOccluders(ThreadPool& pool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	mSetups.resize(pool.SlotCount());
+	for(auto& setups : mSetups)
+		setups.clear();
+
+	// Setup is split by occluder.  Each slot appends to its own list, so no locking.
+	for(const auto& occluder : mOccluders)
+	{
+		uint32 triCount = occluder.IndexCount / 3;
+		pool.ParallelFor(triCount, SetupGrainSize, [&](uint32 begin, uint32 end, uint32 slot)
+		{
+			Occluder range = occluder;
+			range.Indices = occluder.Indices16 ?
+				(const void*)((const uint16*)occluder.Indices + begin * 3) :
+				(const void*)((const uint32*)occluder.Indices + begin * 3);
+			range.IndexCount = (end - begin) * 3;
+			SetupOccluder(range, mSetups[slot]);
+		});
+	}
+
+	mRasterizedTriangles = 0;
+	for(const auto& setups : mSetups)
+		mRasterizedTriangles += (uint32)setups.size();
+
+	// Bands own disjoint rows of the depth buffer, so they never write the same pixel.
+	uint32 bandCount = (mHeight + BandHeight - 1) / BandHeight;
+	pool.ParallelFor(bandCount, 1, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 band = begin; band < end; ++band)
+			RasterizeBand(band * BandHeight, std::min((band + 1) * BandHeight, mHeight));
+	});
+
+	BuildHierarchicalZ();
+
+	mRasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionCuller::SetupOccluder(const Occluder& occluder, std::vector<TriangleSetup>& out)const
+{
+	XMMATRIX M = XMMatrixMultiply(XMLoadFloat4x4(&occluder.World), XMLoadFloat4x4(&mViewProj));
+	const std::uint8_t* base = reinterpret_cast<const std::uint8_t*>(occluder.Positions);
+
+	for(uint32 i = 0; i + 2 < occluder.IndexCount; i += 3)
+	{
+		XMFLOAT4 clip[3];
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			uint32 index = occluder.Indices16 ?
+				((const uint16*)occluder.Indices)[i + k] :
+				((const uint32*)occluder.Indices)[i + k];
+			XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + (size_t)index * occluder.Stride));
+			XMStoreFloat4(&clip[k], XMVector3Transform(p, M));
+		}
+
+		// Trivially reject triangles entirely outside one frustum plane.
+		if((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+			(clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+			(clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+			(clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w) ||
+			(clip[0].z > clip[0].w && clip[1].z > clip[1].w && clip[2].z > clip[2].w) ||
+			(clip[0].z < 0.0f && clip[1].z < 0.0f && clip[2].z < 0.0f))
+			continue;
+
+		if(clip[0].z >= 0.0f && clip[1].z >= 0.0f && clip[2].z >= 0.0f)
+		{
+			SetupTriangle(clip, out);
+			continue;
+		}
+
+		// Crosses the near plane: clip to a quad or triangle and fan it out.
+		XMFLOAT4 poly[4];
+		uint32 count = ClipNear(clip, 3, poly);
+		for(uint32 k = 1; k + 1 < count; ++k)
+		{
+			XMFLOAT4 tri[3] = { poly[0], poly[k], poly[k + 1] };
+			SetupTriangle(tri, out);
+		}
+	}
+}
+
+void OcclusionCuller::SetupTriangle(const XMFLOAT4* clip, std::vector<TriangleSetup>& out)const
+{
+	float x[3], y[3], z[3];
+	for(int k = 0; k < 3; ++k)
+	{
+		if(clip[k].w <= 1e-6f)
+			return;
+
+		float invW = 1.0f / clip[k].w;
+		x[k] = (clip[k].x * invW * 0.5f + 0.5f) * mWidth;
+		y[k] = (0.5f - clip[k].y * invW * 0.5f) * mHeight;
+		z[k] = clip[k].z * invW;
+	}
+
+	// With y pointing down, clockwise (front facing) triangles have positive area.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if(area <= 0.0f)
+		return;
+
+	TriangleSetup t;
+	t.MinX = std::max(0, (int)floorf(std::min({ x[0], x[1], x[2] })));
+	t.MaxX = std::min((int)mWidth - 1, (int)ceilf(std::max({ x[0], x[1], x[2] })));
+	t.MinY = std::max(0, (int)floorf(std::min({ y[0], y[1], y[2] })));
+	t.MaxY = std::min((int)mHeight - 1, (int)ceilf(std::max({ y[0], y[1], y[2] })));
+	if(t.MinX > t.MaxX || t.MinY > t.MaxY)
+		return;
+
+	// Edge i runs from vertex i to vertex i+1 and is non-negative on the inside.  Each
+	// edge is pushed out by 1/256 of a pixel: the two triangles sharing an edge evaluate
+	// it with opposite signs, and without the bias rounding leaves pinholes along it.
+	for(int i = 0; i < 3; ++i)
+	{
+		int j = (i + 1) % 3;
+		t.EdgeA[i] = -(y[j] - y[i]);
+		t.EdgeB[i] = x[j] - x[i];
+		t.EdgeC[i] = -t.EdgeA[i] * x[i] - t.EdgeB[i] * y[i]
+			+ (fabsf(t.EdgeA[i]) + fabsf(t.EdgeB[i])) * (1.0f / 256.0f);
+	}
+
+	// z/w is affine in screen space.
+	float invArea = 1.0f / area;
+	t.DzDx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * invArea;
+	t.DzDy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * invArea;
+	t.Z0 = z[0] - t.DzDx * x[0] - t.DzDy * y[0];
+
+	out.push_back(t);
+}
+
+void OcclusionCuller::RasterizeBand(int firstRow, int endRow)
+{
+	float* depth = mHiZ[0].data();
+
+	const XMVECTOR pixelOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR zero = XMVectorZero();
+
+	for(const auto& setups : mSetups)
+	{
+		for(const auto& t : setups)
+		{
+			int y0 = std::max(t.MinY, firstRow);
+			int y1 = std::min(t.MaxY, endRow - 1);
+			if(y0 > y1)
+				continue;
+
+			XMVECTOR a0 = XMVectorReplicate(t.EdgeA[0]);
+			XMVECTOR a1 = XMVectorReplicate(t.EdgeA[1]);
+			XMVECTOR a2 = XMVectorReplicate(t.EdgeA[2]);
+			XMVECTOR dzdx = XMVectorReplicate(t.DzDx);
+
+			// Rows start on a multiple of four so every four-wide load stays inside the row.
+			int x0 = t.MinX & ~3;
+
+			for(int y = y0; y <= y1; ++y)
+			{
+				float py = y + 0.5f;
+				XMVECTOR rowE0 = XMVectorReplicate(t.EdgeB[0] * py + t.EdgeC[0]);
+				XMVECTOR rowE1 = XMVectorReplicate(t.EdgeB[1] * py + t.EdgeC[1]);
+				XMVECTOR rowE2 = XMVectorReplicate(t.EdgeB[2] * py + t.EdgeC[2]);
+				XMVECTOR rowZ = XMVectorReplicate(t.Z0 + t.DzDy * py);
+
+				float* row = depth + (size_t)y * mWidth;
+				for(int x = x0; x <= t.MaxX; x += 4)
+				{
+					XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), pixelOffsets);
+
+					XMVECTOR inside = XMVectorAndInt(
+						XMVectorAndInt(
+							XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a0, px, rowE0), zero),
+							XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a1, px, rowE1), zero)),
+						XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a2, px, rowE2), zero));
+
+					XMVECTOR z = XMVectorMultiplyAdd(dzdx, px, rowZ);
+					XMVECTOR current = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+					XMVECTOR closest = XMVectorSelect(current, XMVectorMin(current, z), inside);
+					XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(row + x), closest);
+				}
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildHierarchicalZ()
+{
+	for(size_t level = 1; level < mHiZ.size(); ++level)
+	{
+		const std::vector<float>& src = mHiZ[level - 1];
+		std::vector<float>& dst = mHiZ[level];
+		uint32 srcW = mHiZWidth[level - 1];
+		uint32 srcH = mHiZHeight[level - 1];
+		uint32 dstW = mHiZWidth[level];
+		uint32 dstH = mHiZHeight[level];
+
+		for(uint32 y = 0; y < dstH; ++y)
+		{
+			uint32 sy0 = y * 2;
+			uint32 sy1 = std::min(sy0 + 1, srcH - 1);
+			for(uint32 x = 0; x < dstW; ++x)
+			{
+				uint32 sx0 = x * 2;
+				uint32 sx1 = std::min(sx0 + 1, srcW - 1);
+				dst[y * dstW + x] = std::max(
+					std::max(src[sy0 * srcW + sx0], src[sy0 * srcW + sx1]),
+					std::max(src[sy1 * srcW + sx0], src[sy1 * srcW + sx1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& localBounds, const XMFLOAT4X4& world)const
+{
+	auto start = std::chrono::steady_clock::now();
+	auto finish = [&](std::atomic<uint32>& counter, bool visible)
+	{
+		++counter;
+		mTestNanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		return visible;
+	};
+
+	++mTested;
+
+	XMMATRIX M = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&mViewProj));
+
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	localBounds.GetCorners(corners);
+
+	XMFLOAT4 clip[BoundingBox::CORNER_COUNT];
+	uint32 behindNear = 0;
+	for(size_t i = 0; i < BoundingBox::CORNER_COUNT; ++i)
+	{
+		XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&corners[i]), M));
+		if(clip[i].z < 0.0f || clip[i].w <= 1e-6f)
+			++behindNear;
+	}
+
+	// Entirely behind the near plane: outside the frustum.  Partly behind: the screen
+	// rectangle is unbounded, so the box cannot be tested and counts as visible.
+	if(behindNear == BoundingBox::CORNER_COUNT)
+		return finish(mFrustumCulled, false);
+	if(behindNear > 0)
+		return finish(mVisible, true);
+
+	float minX = FLT_MAX, maxX = -FLT_MAX;
+	float minY = FLT_MAX, maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+	for(const auto& c : clip)
+	{
+		float invW = 1.0f / c.w;
+		minX = std::min(minX, c.x * invW);
+		maxX = std::max(maxX, c.x * invW);
+		minY = std::min(minY, c.y * invW);
+		maxY = std::max(maxY, c.y * invW);
+		minZ = std::min(minZ, c.z * invW);
+	}
+
+	if(maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || minZ > 1.0f)
+		return finish(mFrustumCulled, false);
+
+	// Pixel rectangle covered by the box, clamped to the screen.
+	auto clampX = [&](float v) { return std::min(std::max((int)floorf(v), 0), (int)mWidth - 1); };
+	auto clampY = [&](float v) { return std::min(std::max((int)floorf(v), 0), (int)mHeight - 1); };
+	int px0 = clampX((minX * 0.5f + 0.5f) * mWidth);
+	int px1 = clampX((maxX * 0.5f + 0.5f) * mWidth);
+	int py0 = clampY((0.5f - maxY * 0.5f) * mHeight);
+	int py1 = clampY((0.5f - minY * 0.5f) * mHeight);
+
+	// Coarsest level at which the rectangle spans at most two texels on each axis.
+	uint32 level = 0;
+	while(level + 1 < mHiZ.size() &&
+		((px1 >> level) - (px0 >> level) > 1 || (py1 >> level) - (py0 >> level) > 1))
+		++level;
+
+	const std::vector<float>& hiZ = mHiZ[level];
+	uint32 levelWidth = mHiZWidth[level];
+
+	float farthest = 0.0f;
+	for(int y = py0 >> level; y <= (py1 >> level); ++y)
+	{
+		for(int x = px0 >> level; x <= (px1 >> level); ++x)
+			farthest = std::max(farthest, hiZ[y * levelWidth + x]);
+	}
+
+	if(minZ > farthest)
+		return finish(mOccluded, false);
+
+	return finish(mVisible, true);
+}
+
+OcclusionCuller::Stats OcclusionCuller::GetStats()const
+{
+	Stats stats;
+	stats.OccluderTriangles = mOccluderTriangles;
+	stats.RasterizedTriangles = mRasterizedTriangles;
+	stats.Tested = mTested;
+	stats.FrustumCulled = mFrustumCulled;
+	stats.Occluded = mOccluded;
+	stats.Visible = mVisible;
+	stats.RasterMilliseconds = mRasterMilliseconds;
+	stats.TestMilliseconds = mTestNanoseconds / 1.0e6;
+	return stats;
+}
+
+const std::vector<float>& OcclusionCuller::GetDepthBuffer()const
+{
+	return mHiZ[0];
+}
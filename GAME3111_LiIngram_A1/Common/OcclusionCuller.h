@@ -0,0 +1,138 @@
+//***************************************************************************************
+// OcclusionCuller.h
+//
+// CPU occlusion culling against a low resolution software depth buffer.
+//
+// Each frame a handful of simplified occluders (large boxes, a coarse terrain LOD) are
+// rasterized on the thread pool into a small depth buffer, four pixels at a time with
+// XMVECTOR edge functions.  A max-depth mip chain (hierarchical Z) is then built over it,
+// and render item bounds are tested against the chain before any draw is recorded: an
+// item is occluded when the nearest point of its box lies behind the farthest occluder
+// depth over the whole screen rectangle it covers.
+//
+// Depth follows the D3D convention (0 at the near plane, 1 at the far plane).
+//***************************************************************************************
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <DirectXCollision.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class OcclusionCuller
+{
+public:
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	struct Stats
+	{
+		uint32 OccluderTriangles = 0;   // submitted this frame
+		uint32 RasterizedTriangles = 0; // left after clipping and backface culling
+		uint32 Tested = 0;
+		uint32 FrustumCulled = 0;
+		uint32 Occluded = 0;
+		uint32 Visible = 0;
+
+		double RasterMilliseconds = 0.0; // setup, rasterization and hierarchical Z build
+		double TestMilliseconds = 0.0;   // total spent in IsVisible
+	};
+
+	// Width is rounded up to a multiple of four so rows can be processed four pixels at a time.
+	OcclusionCuller(uint32 width = 320, uint32 height = 192);
+
+	void Resize(uint32 width, uint32 height);
+	uint32 Width()const;
+	uint32 Height()const;
+
+	///<summary>
+	/// Clears the depth buffer and the occluder list and resets the counters.  viewProj
+	/// transforms world space to D3D clip space.
+	///</summary>
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProj);
+
+	///<summary>
+	/// Queues an indexed triangle list as an occluder.  The vertex and index data are
+	/// referenced, not copied, and must stay valid until RasterizeOccluders returns.
+	/// Front faces are clockwise, as with the default D3D rasterizer state.
+	///</summary>
+	void AddOccluder(const DirectX::XMFLOAT3* positions, uint32 stride,
+		const uint16* indices, uint32 indexCount, const DirectX::XMFLOAT4X4& world);
+	void AddOccluder(const DirectX::XMFLOAT3* positions, uint32 stride,
+		const uint32* indices, uint32 indexCount, const DirectX::XMFLOAT4X4& world);
+
+	///<summary>
+	/// Transforms and clips the occluder triangles, rasterizes them in horizontal bands on
+	/// the pool, then builds the hierarchical depth buffer.
+	///</summary>
+	void RasterizeOccluders(ThreadPool& pool = ThreadPool::Get());
+
+	///<summary>
+	/// Tests a local space box drawn with the given world matrix.  Boxes that cross the
+	/// near plane are always visible.  Safe to call from several threads at once.
+	///</summary>
+	bool IsVisible(const DirectX::BoundingBox& localBounds, const DirectX::XMFLOAT4X4& world)const;
+
+	Stats GetStats()const;
+
+	// Full resolution occluder depth, row by row; useful for debug views.
+	const std::vector<float>& GetDepthBuffer()const;
+
+private:
+	struct Occluder
+	{
+		const DirectX::XMFLOAT3* Positions;
+		uint32 Stride;
+		const void* Indices;
+		bool Indices16;
+		uint32 IndexCount;
+		DirectX::XMFLOAT4X4 World;
+	};
+
+	// Screen space triangle ready for rasterization: three edge functions that are
+	// non-negative inside, a depth plane, and a clamped pixel bounding rectangle.
+	struct TriangleSetup
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float Z0, DzDx, DzDy;
+		int MinX, MaxX, MinY, MaxY;
+	};
+
+	void SetupOccluder(const Occluder& occluder, std::vector<TriangleSetup>& out)const;
+	void SetupTriangle(const DirectX::XMFLOAT4* clip, std::vector<TriangleSetup>& out)const;
+	void RasterizeBand(int firstRow, int endRow);
+	void BuildHierarchicalZ();
+
+private:
+	static const int BandHeight = 16;
+
+	uint32 mWidth = 0;
+	uint32 mHeight = 0;
+
+	DirectX::XMFLOAT4X4 mViewProj;
+
+	std::vector<Occluder> mOccluders;
+
+	// One setup list per pool slot, filled in parallel.
+	std::vector<std::vector<TriangleSetup>> mSetups;
+
+	// mHiZ[0] is the full resolution depth buffer; level i+1 holds the maximum depth of
+	// each 2x2 block of level i.
+	std::vector<std::vector<float>> mHiZ;
+	std::vector<uint32> mHiZWidth;
+	std::vector<uint32> mHiZHeight;
+
+	uint32 mOccluderTriangles = 0;
+	uint32 mRasterizedTriangles = 0;
+	double mRasterMilliseconds = 0.0;
+
+	mutable std::atomic<uint32> mTested{ 0 };
+	mutable std::atomic<uint32> mFrustumCulled{ 0 };
+	mutable std::atomic<uint32> mOccluded{ 0 };
+	mutable std::atomic<uint32> mVisible{ 0 };
+	mutable std::atomic<uint64_t> mTestNanoseconds{ 0 };
+};
@@ -0,0 +1,670 @@
+//***************************************************************************************
+// PickingBvh.cpp
+//***************************************************************************************
+
+#include "PickingBvh.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	using Node = TriangleBvh::Node;
+	using uint32 = std::uint32_t;
+
+	// Centroid bins tried per axis when looking for a split.
+	const uint32 BinCount = 12;
+
+	// Nodes this small always become leaves; nodes bigger than MaxLeafSize always split
+	// when their centroids can be separated at all.
+	const uint32 MinLeafSize = 2;
+	const uint32 MaxLeafSize = 16;
+
+	// Cost of visiting a node relative to testing one primitive.
+	const float TraversalCost = 1.0f;
+
+	// Nodes at this depth become leaves, which bounds the traversal stack below.
+	const uint32 MaxTreeDepth = 48;
+	const int StackSize = 64;
+
+	struct Box
+	{
+		XMFLOAT3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const XMFLOAT3& p)
+		{
+			Min.x = std::min(Min.x, p.x); Min.y = std::min(Min.y, p.y); Min.z = std::min(Min.z, p.z);
+			Max.x = std::max(Max.x, p.x); Max.y = std::max(Max.y, p.y); Max.z = std::max(Max.z, p.z);
+		}
+
+		void Grow(const Box& b)
+		{
+			Min.x = std::min(Min.x, b.Min.x); Min.y = std::min(Min.y, b.Min.y); Min.z = std::min(Min.z, b.Min.z);
+			Max.x = std::max(Max.x, b.Max.x); Max.y = std::max(Max.y, b.Max.y); Max.z = std::max(Max.z, b.Max.z);
+		}
+
+		XMFLOAT3 Center()const
+		{
+			return XMFLOAT3(0.5f*(Min.x + Max.x), 0.5f*(Min.y + Max.y), 0.5f*(Min.z + Max.z));
+		}
+
+		// Half the surface area, which is all the SAH needs.
+		float HalfArea()const
+		{
+			if(Min.x > Max.x)
+				return 0.0f;
+
+			float dx = Max.x - Min.x;
+			float dy = Max.y - Min.y;
+			float dz = Max.z - Min.z;
+			return dx*dy + dy*dz + dz*dx;
+		}
+	};
+
+	float Component(const XMFLOAT3& v, uint32 axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	///<summary>
+	/// Builds a binary hierarchy over boxes with binned SAH splits.  On return order lists
+	/// the primitive indices so that every leaf covers a contiguous range of it.
+	///</summary>
+	void BuildHierarchy(const std::vector<Box>& boxes, std::vector<uint32>& order,
+		std::vector<Node>& nodes, uint32& leafCount, uint32& maxDepth)
+	{
+		const uint32 count = (uint32)boxes.size();
+
+		nodes.clear();
+		leafCount = 0;
+		maxDepth = 0;
+
+		order.resize(count);
+		std::iota(order.begin(), order.end(), 0u);
+		if(count == 0)
+			return;
+
+		// A binary tree with count leaves at most has 2*count - 1 nodes.
+		nodes.reserve(2 * (size_t)count);
+		nodes.push_back(Node());
+
+		struct Task
+		{
+			uint32 NodeIndex;
+			uint32 First;
+			uint32 Count;
+			uint32 Depth;
+		};
+		std::vector<Task> tasks;
+		tasks.push_back({ 0, 0, count, 1 });
+
+		while(!tasks.empty())
+		{
+			Task task = tasks.back();
+			tasks.pop_back();
+
+			Box bounds;
+			Box centroids;
+			for(uint32 k = task.First; k < task.First + task.Count; ++k)
+			{
+				bounds.Grow(boxes[order[k]]);
+				centroids.Grow(boxes[order[k]].Center());
+			}
+
+			nodes[task.NodeIndex].Min = bounds.Min;
+			nodes[task.NodeIndex].Max = bounds.Max;
+			maxDepth = std::max(maxDepth, task.Depth);
+
+			// Split on the axis the centroids spread furthest along.
+			uint32 axis = 0;
+			float extent = centroids.Max.x - centroids.Min.x;
+			for(uint32 a = 1; a < 3; ++a)
+			{
+				float e = Component(centroids.Max, a) - Component(centroids.Min, a);
+				if(e > extent)
+				{
+					axis = a;
+					extent = e;
+				}
+			}
+
+			uint32 split = 0;
+			if(task.Count > MinLeafSize && task.Depth < MaxTreeDepth && extent > 0.0f)
+			{
+				const float axisMin = Component(centroids.Min, axis);
+				const float scale = BinCount / extent;
+				auto binOf = [&](uint32 prim)
+				{
+					float c = Component(boxes[prim].Center(), axis);
+					return std::min(BinCount - 1, (uint32)((c - axisMin) * scale));
+				};
+
+				Box binBounds[BinCount];
+				uint32 binCounts[BinCount] = {};
+				for(uint32 k = task.First; k < task.First + task.Count; ++k)
+				{
+					uint32 b = binOf(order[k]);
+					binBounds[b].Grow(boxes[order[k]]);
+					++binCounts[b];
+				}
+
+				// Sweep from the right to get the cost of every right hand side, then from
+				// the left to pair them up.  Splitting after bin b puts bins [0, b] left.
+				float rightCost[BinCount];
+				Box right;
+				uint32 rightCount = 0;
+				for(uint32 b = BinCount - 1; b > 0; --b)
+				{
+					right.Grow(binBounds[b]);
+					rightCount += binCounts[b];
+					rightCost[b - 1] = right.HalfArea() * rightCount;
+				}
+
+				float bestCost = FLT_MAX;
+				Box left;
+				uint32 leftCount = 0;
+				for(uint32 b = 0; b + 1 < BinCount; ++b)
+				{
+					left.Grow(binBounds[b]);
+					leftCount += binCounts[b];
+					if(leftCount == 0 || leftCount == task.Count)
+						continue;
+
+					float cost = left.HalfArea() * leftCount + rightCost[b];
+					if(cost < bestCost)
+					{
+						bestCost = cost;
+						split = b + 1;
+					}
+				}
+
+				float area = bounds.HalfArea();
+				bool worthSplitting = TraversalCost * area + bestCost < area * task.Count;
+				if(split != 0 && (worthSplitting || task.Count > MaxLeafSize))
+				{
+					auto first = order.begin() + task.First;
+					auto mid = std::partition(first, first + task.Count,
+						[&](uint32 prim) { return binOf(prim) < split; });
+					split = (uint32)(mid - order.begin());
+				}
+				else
+				{
+					split = 0;
+				}
+			}
+
+			if(split == 0)
+			{
+				nodes[task.NodeIndex].LeftOrFirst = task.First;
+				nodes[task.NodeIndex].Count = task.Count;
+				++leafCount;
+				continue;
+			}
+
+			uint32 leftChild = (uint32)nodes.size();
+			nodes.push_back(Node());
+			nodes.push_back(Node());
+			nodes[task.NodeIndex].LeftOrFirst = leftChild;
+			nodes[task.NodeIndex].Count = 0;
+
+			tasks.push_back({ leftChild + 1, split, task.First + task.Count - split, task.Depth + 1 });
+			tasks.push_back({ leftChild, task.First, split - task.First, task.Depth + 1 });
+		}
+	}
+
+	// 1 / dir, kept finite so an axis aligned ray never multiplies 0 by infinity.
+	XMVECTOR SafeReciprocal(FXMVECTOR dir)
+	{
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, dir);
+
+		auto inv = [](float x) { return std::fabs(x) > 1e-12f ? 1.0f / x : (x < 0.0f ? -1e12f : 1e12f); };
+		return XMVectorSet(inv(d.x), inv(d.y), inv(d.z), 0.0f);
+	}
+
+	///<summary>
+	/// Slab test.  Returns the distance at which the ray enters the node's box, or a
+	/// negative value if it misses the box or only reaches it beyond maxDistance.
+	///</summary>
+	float IntersectNode(const Node& node, FXMVECTOR origin, FXMVECTOR invDir, FXMVECTOR maxDistance)
+	{
+		XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.Min), origin), invDir);
+		XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.Max), origin), invDir);
+		XMVECTOR tNear = XMVectorMin(t0, t1);
+		XMVECTOR tFar = XMVectorMax(t0, t1);
+
+		XMVECTOR enter = XMVectorMax(XMVectorMax(XMVectorSplatX(tNear), XMVectorSplatY(tNear)),
+			XMVectorMax(XMVectorSplatZ(tNear), XMVectorZero()));
+		XMVECTOR exit = XMVectorMin(XMVectorMin(XMVectorSplatX(tFar), XMVectorSplatY(tFar)),
+			XMVectorMin(XMVectorSplatZ(tFar), maxDistance));
+
+		if(XMVector4Greater(enter, exit))
+			return -1.0f;
+
+		return XMVectorGetX(enter);
+	}
+
+	///<summary>
+	/// Two sided Moller-Trumbore test.  On a hit closer than hit->Distance fills in the
+	/// distance and barycentrics and returns true.
+	///</summary>
+	bool IntersectTriangle(const XMFLOAT3* corners, FXMVECTOR origin, FXMVECTOR dir, TriangleHit* hit)
+	{
+		XMVECTOR v0 = XMLoadFloat3(&corners[0]);
+		XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&corners[1]), v0);
+		XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&corners[2]), v0);
+
+		XMVECTOR p = XMVector3Cross(dir, e2);
+		float det = XMVectorGetX(XMVector3Dot(e1, p));
+		if(std::fabs(det) < 1e-12f)
+			return false;
+
+		float invDet = 1.0f / det;
+
+		XMVECTOR s = XMVectorSubtract(origin, v0);
+		float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+		if(u < 0.0f || u > 1.0f)
+			return false;
+
+		XMVECTOR q = XMVector3Cross(s, e1);
+		float v = XMVectorGetX(XMVector3Dot(dir, q)) * invDet;
+		if(v < 0.0f || u + v > 1.0f)
+			return false;
+
+		float t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+		if(t <= 0.0f || t >= hit->Distance)
+			return false;
+
+		hit->Distance = t;
+		hit->U = u;
+		hit->V = v;
+		return true;
+	}
+
+	struct StackEntry
+	{
+		uint32 NodeIndex;
+		float Enter;
+	};
+
+	///<summary>
+	/// Walks nodes front to back and calls testLeaf(first, count, &maxDistance) for every
+	/// leaf the ray reaches; testLeaf shrinks maxDistance as it finds closer hits so later
+	/// nodes are culled against it.
+	///</summary>
+	template<typename TLeafFunc>
+	void Traverse(const std::vector<Node>& nodes, FXMVECTOR origin, FXMVECTOR dir, float maxDistance, TLeafFunc testLeaf)
+	{
+		if(nodes.empty())
+			return;
+
+		XMVECTOR invDir = SafeReciprocal(dir);
+
+		float rootEnter = IntersectNode(nodes[0], origin, invDir, XMVectorReplicate(maxDistance));
+		if(rootEnter < 0.0f)
+			return;
+
+		StackEntry stack[StackSize];
+		int top = 0;
+		stack[top++] = { 0, rootEnter };
+
+		while(top > 0)
+		{
+			StackEntry entry = stack[--top];
+
+			// A closer hit may have been found since this node was pushed.
+			if(entry.Enter > maxDistance)
+				continue;
+
+			const Node& node = nodes[entry.NodeIndex];
+			if(node.Count > 0)
+			{
+				testLeaf(node.LeftOrFirst, node.Count, &maxDistance);
+				continue;
+			}
+
+			XMVECTOR limit = XMVectorReplicate(maxDistance);
+			uint32 a = node.LeftOrFirst;
+			uint32 b = node.LeftOrFirst + 1;
+			float enterA = IntersectNode(nodes[a], origin, invDir, limit);
+			float enterB = IntersectNode(nodes[b], origin, invDir, limit);
+
+			// Push the far child first so the near one is visited first.
+			if(enterA >= 0.0f && enterB >= 0.0f && enterA < enterB)
+			{
+				std::swap(a, b);
+				std::swap(enterA, enterB);
+			}
+			if(enterA >= 0.0f)
+				stack[top++] = { a, enterA };
+			if(enterB >= 0.0f)
+				stack[top++] = { b, enterB };
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// TriangleBvh
+//---------------------------------------------------------------------------------------
+
+void TriangleBvh::Build(const XMFLOAT3* positions, uint32 stride, const uint16* indices, uint32 indexCount)
+{
+	BuildFromIndices(positions, stride, indices, indexCount);
+}
+
+void TriangleBvh::Build(const XMFLOAT3* positions, uint32 stride, const uint32* indices, uint32 indexCount)
+{
+	BuildFromIndices(positions, stride, indices, indexCount);
+}
+
+template<typename TIndex>
+void TriangleBvh::BuildFromIndices(const XMFLOAT3* positions, uint32 stride, const TIndex* indices, uint32 indexCount)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const uint32 triCount = indexCount / 3;
+	auto position = [&](TIndex index)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(positions) + (size_t)index*stride);
+	};
+
+	std::vector<XMFLOAT3> corners(3 * (size_t)triCount);
+	std::vector<Box> boxes(triCount);
+	for(uint32 t = 0; t < triCount; ++t)
+	{
+		for(uint32 c = 0; c < 3; ++c)
+		{
+			corners[3*t + c] = position(indices[3*t + c]);
+			boxes[t].Grow(corners[3*t + c]);
+		}
+	}
+
+	std::vector<uint32> order;
+	mStats = BuildStats();
+	BuildHierarchy(boxes, order, mNodes, mStats.LeafCount, mStats.MaxDepth);
+
+	// Store the triangles in leaf order so a leaf reads one contiguous run.
+	mCorners.resize(corners.size());
+	mTriangleIds = order;
+	for(uint32 k = 0; k < triCount; ++k)
+	{
+		for(uint32 c = 0; c < 3; ++c)
+			mCorners[3*k + c] = corners[3*order[k] + c];
+	}
+
+	mStats.TriangleCount = triCount;
+	mStats.NodeCount = (uint32)mNodes.size();
+	mStats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool TriangleBvh::Raycast(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, TriangleHit* hit)const
+{
+	TriangleHit best;
+	best.Distance = maxDistance;
+
+	Traverse(mNodes, origin, dir, maxDistance, [&](uint32 first, uint32 count, float* limit)
+	{
+		for(uint32 k = first; k < first + count; ++k)
+		{
+			if(IntersectTriangle(&mCorners[3*k], origin, dir, &best))
+				best.Triangle = mTriangleIds[k];
+		}
+		*limit = best.Distance;
+	});
+
+	if(best.Triangle == ~0u)
+		return false;
+
+	*hit = best;
+	return true;
+}
+
+BoundingBox TriangleBvh::GetBounds()const
+{
+	BoundingBox bounds;
+	if(!mNodes.empty())
+		BoundingBox::CreateFromPoints(bounds, XMLoadFloat3(&mNodes[0].Min), XMLoadFloat3(&mNodes[0].Max));
+	return bounds;
+}
+
+TriangleBvh::uint32 TriangleBvh::TriangleCount()const
+{
+	return (uint32)mTriangleIds.size();
+}
+
+const TriangleBvh::BuildStats& TriangleBvh::GetStats()const
+{
+	return mStats;
+}
+
+//---------------------------------------------------------------------------------------
+// PickingScene
+//---------------------------------------------------------------------------------------
+
+double PickingScene::BenchmarkResult::RaysPerSecond()const
+{
+	return Milliseconds > 0.0 ? RayCount * 1000.0 / Milliseconds : 0.0;
+}
+
+PickingScene::uint32 PickingScene::AddMesh(const XMFLOAT3* positions, uint32 stride, const uint16* indices, uint32 indexCount)
+{
+	mPending.push_back({ positions, stride, indices, true, indexCount });
+	mMeshes.emplace_back();
+	return (uint32)mMeshes.size() - 1;
+}
+
+PickingScene::uint32 PickingScene::AddMesh(const XMFLOAT3* positions, uint32 stride, const uint32* indices, uint32 indexCount)
+{
+	mPending.push_back({ positions, stride, indices, false, indexCount });
+	mMeshes.emplace_back();
+	return (uint32)mMeshes.size() - 1;
+}
+
+PickingScene::uint32 PickingScene::AddInstance(uint32 mesh, const XMFLOAT4X4& world)
+{
+	assert(mesh < mMeshes.size());
+
+	mInstances.push_back(Instance());
+	mInstances.back().Mesh = mesh;
+	SetInstanceWorld((uint32)mInstances.size() - 1, world);
+
+	return (uint32)mInstances.size() - 1;
+}
+
+void PickingScene::SetInstanceWorld(uint32 instance, const XMFLOAT4X4& world)
+{
+	Instance& inst = mInstances[instance];
+	inst.World = world;
+
+	XMMATRIX W = XMLoadFloat4x4(&world);
+	XMVECTOR det = XMMatrixDeterminant(W);
+	XMStoreFloat4x4(&inst.InvWorld, XMMatrixInverse(&det, W));
+}
+
+void PickingScene::Build(ThreadPool& pool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Meshes vary wildly in size, so hand them out one at a time.
+	const uint32 first = mBuiltMeshCount;
+	pool.ParallelFor((uint32)mPending.size(), 1, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 k = begin; k < end; ++k)
+		{
+			const PendingMesh& p = mPending[k];
+			if(p.Indices16)
+				mMeshes[first + k].Build(p.Positions, p.Stride, static_cast<const uint16*>(p.Indices), p.IndexCount);
+			else
+				mMeshes[first + k].Build(p.Positions, p.Stride, static_cast<const uint32*>(p.Indices), p.IndexCount);
+		}
+	});
+
+	if(!mPending.empty())
+		mStats.MeshBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	mPending.clear();
+	mBuiltMeshCount = (uint32)mMeshes.size();
+
+	mStats.MeshCount = (uint32)mMeshes.size();
+	mStats.TriangleCount = 0;
+	for(const auto& mesh : mMeshes)
+		mStats.TriangleCount += mesh.TriangleCount();
+
+	BuildTopLevel();
+}
+
+void PickingScene::BuildTopLevel()
+{
+	assert(mPending.empty() && "Build the meshes before the top level.");
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<Box> boxes(mInstances.size());
+	for(size_t k = 0; k < mInstances.size(); ++k)
+	{
+		BoundingBox world;
+		mMeshes[mInstances[k].Mesh].GetBounds().Transform(world, XMLoadFloat4x4(&mInstances[k].World));
+
+		boxes[k].Min = XMFLOAT3(world.Center.x - world.Extents.x, world.Center.y - world.Extents.y, world.Center.z - world.Extents.z);
+		boxes[k].Max = XMFLOAT3(world.Center.x + world.Extents.x, world.Center.y + world.Extents.y, world.Center.z + world.Extents.z);
+	}
+
+	uint32 leafCount, maxDepth;
+	BuildHierarchy(boxes, mTopOrder, mTopNodes, leafCount, maxDepth);
+
+	mStats.InstanceCount = (uint32)mInstances.size();
+	mStats.TopLevelBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+PickingScene::uint32 PickingScene::MeshCount()const
+{
+	return (uint32)mMeshes.size();
+}
+
+PickingScene::uint32 PickingScene::InstanceCount()const
+{
+	return (uint32)mInstances.size();
+}
+
+const TriangleBvh& PickingScene::GetMesh(uint32 mesh)const
+{
+	return mMeshes[mesh];
+}
+
+BoundingBox PickingScene::GetBounds()const
+{
+	BoundingBox bounds;
+	if(!mTopNodes.empty())
+		BoundingBox::CreateFromPoints(bounds, XMLoadFloat3(&mTopNodes[0].Min), XMLoadFloat3(&mTopNodes[0].Max));
+	return bounds;
+}
+
+const PickingScene::Stats& PickingScene::GetStats()const
+{
+	return mStats;
+}
+
+bool PickingScene::Raycast(const XMFLOAT3& origin, const XMFLOAT3& dir, Hit* hit, float maxDistance)const
+{
+	XMVECTOR o = XMLoadFloat3(&origin);
+	XMVECTOR d = XMLoadFloat3(&dir);
+
+	Hit best;
+	best.Triangle.Distance = maxDistance;
+
+	Traverse(mTopNodes, o, d, maxDistance, [&](uint32 first, uint32 count, float* limit)
+	{
+		for(uint32 k = first; k < first + count; ++k)
+		{
+			const Instance& inst = mInstances[mTopOrder[k]];
+
+			// The inverse world is affine, so the local ray keeps the same parameterization
+			// and distances compare directly across instances.
+			XMMATRIX invWorld = XMLoadFloat4x4(&inst.InvWorld);
+			XMVECTOR localOrigin = XMVector3TransformCoord(o, invWorld);
+			XMVECTOR localDir = XMVector3TransformNormal(d, invWorld);
+
+			TriangleHit triHit;
+			if(mMeshes[inst.Mesh].Raycast(localOrigin, localDir, best.Triangle.Distance, &triHit))
+			{
+				best.Instance = mTopOrder[k];
+				best.Mesh = inst.Mesh;
+				best.Triangle = triHit;
+			}
+		}
+		*limit = best.Triangle.Distance;
+	});
+
+	if(best.Instance == ~0u)
+		return false;
+
+	*hit = best;
+	return true;
+}
+
+PickingScene::uint32 PickingScene::RaycastMany(const Ray* rays, uint32 count, Hit* hits, ThreadPool& pool)const
+{
+	std::atomic<uint32> hitCount{ 0 };
+
+	pool.ParallelFor(count, 256, [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		uint32 localHits = 0;
+		for(uint32 k = begin; k < end; ++k)
+		{
+			if(Raycast(rays[k].Origin, rays[k].Direction, &hits[k]))
+				++localHits;
+			else
+				hits[k] = Hit();
+		}
+		hitCount += localHits;
+	});
+
+	return hitCount;
+}
+
+PickingScene::BenchmarkResult PickingScene::Benchmark(const PickingScene& scene, uint32 rayCount, ThreadPool& pool)
+{
+	BoundingBox bounds = scene.GetBounds();
+	float radius = 2.0f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents))) + 1.0f;
+
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<Ray> rays(rayCount);
+	for(auto& ray : rays)
+	{
+		// Start on a sphere around the scene and aim at a random point inside its bounds.
+		XMVECTOR onSphere;
+		do
+		{
+			onSphere = XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f);
+		} while(XMVectorGetX(XMVector3LengthSq(onSphere)) < 1e-4f);
+		onSphere = XMVector3Normalize(onSphere);
+
+		XMVECTOR center = XMLoadFloat3(&bounds.Center);
+		XMVECTOR target = XMVectorAdd(center, XMVectorMultiply(XMLoadFloat3(&bounds.Extents),
+			XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f)));
+		XMVECTOR origin = XMVectorAdd(center, XMVectorScale(onSphere, radius));
+
+		XMStoreFloat3(&ray.Origin, origin);
+		XMStoreFloat3(&ray.Direction, XMVector3Normalize(XMVectorSubtract(target, origin)));
+	}
+
+	std::vector<Hit> hits(rayCount);
+
+	BenchmarkResult result;
+	result.RayCount = rayCount;
+
+	auto start = std::chrono::steady_clock::now();
+	result.HitCount = scene.RaycastMany(rays.data(), rayCount, hits.data(), pool);
+	result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	return result;
+}
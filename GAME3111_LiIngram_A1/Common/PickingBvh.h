@@ -0,0 +1,201 @@
+//***************************************************************************************
+// PickingBvh.h
+//
+// Two level bounding volume hierarchy for CPU ray picking.
+//
+// TriangleBvh is built once per mesh (typically one submesh of a MeshGeometry) from its
+// CPU side positions and indices.  Nodes are split with the surface area heuristic over
+// a fixed number of centroid bins, and leaves keep a private copy of their triangles in
+// traversal order.  PickingScene places meshes in the world as instances and builds a
+// second, much smaller BVH over the instances' world space boxes.  A ray walks the top
+// level, is moved into each candidate instance's local space, and walks that mesh's
+// triangle BVH.
+//
+// Ray/box and ray/triangle tests use XMVECTOR.  Mesh BVHs build in parallel on the
+// thread pool, and every query is const so picks can run from any number of threads.
+//***************************************************************************************
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <DirectXCollision.h>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+struct TriangleHit
+{
+	float Distance = FLT_MAX;
+
+	// Index of the triangle in the mesh's index list (first index / 3).
+	std::uint32_t Triangle = ~0u;
+
+	// Barycentric weights of the triangle's second and third vertices; the first vertex
+	// has weight 1 - U - V.
+	float U = 0.0f;
+	float V = 0.0f;
+};
+
+class TriangleBvh
+{
+public:
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	struct BuildStats
+	{
+		uint32 TriangleCount = 0;
+		uint32 NodeCount = 0;
+		uint32 LeafCount = 0;
+		uint32 MaxDepth = 0;
+		double Milliseconds = 0.0;
+	};
+
+	///<summary>
+	/// Builds from an indexed triangle list.  positions points at the first vertex the
+	/// indices are relative to (i.e. already offset by the submesh's BaseVertexLocation)
+	/// and consecutive vertices are stride bytes apart.
+	///</summary>
+	void Build(const DirectX::XMFLOAT3* positions, uint32 stride, const uint16* indices, uint32 indexCount);
+	void Build(const DirectX::XMFLOAT3* positions, uint32 stride, const uint32* indices, uint32 indexCount);
+
+	///<summary>
+	/// Nearest triangle hit closer than maxDistance, testing both faces.  The direction
+	/// does not need to be normalized; the distance is in units of it.
+	///</summary>
+	bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance, TriangleHit* hit)const;
+
+	DirectX::BoundingBox GetBounds()const;
+	uint32 TriangleCount()const;
+	const BuildStats& GetStats()const;
+
+	// Flat node layout shared with PickingScene's top level.  Leaves (Count > 0) cover
+	// Count primitives starting at LeftOrFirst; interior nodes have their two children
+	// at LeftOrFirst and LeftOrFirst + 1.
+	struct Node
+	{
+		DirectX::XMFLOAT3 Min;
+		uint32 LeftOrFirst;
+		DirectX::XMFLOAT3 Max;
+		uint32 Count;
+	};
+
+private:
+	template<typename TIndex>
+	void BuildFromIndices(const DirectX::XMFLOAT3* positions, uint32 stride, const TIndex* indices, uint32 indexCount);
+
+private:
+	std::vector<Node> mNodes;
+
+	// Three corners per triangle and the triangle's original index, both in leaf order.
+	std::vector<DirectX::XMFLOAT3> mCorners;
+	std::vector<uint32> mTriangleIds;
+
+	BuildStats mStats;
+};
+
+class PickingScene
+{
+public:
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Direction = { 0.0f, 0.0f, 1.0f };
+	};
+
+	struct Hit
+	{
+		uint32 Instance = ~0u;
+		uint32 Mesh = ~0u;
+		TriangleHit Triangle;
+	};
+
+	struct Stats
+	{
+		uint32 MeshCount = 0;
+		uint32 InstanceCount = 0;
+		uint32 TriangleCount = 0;           // over all meshes, not instances
+		double MeshBuildMilliseconds = 0.0; // wall clock time of the parallel mesh builds
+		double TopLevelBuildMilliseconds = 0.0;
+	};
+
+	struct BenchmarkResult
+	{
+		uint32 RayCount = 0;
+		uint32 HitCount = 0;
+		double Milliseconds = 0.0;
+
+		double RaysPerSecond()const;
+	};
+
+	///<summary>
+	/// Registers a mesh and returns its index.  The position and index data are referenced,
+	/// not copied, until the next Build.
+	///</summary>
+	uint32 AddMesh(const DirectX::XMFLOAT3* positions, uint32 stride, const uint16* indices, uint32 indexCount);
+	uint32 AddMesh(const DirectX::XMFLOAT3* positions, uint32 stride, const uint32* indices, uint32 indexCount);
+
+	// Places a mesh in the world and returns the instance index.
+	uint32 AddInstance(uint32 mesh, const DirectX::XMFLOAT4X4& world);
+
+	// Moves an instance.  Takes effect at the next BuildTopLevel.
+	void SetInstanceWorld(uint32 instance, const DirectX::XMFLOAT4X4& world);
+
+	// Builds the meshes added since the last Build in parallel, then the top level.
+	void Build(ThreadPool& pool = ThreadPool::Get());
+
+	// Rebuilds only the hierarchy over the instances; cheap enough to run every frame.
+	void BuildTopLevel();
+
+	uint32 MeshCount()const;
+	uint32 InstanceCount()const;
+	const TriangleBvh& GetMesh(uint32 mesh)const;
+	DirectX::BoundingBox GetBounds()const;
+	const Stats& GetStats()const;
+
+	// Nearest hit over all instances closer than maxDistance.
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& dir, Hit* hit,
+		float maxDistance = FLT_MAX)const;
+
+	// Casts many rays on the pool; hits[i].Instance is ~0u where rays[i] missed.
+	uint32 RaycastMany(const Ray* rays, uint32 count, Hit* hits, ThreadPool& pool = ThreadPool::Get())const;
+
+	///<summary>
+	/// Casts rayCount pseudo-random rays from a sphere around the scene toward points
+	/// inside its bounds and times them with RaycastMany.
+	///</summary>
+	static BenchmarkResult Benchmark(const PickingScene& scene, uint32 rayCount,
+		ThreadPool& pool = ThreadPool::Get());
+
+private:
+	struct PendingMesh
+	{
+		const DirectX::XMFLOAT3* Positions;
+		uint32 Stride;
+		const void* Indices;
+		bool Indices16;
+		uint32 IndexCount;
+	};
+
+	struct Instance
+	{
+		uint32 Mesh;
+		DirectX::XMFLOAT4X4 World;
+		DirectX::XMFLOAT4X4 InvWorld;
+	};
+
+private:
+	std::vector<TriangleBvh> mMeshes;
+	std::vector<PendingMesh> mPending;
+	uint32 mBuiltMeshCount = 0;
+
+	std::vector<Instance> mInstances;
+
+	std::vector<TriangleBvh::Node> mTopNodes;
+	std::vector<uint32> mTopOrder;
+
+	Stats mStats;
+};
@@ -0,0 +1,376 @@
+//***************************************************************************************
+// PsoCache.cpp
+//***************************************************************************************
+
+#include "PsoCache.h"
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	const std::uint64_t FnvOffsetBasis = 14695981039346656037ull;
+
+	// 64 bit FNV-1a.
+	std::uint64_t Fnv1a(const void* data, size_t size, std::uint64_t hash = FnvOffsetBasis)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		for(size_t i = 0; i < size; ++i)
+			hash = (hash ^ p[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	// Appends a description's fields to a byte string.  Only ever fed whole scalar fields,
+	// never structs, so padding bytes cannot leak into it, and variable length data is
+	// preceded by its length, so two different descriptions never write the same bytes.
+	class DescriptionWriter
+	{
+	public:
+		explicit DescriptionWriter(std::vector<unsigned char>& bytes)
+			: mBytes(bytes)
+		{
+		}
+
+		void Bytes(const void* data, size_t size)
+		{
+			const unsigned char* p = static_cast<const unsigned char*>(data);
+			mBytes.insert(mBytes.end(), p, p + size);
+		}
+
+		template<typename T>
+		void Value(const T& value)
+		{
+			static_assert(std::is_scalar<T>::value, "write fields one at a time");
+			Bytes(&value, sizeof(T));
+		}
+
+		void String(const char* s)
+		{
+			size_t length = s != nullptr ? strlen(s) : 0;
+			Value(length);
+			Bytes(s, length);
+		}
+
+	private:
+		std::vector<unsigned char>& mBytes;
+	};
+
+	void WriteShader(DescriptionWriter& w, const D3D12_SHADER_BYTECODE& shader)
+	{
+		size_t length = shader.pShaderBytecode != nullptr ? shader.BytecodeLength : 0;
+		w.Value(length);
+		w.Bytes(shader.pShaderBytecode, length);
+	}
+
+	void WriteStencilOp(DescriptionWriter& w, const D3D12_DEPTH_STENCILOP_DESC& op)
+	{
+		w.Value(op.StencilFailOp);
+		w.Value(op.StencilDepthFailOp);
+		w.Value(op.StencilPassOp);
+		w.Value(op.StencilFunc);
+	}
+
+	PsoCache::Key KeyOf(std::uint64_t rootSignatureHash, const std::vector<unsigned char>& description)
+	{
+		return Fnv1a(description.data(), description.size(), Fnv1a(&rootSignatureHash, sizeof(rootSignatureHash)));
+	}
+
+	std::wstring LibraryName(PsoCache::Key key)
+	{
+		wchar_t name[17];
+		swprintf_s(name, L"%016llx", (unsigned long long)key);
+		return name;
+	}
+
+	// Everything in desc but the root signature, which the caller accounts for.
+	void Describe(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::vector<unsigned char>& bytes)
+	{
+		DescriptionWriter w(bytes);
+
+		WriteShader(w, desc.VS);
+		WriteShader(w, desc.PS);
+		WriteShader(w, desc.DS);
+		WriteShader(w, desc.HS);
+		WriteShader(w, desc.GS);
+
+		const D3D12_STREAM_OUTPUT_DESC& so = desc.StreamOutput;
+		w.Value(so.NumEntries);
+		for(UINT i = 0; i < so.NumEntries; ++i)
+		{
+			const D3D12_SO_DECLARATION_ENTRY& e = so.pSODeclaration[i];
+			w.Value(e.Stream);
+			w.String(e.SemanticName);
+			w.Value(e.SemanticIndex);
+			w.Value(e.StartComponent);
+			w.Value(e.ComponentCount);
+			w.Value(e.OutputSlot);
+		}
+		w.Value(so.NumStrides);
+		for(UINT i = 0; i < so.NumStrides; ++i)
+			w.Value(so.pBufferStrides[i]);
+		w.Value(so.RasterizedStream);
+
+		const D3D12_BLEND_DESC& blend = desc.BlendState;
+		w.Value(blend.AlphaToCoverageEnable);
+		w.Value(blend.IndependentBlendEnable);
+		for(const D3D12_RENDER_TARGET_BLEND_DESC& rt : blend.RenderTarget)
+		{
+			w.Value(rt.BlendEnable);
+			w.Value(rt.LogicOpEnable);
+			w.Value(rt.SrcBlend);
+			w.Value(rt.DestBlend);
+			w.Value(rt.BlendOp);
+			w.Value(rt.SrcBlendAlpha);
+			w.Value(rt.DestBlendAlpha);
+			w.Value(rt.BlendOpAlpha);
+			w.Value(rt.LogicOp);
+			w.Value(rt.RenderTargetWriteMask);
+		}
+
+		w.Value(desc.SampleMask);
+
+		const D3D12_RASTERIZER_DESC& raster = desc.RasterizerState;
+		w.Value(raster.FillMode);
+		w.Value(raster.CullMode);
+		w.Value(raster.FrontCounterClockwise);
+		w.Value(raster.DepthBias);
+		w.Value(raster.DepthBiasClamp);
+		w.Value(raster.SlopeScaledDepthBias);
+		w.Value(raster.DepthClipEnable);
+		w.Value(raster.MultisampleEnable);
+		w.Value(raster.AntialiasedLineEnable);
+		w.Value(raster.ForcedSampleCount);
+		w.Value(raster.ConservativeRaster);
+
+		const D3D12_DEPTH_STENCIL_DESC& depth = desc.DepthStencilState;
+		w.Value(depth.DepthEnable);
+		w.Value(depth.DepthWriteMask);
+		w.Value(depth.DepthFunc);
+		w.Value(depth.StencilEnable);
+		w.Value(depth.StencilReadMask);
+		w.Value(depth.StencilWriteMask);
+		WriteStencilOp(w, depth.FrontFace);
+		WriteStencilOp(w, depth.BackFace);
+
+		const D3D12_INPUT_LAYOUT_DESC& layout = desc.InputLayout;
+		w.Value(layout.NumElements);
+		for(UINT i = 0; i < layout.NumElements; ++i)
+		{
+			const D3D12_INPUT_ELEMENT_DESC& e = layout.pInputElementDescs[i];
+			w.String(e.SemanticName);
+			w.Value(e.SemanticIndex);
+			w.Value(e.Format);
+			w.Value(e.InputSlot);
+			w.Value(e.AlignedByteOffset);
+			w.Value(e.InputSlotClass);
+			w.Value(e.InstanceDataStepRate);
+		}
+
+		w.Value(desc.IBStripCutValue);
+		w.Value(desc.PrimitiveTopologyType);
+
+		// Formats past NumRenderTargets are ignored by D3D12, so they are not written either.
+		w.Value(desc.NumRenderTargets);
+		for(UINT i = 0; i < desc.NumRenderTargets && i < 8; ++i)
+			w.Value(desc.RTVFormats[i]);
+		w.Value(desc.DSVFormat);
+
+		w.Value(desc.SampleDesc.Count);
+		w.Value(desc.SampleDesc.Quality);
+		w.Value(desc.NodeMask);
+		w.Value(desc.Flags);
+
+		// CachedPSO is how the PSO is built, not what it is, so it is left out.
+	}
+}
+
+PsoCache::PsoCache(ID3D12Device* device, const std::wstring& libraryFile)
+	: mDevice(device), mLibraryFile(libraryFile)
+{
+	if(!mLibraryFile.empty())
+		OpenLibrary();
+}
+
+void PsoCache::OpenLibrary()
+{
+	ComPtr<ID3D12Device1> device1;
+	if(FAILED(mDevice->QueryInterface(IID_PPV_ARGS(device1.GetAddressOf()))))
+		return;
+
+	std::ifstream fin(mLibraryFile, std::ios::binary);
+	if(fin)
+	{
+		fin.seekg(0, std::ios_base::end);
+		mLibraryData.resize((size_t)fin.tellg());
+		fin.seekg(0, std::ios_base::beg);
+		fin.read(mLibraryData.data(), mLibraryData.size());
+	}
+
+	// A blob from another driver or adapter is refused; start a new one.
+	if(mLibraryData.empty() || FAILED(device1->CreatePipelineLibrary(mLibraryData.data(), mLibraryData.size(),
+		IID_PPV_ARGS(mLibrary.GetAddressOf()))))
+	{
+		mLibraryData.clear();
+		mLibrary = nullptr;
+		if(FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(mLibrary.GetAddressOf()))))
+			mLibrary = nullptr;
+	}
+}
+
+PsoCache::Key PsoCache::Hash(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64 rootSignatureHash)
+{
+	std::vector<unsigned char> description;
+	Describe(desc, description);
+
+	return KeyOf(rootSignatureHash, description);
+}
+
+PsoCache::uint64 PsoCache::HashRootSignature(const void* blob, size_t blobSize)
+{
+	return Fnv1a(blob, blobSize);
+}
+
+void PsoCache::RegisterRootSignature(ID3D12RootSignature* rootSignature, const void* blob, size_t blobSize)
+{
+	mRootSignatures[rootSignature] = HashRootSignature(blob, blobSize);
+}
+
+PsoCache::Key PsoCache::Request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	++mStats.Requests;
+
+	std::vector<unsigned char> description;
+	Describe(desc, description);
+
+	// An unregistered root signature can only be told apart by its address, which is no
+	// use as a name in the next run's library.
+	auto rootSignature = mRootSignatures.find(desc.pRootSignature);
+	bool persistent = rootSignature != mRootSignatures.end();
+	uint64 rootSignatureHash = persistent ? rootSignature->second : (uint64)(std::uintptr_t)desc.pRootSignature;
+
+	Key key = KeyOf(rootSignatureHash, description);
+
+	// The hash only finds the candidate; the full description decides.  Probing makes the
+	// key depend on request order, so a probed entry stays out of the library.
+	for(auto it = mEntryIndex.find(key); it != mEntryIndex.end(); it = mEntryIndex.find(key))
+	{
+		const Entry& existing = mEntries[it->second];
+		if(existing.Desc.pRootSignature == desc.pRootSignature && existing.Description == description)
+			return key;
+
+		++mStats.HashCollisions;
+		persistent = false;
+		++key;
+	}
+
+	Entry entry;
+	entry.Hash = key;
+	entry.Desc = desc;
+	entry.Desc.CachedPSO = {};
+	entry.Description = std::move(description);
+	entry.Persistent = persistent;
+
+	mEntryIndex[key] = (uint32)mEntries.size();
+	mPending.push_back((uint32)mEntries.size());
+	mEntries.push_back(std::move(entry));
+	++mStats.Entries;
+
+	return key;
+}
+
+void PsoCache::Compile(ThreadPool& pool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<char> created(mPending.size(), 0);
+	std::vector<HRESULT> results(mPending.size(), S_OK);
+
+	// CreateGraphicsPipelineState is free threaded, and so are library loads as long as no
+	// two threads load the same name, which distinct keys guarantee.  Stores happen below,
+	// on this thread only.  Failures are only recorded here and thrown once the loop is
+	// over, on the calling thread, where the app's DxException handler can report them.
+	pool.ParallelFor((uint32)mPending.size(), 1, [&](uint32 begin, uint32 end, uint32)
+	{
+		for(uint32 i = begin; i < end; ++i)
+		{
+			Entry& entry = mEntries[mPending[i]];
+
+			if(mLibrary != nullptr && entry.Persistent && SUCCEEDED(mLibrary->LoadGraphicsPipeline(
+				LibraryName(entry.Hash).c_str(), &entry.Desc, IID_PPV_ARGS(entry.Pso.GetAddressOf()))))
+				continue;
+
+			results[i] = mDevice->CreateGraphicsPipelineState(&entry.Desc, IID_PPV_ARGS(entry.Pso.GetAddressOf()));
+			created[i] = SUCCEEDED(results[i]) ? 1 : 0;
+		}
+	});
+
+	// Failed entries stay pending; the rest are done either way.
+	std::vector<uint32> failed;
+	HRESULT createPipelineStateResult = S_OK;
+
+	for(size_t i = 0; i < mPending.size(); ++i)
+	{
+		Entry& entry = mEntries[mPending[i]];
+		if(FAILED(results[i]))
+		{
+			if(failed.empty())
+				createPipelineStateResult = results[i];
+			failed.push_back(mPending[i]);
+			continue;
+		}
+
+		if(!created[i])
+		{
+			++mStats.LoadedFromLibrary;
+			continue;
+		}
+
+		++mStats.Compiled;
+		if(mLibrary != nullptr && entry.Persistent && SUCCEEDED(mLibrary->StorePipeline(LibraryName(entry.Hash).c_str(), entry.Pso.Get())))
+		{
+			++mStats.StoredToLibrary;
+			mLibraryDirty = true;
+		}
+	}
+
+	mPending = std::move(failed);
+	mStats.CompileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	ThrowIfFailed(createPipelineStateResult);
+}
+
+ID3D12PipelineState* PsoCache::Get(Key key)const
+{
+	auto it = mEntryIndex.find(key);
+	return it != mEntryIndex.end() ? mEntries[it->second].Pso.Get() : nullptr;
+}
+
+bool PsoCache::SaveLibrary()
+{
+	if(mLibrary == nullptr || !mLibraryDirty)
+		return false;
+
+	std::vector<char> data(mLibrary->GetSerializedSize());
+	if(FAILED(mLibrary->Serialize(data.data(), data.size())))
+		return false;
+
+	std::ofstream fout(mLibraryFile, std::ios::binary);
+	fout.write(data.data(), data.size());
+	if(!fout)
+		return false;
+
+	mLibraryDirty = false;
+	return true;
+}
+
+PsoCache::uint32 PsoCache::EntryCount()const
+{
+	return (uint32)mEntries.size();
+}
+
+const PsoCache::Stats& PsoCache::GetStats()const
+{
+	return mStats;
+}
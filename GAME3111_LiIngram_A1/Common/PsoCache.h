@@ -0,0 +1,110 @@
+//***************************************************************************************
+// PsoCache.h
+//
+// Graphics pipeline state objects keyed by a 64 bit hash of their full description.
+//
+// Request writes a D3D12_GRAPHICS_PIPELINE_STATE_DESC out field by field into a canonical
+// byte string: shader bytecode and input layout semantic names by content, everything
+// else by value.  The root signature stands in as the hash of its serialized blob when it
+// was registered with RegisterRootSignature, and as its address otherwise.  The key is
+// the hash of the two.  A request whose key is taken is only merged with that entry when
+// the byte strings and root signatures are equal too; a different description moves on
+// to the next free key.  Compile then creates every pending entry in parallel on the
+// thread pool.
+//
+// With a library file, compiled PSOs are also stored in an ID3D12PipelineLibrary under
+// their key, which is why the key must not depend on anything that changes between runs.
+// Only entries with a registered root signature and a key of their own (not one found by
+// probing past a collision) use the library.  The next run loads them from it instead of
+// compiling, until the driver changes and the old blob is refused, in which case the
+// library starts over empty.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "ThreadPool.h"
+
+class PsoCache
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+	using Key = uint64;
+
+	struct Stats
+	{
+		uint32 Requests = 0;
+		uint32 Entries = 0;             // distinct descriptions
+		uint32 Compiled = 0;            // created with CreateGraphicsPipelineState
+		uint32 LoadedFromLibrary = 0;
+		uint32 StoredToLibrary = 0;
+		uint32 HashCollisions = 0;      // requests that had to probe past a different description
+		double CompileMilliseconds = 0.0;   // wall clock time of the last Compile
+	};
+
+	// libraryFile may be empty to run without a pipeline library.
+	explicit PsoCache(ID3D12Device* device, const std::wstring& libraryFile = L"");
+	PsoCache(const PsoCache& rhs) = delete;
+	PsoCache& operator=(const PsoCache& rhs) = delete;
+
+	// Key of desc when its root signature hashes to rootSignatureHash.
+	static Key Hash(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64 rootSignatureHash);
+
+	// Hash of a serialized root signature, as RegisterRootSignature stores it.
+	static uint64 HashRootSignature(const void* blob, size_t blobSize);
+
+	///<summary>
+	/// Identifies rootSignature by the blob it was created from, so PSOs using it get the
+	/// same key in every run and can go through the pipeline library.  Register before
+	/// requesting PSOs that use it.
+	///</summary>
+	void RegisterRootSignature(ID3D12RootSignature* rootSignature, const void* blob, size_t blobSize);
+
+	///<summary>
+	/// Returns the key for desc, adding an entry if it is new.  Everything desc points to
+	/// (shaders, input layout, root signature) must stay alive until Compile returns.
+	///</summary>
+	Key Request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+	// Creates every requested PSO that does not exist yet.  If any creation fails, the
+	// others are still kept, the failed ones stay pending, and the first failure is thrown
+	// as a DxException on the calling thread.
+	void Compile(ThreadPool& pool = ThreadPool::Get());
+
+	// nullptr until the key has been compiled.
+	ID3D12PipelineState* Get(Key key)const;
+
+	// Writes the pipeline library to the library file if anything was added to it.
+	bool SaveLibrary();
+
+	uint32 EntryCount()const;
+	const Stats& GetStats()const;
+
+private:
+	struct Entry
+	{
+		Key Hash;
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+		std::vector<unsigned char> Description;   // canonical bytes of Desc, root signature aside
+		bool Persistent;                          // loaded from and stored to the library
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> Pso;
+	};
+
+	void OpenLibrary();
+
+private:
+	ID3D12Device* mDevice;
+
+	std::vector<Entry> mEntries;
+	std::unordered_map<Key, uint32> mEntryIndex;
+	std::vector<uint32> mPending;
+	std::unordered_map<ID3D12RootSignature*, uint64> mRootSignatures;
+
+	std::wstring mLibraryFile;
+	std::vector<char> mLibraryData;   // must outlive mLibrary
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> mLibrary;
+	bool mLibraryDirty = false;
+
+	Stats mStats;
+};
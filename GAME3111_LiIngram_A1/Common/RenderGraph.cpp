@@ -0,0 +1,521 @@
+//***************************************************************************************
+// RenderGraph.cpp
+//***************************************************************************************
+
+#include "RenderGraph.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <random>
+
+namespace
+{
+	RenderGraph::uint64 AlignUp(RenderGraph::uint64 value, RenderGraph::uint64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool IsReadOnly(RenderGraph::States state)
+	{
+		return state != ResourceState::Common && (state & ~ResourceState::ReadOnlyMask) == 0;
+	}
+}
+
+const RenderGraph::uint32 RenderGraph::InvalidHandle;
+const RenderGraph::uint64 RenderGraph::DefaultAlignment;
+
+double RenderGraph::BenchmarkResult::CompilesPerSecond()const
+{
+	return Milliseconds > 0.0 ? Iterations * 1000.0 / Milliseconds : 0.0;
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportResource(const std::string& name, States initialState, States finalState)
+{
+	Resource r;
+	r.Name = name;
+	r.Imported = true;
+	r.InitialState = initialState;
+	r.FinalState = finalState;
+	mResources.push_back(r);
+
+	return (ResourceHandle)mResources.size() - 1;
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTransient(const std::string& name, uint64 sizeInBytes, uint64 alignment)
+{
+	assert(alignment > 0);
+
+	Resource r;
+	r.Name = name;
+	r.Size = sizeInBytes;
+	r.Alignment = alignment;
+	mResources.push_back(r);
+
+	return (ResourceHandle)mResources.size() - 1;
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(const std::string& name, std::function<void()> execute)
+{
+	Pass p;
+	p.Name = name;
+	p.Execute = std::move(execute);
+	mPasses.push_back(std::move(p));
+
+	return (PassHandle)mPasses.size() - 1;
+}
+
+void RenderGraph::Read(PassHandle pass, ResourceHandle resource, States state)
+{
+	AddAccess(pass, resource, state, false);
+}
+
+void RenderGraph::Write(PassHandle pass, ResourceHandle resource, States state)
+{
+	AddAccess(pass, resource, state, true);
+}
+
+void RenderGraph::AddAccess(PassHandle pass, ResourceHandle resource, States state, bool write)
+{
+	assert(pass < mPasses.size() && resource < mResources.size());
+
+	for(auto& a : mPasses[pass].Accesses)
+	{
+		if(a.Resource == resource)
+		{
+			a.State |= state;
+			a.Write = a.Write || write;
+			return;
+		}
+	}
+
+	mPasses[pass].Accesses.push_back({ resource, state, write });
+}
+
+void RenderGraph::SetSideEffects(PassHandle pass)
+{
+	mPasses[pass].SideEffects = true;
+}
+
+void RenderGraph::Clear()
+{
+	mPasses.clear();
+	mResources.clear();
+	mLive.clear();
+	mBarriers.clear();
+	mBatches.clear();
+	mStats = Stats();
+}
+
+void RenderGraph::Compile()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	mStats = Stats();
+	mStats.PassCount = (uint32)mPasses.size();
+	mStats.ResourceCount = (uint32)mResources.size();
+
+	CullPasses();
+	PlaceTransients();
+	BuildBarriers();
+
+	mStats.CompileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RenderGraph::CullPasses()
+{
+	const uint32 passCount = (uint32)mPasses.size();
+	const uint32 resourceCount = (uint32)mResources.size();
+
+	// Walk backwards from the imported resources: a pass is needed when it writes
+	// something that is needed, and then everything it reads is needed too.
+	std::vector<bool> needed(resourceCount);
+	for(uint32 r = 0; r < resourceCount; ++r)
+		needed[r] = mResources[r].Imported;
+
+	mLive.assign(passCount, false);
+	for(uint32 p = passCount; p-- > 0;)
+	{
+		const Pass& pass = mPasses[p];
+
+		bool live = pass.SideEffects;
+		for(const auto& a : pass.Accesses)
+			live = live || (a.Write && needed[a.Resource]);
+
+		if(!live)
+		{
+			++mStats.CulledPassCount;
+			continue;
+		}
+
+		mLive[p] = true;
+		for(const auto& a : pass.Accesses)
+		{
+			if(!a.Write)
+				needed[a.Resource] = true;
+		}
+	}
+
+	mFirstUse.assign(resourceCount, InvalidHandle);
+	mLastUse.assign(resourceCount, InvalidHandle);
+	for(uint32 p = 0; p < passCount; ++p)
+	{
+		if(!mLive[p])
+			continue;
+
+		for(const auto& a : mPasses[p].Accesses)
+		{
+			if(mFirstUse[a.Resource] == InvalidHandle)
+				mFirstUse[a.Resource] = p;
+			mLastUse[a.Resource] = p;
+		}
+	}
+}
+
+void RenderGraph::PlaceTransients()
+{
+	const uint32 resourceCount = (uint32)mResources.size();
+
+	mHeapOffsets.assign(resourceCount, 0);
+	mAliased.assign(resourceCount, false);
+	mAliasBefore.assign(resourceCount, InvalidHandle);
+
+	std::vector<ResourceHandle> order;
+	for(uint32 r = 0; r < resourceCount; ++r)
+	{
+		if(!mResources[r].Imported && mFirstUse[r] != InvalidHandle)
+		{
+			order.push_back(r);
+			mStats.TransientBytes += mResources[r].Size;
+		}
+	}
+	mStats.TransientCount = (uint32)order.size();
+
+	// Biggest first, so the large resources claim the bottom of the heap and the small
+	// ones fill the gaps between them.
+	std::sort(order.begin(), order.end(), [&](ResourceHandle a, ResourceHandle b)
+	{
+		if(mResources[a].Size != mResources[b].Size)
+			return mResources[a].Size > mResources[b].Size;
+		return mFirstUse[a] < mFirstUse[b];
+	});
+
+	auto livesOverlap = [&](ResourceHandle a, ResourceHandle b)
+	{
+		return mFirstUse[a] <= mLastUse[b] && mFirstUse[b] <= mLastUse[a];
+	};
+
+	std::vector<ResourceHandle> placed;
+	std::vector<ResourceHandle> blocking;
+	uint64 heapSize = 0;
+
+	for(ResourceHandle r : order)
+	{
+		const Resource& res = mResources[r];
+
+		// Lowest offset that does not collide with anything alive at the same time.
+		blocking.clear();
+		for(ResourceHandle q : placed)
+		{
+			if(livesOverlap(q, r))
+				blocking.push_back(q);
+		}
+		std::sort(blocking.begin(), blocking.end(), [&](ResourceHandle a, ResourceHandle b)
+		{
+			return mHeapOffsets[a] < mHeapOffsets[b];
+		});
+
+		uint64 offset = 0;
+		for(ResourceHandle q : blocking)
+		{
+			if(AlignUp(offset, res.Alignment) + res.Size <= mHeapOffsets[q])
+				break;
+			offset = std::max(offset, mHeapOffsets[q] + mResources[q].Size);
+		}
+		offset = AlignUp(offset, res.Alignment);
+
+		mHeapOffsets[r] = offset;
+		heapSize = std::max(heapSize, offset + res.Size);
+		placed.push_back(r);
+	}
+
+	mStats.HeapBytes = heapSize;
+
+	// A transient needs an aliasing barrier when it takes over memory an earlier one used.
+	for(ResourceHandle r : placed)
+	{
+		uint64 begin = mHeapOffsets[r];
+		uint64 end = begin + mResources[r].Size;
+
+		for(ResourceHandle q : placed)
+		{
+			uint64 qBegin = mHeapOffsets[q];
+			uint64 qEnd = qBegin + mResources[q].Size;
+			if(mLastUse[q] >= mFirstUse[r] || qEnd <= begin || end <= qBegin)
+				continue;
+
+			mAliasBefore[r] = mAliased[r] ? InvalidHandle : q;
+			mAliased[r] = true;
+		}
+	}
+}
+
+void RenderGraph::BuildBarriers()
+{
+	const uint32 passCount = (uint32)mPasses.size();
+	const uint32 resourceCount = (uint32)mResources.size();
+
+	mBarriers.clear();
+	mBatches.clear();
+	mInitialStates.assign(resourceCount, ResourceState::Common);
+
+	// Every live access of each resource in pass order, for looking ahead over reads.
+	std::vector<std::vector<const Access*>> uses(resourceCount);
+	std::vector<std::vector<ResourceHandle>> lastUsedBy(passCount);
+	for(uint32 p = 0; p < passCount; ++p)
+	{
+		if(!mLive[p])
+			continue;
+
+		for(const auto& a : mPasses[p].Accesses)
+		{
+			uses[a.Resource].push_back(&a);
+			if(!mResources[a.Resource].Imported && mLastUse[a.Resource] == p)
+				lastUsedBy[p].push_back(a.Resource);
+		}
+	}
+
+	std::vector<uint32> cursor(resourceCount, 0);
+	std::vector<States> current(resourceCount);
+	std::vector<bool> touched(resourceCount, false);
+
+	// Union of the read states from the current use up to the next write.  Transitioning
+	// to all of them at once saves a barrier for each further reader.
+	auto readUnion = [&](ResourceHandle r)
+	{
+		States u = ResourceState::Common;
+		for(size_t k = cursor[r]; k < uses[r].size() && !uses[r][k]->Write; ++k)
+			u |= uses[r][k]->State;
+		return u;
+	};
+
+	auto transition = [&](ResourceHandle r, States before, States after)
+	{
+		Barrier b;
+		b.Type = Barrier::Kind::Transition;
+		b.Resource = r;
+		b.Before = before;
+		b.After = after;
+		mBarriers.push_back(b);
+	};
+
+	// Transients go back to the state they are created in once their last pass is done,
+	// before their memory is handed on, so every frame starts out the same.
+	auto restoreTransients = [&](PassHandle lastPass)
+	{
+		for(ResourceHandle r : lastUsedBy[lastPass])
+		{
+			if(current[r] != mInitialStates[r])
+				transition(r, current[r], mInitialStates[r]);
+		}
+	};
+
+	auto endBatch = [&](PassHandle pass, uint32 first)
+	{
+		uint32 count = (uint32)mBarriers.size() - first;
+		mBatches.push_back({ pass, first, count });
+		if(count > 0)
+			++mStats.BatchCount;
+	};
+
+	PassHandle previous = InvalidHandle;
+	for(uint32 p = 0; p < passCount; ++p)
+	{
+		if(!mLive[p])
+			continue;
+
+		uint32 first = (uint32)mBarriers.size();
+		if(previous != InvalidHandle)
+			restoreTransients(previous);
+
+		for(const auto& a : mPasses[p].Accesses)
+		{
+			if(mFirstUse[a.Resource] == p && mAliased[a.Resource])
+			{
+				Barrier b;
+				b.Type = Barrier::Kind::Aliasing;
+				b.Resource = a.Resource;
+				b.AliasBefore = mAliasBefore[a.Resource];
+				mBarriers.push_back(b);
+			}
+		}
+
+		for(const auto& a : mPasses[p].Accesses)
+		{
+			ResourceHandle r = a.Resource;
+			States needed = a.Write ? a.State : readUnion(r);
+			++cursor[r];
+
+			if(!touched[r])
+			{
+				touched[r] = true;
+				if(!mResources[r].Imported)
+				{
+					// Transients are created in the state of their first use.
+					current[r] = needed;
+					mInitialStates[r] = needed;
+					continue;
+				}
+				current[r] = mResources[r].InitialState;
+			}
+
+			if(a.Write)
+			{
+				if(current[r] != needed)
+				{
+					transition(r, current[r], needed);
+				}
+				else if(needed == ResourceState::UnorderedAccess)
+				{
+					Barrier b;
+					b.Type = Barrier::Kind::UnorderedAccess;
+					b.Resource = r;
+					mBarriers.push_back(b);
+				}
+				current[r] = needed;
+			}
+			else if(!IsReadOnly(current[r]) || (current[r] & a.State) != a.State)
+			{
+				transition(r, current[r], needed);
+				current[r] = needed;
+			}
+		}
+
+		endBatch(p, first);
+		previous = p;
+	}
+
+	// Final batch: the last pass's transients, then the imported resources.
+	uint32 first = (uint32)mBarriers.size();
+	if(previous != InvalidHandle)
+		restoreTransients(previous);
+
+	for(uint32 r = 0; r < resourceCount; ++r)
+	{
+		const Resource& res = mResources[r];
+		if(!res.Imported)
+			continue;
+
+		mInitialStates[r] = res.InitialState;
+
+		States state = touched[r] ? current[r] : res.InitialState;
+		if(state != res.FinalState)
+			transition(r, state, res.FinalState);
+	}
+	endBatch(InvalidHandle, first);
+
+	mStats.BarrierCount = (uint32)mBarriers.size();
+}
+
+void RenderGraph::Execute(const BarrierFunc& submitBarriers)const
+{
+	for(const Batch& batch : mBatches)
+	{
+		if(batch.Count > 0)
+			submitBarriers(&mBarriers[batch.First], batch.Count);
+
+		if(batch.Pass != InvalidHandle && mPasses[batch.Pass].Execute)
+			mPasses[batch.Pass].Execute();
+	}
+}
+
+RenderGraph::uint32 RenderGraph::PassCount()const
+{
+	return (uint32)mPasses.size();
+}
+
+RenderGraph::uint32 RenderGraph::ResourceCount()const
+{
+	return (uint32)mResources.size();
+}
+
+const std::string& RenderGraph::GetPassName(PassHandle pass)const
+{
+	return mPasses[pass].Name;
+}
+
+const std::string& RenderGraph::GetResourceName(ResourceHandle resource)const
+{
+	return mResources[resource].Name;
+}
+
+bool RenderGraph::IsPassCulled(PassHandle pass)const
+{
+	return !mLive[pass];
+}
+
+RenderGraph::States RenderGraph::GetInitialState(ResourceHandle resource)const
+{
+	return mInitialStates[resource];
+}
+
+RenderGraph::uint64 RenderGraph::GetHeapOffset(ResourceHandle resource)const
+{
+	assert(!mResources[resource].Imported);
+	return mHeapOffsets[resource];
+}
+
+RenderGraph::uint64 RenderGraph::GetHeapSize()const
+{
+	return mStats.HeapBytes;
+}
+
+const RenderGraph::Stats& RenderGraph::GetStats()const
+{
+	return mStats;
+}
+
+RenderGraph::BenchmarkResult RenderGraph::Benchmark(uint32 passCount, uint32 iterations)
+{
+	const uint64 megabyte = 1024 * 1024;
+
+	std::mt19937 rng(12345);
+
+	RenderGraph graph;
+	ResourceHandle backBuffer = graph.ImportResource("BackBuffer", ResourceState::Present, ResourceState::Present);
+
+	std::vector<ResourceHandle> outputs;
+	for(uint32 i = 0; i < passCount; ++i)
+	{
+		PassHandle pass = graph.AddPass("Pass" + std::to_string(i));
+
+		// Read recent outputs only, so lifetimes stay short as in a real frame.
+		uint32 window = std::min((uint32)outputs.size(), 8u);
+		uint32 readCount = std::min(window, 1 + (uint32)(rng() % 3));
+		for(uint32 k = 0; k < readCount; ++k)
+		{
+			ResourceHandle input = outputs[outputs.size() - 1 - rng() % window];
+			graph.Read(pass, input, (rng() & 1) ? ResourceState::PixelShaderResource :
+				ResourceState::NonPixelShaderResource);
+		}
+
+		ResourceHandle output = graph.CreateTransient("Target" + std::to_string(i), (1 + rng() % 16) * megabyte);
+		graph.Write(pass, output, (rng() % 4 == 0) ? ResourceState::UnorderedAccess : ResourceState::RenderTarget);
+		outputs.push_back(output);
+	}
+
+	PassHandle composite = graph.AddPass("Composite");
+	if(!outputs.empty())
+		graph.Read(composite, outputs.back(), ResourceState::PixelShaderResource);
+	graph.Write(composite, backBuffer, ResourceState::RenderTarget);
+
+	BenchmarkResult result;
+	result.Iterations = iterations;
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32 i = 0; i < iterations; ++i)
+		graph.Compile();
+	result.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	result.LastStats = graph.GetStats();
+	return result;
+}
@@ -0,0 +1,217 @@
+//***************************************************************************************
+// RenderGraph.h
+//
+// Frame graph of render passes.  Each pass declares the resources it reads and writes and
+// the state it needs them in; Compile then works out everything that used to be written
+// by hand in Draw:
+//
+//  - passes whose output nobody reads are culled;
+//  - state transitions are derived from the declared accesses and emitted as one batch
+//    per pass, and consecutive read-only uses are merged into a single transition to the
+//    union of their read states;
+//  - transient resources (created and consumed within the frame) are placed in a shared
+//    heap by lifetime, so resources that are never alive at the same time share memory,
+//    with the aliasing barriers that requires.
+//
+// The graph only deals in handles, sizes and states and never touches Direct3D, so it can
+// be compiled and benchmarked headless.  Passes run in the order they were added.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Resource states.  The values match D3D12_RESOURCE_STATES so a D3D12 backend can cast
+// them directly.  Read-only states may be combined with |.
+namespace ResourceState
+{
+	enum : std::uint32_t
+	{
+		Common = 0,
+		Present = 0,
+		VertexAndConstantBuffer = 0x1,
+		IndexBuffer = 0x2,
+		RenderTarget = 0x4,
+		UnorderedAccess = 0x8,
+		DepthWrite = 0x10,
+		DepthRead = 0x20,
+		NonPixelShaderResource = 0x40,
+		PixelShaderResource = 0x80,
+		IndirectArgument = 0x200,
+		CopyDest = 0x400,
+		CopySource = 0x800,
+
+		ReadOnlyMask = VertexAndConstantBuffer | IndexBuffer | DepthRead | NonPixelShaderResource |
+			PixelShaderResource | IndirectArgument | CopySource
+	};
+}
+
+class RenderGraph
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+	using States = std::uint32_t;
+	using ResourceHandle = uint32;
+	using PassHandle = uint32;
+
+	static const uint32 InvalidHandle = ~0u;
+
+	// Placement alignment of transient resources; 64KB is the D3D12 default for buffers and
+	// non-MSAA textures.
+	static const uint64 DefaultAlignment = 64 * 1024;
+
+	struct Barrier
+	{
+		enum class Kind
+		{
+			Transition,
+			Aliasing,
+			UnorderedAccess
+		};
+
+		Kind Type = Kind::Transition;
+		ResourceHandle Resource = InvalidHandle;
+
+		// Aliasing only: the resource that last used the memory, or InvalidHandle when
+		// several did.
+		ResourceHandle AliasBefore = InvalidHandle;
+
+		// Transition only.
+		States Before = ResourceState::Common;
+		States After = ResourceState::Common;
+	};
+
+	struct Stats
+	{
+		uint32 PassCount = 0;
+		uint32 CulledPassCount = 0;
+		uint32 ResourceCount = 0;
+		uint32 TransientCount = 0;    // transients used by live passes
+		uint32 BarrierCount = 0;
+		uint32 BatchCount = 0;        // non-empty barrier batches, i.e. ResourceBarrier calls
+		uint64 TransientBytes = 0;    // sum of the live transients' sizes
+		uint64 HeapBytes = 0;         // memory they need once aliased
+		double CompileMilliseconds = 0.0;
+	};
+
+	struct BenchmarkResult
+	{
+		uint32 Iterations = 0;
+		double Milliseconds = 0.0;    // total over all iterations
+		Stats LastStats;
+
+		double CompilesPerSecond()const;
+	};
+
+	// A resource owned outside the graph (the back buffer, the depth buffer, ...).  It
+	// starts the frame in initialState and is returned to finalState at the end.
+	ResourceHandle ImportResource(const std::string& name, States initialState, States finalState);
+
+	///<summary>
+	/// A resource that only lives within the frame.  Its heap offset is known after Compile
+	/// (GetHeapOffset) and it must be created in GetInitialState.  After its aliasing
+	/// barrier the contents are undefined, so the first pass using it must fully write it.
+	///</summary>
+	ResourceHandle CreateTransient(const std::string& name, uint64 sizeInBytes, uint64 alignment = DefaultAlignment);
+
+	PassHandle AddPass(const std::string& name, std::function<void()> execute = nullptr);
+
+	// Declares an access.  Several accesses to one resource in one pass are combined.
+	void Read(PassHandle pass, ResourceHandle resource, States state);
+	void Write(PassHandle pass, ResourceHandle resource, States state);
+
+	// Keeps a pass even when nothing reads what it writes (readbacks, queries, ...).
+	void SetSideEffects(PassHandle pass);
+
+	// Removes every pass and resource.
+	void Clear();
+
+	void Compile();
+
+	// Called with each barrier batch; count is never zero.
+	using BarrierFunc = std::function<void(const Barrier* barriers, uint32 count)>;
+
+	///<summary>
+	/// Runs the live passes in order, handing each one's barrier batch to submitBarriers
+	/// before its execute callback, then the final batch that returns every resource to
+	/// its final state.
+	///</summary>
+	void Execute(const BarrierFunc& submitBarriers)const;
+
+	uint32 PassCount()const;
+	uint32 ResourceCount()const;
+	const std::string& GetPassName(PassHandle pass)const;
+	const std::string& GetResourceName(ResourceHandle resource)const;
+
+	// Results of the last Compile.
+	bool IsPassCulled(PassHandle pass)const;
+	States GetInitialState(ResourceHandle resource)const;
+	uint64 GetHeapOffset(ResourceHandle resource)const;
+	uint64 GetHeapSize()const;
+	const Stats& GetStats()const;
+
+	///<summary>
+	/// Builds a synthetic frame of passCount passes, each producing a transient from one
+	/// to three earlier ones, with some outputs left unread, and times Compile over it.
+	///</summary>
+	static BenchmarkResult Benchmark(uint32 passCount, uint32 iterations);
+
+private:
+	struct Access
+	{
+		ResourceHandle Resource;
+		States State;
+		bool Write;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::function<void()> Execute;
+		std::vector<Access> Accesses;
+		bool SideEffects = false;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		bool Imported = false;
+		States InitialState = ResourceState::Common;
+		States FinalState = ResourceState::Common;
+		uint64 Size = 0;
+		uint64 Alignment = 1;
+	};
+
+	// Range of mBarriers submitted before Pass, or at the end when Pass is InvalidHandle.
+	struct Batch
+	{
+		PassHandle Pass;
+		uint32 First;
+		uint32 Count;
+	};
+
+	void AddAccess(PassHandle pass, ResourceHandle resource, States state, bool write);
+	void CullPasses();
+	void PlaceTransients();
+	void BuildBarriers();
+
+private:
+	std::vector<Pass> mPasses;
+	std::vector<Resource> mResources;
+
+	// Compile results.
+	std::vector<bool> mLive;
+	std::vector<uint32> mFirstUse;
+	std::vector<uint32> mLastUse;
+	std::vector<States> mInitialStates;
+	std::vector<uint64> mHeapOffsets;
+	std::vector<bool> mAliased;
+	std::vector<ResourceHandle> mAliasBefore;
+	std::vector<Barrier> mBarriers;
+	std::vector<Batch> mBatches;
+	Stats mStats;
+};
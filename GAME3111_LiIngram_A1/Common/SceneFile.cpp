@@ -0,0 +1,435 @@
+//***************************************************************************************
+// SceneFile.cpp
+//***************************************************************************************
+
+#include "SceneFile.h"
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const SceneFile::uint32 SceneFile::Magic;
+const SceneFile::uint32 SceneFile::Version;
+const SceneFile::uint32 SceneFile::ArrayAlignment;
+
+namespace
+{
+	SceneFile::uint64 AlignUp(SceneFile::uint64 value, SceneFile::uint64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	void SetError(std::string* error, const char* message)
+	{
+		if(error != nullptr)
+			*error = message;
+	}
+}
+
+std::vector<SceneFile::uint8> SceneFile::Serialize(const std::vector<Item>& items)
+{
+	// Name table, in order of first use.
+	std::vector<NameEntry> names;
+	std::string nameText;
+	std::unordered_map<uint64, uint32> nameIndices;
+	auto nameIndex = [&](const AssetName& name)
+	{
+		auto found = nameIndices.find(name.Hash);
+		if(found != nameIndices.end())
+			return found->second;
+
+		uint32 length = (uint32)strlen(name.Text);
+		names.push_back({ name.Hash, (uint32)nameText.size(), length });
+		nameText.append(name.Text, length);
+		nameText.push_back('\0');
+		return nameIndices[name.Hash] = (uint32)names.size() - 1;
+	};
+
+	uint32 count = (uint32)items.size();
+	std::vector<uint32> geometries(count), submeshes(count);
+	for(uint32 i = 0; i < count; ++i)
+	{
+		geometries[i] = nameIndex(items[i].Geometry);
+		submeshes[i] = nameIndex(items[i].Submesh);
+	}
+
+	Header header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.ItemCount = count;
+	header.NameCount = (uint32)names.size();
+	header.Sizes[WorldsArray] = (uint64)count * sizeof(DirectX::XMFLOAT4X4);
+	header.Sizes[GeometriesArray] = (uint64)count * sizeof(uint32);
+	header.Sizes[SubmeshesArray] = (uint64)count * sizeof(uint32);
+	header.Sizes[BucketsArray] = count;
+	header.Sizes[FlagsArray] = count;
+	header.Sizes[BoundsCentersArray] = (uint64)count * sizeof(DirectX::XMFLOAT3);
+	header.Sizes[BoundsExtentsArray] = (uint64)count * sizeof(DirectX::XMFLOAT3);
+	header.Sizes[NamesArray] = names.size() * sizeof(NameEntry);
+	header.Sizes[NameTextArray] = nameText.size();
+
+	uint64 offset = AlignUp(sizeof(Header), ArrayAlignment);
+	for(int a = 0; a < ArrayCount; ++a)
+	{
+		header.Offsets[a] = offset;
+		offset = AlignUp(offset + header.Sizes[a], ArrayAlignment);
+	}
+	header.FileSize = offset;
+
+	std::vector<uint8> data((size_t)header.FileSize, 0);
+	memcpy(data.data(), &header, sizeof(header));
+
+	auto at = [&](Array array) { return data.data() + header.Offsets[array]; };
+	for(uint32 i = 0; i < count; ++i)
+	{
+		const Item& item = items[i];
+		memcpy(at(WorldsArray) + i * sizeof(DirectX::XMFLOAT4X4), &item.World, sizeof(DirectX::XMFLOAT4X4));
+		at(BucketsArray)[i] = item.Bucket;
+		at(FlagsArray)[i] = item.Flags;
+		memcpy(at(BoundsCentersArray) + i * sizeof(DirectX::XMFLOAT3), &item.BoundsCenter, sizeof(DirectX::XMFLOAT3));
+		memcpy(at(BoundsExtentsArray) + i * sizeof(DirectX::XMFLOAT3), &item.BoundsExtents, sizeof(DirectX::XMFLOAT3));
+	}
+
+	// An empty scene has no names either, and its empty vectors may have no storage.
+	if(count != 0)
+	{
+		memcpy(at(GeometriesArray), geometries.data(), (size_t)header.Sizes[GeometriesArray]);
+		memcpy(at(SubmeshesArray), submeshes.data(), (size_t)header.Sizes[SubmeshesArray]);
+		memcpy(at(NamesArray), names.data(), (size_t)header.Sizes[NamesArray]);
+	}
+	memcpy(at(NameTextArray), nameText.data(), nameText.size());
+
+	return data;
+}
+
+bool SceneFile::Save(const std::string& path, const std::vector<Item>& items)
+{
+	std::vector<uint8> data = Serialize(items);
+
+	std::ofstream fout(path, std::ios::binary);
+	if(!fout)
+		return false;
+
+	fout.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return (bool)fout;
+}
+
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+bool SceneFile::Open(const std::string& path, std::string* error)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		SetError(error, "cannot open file");
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if(view == nullptr)
+	{
+		if(mapping != nullptr)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		SetError(error, "cannot map file");
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = static_cast<const uint8*>(view);
+	mSize = (uint64)size.QuadPart;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		SetError(error, "cannot open file");
+		return false;
+	}
+
+	struct stat st;
+	void* view = MAP_FAILED;
+	if(fstat(fd, &st) == 0 && st.st_size > 0)
+		view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping keeps the file alive.
+	close(fd);
+	if(view == MAP_FAILED)
+	{
+		SetError(error, "cannot map file");
+		return false;
+	}
+
+	mData = static_cast<const uint8*>(view);
+	mSize = (uint64)st.st_size;
+#endif
+
+	mHeader = reinterpret_cast<const Header*>(mData);
+	if(!Validate(error))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool SceneFile::OpenMemory(std::vector<uint8> data, std::string* error)
+{
+	Close();
+
+	if(data.empty())
+	{
+		SetError(error, "not a scene file");
+		return false;
+	}
+
+	mBuffer = std::move(data);
+	mData = mBuffer.data();
+	mSize = mBuffer.size();
+
+	mHeader = reinterpret_cast<const Header*>(mData);
+	if(!Validate(error))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool SceneFile::Validate(std::string* error)const
+{
+	if(mSize < sizeof(Header) || mHeader->Magic != Magic)
+	{
+		SetError(error, "not a scene file");
+		return false;
+	}
+	if(mHeader->Version != Version)
+	{
+		SetError(error, "unsupported scene file version");
+		return false;
+	}
+	if(mHeader->FileSize != mSize)
+	{
+		SetError(error, "scene file size does not match its header");
+		return false;
+	}
+
+	uint64 count = mHeader->ItemCount;
+	const uint64 expected[ArrayCount] =
+	{
+		count * sizeof(DirectX::XMFLOAT4X4),
+		count * sizeof(uint32),
+		count * sizeof(uint32),
+		count,
+		count,
+		count * sizeof(DirectX::XMFLOAT3),
+		count * sizeof(DirectX::XMFLOAT3),
+		(uint64)mHeader->NameCount * sizeof(NameEntry),
+		mHeader->Sizes[NameTextArray]
+	};
+	for(int a = 0; a < ArrayCount; ++a)
+	{
+		uint64 offset = mHeader->Offsets[a];
+		uint64 size = mHeader->Sizes[a];
+		if(size != expected[a] || offset % ArrayAlignment != 0 || offset > mSize || size > mSize - offset)
+		{
+			SetError(error, "scene file array out of bounds");
+			return false;
+		}
+	}
+
+	const NameEntry* names = GetArray<NameEntry>(NamesArray);
+	const char* text = GetArray<char>(NameTextArray);
+	uint64 textSize = mHeader->Sizes[NameTextArray];
+	for(uint32 i = 0; i < mHeader->NameCount; ++i)
+	{
+		if((uint64)names[i].TextOffset + names[i].Length >= textSize ||
+			text[names[i].TextOffset + names[i].Length] != '\0')
+		{
+			SetError(error, "scene file name out of bounds");
+			return false;
+		}
+	}
+
+	// Checked once here so users can index the name table without checks.
+	const uint32* geometries = GetArray<uint32>(GeometriesArray);
+	const uint32* submeshes = GetArray<uint32>(SubmeshesArray);
+	for(uint64 i = 0; i < count; ++i)
+	{
+		if(geometries[i] >= mHeader->NameCount || submeshes[i] >= mHeader->NameCount)
+		{
+			SetError(error, "scene file item refers to a missing name");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void SceneFile::Close()
+{
+	if(mData == nullptr)
+		return;
+
+	if(!mBuffer.empty())
+	{
+		mBuffer.clear();
+		mBuffer.shrink_to_fit();
+	}
+	else
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mData);
+		CloseHandle(mMapping);
+		CloseHandle(mFile);
+#else
+		munmap(const_cast<uint8*>(mData), (size_t)mSize);
+#endif
+	}
+
+	mData = nullptr;
+	mSize = 0;
+	mHeader = nullptr;
+	mFile = nullptr;
+	mMapping = nullptr;
+}
+
+bool SceneFile::IsOpen()const
+{
+	return mData != nullptr;
+}
+
+SceneFile::uint32 SceneFile::ItemCount()const
+{
+	return mHeader != nullptr ? mHeader->ItemCount : 0;
+}
+
+const DirectX::XMFLOAT4X4* SceneFile::Worlds()const
+{
+	return GetArray<DirectX::XMFLOAT4X4>(WorldsArray);
+}
+
+const SceneFile::uint32* SceneFile::Geometries()const
+{
+	return GetArray<uint32>(GeometriesArray);
+}
+
+const SceneFile::uint32* SceneFile::Submeshes()const
+{
+	return GetArray<uint32>(SubmeshesArray);
+}
+
+const SceneFile::uint8* SceneFile::Buckets()const
+{
+	return GetArray<uint8>(BucketsArray);
+}
+
+const SceneFile::uint8* SceneFile::Flags()const
+{
+	return GetArray<uint8>(FlagsArray);
+}
+
+const DirectX::XMFLOAT3* SceneFile::BoundsCenters()const
+{
+	return GetArray<DirectX::XMFLOAT3>(BoundsCentersArray);
+}
+
+const DirectX::XMFLOAT3* SceneFile::BoundsExtents()const
+{
+	return GetArray<DirectX::XMFLOAT3>(BoundsExtentsArray);
+}
+
+SceneFile::uint32 SceneFile::NameCount()const
+{
+	return mHeader != nullptr ? mHeader->NameCount : 0;
+}
+
+AssetName SceneFile::GetName(uint32 index)const
+{
+	assert(index < NameCount());
+	const NameEntry& entry = GetArray<NameEntry>(NamesArray)[index];
+	return AssetName{ entry.Hash, GetArray<char>(NameTextArray) + entry.TextOffset };
+}
+
+SceneFile::BenchmarkResult SceneFile::Benchmark(const std::string& path, uint32 itemCount)
+{
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b)
+	{
+		return std::chrono::duration<double, std::milli>(b - a).count();
+	};
+
+	// A grid of items over a handful of submeshes, like a large version of the shapes scene.
+	const AssetName submeshNames[] = { ASSET_NAME("box"), ASSET_NAME("sphere"), ASSET_NAME("cylinder") };
+	std::vector<Item> items(itemCount);
+	uint32 side = 1;
+	while(side * side < itemCount)
+		++side;
+	for(uint32 i = 0; i < itemCount; ++i)
+	{
+		Item& item = items[i];
+		item.World = DirectX::XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			(float)(i % side) * 3.0f, 0.0f, (float)(i / side) * 3.0f, 1.0f);
+		item.Geometry = ASSET_NAME("shapeGeo");
+		item.Submesh = submeshNames[i % 3];
+		item.Flags = i % 3 == 0 ? Occluder : UseLod;
+		item.BoundsCenter = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+		item.BoundsExtents = DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f);
+	}
+
+	BenchmarkResult result;
+	result.ItemCount = itemCount;
+
+	auto t0 = Clock::now();
+	bool saved = Save(path, items);
+	auto t1 = Clock::now();
+
+	SceneFile scene;
+	if(!saved || !scene.Open(path))
+		return result;
+	auto t2 = Clock::now();
+
+	// What a loader does: one front to back pass over each array.
+	float sum = 0.0f;
+	uint64 refs = 0;
+	for(uint32 i = 0; i < itemCount; ++i)
+		sum += scene.Worlds()[i]._41 + scene.BoundsExtents()[i].x;
+	for(uint32 i = 0; i < itemCount; ++i)
+		refs += scene.Submeshes()[i] + scene.Geometries()[i] + scene.Flags()[i] + scene.Buckets()[i];
+	auto t3 = Clock::now();
+
+	// Keeps the reads from being optimized away.
+	volatile float checksum = sum + (float)refs;
+	(void)checksum;
+
+	result.FileBytes = scene.mSize;
+	result.SaveMilliseconds = ms(t0, t1);
+	result.OpenMilliseconds = ms(t1, t2);
+	result.ReadMilliseconds = ms(t2, t3);
+	return result;
+}
@@ -0,0 +1,167 @@
+//***************************************************************************************
+// SceneFile.h
+//
+// Binary scene of render items, laid out to be memory mapped and read in place.  Each
+// item field is its own array (SoA), so a loader touches only the fields it needs and
+// reads every array front to back:
+//
+//   Worlds          XMFLOAT4X4 per item, as stored in RenderItem::World
+//   Geometries      uint32 per item, index into the name table
+//   Submeshes       uint32 per item, index into the name table
+//   Buckets         uint8 per item, the PSO bucket the item draws with
+//   Flags           uint8 per item, ItemFlags
+//   BoundsCenters   XMFLOAT3 per item, local space bounds
+//   BoundsExtents   XMFLOAT3 per item
+//   Names           NameEntry per referenced asset name: its FNV-1a hash (as ASSET_NAME)
+//                   and the offset of its text
+//   NameText        the names, zero terminated
+//
+// The header holds the counts and the offset of every array; arrays are 64 byte aligned.
+// Open checks the header, the array bounds and the name references once; after that the
+// arrays are plain pointers into the mapping.  Scalars are little endian.  OpenMemory
+// reads the same layout from a buffer, such as one made by Serialize, with the same checks.
+//***************************************************************************************
+
+#pragma once
+
+#include "AssetRegistry.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SceneFile
+{
+public:
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint32 Magic = 0x454e4353;   // "SCNE"
+	static const uint32 Version = 1;
+	static const uint32 ArrayAlignment = 64;
+
+	enum ItemFlags : uint8
+	{
+		Occluder = 0x1,
+		UseLod = 0x2     // pick the level from the submesh's LOD table each frame
+	};
+
+	struct NameEntry
+	{
+		uint64 Hash;
+		uint32 TextOffset;
+		uint32 Length;
+	};
+
+	// One item as handed to Save.
+	struct Item
+	{
+		DirectX::XMFLOAT4X4 World;
+		AssetName Geometry;
+		AssetName Submesh;
+		uint8 Bucket = 0;
+		uint8 Flags = 0;
+		DirectX::XMFLOAT3 BoundsCenter;
+		DirectX::XMFLOAT3 BoundsExtents;
+	};
+
+	struct BenchmarkResult
+	{
+		uint32 ItemCount = 0;
+		uint64 FileBytes = 0;
+		double SaveMilliseconds = 0.0;
+		double OpenMilliseconds = 0.0;     // map and validate
+		double ReadMilliseconds = 0.0;     // one pass over every array
+	};
+
+	// The file image of items; names are stored once each however many items refer to them.
+	static std::vector<uint8> Serialize(const std::vector<Item>& items);
+
+	// Writes Serialize(items) to path.
+	static bool Save(const std::string& path, const std::vector<Item>& items);
+
+	SceneFile() = default;
+	SceneFile(const SceneFile& rhs) = delete;
+	SceneFile& operator=(const SceneFile& rhs) = delete;
+	~SceneFile();
+
+	///<summary>
+	/// Maps the file read only.  Returns false, with error set, if it cannot be mapped or
+	/// fails validation; the scene is then empty.
+	///</summary>
+	bool Open(const std::string& path, std::string* error = nullptr);
+
+	// Takes data over and reads the scene from it in place, validated like a file.
+	bool OpenMemory(std::vector<uint8> data, std::string* error = nullptr);
+
+	void Close();
+	bool IsOpen()const;
+
+	uint32 ItemCount()const;
+	const DirectX::XMFLOAT4X4* Worlds()const;
+	const uint32* Geometries()const;
+	const uint32* Submeshes()const;
+	const uint8* Buckets()const;
+	const uint8* Flags()const;
+	const DirectX::XMFLOAT3* BoundsCenters()const;
+	const DirectX::XMFLOAT3* BoundsExtents()const;
+
+	uint32 NameCount()const;
+
+	// Text points into the mapping and is valid until Close.
+	AssetName GetName(uint32 index)const;
+
+	///<summary>
+	/// Saves a synthetic scene of itemCount items to path, opens it and reads every
+	/// array once.  Leaves the file behind.
+	///</summary>
+	static BenchmarkResult Benchmark(const std::string& path, uint32 itemCount);
+
+private:
+	enum Array
+	{
+		WorldsArray,
+		GeometriesArray,
+		SubmeshesArray,
+		BucketsArray,
+		FlagsArray,
+		BoundsCentersArray,
+		BoundsExtentsArray,
+		NamesArray,
+		NameTextArray,
+
+		ArrayCount
+	};
+
+	struct Header
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 ItemCount;
+		uint32 NameCount;
+		uint64 FileSize;
+		uint64 Offsets[ArrayCount];
+		uint64 Sizes[ArrayCount];
+	};
+
+	bool Validate(std::string* error)const;
+
+	template<typename T>
+	const T* GetArray(Array array)const
+	{
+		return reinterpret_cast<const T*>(mData + mHeader->Offsets[array]);
+	}
+
+private:
+	const uint8* mData = nullptr;
+	uint64 mSize = 0;
+	const Header* mHeader = nullptr;
+
+	// Platform handles of the mapping.
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+
+	// Owns the data when opened with OpenMemory.
+	std::vector<uint8> mBuffer;
+};
@@ -0,0 +1,244 @@
+//***************************************************************************************
+// TerrainEditor.cpp
+//***************************************************************************************
+
+#include "TerrainEditor.h"
+#include "MeshNormals.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	bool Overlaps(const GridRegion& a, const GridRegion& b)
+	{
+		return a.RowBegin < b.RowEnd && b.RowBegin < a.RowEnd &&
+			a.ColBegin < b.ColEnd && b.ColBegin < a.ColEnd;
+	}
+
+	GridRegion Union(const GridRegion& a, const GridRegion& b)
+	{
+		GridRegion r;
+		r.RowBegin = std::min(a.RowBegin, b.RowBegin);
+		r.RowEnd = std::max(a.RowEnd, b.RowEnd);
+		r.ColBegin = std::min(a.ColBegin, b.ColBegin);
+		r.ColEnd = std::max(a.ColEnd, b.ColEnd);
+		return r;
+	}
+
+	// Clamps a possibly negative or out of range grid coordinate to [0, count].
+	GeometryGenerator::uint32 ClampIndex(float f, GeometryGenerator::uint32 count)
+	{
+		if(f <= 0.0f)
+			return 0;
+		if(f >= (float)count)
+			return count;
+		return (GeometryGenerator::uint32)f;
+	}
+}
+
+bool GridRegion::Empty()const
+{
+	return RowBegin >= RowEnd || ColBegin >= ColEnd;
+}
+
+GeometryGenerator::uint32 GridRegion::VertexCount()const
+{
+	return Empty() ? 0 : (RowEnd - RowBegin) * (ColEnd - ColBegin);
+}
+
+TerrainEditor::TerrainEditor(GeometryGenerator::MeshData& grid, uint32 m, uint32 n)
+	: mGrid(grid), mNumRows(m), mNumCols(n)
+{
+	assert(m >= 2 && n >= 2);
+	assert(grid.Vertices.size() == (size_t)m*n);
+
+	const XMFLOAT3& first = grid.Vertices[0].Position;
+	mOriginX = first.x;
+	mOriginZ = first.z;
+	mDx = grid.Vertices[1].Position.x - first.x;
+	mDz = first.z - grid.Vertices[n].Position.z;
+}
+
+TerrainEditor::uint32 TerrainEditor::RowCount()const
+{
+	return mNumRows;
+}
+
+TerrainEditor::uint32 TerrainEditor::ColumnCount()const
+{
+	return mNumCols;
+}
+
+GridRegion TerrainEditor::BrushRegion(float x, float z, float radius)const
+{
+	GridRegion r;
+	r.ColBegin = ClampIndex(std::ceil((x - radius - mOriginX) / mDx), mNumCols);
+	r.ColEnd = ClampIndex(std::floor((x + radius - mOriginX) / mDx) + 1.0f, mNumCols);
+	r.RowBegin = ClampIndex(std::ceil((mOriginZ - (z + radius)) / mDz), mNumRows);
+	r.RowEnd = ClampIndex(std::floor((mOriginZ - (z - radius)) / mDz) + 1.0f, mNumRows);
+	return r;
+}
+
+float TerrainEditor::BrushWeight(uint32 i, uint32 j, float x, float z, float radius)const
+{
+	const XMFLOAT3& p = mGrid.Vertices[i*mNumCols + j].Position;
+
+	float distSq = (p.x - x) * (p.x - x) + (p.z - z) * (p.z - z);
+	float radiusSq = radius * radius;
+	if(distSq >= radiusSq)
+		return 0.0f;
+
+	float q = 1.0f - distSq / radiusSq;
+	return q * q;
+}
+
+void TerrainEditor::Raise(float x, float z, float radius, float amount)
+{
+	GridRegion r = BrushRegion(x, z, radius);
+	if(r.Empty())
+		return;
+
+	for(uint32 i = r.RowBegin; i < r.RowEnd; ++i)
+	{
+		for(uint32 j = r.ColBegin; j < r.ColEnd; ++j)
+			mGrid.Vertices[i*mNumCols + j].Position.y += amount * BrushWeight(i, j, x, z, radius);
+	}
+
+	MarkHeightsChanged(r);
+}
+
+void TerrainEditor::Smooth(float x, float z, float radius, float strength)
+{
+	GridRegion r = BrushRegion(x, z, radius);
+	if(r.Empty())
+		return;
+
+	// Snapshot the brush area plus a one vertex border so every average sees old heights.
+	GridRegion s;
+	s.RowBegin = r.RowBegin > 0 ? r.RowBegin - 1 : 0;
+	s.RowEnd = std::min(r.RowEnd + 1, mNumRows);
+	s.ColBegin = r.ColBegin > 0 ? r.ColBegin - 1 : 0;
+	s.ColEnd = std::min(r.ColEnd + 1, mNumCols);
+
+	const uint32 pitch = s.ColEnd - s.ColBegin;
+	mScratch.resize(s.VertexCount());
+	for(uint32 i = s.RowBegin; i < s.RowEnd; ++i)
+	{
+		for(uint32 j = s.ColBegin; j < s.ColEnd; ++j)
+			mScratch[(i - s.RowBegin)*pitch + (j - s.ColBegin)] = mGrid.Vertices[i*mNumCols + j].Position.y;
+	}
+
+	auto old = [&](uint32 i, uint32 j) { return mScratch[(i - s.RowBegin)*pitch + (j - s.ColBegin)]; };
+
+	for(uint32 i = r.RowBegin; i < r.RowEnd; ++i)
+	{
+		uint32 up = i > s.RowBegin ? i - 1 : i;
+		uint32 down = i + 1 < s.RowEnd ? i + 1 : i;
+
+		for(uint32 j = r.ColBegin; j < r.ColEnd; ++j)
+		{
+			uint32 left = j > s.ColBegin ? j - 1 : j;
+			uint32 right = j + 1 < s.ColEnd ? j + 1 : j;
+
+			float average = 0.25f * (old(up, j) + old(down, j) + old(i, left) + old(i, right));
+			float w = strength * BrushWeight(i, j, x, z, radius);
+
+			float& y = mGrid.Vertices[i*mNumCols + j].Position.y;
+			y += (average - y) * w;
+		}
+	}
+
+	MarkHeightsChanged(r);
+}
+
+void TerrainEditor::MarkHeightsChanged(const GridRegion& region)
+{
+	// Normals come from central differences, so the ring around the edit changes too.
+	GridRegion r;
+	r.RowBegin = region.RowBegin > 0 ? region.RowBegin - 1 : 0;
+	r.RowEnd = std::min(region.RowEnd + 1, mNumRows);
+	r.ColBegin = region.ColBegin > 0 ? region.ColBegin - 1 : 0;
+	r.ColEnd = std::min(region.ColEnd + 1, mNumCols);
+
+	// Keep the list disjoint so no vertex is uploaded twice.
+	for(size_t k = 0; k < mDirty.size();)
+	{
+		if(Overlaps(mDirty[k], r))
+		{
+			r = Union(r, mDirty[k]);
+			mDirty[k] = mDirty.back();
+			mDirty.pop_back();
+			k = 0;
+		}
+		else
+		{
+			++k;
+		}
+	}
+	mDirty.push_back(r);
+
+	if(mDirty.size() > MaxDirtyRegions)
+	{
+		GridRegion all = mDirty[0];
+		for(const auto& d : mDirty)
+			all = Union(all, d);
+
+		mDirty.assign(1, all);
+	}
+}
+
+bool TerrainEditor::IsDirty()const
+{
+	return !mDirty.empty();
+}
+
+std::vector<GridRegion> TerrainEditor::TakeDirtyRegions(uint32 maxVertices, ThreadPool& pool)
+{
+	std::vector<GridRegion> taken;
+
+	uint32 budget = maxVertices;
+	while(!mDirty.empty())
+	{
+		GridRegion& r = mDirty.back();
+
+		uint32 width = r.ColEnd - r.ColBegin;
+		uint32 rows = r.RowEnd - r.RowBegin;
+		uint32 fitRows = budget / width;
+		if(fitRows == 0)
+		{
+			if(!taken.empty())
+				break;
+
+			// Always make progress, even when a single row is over budget.
+			fitRows = 1;
+		}
+
+		if(fitRows >= rows)
+		{
+			taken.push_back(r);
+			mDirty.pop_back();
+		}
+		else
+		{
+			GridRegion part = r;
+			part.RowEnd = r.RowBegin + fitRows;
+			r.RowBegin = part.RowEnd;
+			taken.push_back(part);
+		}
+
+		budget -= std::min(budget, taken.back().VertexCount());
+		if(budget == 0)
+			break;
+	}
+
+	for(const auto& r : taken)
+	{
+		MeshNormals::ComputeGridNormalsAndTangents(mGrid, mNumRows, mNumCols,
+			r.RowBegin, r.RowEnd, r.ColBegin, r.ColEnd, pool);
+	}
+
+	return taken;
+}
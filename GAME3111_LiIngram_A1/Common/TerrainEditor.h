@@ -0,0 +1,89 @@
+//***************************************************************************************
+// TerrainEditor.h
+//
+// Runtime height edits (raise, lower, smooth brushes) on a grid built by
+// GeometryGenerator::CreateGrid.  Each edit touches only the vertices under the brush and
+// records the rectangle of vertices whose position or normal changed.  The renderer then
+// takes those rectangles a bounded number of vertices at a time, rewrites just those
+// vertices and uploads just those byte ranges, so the cost of an edit depends on the
+// brush size and not on the size of the terrain.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+
+// Half open rectangle of grid vertices: rows [RowBegin, RowEnd), columns [ColBegin, ColEnd).
+struct GridRegion
+{
+	GeometryGenerator::uint32 RowBegin = 0;
+	GeometryGenerator::uint32 RowEnd = 0;
+	GeometryGenerator::uint32 ColBegin = 0;
+	GeometryGenerator::uint32 ColEnd = 0;
+
+	bool Empty()const;
+	GeometryGenerator::uint32 VertexCount()const;
+};
+
+class TerrainEditor
+{
+public:
+	using uint32 = GeometryGenerator::uint32;
+
+	///<summary>
+	/// Edits grid in place.  grid must have the m x n layout of CreateGrid and outlive the
+	/// editor; its normals and tangents are expected to be up to date already.
+	///</summary>
+	TerrainEditor(GeometryGenerator::MeshData& grid, uint32 m, uint32 n);
+	TerrainEditor(const TerrainEditor& rhs) = delete;
+	TerrainEditor& operator=(const TerrainEditor& rhs) = delete;
+
+	uint32 RowCount()const;
+	uint32 ColumnCount()const;
+
+	// Adds amount (negative to lower) at the brush centre, falling off smoothly to zero at radius.
+	void Raise(float x, float z, float radius, float amount);
+
+	// Moves heights toward the average of their four neighbours; strength in [0, 1].
+	void Smooth(float x, float z, float radius, float strength);
+
+	bool IsDirty()const;
+
+	///<summary>
+	/// Removes up to maxVertices worth of dirty vertices (always at least one row), updates
+	/// their normals and tangents, and returns the regions taken.  Anything over the budget
+	/// stays dirty for the next call.
+	///</summary>
+	std::vector<GridRegion> TakeDirtyRegions(uint32 maxVertices, ThreadPool& pool = ThreadPool::Get());
+
+private:
+	// Vertices within radius of (x, z), clamped to the grid.
+	GridRegion BrushRegion(float x, float z, float radius)const;
+
+	// Records that the heights in region changed, which also moves the normals one vertex around it.
+	void MarkHeightsChanged(const GridRegion& region);
+
+	float BrushWeight(uint32 i, uint32 j, float x, float z, float radius)const;
+
+private:
+	// Beyond this many separate rectangles they are collapsed into their bounding rectangle.
+	static const size_t MaxDirtyRegions = 8;
+
+	GeometryGenerator::MeshData& mGrid;
+	uint32 mNumRows = 0;
+	uint32 mNumCols = 0;
+
+	// Position of vertex (0, 0) and the spacing; rows run toward -z (see CreateGrid).
+	float mOriginX = 0.0f;
+	float mOriginZ = 0.0f;
+	float mDx = 1.0f;
+	float mDz = 1.0f;
+
+	// Disjoint rectangles still to be taken.
+	std::vector<GridRegion> mDirty;
+
+	// Heights under the brush, copied before smoothing so it reads unmodified neighbours.
+	std::vector<float> mScratch;
+};
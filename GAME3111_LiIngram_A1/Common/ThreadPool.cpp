@@ -0,0 +1,183 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32 workerCount)
+{
+	if(workerCount == ~0u)
+	{
+		uint32 hw = std::thread::hardware_concurrency();
+		workerCount = hw > 1 ? hw - 1 : 0;
+	}
+
+	mThreads.reserve(workerCount);
+	for(uint32 i = 0; i < workerCount; ++i)
+		mThreads.emplace_back(&ThreadPool::WorkerMain, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutdown = true;
+	}
+	mWakeCondition.notify_all();
+
+	for(auto& t : mThreads)
+		t.join();
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::uint32 ThreadPool::WorkerCount()const
+{
+	return (uint32)mThreads.size();
+}
+
+ThreadPool::uint32 ThreadPool::SlotCount()const
+{
+	// One slot per helper task plus one for the calling thread.
+	return (uint32)mThreads.size() + 1;
+}
+
+ThreadPool::uint32 ThreadPool::CacheAlignedGrain(uint32 elementByteSize, uint32 minGrain)
+{
+	// The smallest run of elements that fills whole cache lines is
+	// lcm(elementByteSize, CacheLineSize) / elementByteSize = CacheLineSize / gcd.
+	uint32 a = std::max(elementByteSize, 1u);
+	uint32 b = CacheLineSize;
+	while(b != 0)
+	{
+		uint32 r = a % b;
+		a = b;
+		b = r;
+	}
+	uint32 step = CacheLineSize / a;
+
+	minGrain = std::max(minGrain, 1u);
+	return (minGrain + step - 1) / step * step;
+}
+
+void ThreadPool::ParallelFor(uint32 count, uint32 grainSize, const RangeFunc& func)
+{
+	if(count == 0)
+		return;
+
+	grainSize = std::max(grainSize, 1u);
+	uint32 chunkCount = (count + grainSize - 1) / grainSize;
+	uint32 helperCount = std::min(chunkCount - 1, WorkerCount());
+
+	if(helperCount == 0)
+	{
+		func(0, count, 0);
+		return;
+	}
+
+	// Chunks are handed out dynamically so a slow range does not stall the whole loop.
+	struct Job
+	{
+		std::atomic<uint32> NextChunk{ 0 };
+		std::atomic<uint32> PendingHelpers{ 0 };
+
+		// First exception thrown by func on any thread, rethrown on the caller.
+		std::mutex ErrorMutex;
+		std::exception_ptr Error;
+	};
+	auto job = std::make_shared<Job>();
+	job->PendingHelpers = helperCount;
+
+	// Never throws: func lives on the caller's stack, so the caller must not unwind before
+	// every helper is done with it, and an exception escaping a worker would terminate.
+	auto runChunks = [job, count, grainSize, chunkCount, &func](uint32 slot)
+	{
+		try
+		{
+			for(uint32 chunk = job->NextChunk++; chunk < chunkCount; chunk = job->NextChunk++)
+			{
+				uint32 begin = chunk * grainSize;
+				uint32 end = std::min(begin + grainSize, count);
+				func(begin, end, slot);
+			}
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(job->ErrorMutex);
+			if(!job->Error)
+				job->Error = std::current_exception();
+
+			// Nobody starts a chunk after a failure; the result is thrown away anyway.
+			job->NextChunk = chunkCount;
+		}
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for(uint32 i = 0; i < helperCount; ++i)
+		{
+			mTasks.emplace_back([job, runChunks, i]()
+			{
+				runChunks(i + 1);
+				job->PendingHelpers--;
+			});
+		}
+	}
+	mWakeCondition.notify_all();
+
+	runChunks(0);
+
+	// Help drain the queue while waiting so a ParallelFor issued from inside a worker
+	// cannot deadlock the pool.
+	while(job->PendingHelpers.load() > 0)
+	{
+		if(!RunOneTask())
+			std::this_thread::yield();
+	}
+
+	if(job->Error)
+		std::rethrow_exception(job->Error);
+}
+
+void ThreadPool::WorkerMain()
+{
+	for(;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeCondition.wait(lock, [this]() { return mShutdown || !mTasks.empty(); });
+
+			if(mShutdown && mTasks.empty())
+				return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+bool ThreadPool::RunOneTask()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(mTasks.empty())
+			return false;
+
+		task = std::move(mTasks.front());
+		mTasks.pop_front();
+	}
+
+	task();
+	return true;
+}
@@ -0,0 +1,74 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// Small fixed-size pool of worker threads used to split CPU-side work (mesh processing,
+// constant buffer updates, culling, ...) into independent index ranges.
+//
+// The calling thread always takes part in a ParallelFor, so a pool created with zero
+// workers simply runs everything inline.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Called with a half open range [begin, end) and the slot of the thread running it.
+	// Slots are in [0, SlotCount()) and unique among the ranges of one ParallelFor call,
+	// so a call can keep per-slot partial results without atomics.  The calling thread
+	// always runs as slot 0, so concurrent or nested calls reuse slots; anything that
+	// outlives a single call must not be keyed by slot.
+	using RangeFunc = std::function<void(uint32 begin, uint32 end, uint32 slot)>;
+
+	static const uint32 CacheLineSize = 64;
+
+	// workerCount == ~0u picks hardware_concurrency()-1 workers.
+	explicit ThreadPool(uint32 workerCount = ~0u);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	// Process wide pool shared by the Common helpers.
+	static ThreadPool& Get();
+
+	uint32 WorkerCount()const;
+
+	// Number of distinct slot values a ParallelFor on this pool can pass to its callback.
+	uint32 SlotCount()const;
+
+	// Splits [0, count) into chunks of at least grainSize items and runs func over them on the
+	// workers and the calling thread.  Returns once every chunk has finished.  If func throws,
+	// no further chunks are started and the first exception is rethrown here once all the
+	// chunks already running have returned.
+	void ParallelFor(uint32 count, uint32 grainSize, const RangeFunc& func);
+
+	///<summary>
+	/// Grain size of at least minGrain for a ParallelFor that writes one element of
+	/// elementByteSize bytes per index into a cache line aligned array.  Every chunk then
+	/// starts on a cache line boundary, so no two threads ever write the same line.
+	///</summary>
+	static uint32 CacheAlignedGrain(uint32 elementByteSize, uint32 minGrain);
+
+private:
+	void WorkerMain();
+	bool RunOneTask();
+
+private:
+	std::vector<std::thread> mThreads;
+
+	std::mutex mMutex;
+	std::condition_variable mWakeCondition;
+	std::deque<std::function<void()>> mTasks;
+	bool mShutdown = false;
+};
@@ -6,7 +6,8 @@ template<typename T>
 class UploadBuffer
 {
 public:
-    UploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer) : 
+    UploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer,
+        MemoryTag tag = MemoryTag::FrameResources) : 
         mIsConstantBuffer(isConstantBuffer)
     {
         mElementByteSize = sizeof(T);
@@ -21,13 +22,16 @@ public:
         if(isConstantBuffer)
             mElementByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(T));
 
+        mByteSize = mElementByteSize*elementCount;
+
         ThrowIfFailed(device->CreateCommittedResource(
             &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
             D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(mElementByteSize*elementCount),
+            &CD3DX12_RESOURCE_DESC::Buffer(mByteSize),
 			D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr,
             IID_PPV_ARGS(&mUploadBuffer)));
+        d3dUtil::TrackResource(mUploadBuffer.Get(), tag);
 
         ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
 
@@ -50,15 +54,44 @@ public:
         return mUploadBuffer.Get();
     }
 
+    // Bytes between consecutive elements; padded to 256 for constant buffers.
+    UINT ElementByteSize()const
+    {
+        return mElementByteSize;
+    }
+
+    // Safe to call from several threads at once as long as they write different elements.
     void CopyData(int elementIndex, const T& data)
     {
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Mapped memory for buffers that are rewritten in bulk every frame, such as dynamic
+    // vertex buffers.  Elements are only tightly packed when this is not a constant buffer.
+    // The memory is write-combined: write it sequentially and never read from it.
+    T* MappedData()
+    {
+        assert(!mIsConstantBuffer);
+        return reinterpret_cast<T*>(mMappedData);
+    }
+
+    // The whole buffer as the CPU last wrote it.  Reading write-combined memory is slow,
+    // so this is for capture tools, not the frame loop.
+    const BYTE* MappedBytes()const
+    {
+        return mMappedData;
+    }
+
+    UINT ByteSize()const
+    {
+        return mByteSize;
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
+    UINT mByteSize = 0;
     bool mIsConstantBuffer = false;
 };
\ No newline at end of file
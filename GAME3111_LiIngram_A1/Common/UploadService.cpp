@@ -0,0 +1,196 @@
+//***************************************************************************************
+// UploadService.cpp
+//***************************************************************************************
+
+#include "UploadService.h"
+#include <algorithm>
+#include <chrono>
+
+const UploadService::uint64 UploadService::DefaultBatchBytes;
+
+UploadService::UploadService(CommandBackend& backend, SubmitFunc submit, uint64 batchBytes)
+	: mBackend(backend), mPool(backend), mSubmit(std::move(submit)), mBatchBytes(batchBytes)
+{
+	mWorker = std::thread(&UploadService::WorkerMain, this);
+}
+
+UploadService::~UploadService()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutdown = true;
+	}
+	mWake.notify_all();
+	mWorker.join();
+}
+
+UploadService::Ticket UploadService::Enqueue(uint64 byteSize, RecordFunc record, std::function<void()> onRetire)
+{
+	Ticket ticket;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		ticket = mNextTicket++;
+		mPending.push_back({ ticket, byteSize, std::move(record), std::move(onRetire) });
+		++mStats.Requests;
+	}
+	mWake.notify_one();
+
+	return ticket;
+}
+
+void UploadService::WorkerMain()
+{
+	std::vector<Request> batch;
+
+	for(;;)
+	{
+		batch.clear();
+		uint64 bytes = 0;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mShutdown || !mPending.empty(); });
+
+			if(mPending.empty())
+				return;
+
+			// At least one request, then more while they fit the batch budget.
+			do
+			{
+				bytes += mPending.front().Size;
+				batch.push_back(std::move(mPending.front()));
+				mPending.pop_front();
+			}
+			while(!mPending.empty() && bytes + mPending.front().Size <= mBatchBytes);
+		}
+
+		CommandContextPool::Context context;
+		uint64 fence = 0;
+		try
+		{
+			context = mPool.Acquire();
+			for(const Request& r : batch)
+				r.Record(context.List);
+			mPool.AddRecordedBytes(context, bytes);
+			mPool.Close(context);
+
+			fence = mSubmit(context.List);
+		}
+		catch(...)
+		{
+			// Letting it escape would terminate the process.  Hand it to the caller's
+			// thread instead; later batches could never complete, so stop here.
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mError = std::current_exception();
+			}
+			mSubmitted.notify_all();
+			return;
+		}
+		mPool.Release(context, fence);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			mSubmittedTicket = batch.back().Id;
+			mBatches.push_back({ mSubmittedTicket, fence });
+			for(Request& r : batch)
+			{
+				// The recorded copy is on the GPU now; keep only what Retire needs.
+				r.Record = nullptr;
+				mInFlight.push_back(std::move(r));
+			}
+
+			++mStats.Batches;
+			mStats.Bytes += bytes;
+			mStats.LargestBatchBytes = std::max(mStats.LargestBatchBytes, bytes);
+		}
+		mSubmitted.notify_all();
+	}
+}
+
+UploadService::Ticket UploadService::CompletedTicketLocked()const
+{
+	if(!mBatches.empty())
+	{
+		uint64 completed = mBackend.CompletedFence();
+		while(!mBatches.empty() && mBatches.front().Fence <= completed)
+		{
+			mCompletedTicket = mBatches.front().Last;
+			mBatches.pop_front();
+		}
+	}
+
+	return mCompletedTicket;
+}
+
+bool UploadService::IsReady(Ticket ticket)const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return ticket <= CompletedTicketLocked();
+}
+
+UploadService::uint32 UploadService::Retire()
+{
+	std::vector<std::function<void()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if(mError)
+			std::rethrow_exception(mError);
+
+		Ticket completed = CompletedTicketLocked();
+		while(!mInFlight.empty() && mInFlight.front().Id <= completed)
+		{
+			if(mInFlight.front().OnRetire)
+				callbacks.push_back(std::move(mInFlight.front().OnRetire));
+			mInFlight.pop_front();
+			++mStats.Retired;
+		}
+	}
+
+	// Outside the lock, so callbacks may enqueue more uploads.
+	for(auto& callback : callbacks)
+		callback();
+
+	return (uint32)callbacks.size();
+}
+
+void UploadService::WaitIdle()
+{
+	Ticket last;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		last = mNextTicket - 1;
+		mSubmitted.wait(lock, [&]() { return mSubmittedTicket >= last || mError; });
+
+		if(mError)
+			std::rethrow_exception(mError);
+	}
+
+	while(!IsReady(last))
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+bool UploadService::Failed()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mError != nullptr;
+}
+
+UploadService::Ticket UploadService::LastTicket()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNextTicket - 1;
+}
+
+UploadService::Stats UploadService::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	Stats stats = mStats;
+	stats.Pending = mPending.size();
+	stats.InFlight = mInFlight.size();
+	return stats;
+}
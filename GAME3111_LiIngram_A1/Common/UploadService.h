@@ -0,0 +1,135 @@
+//***************************************************************************************
+// UploadService.h
+//
+// Background uploader.  Callers enqueue copies from any thread and get a ticket back; a
+// worker thread gathers pending copies into batches of about BatchBytes, records each
+// batch into one list from a CommandContextPool, and submits it with its own fence.
+// The render thread polls IsReady(ticket) and leaves whatever depends on a pending
+// upload out of the frame, so nothing ever waits on the copy queue.
+//
+// Batches are recorded and submitted in enqueue order, so tickets complete in order and
+// readiness is one comparison against the last completed ticket.  Retire runs each
+// finished upload's retire callback (typically releasing its staging buffer) on the
+// thread that calls it.
+//
+// If a record or submit callback throws, the worker keeps the exception and stops, since
+// nothing queued after the failed batch could complete.  Retire and WaitIdle rethrow it
+// on their caller, so a failure reaches the render thread instead of terminating the
+// process from the worker.
+//
+// Like the pool, the service never touches Direct3D: recording goes through the
+// callbacks and submission through SubmitFunc, so it runs on NullCommandBackend too.
+//***************************************************************************************
+
+#pragma once
+
+#include "CommandContextPool.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <thread>
+
+class UploadService
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Tickets start at 1; 0 is never handed out and always reads as ready.
+	using Ticket = uint64;
+
+	// Records the copy into the backend's list with the given index.  Runs on the worker.
+	using RecordFunc = std::function<void(uint32 list)>;
+
+	// Executes the closed list on the copy queue, signals the next fence value and
+	// returns it.  Runs on the worker.
+	using SubmitFunc = std::function<uint64(uint32 list)>;
+
+	static const uint64 DefaultBatchBytes = 4 * 1024 * 1024;
+
+	struct Stats
+	{
+		uint64 Requests = 0;
+		uint64 Batches = 0;
+		uint64 Bytes = 0;         // submitted so far
+		uint64 Pending = 0;       // enqueued, not yet submitted
+		uint64 InFlight = 0;      // submitted, not yet retired
+		uint64 Retired = 0;
+		uint64 LargestBatchBytes = 0;
+	};
+
+	UploadService(CommandBackend& backend, SubmitFunc submit, uint64 batchBytes = DefaultBatchBytes);
+	UploadService(const UploadService& rhs) = delete;
+	UploadService& operator=(const UploadService& rhs) = delete;
+
+	// Submits whatever is still pending and stops the worker.  Does not wait for the GPU;
+	// call WaitIdle first if the copies' resources are about to be released.
+	~UploadService();
+
+	///<summary>
+	/// Queues a copy of byteSize bytes.  record runs on the worker thread, so anything it
+	/// touches must stay alive until onRetire runs (or the service is destroyed).
+	///</summary>
+	Ticket Enqueue(uint64 byteSize, RecordFunc record, std::function<void()> onRetire = nullptr);
+
+	// True once the copy queue has finished the ticket's batch.
+	bool IsReady(Ticket ticket)const;
+
+	// Runs the retire callbacks of every finished upload and returns how many ran.
+	// Rethrows the worker's exception once it has failed.
+	uint32 Retire();
+
+	// Blocks until every upload enqueued so far has completed on the GPU.  For shutdown
+	// and tests, not for the frame loop.  Rethrows the worker's exception once it has
+	// failed.
+	void WaitIdle();
+
+	// True once a callback on the worker has thrown; nothing completes after that.
+	bool Failed()const;
+
+	Ticket LastTicket()const;
+	Stats GetStats()const;
+
+private:
+	struct Request
+	{
+		Ticket Id;
+		uint64 Size;
+		RecordFunc Record;
+		std::function<void()> OnRetire;
+	};
+
+	struct Batch
+	{
+		Ticket Last;
+		uint64 Fence;
+	};
+
+	void WorkerMain();
+	Ticket CompletedTicketLocked()const;
+
+private:
+	CommandBackend& mBackend;
+	CommandContextPool mPool;
+	SubmitFunc mSubmit;
+	uint64 mBatchBytes;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mSubmitted;
+
+	std::deque<Request> mPending;
+	std::deque<Request> mInFlight;   // submitted, waiting to be retired
+	mutable std::deque<Batch> mBatches;
+	mutable Ticket mCompletedTicket = 0;
+
+	Ticket mNextTicket = 1;
+	Ticket mSubmittedTicket = 0;
+	bool mShutdown = false;
+	std::exception_ptr mError;
+
+	Stats mStats;
+
+	std::thread mWorker;
+};
@@ -0,0 +1,379 @@
+//***************************************************************************************
+// VertexLayout.h
+//
+// Compile-time description of an application vertex structure.  A single declaration
+// next to the vertex struct, e.g.
+//
+//   using VertexDesc = VertexLayout<Vertex,
+//       VERTEX_ATTRIBUTE(Vertex, Pos, Position),
+//       VERTEX_ATTRIBUTE(Vertex, Color, Color)>;
+//
+// generates the D3D12_INPUT_ELEMENT_DESC array (offsets come from offsetof, never typed
+// by hand), checks at compile time that the description matches the struct, and gives a
+// GeometryGenerator::MeshData -> Vertex conversion that is unrolled for that layout.
+//
+// Fields may also be stored compressed: XMHALF2/XMHALF4 for any float attribute, and
+// XMSHORTN4/XMBYTEN4 (signed normalized) for normals and tangents.  A float3 packed
+// into four components gets w = 0; declare the shader input as float3.  Convert runs
+// attribute by attribute over blocks of vertices, so every packing kernel sees a run of
+// vertices in a row; with SSE the half conversion does four floats per instruction
+// sequence, and two texture coordinates at a time.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GeometryGenerator.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Semantics an attribute can carry.  Each one maps to a field of GeometryGenerator::Vertex,
+// except Color which is filled with a constant supplied at conversion time.
+enum class VertexSemantic
+{
+	Position,
+	Normal,
+	Tangent,
+	TexCoord,
+	Color
+};
+
+template<VertexSemantic Semantic>
+struct VertexSemanticTraits;
+
+// FieldType is the uncompressed type; UnitLength semantics may also use the normalized
+// integer encodings.
+template<>
+struct VertexSemanticTraits<VertexSemantic::Position>
+{
+	using FieldType = DirectX::XMFLOAT3;
+	static constexpr const char* Name = "POSITION";
+	static constexpr size_t SourceOffset = offsetof(GeometryGenerator::Vertex, Position);
+	static constexpr bool UnitLength = false;
+};
+
+template<>
+struct VertexSemanticTraits<VertexSemantic::Normal>
+{
+	using FieldType = DirectX::XMFLOAT3;
+	static constexpr const char* Name = "NORMAL";
+	static constexpr size_t SourceOffset = offsetof(GeometryGenerator::Vertex, Normal);
+	static constexpr bool UnitLength = true;
+};
+
+template<>
+struct VertexSemanticTraits<VertexSemantic::Tangent>
+{
+	using FieldType = DirectX::XMFLOAT3;
+	static constexpr const char* Name = "TANGENT";
+	static constexpr size_t SourceOffset = offsetof(GeometryGenerator::Vertex, TangentU);
+	static constexpr bool UnitLength = true;
+};
+
+template<>
+struct VertexSemanticTraits<VertexSemantic::TexCoord>
+{
+	using FieldType = DirectX::XMFLOAT2;
+	static constexpr const char* Name = "TEXCOORD";
+	static constexpr size_t SourceOffset = offsetof(GeometryGenerator::Vertex, TexC);
+	static constexpr bool UnitLength = false;
+};
+
+template<>
+struct VertexSemanticTraits<VertexSemantic::Color>
+{
+	using FieldType = DirectX::XMFLOAT4;
+	static constexpr const char* Name = "COLOR";
+	static constexpr bool UnitLength = false;
+};
+
+// DXGI format used to feed a field type to the input assembler.
+template<typename TField>
+struct VertexFieldFormat;
+
+template<> struct VertexFieldFormat<float>             { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R32_FLOAT; };
+template<> struct VertexFieldFormat<DirectX::XMFLOAT2> { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R32G32_FLOAT; };
+template<> struct VertexFieldFormat<DirectX::XMFLOAT3> { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R32G32B32_FLOAT; };
+template<> struct VertexFieldFormat<DirectX::XMFLOAT4> { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R32G32B32A32_FLOAT; };
+template<> struct VertexFieldFormat<DirectX::PackedVector::XMHALF2>   { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R16G16_FLOAT; };
+template<> struct VertexFieldFormat<DirectX::PackedVector::XMHALF4>   { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R16G16B16A16_FLOAT; };
+template<> struct VertexFieldFormat<DirectX::PackedVector::XMSHORTN4> { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R16G16B16A16_SNORM; };
+template<> struct VertexFieldFormat<DirectX::PackedVector::XMBYTEN4>  { static constexpr DXGI_FORMAT Value = DXGI_FORMAT_R8G8B8A8_SNORM; };
+
+namespace VertexPacking
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_F16C_INTRINSICS_)
+	// Four floats to four halves with SSE2 integer ops, rounding to nearest even like
+	// F16C: overflow becomes infinity, NaN stays NaN, small values become denormals.
+	// Each lane of the result holds its half in the low 16 bits.
+	inline __m128i FloatToHalf4(__m128 f)
+	{
+		const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);        // this and up round to infinity
+		const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);     // smallest float giving a normal half
+		const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+		__m128 sign = _mm_and_ps(f, _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000)));
+		__m128 absF = _mm_xor_ps(f, sign);
+		__m128i absBits = _mm_castps_si128(absF);
+
+		__m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+		__m128i isFinite = _mm_cmpgt_epi32(f16Max, absBits);
+		__m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absBits);
+		__m128i special = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+		// Denormal results: let a float add do the shift and the rounding.
+		__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+		// Normal results: rebias the exponent, round half to even, drop 13 mantissa bits.
+		__m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+		__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantissaOdd), 13);
+
+		__m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+		__m128i bits = _mm_or_si128(_mm_and_si128(isFinite, finite), _mm_andnot_si128(isFinite, special));
+		return _mm_or_si128(bits, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+	}
+
+	// Narrows the four 16 bit values to the low eight bytes.  SSE2 only has a signed
+	// saturating pack, so sign-extend first to keep the bit patterns.
+	inline __m128i PackHalf4(__m128i halves)
+	{
+		halves = _mm_srai_epi32(_mm_slli_epi32(halves, 16), 16);
+		return _mm_packs_epi32(halves, halves);
+	}
+#endif
+
+	inline void StoreHalf4(DirectX::PackedVector::XMHALF4* dst, DirectX::FXMVECTOR v)
+	{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_F16C_INTRINSICS_)
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), PackHalf4(FloatToHalf4(v)));
+#else
+		DirectX::PackedVector::XMStoreHalf4(dst, v);
+#endif
+	}
+
+	// How a field of type TField is filled from a TSource.  Convert handles count fields
+	// read srcStride bytes apart (0 repeats one value) and written dstStride bytes apart.
+	// Only the specializations below exist, so an unsupported pairing fails to compile.
+	template<typename TField, typename TSource>
+	struct Codec;
+
+	template<typename T>
+	struct Codec<T, T>
+	{
+		static void Convert(const BYTE* src, size_t srcStride, BYTE* dst, size_t dstStride, size_t count)
+		{
+			for(size_t i = 0; i < count; ++i, src += srcStride, dst += dstStride)
+				std::memcpy(dst, src, sizeof(T));
+		}
+	};
+
+	template<>
+	struct Codec<DirectX::PackedVector::XMHALF4, DirectX::XMFLOAT3>
+	{
+		static void Convert(const BYTE* src, size_t srcStride, BYTE* dst, size_t dstStride, size_t count)
+		{
+			for(size_t i = 0; i < count; ++i, src += srcStride, dst += dstStride)
+			{
+				StoreHalf4(reinterpret_cast<DirectX::PackedVector::XMHALF4*>(dst),
+					DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3*>(src)));
+			}
+		}
+	};
+
+	template<>
+	struct Codec<DirectX::PackedVector::XMHALF4, DirectX::XMFLOAT4>
+	{
+		static void Convert(const BYTE* src, size_t srcStride, BYTE* dst, size_t dstStride, size_t count)
+		{
+			for(size_t i = 0; i < count; ++i, src += srcStride, dst += dstStride)
+			{
+				StoreHalf4(reinterpret_cast<DirectX::PackedVector::XMHALF4*>(dst),
+					DirectX::XMLoadFloat4(reinterpret_cast<const DirectX::XMFLOAT4*>(src)));
+			}
+		}
+	};
+
+	template<>
+	struct Codec<DirectX::PackedVector::XMHALF2, DirectX::XMFLOAT2>
+	{
+		static void Convert(const BYTE* src, size_t srcStride, BYTE* dst, size_t dstStride, size_t count)
+		{
+			size_t i = 0;
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_F16C_INTRINSICS_)
+			// Two vertices per conversion: x0 y0 x1 y1.
+			for(; i + 2 <= count; i += 2, src += 2 * srcStride, dst += 2 * dstStride)
+			{
+				__m128 v = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(src));
+				v = _mm_loadh_pi(v, reinterpret_cast<const __m64*>(src + srcStride));
+
+				__m128i packed = PackHalf4(FloatToHalf4(v));
+				int lo = _mm_cvtsi128_si32(packed);
+				int hi = _mm_cvtsi128_si32(_mm_srli_si128(packed, 4));
+				std::memcpy(dst, &lo, sizeof(lo));
+				std::memcpy(dst + dstStride, &hi, sizeof(hi));
+			}
+#endif
+			for(; i < count; ++i, src += srcStride, dst += dstStride)
+			{
+				DirectX::PackedVector::XMStoreHalf2(reinterpret_cast<DirectX::PackedVector::XMHALF2*>(dst),
+					DirectX::XMLoadFloat2(reinterpret_cast<const DirectX::XMFLOAT2*>(src)));
+			}
+		}
+	};
+
+	// DirectXMath's normalized stores already clamp, scale and pack in one SIMD sequence.
+	template<>
+	struct Codec<DirectX::PackedVector::XMSHORTN4, DirectX::XMFLOAT3>
+	{
+		static void Convert(const BYTE* src, size_t srcStride, BYTE* dst, size_t dstStride, size_t count)
+		{
+			for(size_t i = 0; i < count; ++i, src += srcStride, dst += dstStride)
+			{
+				DirectX::PackedVector::XMStoreShortN4(reinterpret_cast<DirectX::PackedVector::XMSHORTN4*>(dst),
+					DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3*>(src)));
+			}
+		}
+	};
+
+	template<>
+	struct Codec<DirectX::PackedVector::XMBYTEN4, DirectX::XMFLOAT3>
+	{
+		static void Convert(const BYTE* src, size_t srcStride, BYTE* dst, size_t dstStride, size_t count)
+		{
+			for(size_t i = 0; i < count; ++i, src += srcStride, dst += dstStride)
+			{
+				DirectX::PackedVector::XMStoreByteN4(reinterpret_cast<DirectX::PackedVector::XMBYTEN4*>(dst),
+					DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3*>(src)));
+			}
+		}
+	};
+
+	template<typename TField>
+	constexpr bool IsNormalizedInteger()
+	{
+		return std::is_same<TField, DirectX::PackedVector::XMSHORTN4>::value ||
+			std::is_same<TField, DirectX::PackedVector::XMBYTEN4>::value;
+	}
+}
+
+// One field of a vertex.  Use VERTEX_ATTRIBUTE rather than naming this directly so the
+// offset is always taken from the struct.
+template<typename TField, size_t FieldOffset, VertexSemantic Semantic, UINT SemanticIndex = 0>
+struct VertexAttribute
+{
+	using Traits = VertexSemanticTraits<Semantic>;
+
+	using Codec = VertexPacking::Codec<TField, typename Traits::FieldType>;
+
+	static_assert(!VertexPacking::IsNormalizedInteger<TField>() || Traits::UnitLength,
+		"Normalized integer fields only hold values in [-1, 1]; use them for normals and tangents.");
+
+	static constexpr UINT Offset = (UINT)FieldOffset;
+	static constexpr UINT Size = (UINT)sizeof(TField);
+
+	static constexpr D3D12_INPUT_ELEMENT_DESC Desc()
+	{
+		return { Traits::Name, SemanticIndex, VertexFieldFormat<TField>::Value, 0, Offset,
+			D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+	}
+
+	// Fills this field of count vertices dstStride bytes apart from count source vertices.
+	// Sizes and offsets are constants, so a plain copy becomes a couple of moves.
+	static void Convert(const GeometryGenerator::Vertex* src, BYTE* dst, size_t dstStride, size_t count,
+		const DirectX::XMFLOAT4& color)
+	{
+		if constexpr(Semantic == VertexSemantic::Color)
+			Codec::Convert(reinterpret_cast<const BYTE*>(&color), 0, dst + Offset, dstStride, count);
+		else
+			Codec::Convert(reinterpret_cast<const BYTE*>(src) + Traits::SourceOffset, sizeof(GeometryGenerator::Vertex),
+				dst + Offset, dstStride, count);
+	}
+};
+
+#define VERTEX_ATTRIBUTE(VertexType, Member, Semantic) \
+	VertexAttribute<decltype(VertexType::Member), offsetof(VertexType, Member), VertexSemantic::Semantic>
+
+template<typename TVertex, typename... TAttributes>
+class VertexLayout
+{
+public:
+	static constexpr UINT AttributeCount = (UINT)sizeof...(TAttributes);
+
+	static_assert(AttributeCount > 0, "A vertex layout needs at least one attribute.");
+	static_assert(std::is_standard_layout<TVertex>::value && std::is_trivially_copyable<TVertex>::value,
+		"Vertex types must be plain data to be copied into a vertex buffer.");
+
+	// Attributes must be listed in memory order, must not overlap and must cover every byte
+	// of the vertex.  The last rule catches a field added to the struct but not the layout.
+	static constexpr bool AttributesMatchStruct()
+	{
+		constexpr UINT offsets[] = { TAttributes::Offset... };
+		constexpr UINT sizes[] = { TAttributes::Size... };
+
+		UINT end = 0;
+		for(UINT i = 0; i < AttributeCount; ++i)
+		{
+			if(offsets[i] != end)
+				return false;
+			end = offsets[i] + sizes[i];
+		}
+		return end == sizeof(TVertex);
+	}
+
+	static_assert(AttributesMatchStruct(),
+		"Vertex layout attributes must be in order, non-overlapping and cover the whole vertex.");
+
+	static constexpr UINT Stride = (UINT)sizeof(TVertex);
+
+	static constexpr std::array<D3D12_INPUT_ELEMENT_DESC, AttributeCount> InputElements = { { TAttributes::Desc()... } };
+
+	static D3D12_INPUT_LAYOUT_DESC InputLayoutDesc()
+	{
+		return { InputElements.data(), AttributeCount };
+	}
+
+	static std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayout()
+	{
+		return std::vector<D3D12_INPUT_ELEMENT_DESC>(InputElements.begin(), InputElements.end());
+	}
+
+	// Vertices Convert processes attribute by attribute; source and output of a block stay
+	// in L1 between the attribute passes.
+	static constexpr size_t BatchSize = 256;
+
+	static TVertex ConvertVertex(const GeometryGenerator::Vertex& src,
+		const DirectX::XMFLOAT4& color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f))
+	{
+		TVertex dst;
+		ConvertRange(&src, &dst, 1, color);
+		return dst;
+	}
+
+	static void Convert(const GeometryGenerator::MeshData& meshData, TVertex* dst,
+		const DirectX::XMFLOAT4& color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f))
+	{
+		const size_t count = meshData.Vertices.size();
+		const GeometryGenerator::Vertex* src = meshData.Vertices.data();
+		for(size_t first = 0; first < count; first += BatchSize)
+			ConvertRange(src + first, dst + first, std::min(BatchSize, count - first), color);
+	}
+
+	static std::vector<TVertex> Convert(const GeometryGenerator::MeshData& meshData,
+		const DirectX::XMFLOAT4& color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f))
+	{
+		std::vector<TVertex> vertices(meshData.Vertices.size());
+		Convert(meshData, vertices.data(), color);
+		return vertices;
+	}
+
+private:
+	static void ConvertRange(const GeometryGenerator::Vertex* src, TVertex* dst, size_t count,
+		const DirectX::XMFLOAT4& color)
+	{
+		BYTE* out = reinterpret_cast<BYTE*>(dst);
+		(TAttributes::Convert(src, out, Stride, count, color), ...);
+	}
+};
@@ -0,0 +1,224 @@
+//***************************************************************************************
+// Waves.cpp
+//***************************************************************************************
+
+#include "Waves.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace DirectX;
+
+namespace
+{
+	template<typename TIndex>
+	std::vector<TIndex> BuildGridIndices(Waves::uint32 m, Waves::uint32 n)
+	{
+		std::vector<TIndex> indices((size_t)(m - 1) * (n - 1) * 6);
+
+		// Iterate over each quad.
+		size_t k = 0;
+		for(Waves::uint32 i = 0; i < m - 1; ++i)
+		{
+			for(Waves::uint32 j = 0; j < n - 1; ++j)
+			{
+				indices[k] = (TIndex)(i * n + j);
+				indices[k + 1] = (TIndex)(i * n + j + 1);
+				indices[k + 2] = (TIndex)((i + 1) * n + j);
+
+				indices[k + 3] = (TIndex)((i + 1) * n + j);
+				indices[k + 4] = (TIndex)(i * n + j + 1);
+				indices[k + 5] = (TIndex)((i + 1) * n + j + 1);
+
+				k += 6; // next quad
+			}
+		}
+
+		return indices;
+	}
+}
+
+double Waves::BenchmarkResult::CellsPerSecond()const
+{
+	return StepMilliseconds > 0.0 ? (double)RowCount * ColumnCount * 1000.0 / StepMilliseconds : 0.0;
+}
+
+Waves::Waves(uint32 m, uint32 n, float dx, float dt, float speed, float damping)
+{
+	assert(m >= 3 && n >= 3);
+
+	mNumRows = m;
+	mNumCols = n;
+
+	mTimeStep = dt;
+	mSpatialStep = dx;
+
+	float d = damping * dt + 2.0f;
+	float e = (speed * speed) * (dt * dt) / (dx * dx);
+	mK1 = (damping * dt - 2.0f) / d;
+	mK2 = (4.0f - 8.0f * e) / d;
+	mK3 = (2.0f * e) / d;
+
+	mPrevSolution.assign((size_t)m * n, 0.0f);
+	mCurrSolution.assign((size_t)m * n, 0.0f);
+}
+
+Waves::uint32 Waves::RowCount()const
+{
+	return mNumRows;
+}
+
+Waves::uint32 Waves::ColumnCount()const
+{
+	return mNumCols;
+}
+
+Waves::uint32 Waves::VertexCount()const
+{
+	return mNumRows * mNumCols;
+}
+
+Waves::uint32 Waves::TriangleCount()const
+{
+	return (mNumRows - 1) * (mNumCols - 1) * 2;
+}
+
+float Waves::Width()const
+{
+	return (mNumCols - 1) * mSpatialStep;
+}
+
+float Waves::Depth()const
+{
+	return (mNumRows - 1) * mSpatialStep;
+}
+
+float Waves::TimeStep()const
+{
+	return mTimeStep;
+}
+
+float Waves::Height(uint32 i)const
+{
+	return mCurrSolution[i];
+}
+
+XMFLOAT3 Waves::Position(uint32 i, uint32 j)const
+{
+	return XMFLOAT3(-0.5f * Width() + j * mSpatialStep, mCurrSolution[i * mNumCols + j], 0.5f * Depth() - i * mSpatialStep);
+}
+
+Waves::uint32 Waves::LastStepCount()const
+{
+	return mLastStepCount;
+}
+
+double Waves::LastUpdateMilliseconds()const
+{
+	return mLastUpdateMilliseconds;
+}
+
+Waves::uint32 Waves::RowGrainSize()const
+{
+	return std::max(1u, 4096u / mNumCols);
+}
+
+void Waves::Update(float dt, ThreadPool& pool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	mAccumulator += dt;
+
+	mLastStepCount = 0;
+	while(mAccumulator >= mTimeStep && mLastStepCount < MaxStepsPerUpdate)
+	{
+		Step(pool);
+		mAccumulator -= mTimeStep;
+		++mLastStepCount;
+	}
+
+	// Fell behind; drop the backlog rather than trying to catch up next frame.
+	if(mAccumulator >= mTimeStep)
+		mAccumulator = 0.0f;
+
+	mLastUpdateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Waves::Step(ThreadPool& pool)
+{
+	const uint32 n = mNumCols;
+
+	// Columns [1, simdEnd) go four at a time; the rest of the interior is done one by one.
+	const uint32 simdEnd = 1 + ((n - 2) & ~3u);
+
+	// The border rows and columns stay at zero, so only the interior rows are split up.
+	pool.ParallelFor(mNumRows - 2, RowGrainSize(), [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		const XMVECTOR k1 = XMVectorReplicate(mK1);
+		const XMVECTOR k2 = XMVectorReplicate(mK2);
+		const XMVECTOR k3 = XMVectorReplicate(mK3);
+
+		for(uint32 i = begin + 1; i < end + 1; ++i)
+		{
+			// The next solution overwrites the previous one in place: each entry only
+			// reads its own previous value, and the neighbours come from the current step.
+			float* next = &mPrevSolution[i * n];
+			const float* curr = &mCurrSolution[i * n];
+			const float* above = curr - n;
+			const float* below = curr + n;
+
+			uint32 j = 1;
+			for(; j < simdEnd; j += 4)
+			{
+				XMVECTOR prev4 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(next + j));
+				XMVECTOR curr4 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j));
+
+				XMVECTOR sum = XMVectorAdd(
+					XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(above + j)),
+						XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(below + j))),
+					XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j - 1)),
+						XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(curr + j + 1))));
+
+				XMVECTOR result = XMVectorMultiplyAdd(k3, sum,
+					XMVectorMultiplyAdd(k2, curr4, XMVectorMultiply(k1, prev4)));
+
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(next + j), result);
+			}
+
+			for(; j < n - 1; ++j)
+			{
+				next[j] = mK1 * next[j] + mK2 * curr[j] +
+					mK3 * (above[j] + below[j] + curr[j - 1] + curr[j + 1]);
+			}
+		}
+	});
+
+	// The new solution is now in mPrevSolution; swap so the current step is the newest.
+	std::swap(mPrevSolution, mCurrSolution);
+}
+
+void Waves::Disturb(uint32 i, uint32 j, float magnitude)
+{
+	// Don't disturb boundaries.
+	assert(i > 1 && i < mNumRows - 2);
+	assert(j > 1 && j < mNumCols - 2);
+
+	float halfMag = 0.5f * magnitude;
+
+	// Disturb the ij-th vertex height and its neighbors.
+	mCurrSolution[i * mNumCols + j] += magnitude;
+	mCurrSolution[i * mNumCols + j + 1] += halfMag;
+	mCurrSolution[i * mNumCols + j - 1] += halfMag;
+	mCurrSolution[(i + 1) * mNumCols + j] += halfMag;
+	mCurrSolution[(i - 1) * mNumCols + j] += halfMag;
+}
+
+std::vector<std::uint16_t> Waves::BuildIndices16()const
+{
+	assert(VertexCount() <= 0x10000);
+	return BuildGridIndices<std::uint16_t>(mNumRows, mNumCols);
+}
+
+std::vector<Waves::uint32> Waves::BuildIndices32()const
+{
+	return BuildGridIndices<uint32>(mNumRows, mNumCols);
+}
@@ -0,0 +1,172 @@
+//***************************************************************************************
+// Waves.h
+//
+// Water surface simulated on the CPU with the finite difference form of the 2D wave
+// equation.  The grid lies in the xz-plane centred on the origin and only the heights
+// change, so they are kept in two flat float arrays (previous and current step) that the
+// solver walks four columns at a time with XMVECTOR, split over the thread pool by rows.
+//
+// The solver runs at a fixed time step: Update accumulates the frame time and takes as
+// many whole steps as fit, so the result does not depend on the frame rate.
+//***************************************************************************************
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <chrono>
+#include <vector>
+
+class Waves
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct BenchmarkResult
+	{
+		uint32 RowCount = 0;
+		uint32 ColumnCount = 0;
+		uint32 Steps = 0;
+		double StepMilliseconds = 0.0;  // average time of one solver step
+		double WriteMilliseconds = 0.0; // average time to write the grid out as vertices
+
+		double CellsPerSecond()const;
+	};
+
+	///<summary>
+	/// m x n grid of vertices spaced dx apart.  dt is the fixed solver step; the scheme is
+	/// only stable while speed*dt/dx stays below 1/sqrt(2).
+	///</summary>
+	Waves(uint32 m, uint32 n, float dx, float dt, float speed, float damping);
+	Waves(const Waves& rhs) = delete;
+	Waves& operator=(const Waves& rhs) = delete;
+
+	uint32 RowCount()const;
+	uint32 ColumnCount()const;
+	uint32 VertexCount()const;
+	uint32 TriangleCount()const;
+	float Width()const;
+	float Depth()const;
+	float TimeStep()const;
+
+	// Height of vertex i*ColumnCount()+j at the current step.
+	float Height(uint32 i)const;
+	DirectX::XMFLOAT3 Position(uint32 i, uint32 j)const;
+
+	// Solver steps taken by the last Update and the time they took.
+	uint32 LastStepCount()const;
+	double LastUpdateMilliseconds()const;
+
+	///<summary>
+	/// Advances the simulation by dt seconds of game time.  At most MaxStepsPerUpdate steps
+	/// are taken; any time beyond that is dropped so a long stall cannot snowball.
+	///</summary>
+	void Update(float dt, ThreadPool& pool = ThreadPool::Get());
+
+	// Takes exactly one solver step.
+	void Step(ThreadPool& pool = ThreadPool::Get());
+
+	// Raises vertex (i, j) by magnitude and its four neighbours by half that.  Vertices on
+	// the border are fixed, so (i, j) must be at least two rows/columns in from the edge.
+	void Disturb(uint32 i, uint32 j, float magnitude);
+
+	// Same triangulation as GeometryGenerator::CreateGrid: two clockwise triangles per quad.
+	std::vector<std::uint16_t> BuildIndices16()const;
+	std::vector<uint32> BuildIndices32()const;
+
+	///<summary>
+	/// Writes every vertex, in row order, to dst as convert(const XMFLOAT3& position).  dst
+	/// is typically the mapped memory of an upload heap buffer, which is write-combined, so
+	/// each vertex is written once front to back and never read back.
+	///</summary>
+	template<typename TVertex, typename ConvertFunc>
+	void WriteVertices(TVertex* dst, ConvertFunc convert, ThreadPool& pool = ThreadPool::Get())const;
+
+	///<summary>
+	/// Times steps and vertex writes on a fresh m x n grid.  Meant to be run from a debug
+	/// key or a tool, since large grids take a while.
+	///</summary>
+	template<typename TVertex, typename ConvertFunc>
+	static BenchmarkResult Benchmark(uint32 m, uint32 n, uint32 steps, ConvertFunc convert,
+		ThreadPool& pool = ThreadPool::Get());
+
+	static const uint32 MaxStepsPerUpdate = 4;
+
+private:
+	// Rows handed to a worker at a time; sized so each chunk touches a few thousand cells.
+	uint32 RowGrainSize()const;
+
+private:
+	uint32 mNumRows = 0;
+	uint32 mNumCols = 0;
+
+	float mK1 = 0.0f;
+	float mK2 = 0.0f;
+	float mK3 = 0.0f;
+
+	float mTimeStep = 0.0f;
+	float mSpatialStep = 0.0f;
+	float mAccumulator = 0.0f;
+
+	uint32 mLastStepCount = 0;
+	double mLastUpdateMilliseconds = 0.0;
+
+	std::vector<float> mPrevSolution;
+	std::vector<float> mCurrSolution;
+};
+
+template<typename TVertex, typename ConvertFunc>
+void Waves::WriteVertices(TVertex* dst, ConvertFunc convert, ThreadPool& pool)const
+{
+	const float halfWidth = 0.5f * Width();
+	const float halfDepth = 0.5f * Depth();
+
+	pool.ParallelFor(mNumRows, RowGrainSize(), [&](uint32 begin, uint32 end, uint32 slot)
+	{
+		for(uint32 i = begin; i < end; ++i)
+		{
+			const float z = halfDepth - i * mSpatialStep;
+			const float* heights = &mCurrSolution[i * mNumCols];
+			TVertex* row = dst + i * mNumCols;
+
+			for(uint32 j = 0; j < mNumCols; ++j)
+				row[j] = convert(DirectX::XMFLOAT3(-halfWidth + j * mSpatialStep, heights[j], z));
+		}
+	});
+}
+
+template<typename TVertex, typename ConvertFunc>
+Waves::BenchmarkResult Waves::Benchmark(uint32 m, uint32 n, uint32 steps, ConvertFunc convert,
+	ThreadPool& pool)
+{
+	BenchmarkResult result;
+	result.RowCount = m;
+	result.ColumnCount = n;
+	result.Steps = steps;
+
+	if(steps == 0)
+		return result;
+
+	Waves waves(m, n, 1.0f, 0.03f, 4.0f, 0.2f);
+	waves.Disturb(m / 2, n / 2, 1.0f);
+
+	std::vector<TVertex> vertices(waves.VertexCount());
+
+	double stepMs = 0.0;
+	double writeMs = 0.0;
+	for(uint32 s = 0; s < steps; ++s)
+	{
+		auto start = std::chrono::steady_clock::now();
+		waves.Step(pool);
+		auto stepped = std::chrono::steady_clock::now();
+		waves.WriteVertices(vertices.data(), convert, pool);
+		auto written = std::chrono::steady_clock::now();
+
+		stepMs += std::chrono::duration<double, std::milli>(stepped - start).count();
+		writeMs += std::chrono::duration<double, std::milli>(written - stepped).count();
+	}
+
+	result.StepMilliseconds = stepMs / steps;
+	result.WriteMilliseconds = writeMs / steps;
+	return result;
+}
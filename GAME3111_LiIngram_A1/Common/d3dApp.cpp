@@ -17,6 +17,36 @@ MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return D3DApp::GetApp()->MsgProc(hwnd, msg, wParam, lParam);
 }
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace
+{
+	// Sleeps on a high resolution waitable timer where the OS has one (Windows 10 1803
+	// on), which wakes within a fraction of a millisecond rather than on the next
+	// scheduler tick.  Elsewhere the pacer's sleep estimate absorbs the coarser sleeps.
+	FramePacer::Hooks HighResolutionPacerHooks()
+	{
+		FramePacer::Hooks hooks = FramePacer::DefaultHooks();
+
+		HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if(timer == nullptr)
+			return hooks;
+
+		std::shared_ptr<void> owner(timer, CloseHandle);
+		hooks.Sleep = [owner](FramePacer::Duration duration)
+		{
+			// Negative is relative, in 100 ns units.
+			LARGE_INTEGER due;
+			due.QuadPart = -(LONGLONG)(duration.count() / 100);
+			if(SetWaitableTimerEx(owner.get(), &due, 0, nullptr, nullptr, nullptr, 0))
+				WaitForSingleObject(owner.get(), INFINITE);
+		};
+		return hooks;
+	}
+}
+
 D3DApp* D3DApp::mApp = nullptr;
 D3DApp* D3DApp::GetApp()
 {
@@ -24,7 +54,8 @@ D3DApp* D3DApp::GetApp()
 }
 
 D3DApp::D3DApp(HINSTANCE hInstance)
-:	mhAppInst(hInstance)
+:	mhAppInst(hInstance),
+	mFramePacer(0.0, HighResolutionPacerHooks())
 {
     // Only one D3DApp can be constructed.
     assert(mApp == nullptr);
@@ -86,17 +117,22 @@ int D3DApp::Run()
 		// Otherwise, do animation/game stuff.
 		else
         {	
-			mTimer.Tick();
-
 			if( !mAppPaused )
 			{
+				// Returns at once when unpaced.
+				mFramePacer.WaitForNextFrame();
+
+				mTimer.Tick();
 				CalculateFrameStats();
 				Update(mTimer);	
                 Draw(mTimer);
 			}
 			else
 			{
-				Sleep(100);
+				// Nothing to draw, so block until the next message instead of polling.
+				mTimer.Tick();
+				WaitMessage();
+				mFramePacer.Restart();
 			}
         }
     }
@@ -127,6 +163,7 @@ void D3DApp::CreateRtvAndDsvDescriptorHeaps()
 	rtvHeapDesc.NodeMask = 0;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
         &rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.GetAddressOf())));
+    d3dUtil::TrackDescriptorHeap(mRtvHeap.Get());
 
 
     D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
@@ -136,6 +173,7 @@ void D3DApp::CreateRtvAndDsvDescriptorHeaps()
 	dsvHeapDesc.NodeMask = 0;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
         &dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.GetAddressOf())));
+    d3dUtil::TrackDescriptorHeap(mDsvHeap.Get());
 }
 
 void D3DApp::OnResize()
@@ -167,6 +205,7 @@ void D3DApp::OnResize()
 	for (UINT i = 0; i < SwapChainBufferCount; i++)
 	{
 		ThrowIfFailed(mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])));
+		d3dUtil::TrackResource(mSwapChainBuffer[i].Get(), MemoryTag::RenderTargets);
 		md3dDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
 		rtvHeapHandle.Offset(1, mRtvDescriptorSize);
 	}
@@ -202,6 +241,7 @@ void D3DApp::OnResize()
 		D3D12_RESOURCE_STATE_COMMON,
         &optClear,
         IID_PPV_ARGS(mDepthStencilBuffer.GetAddressOf())));
+    d3dUtil::TrackResource(mDepthStencilBuffer.Get(), MemoryTag::RenderTargets);
 
     //! Create descriptor to mip level 0 of entire resource using the format of the resource.
 	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
@@ -9,6 +9,7 @@
 
 #include "d3dUtil.h"
 #include "GameTimer.h"
+#include "FramePacer.h"
 
 // Link necessary d3d12 libraries.
 #pragma comment(lib,"d3dcompiler.lib")
@@ -86,6 +87,9 @@ protected:
     bool      m4xMsaaState = false;    // 4X MSAA enabled
     UINT      m4xMsaaQuality = 0;      // quality level of 4X MSAA
 
+	// Holds Run to a target frame rate; unpaced unless a derived class sets one.
+	FramePacer mFramePacer;
+
 	// Used to keep track of the delta-time and game time.
 	GameTimer mTimer;
 	
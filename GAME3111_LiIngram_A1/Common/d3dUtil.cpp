@@ -1,10 +1,66 @@
 
 #include "d3dUtil.h"
 #include <comdef.h>
+#include <atomic>
 #include <fstream>
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    // {5C1F7D0A-3E8B-4C27-9A61-2F4B8D6E0C13}
+    const GUID MemoryTrackingGuid =
+        { 0x5c1f7d0a, 0x3e8b, 0x4c27, { 0x9a, 0x61, 0x2f, 0x4b, 0x8d, 0x6e, 0x0c, 0x13 } };
+
+    // Attached to a D3D object as private data.  The object releases it when it is
+    // destroyed, which frees the tracked bytes.
+    class TrackedMemoryToken : public IUnknown
+    {
+    public:
+        TrackedMemoryToken(MemoryTag tag, UINT64 bytes) : mMemory(tag, MemoryKind::Gpu, bytes) {}
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object)override
+        {
+            if(object == nullptr)
+                return E_POINTER;
+
+            if(riid == __uuidof(IUnknown))
+            {
+                *object = static_cast<IUnknown*>(this);
+                AddRef();
+                return S_OK;
+            }
+
+            *object = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef()override
+        {
+            return ++mRefs;
+        }
+
+        ULONG STDMETHODCALLTYPE Release()override
+        {
+            ULONG refs = --mRefs;
+            if(refs == 0)
+                delete this;
+            return refs;
+        }
+
+    private:
+        std::atomic<ULONG> mRefs{ 1 };
+        TrackedMemory mMemory;
+    };
+
+    void AttachTrackedMemory(ID3D12Object* object, MemoryTag tag, UINT64 bytes)
+    {
+        ComPtr<IUnknown> token;
+        token.Attach(new TrackedMemoryToken(tag, bytes));
+        ThrowIfFailed(object->SetPrivateDataInterface(MemoryTrackingGuid, token.Get()));
+    }
+}
+
 DxException::DxException(HRESULT hr, const std::wstring& functionName, const std::wstring& filename, int lineNumber) :
     ErrorCode(hr),
     FunctionName(functionName),
@@ -79,6 +135,10 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
 	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
 		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
 
+    // Default buffers made here only ever hold vertex and index data.
+    TrackResource(defaultBuffer.Get(), MemoryTag::Geometry);
+    TrackResource(uploadBuffer.Get(), MemoryTag::Uploaders);
+
     // Note: uploadBuffer has to be kept alive after the above function calls because
     // the command list has not been executed yet that performs the actual copy.
     // The caller can Release the uploadBuffer after it knows the copy has been executed.
@@ -87,6 +147,68 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     return defaultBuffer;
 }
 
+ComPtr<ID3D12Resource> d3dUtil::CreateStagedBuffer(
+    ID3D12Device* device,
+    const void* initData,
+    UINT64 byteSize,
+    ComPtr<ID3D12Resource>& uploadBuffer)
+{
+    ComPtr<ID3D12Resource> defaultBuffer;
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(uploadBuffer.GetAddressOf())));
+
+    void* mapped = nullptr;
+    ThrowIfFailed(uploadBuffer->Map(0, nullptr, &mapped));
+    memcpy(mapped, initData, (size_t)byteSize);
+    uploadBuffer->Unmap(0, nullptr);
+
+    TrackResource(defaultBuffer.Get(), MemoryTag::Geometry);
+    TrackResource(uploadBuffer.Get(), MemoryTag::Uploaders);
+
+    // Buffers are promoted from COMMON to COPY_DEST on the copy queue and decay back to
+    // COMMON once it is done, from where the direct queue promotes them to whatever
+    // read state it needs.  So no barriers are recorded for either queue.
+    return defaultBuffer;
+}
+
+UINT64 d3dUtil::EstimateResourceBytes(ID3D12Resource* resource)
+{
+    ComPtr<ID3D12Device> device;
+    ThrowIfFailed(resource->GetDevice(IID_PPV_ARGS(&device)));
+
+    D3D12_RESOURCE_DESC desc = resource->GetDesc();
+    return device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
+void d3dUtil::TrackResource(ID3D12Resource* resource, MemoryTag tag)
+{
+    AttachTrackedMemory(resource, tag, EstimateResourceBytes(resource));
+}
+
+void d3dUtil::TrackDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+    ComPtr<ID3D12Device> device;
+    ThrowIfFailed(heap->GetDevice(IID_PPV_ARGS(&device)));
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc = heap->GetDesc();
+    AttachTrackedMemory(heap, MemoryTag::DescriptorHeaps,
+        (UINT64)desc.NumDescriptors * device->GetDescriptorHandleIncrementSize(desc.Type));
+}
+
 ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
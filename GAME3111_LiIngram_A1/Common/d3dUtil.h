@@ -24,6 +24,7 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "MemoryTracker.h"
 
 extern const int gNumFrameResources;
 
@@ -117,6 +118,26 @@ public:
 		UINT64 byteSize,
 		Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+	// Like CreateDefaultBuffer, but only fills the upload buffer; the caller records the
+	// CopyBufferRegion, on any queue.  The default buffer is left in COMMON.
+	static Microsoft::WRL::ComPtr<ID3D12Resource> CreateStagedBuffer(
+		ID3D12Device* device,
+		const void* initData,
+		UINT64 byteSize,
+		Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
+
+	// What the driver reserves for the resource, alignment and padding included.
+	static UINT64 EstimateResourceBytes(ID3D12Resource* resource);
+
+	///<summary>
+	/// Counts the resource's estimated size as GPU memory under tag until the resource is
+	/// destroyed.  Tracking the same resource again replaces the earlier entry.
+	///</summary>
+	static void TrackResource(ID3D12Resource* resource, MemoryTag tag);
+
+	// Same for a descriptor heap, sized by its descriptor count and increment.
+	static void TrackDescriptorHeap(ID3D12DescriptorHeap* heap);
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
@@ -176,6 +197,8 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> ColorBufferUploader = nullptr;
 
+	// The CPU copies' bytes, for the memory tracker.  The GPU buffers track themselves.
+	TrackedMemory CpuMemory;
 
 
 	// Data about the buffers.
@@ -4,10 +4,29 @@
 //rendering pass such as the eye position, the view and projection matrices, and information
 //about the screen(render target) dimensions; it also includes game timing information
 
+#ifdef OBJECT_DATA_BUFFER
+// Compact per object data (ObjectData in FrameResource.h): the affine part of the world
+// matrix as the three rows of its transpose, 48 bytes per object with no padding.
+struct ObjectData
+{
+	float4 WorldRow0;
+	float4 WorldRow1;
+	float4 WorldRow2;
+};
+
+StructuredBuffer<ObjectData> gObjectData : register(t0);
+
+// Index of the object being drawn, set as a root constant per draw.
+cbuffer cbObjectIndex : register(b2)
+{
+	uint gObjectIndex;
+};
+#else
 cbuffer cbPerObject : register(b0)
 {
 	float4x4 gWorld;
 };
+#endif
 
 cbuffer cbPass : register(b1)
 {
@@ -45,7 +64,14 @@ VertexOut VS(VertexIn vin)
 
 	////step14
 	// Transform to homogeneous clip space.
+#ifdef OBJECT_DATA_BUFFER
+	// The last column of an affine world matrix is (0, 0, 0, 1), so w stays 1.
+	ObjectData obj = gObjectData[gObjectIndex];
+	float4 posL = float4(vin.PosL, 1.0f);
+	float4 posW = float4(dot(obj.WorldRow0, posL), dot(obj.WorldRow1, posL), dot(obj.WorldRow2, posL), 1.0f);
+#else
 	float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+#endif
 	vout.PosH = mul(posW, gViewProj);
 
 	// Just pass vertex color into the pixel shader.
@@ -1,6 +1,9 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT waveVertCount,
+    UINT terrainStagingVertCount, UINT objectDataCount)
+    : Arena(FrameArena::DefaultFrameBytes, FrameArena::DefaultScratchBytes,
+        MemoryTracker::Get().Resource(MemoryTag::FrameArenas))
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -8,6 +11,15 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 
     PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+
+    if (objectDataCount > 0)
+        ObjectDataBuffer = std::make_unique<UploadBuffer<ObjectData>>(device, objectDataCount, false);
+
+    if (waveVertCount > 0)
+        WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
+
+    if (terrainStagingVertCount > 0)
+        TerrainStagingVB = std::make_unique<UploadBuffer<Vertex>>(device, terrainStagingVertCount, false);
 }
 
 FrameResource::~FrameResource()
@@ -3,12 +3,23 @@
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
+#include "../Common/VertexLayout.h"
+#include "../Common/FrameArena.h"
 
 struct ObjectConstants
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 };
 
+// Compact alternative to ObjectConstants for apps that index a structured buffer instead
+// of binding a constant buffer per object.  Only the affine part of the world matrix is
+// kept, stored transposed as three float4 rows (XMStoreFloat3x4), so elements are 48
+// bytes and tightly packed rather than padded to 256.
+struct ObjectData
+{
+    DirectX::XMFLOAT3X4 World;
+};
+
 struct PassConstants
 {
     DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
@@ -33,6 +44,12 @@ struct Vertex
     DirectX::XMFLOAT4 Color;
 };
 
+// Input layout and MeshData converter for Vertex.  Keep this in sync with the struct;
+// a field missing here is a compile error.
+using VertexDesc = VertexLayout<Vertex,
+    VERTEX_ATTRIBUTE(Vertex, Pos, Position),
+    VERTEX_ATTRIBUTE(Vertex, Color, Color)>;
+
 // Step2: we usually use a circular array of three frame resource elements.The idea is that for frame n, the CPU will
 //cycle through the frame resource array to get the next available(i.e., not in use by GPU)
 //frame resource.The CPU will then do any resource updates, and build and submit
@@ -45,7 +62,8 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT waveVertCount = 0,
+        UINT terrainStagingVertCount = 0, UINT objectDataCount = 0);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -59,6 +77,23 @@ public:
     std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
+    // Structured buffer of ObjectData, read by the vertex shader with a per draw index.
+    // Only created when objectDataCount > 0.
+    std::unique_ptr<UploadBuffer<ObjectData>> ObjectDataBuffer = nullptr;
+
+    // We cannot update a dynamic vertex buffer until the GPU is done processing the
+    // commands that reference it.  So each frame needs its own.  Only created when the
+    // demo simulates waves (waveVertCount > 0).
+    std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+
+    // Edited terrain vertices are written here and copied into the static terrain vertex
+    // buffer with CopyBufferRegion.  Per frame for the same reason as the cbuffers.
+    std::unique_ptr<UploadBuffer<Vertex>> TerrainStagingVB = nullptr;
+
+    // Per frame CPU allocations (barrier arrays, draw lists, ...).  Reset along with the
+    // cbuffers once the GPU is done with this frame resource.
+    FrameArena Arena;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
@@ -9,6 +9,14 @@
  *   Hold down '1' key to view scene in wireframe mode.
  *   Hold the left mouse button down and move the mouse to rotate.
  *   Hold the right mouse button down and move the mouse to zoom in and out.
+ *   Click the left mouse button without dragging to pick the triangle under the cursor.
+ *   Press 'O' to switch object data between per object constant buffers and a
+ *   compact structured buffer; the memory and upload counters are logged on each switch.
+ *   Press 'B' to benchmark the picking BVH, the object data update and render graph compiles,
+ *   and to log the command allocator pool.
+ *
+ *   Run with -scene <file> to load the render items from a scene file instead of the built
+ *   in scene; a file that does not exist yet is written from the built in scene first.
  *
  *  @author Hooman Salamat
  */
@@ -18,14 +26,92 @@
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/MeshPacker.h"
+#include "../Common/MeshLod.h"
+#include "../Common/Meshlet.h"
+#include "../Common/OcclusionCuller.h"
+#include "../Common/PickingBvh.h"
+#include "../Common/RenderGraph.h"
+#include "../Common/D3D12CommandBackend.h"
+#include "../Common/D3D12CommandSink.h"
+#include "../Common/FrameStats.h"
+#include "../Common/UploadService.h"
+#include "../Common/PsoCache.h"
+#include "../Common/AssetRegistry.h"
+#include "../Common/SceneFile.h"
 #include "FrameResource.h"
 
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Fewest render items UpdateObjectCBs hands to one thread.  Scenes smaller than this are
+// updated inline without waking the pool.
+const UINT gObjectCBGrainSize = 256;
+
+// Rough allocator space taken by one DrawRenderItems iteration (vertex and index buffer
+// views, topology, root argument and the draw), for the command pool's memory counters.
+const UINT64 gEstimatedDrawCommandBytes = 128;
+
+// Frames recorded by one command capture ('C'), and the file it is written to.
+const UINT gCaptureFrameCount = 60;
+const char* const gCaptureFile = "ShapesApp.cmdcapture";
+
+// Where 'F' writes the frame statistics history.
+const char* const gFrameStatsCsvFile = "ShapesApp.framestats.csv";
+const char* const gFrameStatsJsonFile = "ShapesApp.framestats.json";
+
+// Frame rate the loop is paced to; 'P' switches pacing off and on.
+const double gTargetFrameRate = 60.0;
+
+// The render items come from the built in scene unless a scene file is given with -scene.
+// The scene benchmark writes its file to the temp directory.
+const char* const gSceneBenchmarkFile = "ShapesApp.benchmark.scene";
+const UINT gSceneBenchmarkItems = 100000;
+
+// Scene file PSO buckets.  Everything here draws with the opaque PSOs.
+const std::uint8_t gOpaqueBucket = 0;
+
+// Crossing one of these logs a warning.  Render targets follow the window size and have
+// no budget.
+struct MemoryBudget
+{
+	MemoryTag Tag;
+	MemoryKind Kind;
+	UINT64 Bytes;
+};
+
+const MemoryBudget gMemoryBudgets[] =
+{
+	{ MemoryTag::Geometry, MemoryKind::Cpu, 4 * 1024 * 1024 },
+	{ MemoryTag::Geometry, MemoryKind::Gpu, 8 * 1024 * 1024 },
+	{ MemoryTag::Uploaders, MemoryKind::Gpu, 16 * 1024 * 1024 },
+	{ MemoryTag::FrameResources, MemoryKind::Gpu, 8 * 1024 * 1024 },
+	{ MemoryTag::DescriptorHeaps, MemoryKind::Gpu, 1024 * 1024 },
+	{ MemoryTag::Textures, MemoryKind::Gpu, 256 * 1024 * 1024 },
+	{ MemoryTag::FrameArenas, MemoryKind::Cpu, 8 * 1024 * 1024 },
+};
+
+// A lit, textured vertex packed into 16 bytes instead of 32, for the geometry benchmark to
+// time the half and snorm packing against the plain float copy of VertexDesc.
+struct CompactVertex
+{
+	XMHALF4 Pos;
+	XMBYTEN4 Normal;
+	XMHALF2 TexC;
+};
+
+using CompactVertexDesc = VertexLayout<CompactVertex,
+	VERTEX_ATTRIBUTE(CompactVertex, Pos, Position),
+	VERTEX_ATTRIBUTE(CompactVertex, Normal, Normal),
+	VERTEX_ATTRIBUTE(CompactVertex, TexC, TexCoord)>;
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -48,6 +134,9 @@ struct RenderItem
 
 	MeshGeometry* Geo = nullptr;
 
+	// Id of Geo in the command sink.
+	UINT GeoSinkId = 0;
+
 	// Primitive topology.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -55,18 +144,52 @@ struct RenderItem
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// Optional LOD table.  When set, the DrawIndexedInstanced parameters above are
+	// replaced each frame by the level picked for the current camera.
+	const LodTable* Lod = nullptr;
+	UINT LodLevel = 0;
+
+	// Local space bounds tested against the occlusion buffer each frame.  Occluders are
+	// rasterized into that buffer instead and are never culled themselves.
+	BoundingBox Bounds;
+	bool IsOccluder = false;
+	bool Visible = true;
+};
+
+// CPU stand-in for an UploadBuffer, used to compare object data written by different
+// thread counts without reading back write-combined upload memory.
+template<typename T>
+struct CpuObjectBuffer
+{
+	std::vector<T> Data;
+
+	UINT ElementByteSize()const
+	{
+		return sizeof(T);
+	}
+
+	void CopyData(int elementIndex, const T& data)
+	{
+		Data[elementIndex] = data;
+	}
 };
 
 class ShapesApp : public D3DApp
 {
 public:
-	ShapesApp(HINSTANCE hInstance);
+	// sceneFile may be empty to use the built in scene.
+	ShapesApp(HINSTANCE hInstance, const std::string& sceneFile = "");
 	ShapesApp(const ShapesApp& rhs) = delete;
 	ShapesApp& operator=(const ShapesApp& rhs) = delete;
 	~ShapesApp();
 
 	virtual bool Initialize()override;
 
+	// The path following -scene on the command line, or empty.  Quote it if it has spaces.
+	static std::string SceneFileArgument(const char* cmdLine);
+	static std::string TempFilePath(const char* name);
+
 private:
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
@@ -78,18 +201,57 @@ private:
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateLods(const GameTimer& gt);
+	void UpdateOcclusion(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void UpdateUploads();
+
+	// Writes convert(world) for every dirty item into its slot of buffer, spread over the
+	// pool, and returns the number of bytes written.
+	template<typename TBuffer, typename TConvert>
+	static UINT64 WriteObjectData(const std::vector<std::unique_ptr<RenderItem>>& ritems, TBuffer& buffer,
+		TConvert convert, ThreadPool& pool);
+	static ObjectConstants MakeObjectConstants(FXMMATRIX world);
+	static ObjectData MakeObjectData(FXMMATRIX world);
+	void LogObjectDataStats();
+
+	void Pick(int sx, int sy);
+	void RunPickingBenchmark();
+	void RunObjectDataBenchmark();
+	void RunRenderGraphBenchmark();
+	void LogCommandPoolStats();
+	void LogFrameArenaStats();
+	void LogOcclusionStats();
+	void RunGeometryBenchmark();
+	void RunMeshletBenchmark();
+	void RunSceneBenchmark();
 
 	void BuildDescriptorHeaps();
 	void BuildConstantBufferViews();
 	void BuildRootSignature();
 	void BuildShadersAndInputLayout();
+	void BuildUploadService();
 	void BuildShapeGeometry();
+	void EnqueueGeometryUpload(MeshGeometry* geo, const void* vertices, const void* indices);
 	void BuildPSOs();
 	void BuildFrameResources();
-	void BuildRenderItems();
-	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	std::vector<SceneFile::Item> BuildDefaultScene();
+	bool LoadRenderItems(const SceneFile& scene, std::string* error);
+	bool BuildRenderItems();
+	void BuildPickingScene();
+	void BuildRenderGraph();
+	void BuildCommandSink();
+	void UpdateSinkSwapChain();
+	void SubmitBarriers(const RenderGraph::Barrier* barriers, UINT count);
+	void ReportUploadContents();
+	void FinishCapture();
+	void DumpFrameStats();
+	void SetMemoryBudgets();
+	void LogMemoryStats();
+	void LogFramePacerStats();
+	bool IsGeometryPending(const MeshGeometry* geo)const;
+	void DrawRenderItems(CommandSink& sink, RenderItem* const* ritems, size_t count);
 
 private:
 
@@ -98,16 +260,76 @@ private:
 	int mCurrFrameResourceIndex = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	ComPtr<ID3DBlob> mSerializedRootSignature = nullptr;
 	ComPtr<ID3D12DescriptorHeap> mCbvHeap = nullptr;
 
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
-	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
-	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
-	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	// Assets are registered under compile time hashed names and held by handle.
+	// mSubmeshes mirrors the DrawArgs of every geometry, registered under the same names.
+	AssetRegistry<std::unique_ptr<MeshGeometry>> mGeometries;
+	AssetRegistry<SubmeshGeometry> mSubmeshes;
+	AssetRegistry<ComPtr<ID3DBlob>> mShaders;
+	AssetRegistry<ComPtr<ID3D12PipelineState>> mPSOs;
+	AssetRegistry<LodTable> mLodTables;
+	std::unique_ptr<PsoCache> mPsoCache;
+
+	// Opaque PSOs indexed by [mUseObjectDataBuffer][mIsWireframe].
+	AssetRegistry<ComPtr<ID3D12PipelineState>>::Handle mOpaquePsos[2][2];
+
+	OcclusionCuller mOcclusionCuller;
+
+	// One triangle BVH per submesh and one instance per render item, in mAllRitems order.
+	PickingScene mPickingScene;
+	std::vector<std::string> mPickMeshNames;
+
+	// Passes of a frame.  Compiled once; Draw executes it and translates its barriers.
+	RenderGraph mRenderGraph;
+	RenderGraph::ResourceHandle mBackBufferHandle = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mDepthStencilHandle = RenderGraph::InvalidHandle;
+
+	// Frame command lists come from the pool; mRecordingList is the one Draw is recording.
+	std::unique_ptr<D3D12CommandBackend> mCommandBackend;
+	std::unique_ptr<CommandContextPool> mCommandPool;
+	ID3D12GraphicsCommandList* mRecordingList = nullptr;
+
+	// Draw records through mSink, which counts into mFrameStats and passes the commands
+	// on to the D3D12 sink, or to a capture in front of it while 'C' is capturing frames.
+	// The ids below name objects registered with the sink.
+	std::unique_ptr<D3D12CommandSink> mCommandSink;
+	std::unique_ptr<CommandCapture> mCapture;
+	std::unique_ptr<FrameStatsSink> mStatsSink;
+	CommandSink* mSink = nullptr;
+	UINT mSinkOpaquePsos[2][2];
+	UINT mSinkRootSignature = 0;
+	UINT mSinkCbvHeap = 0;
+	UINT mSinkBackBuffers[SwapChainBufferCount];
+	UINT mSinkBackBufferRtvs[SwapChainBufferCount];
+	UINT mSinkDepthStencil = 0;
+	UINT mSinkDsv = 0;
+
+	struct FrameSinkBuffers
+	{
+		UINT PassCB;
+		UINT ObjectCB;
+		UINT ObjectData;
+	};
+	FrameSinkBuffers mSinkFrameBuffers[gNumFrameResources];
+
+	// Geometry is copied on its own queue by the upload service.  Render items whose
+	// geometry is still in mPendingGeometry are not drawn.  Never more than a handful.
+	ComPtr<ID3D12CommandQueue> mCopyQueue;
+	ComPtr<ID3D12Fence> mCopyFence;
+	UINT64 mCopyFenceValue = 0;
+	std::unique_ptr<D3D12CommandBackend> mCopyBackend;
+	std::unique_ptr<UploadService> mUploadService;
+	std::vector<std::pair<const MeshGeometry*, UploadService::Ticket>> mPendingGeometry;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
+	// Scene file given with -scene; empty for the built in scene.
+	std::string mSceneFile;
+
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
@@ -120,6 +342,15 @@ private:
 
 	bool mIsWireframe = false;
 
+	// Object data path: per object 256 byte constant buffers, or 48 byte ObjectData
+	// elements packed in one structured buffer per frame resource.
+	bool mUseObjectDataBuffer = false;
+	bool mObjectDataKeyDown = false;
+
+	// Bytes written by the last UpdateObjectCBs, and in total since the path was switched.
+	UINT64 mObjectUploadBytes = 0;
+	UINT64 mObjectUploadBytesTotal = 0;
+
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
@@ -129,6 +360,18 @@ private:
 	float mRadius = 15.0f;
 
 	POINT mLastMousePos;
+
+	// A left button press becomes a pick if it is released without dragging.
+	POINT mMouseDownPos;
+	bool mPickPending = false;
+
+	bool mBenchmarkKeyDown = false;
+	bool mCaptureKeyDown = false;
+	bool mFrameStatsKeyDown = false;
+	bool mMemoryKeyDown = false;
+	bool mPacingKeyDown = false;
+
+	FrameStats mFrameStats;
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -141,7 +384,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 	try
 	{
-		ShapesApp theApp(hInstance);
+		ShapesApp theApp(hInstance, ShapesApp::SceneFileArgument(cmdLine));
 		if (!theApp.Initialize())
 			return 0;
 
@@ -154,41 +397,79 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	}
 }
 
-ShapesApp::ShapesApp(HINSTANCE hInstance)
-	: D3DApp(hInstance)
+ShapesApp::ShapesApp(HINSTANCE hInstance, const std::string& sceneFile)
+	: D3DApp(hInstance), mSceneFile(sceneFile)
 {
+	mFramePacer.SetTargetRate(gTargetFrameRate);
+}
+
+std::string ShapesApp::SceneFileArgument(const char* cmdLine)
+{
+	std::istringstream in(cmdLine != nullptr ? cmdLine : "");
+	std::string arg;
+	while (in >> arg)
+	{
+		if (arg != "-scene")
+			continue;
+
+		// Backslashes are path separators here, not escapes.
+		arg.clear();
+		if ((in >> std::ws).peek() == '"')
+			std::getline(in.ignore(), arg, '"');
+		else
+			in >> arg;
+		return arg;
+	}
+	return "";
+}
+
+std::string ShapesApp::TempFilePath(const char* name)
+{
+	char dir[MAX_PATH + 1];
+	DWORD length = GetTempPathA(MAX_PATH + 1, dir);
+	if (length == 0 || length > MAX_PATH)
+		return name;
+	return std::string(dir, length) + name;
 }
 
 ShapesApp::~ShapesApp()
 {
+	// Uploads may still be reading staging buffers owned by the geometry.  A failed
+	// service will never finish its queue, so there is nothing to wait for.
+	if (mUploadService != nullptr && !mUploadService->Failed())
+		mUploadService->WaitIdle();
+
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
 }
 
 bool ShapesApp::Initialize()
 {
+	// Before anything is created, so start up allocations are checked too.
+	SetMemoryBudgets();
+
 	if (!D3DApp::Initialize())
 		return false;
 
-	// Reset the command list to prep for initialization commands.
-	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
-
+	// Nothing is recorded on the direct queue here: geometry goes through the upload
+	// service and is drawn once its copies land, so there is nothing to wait for.
+	BuildUploadService();
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
 	BuildShapeGeometry();
-	BuildRenderItems();
+	if (!BuildRenderItems())
+		return false;
+	BuildPickingScene();
 	BuildFrameResources();
 	BuildDescriptorHeaps();
 	BuildConstantBufferViews();
 	BuildPSOs();
+	BuildRenderGraph();
 
-	// Execute the initialization commands.
-	ThrowIfFailed(mCommandList->Close());
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	mCommandBackend = std::make_unique<D3D12CommandBackend>(md3dDevice.Get(), mFence.Get());
+	mCommandPool = std::make_unique<CommandContextPool>(*mCommandBackend);
 
-	// Wait until initialization is complete.
-	FlushCommandQueue();
+	BuildCommandSink();
 
 	return true;
 }
@@ -197,6 +478,10 @@ void ShapesApp::OnResize()
 {
 	D3DApp::OnResize();
 
+	// The swap chain buffers and the depth buffer were recreated.
+	if (mCommandSink != nullptr)
+		UpdateSinkSwapChain();
+
 	// The window resized, so update the aspect ratio and recompute the projection matrix.
 	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	XMStoreFloat4x4(&mProj, P);
@@ -206,6 +491,8 @@ void ShapesApp::Update(const GameTimer& gt)
 {
 	OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateLods(gt);
+	UpdateOcclusion(gt);
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -215,71 +502,77 @@ void ShapesApp::Update(const GameTimer& gt)
 	// If not, wait until the GPU has completed commands up to this fence point.
 	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
 	{
+		auto waitStart = std::chrono::steady_clock::now();
+
 		HANDLE eventHandle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
 		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
 		WaitForSingleObject(eventHandle, INFINITE);
 		CloseHandle(eventHandle);
+
+		mFrameStats.Add(FrameCounter::FenceWaitMicroseconds, (UINT64)std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - waitStart).count());
 	}
 
+	// Nothing allocated during the frame resource's previous frame is in use any more.
+	mCurrFrameResource->Arena.Reset();
+
 	UpdateObjectCBs(gt);
 	UpdateMainPassCB(gt);
+	UpdateUploads();
 }
 
-void ShapesApp::Draw(const GameTimer& gt)
+void ShapesApp::UpdateUploads()
 {
-	auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
-
-	// Reuse the memory associated with command recording.
-	// We can only reset when the associated command lists have finished execution on the GPU.
-	ThrowIfFailed(cmdListAlloc->Reset());
+	// Drops the staging buffers of finished copies.
+	mUploadService->Retire();
 
-	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
-	// Reusing the command list reuses memory.
-	if (mIsWireframe)
+	for (auto it = mPendingGeometry.begin(); it != mPendingGeometry.end();)
 	{
-		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque_wireframe"].Get()));
+		if (mUploadService->IsReady(it->second))
+			it = mPendingGeometry.erase(it);
+		else
+			++it;
 	}
-	else
-	{
-		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
-	}
-
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
-
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+}
 
-	// Clear the back buffer and depth buffer.
-	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
-	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+void ShapesApp::Draw(const GameTimer& gt)
+{
+	// The pool hands back an open list on an allocator the GPU has finished with, so
+	// there is no per frame allocator to reset here.
+	CommandContextPool::Context context = mCommandPool->Acquire();
+	mRecordingList = mCommandBackend->GetList(context.List);
+	mCommandSink->SetList(mRecordingList);
 
-	// Specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	// Numbered by the fence value the frame will signal.
+	mSink->BeginFrame(mCurrentFence + 1);
+	ReportUploadContents();
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mCbvHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	mSink->SetPipelineState(mSinkOpaquePsos[mUseObjectDataBuffer][mIsWireframe]);
 
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	mSink->SetViewport({ mScreenViewport.TopLeftX, mScreenViewport.TopLeftY, mScreenViewport.Width,
+		mScreenViewport.Height, mScreenViewport.MinDepth, mScreenViewport.MaxDepth });
+	mSink->SetScissorRect({ mScissorRect.left, mScissorRect.top, mScissorRect.right, mScissorRect.bottom });
 
-	int passCbvIndex = mPassCbvOffset + mCurrFrameResourceIndex;
-	auto passCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-	passCbvHandle.Offset(passCbvIndex, mCbvSrvUavDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
+	// The render graph records the passes with the barriers between them.
+	mRenderGraph.Execute([this](const RenderGraph::Barrier* barriers, UINT count)
+	{
+		SubmitBarriers(barriers, count);
+	});
 
-	DrawRenderItems(mCommandList.Get(), mOpaqueRitems);
+	mSink->EndFrame();
+	if (mCapture != nullptr && mCapture->IsComplete())
+		FinishCapture();
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	// D3D12 does not report allocator sizes, so count a rough figure per draw.
+	mCommandPool->AddRecordedBytes(context, mOpaqueRitems.size() * gEstimatedDrawCommandBytes);
 
 	// Done recording commands.
-	ThrowIfFailed(mCommandList->Close());
+	mCommandPool->Close(context);
 
 	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	ID3D12CommandList* cmdsLists[] = { mRecordingList };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	mRecordingList = nullptr;
 
 	// Swap the back and front buffers
 	ThrowIfFailed(mSwapChain->Present(0, 0));
@@ -292,6 +585,182 @@ void ShapesApp::Draw(const GameTimer& gt)
 	// Because we are on the GPU timeline, the new fence point won't be 
 	// set until the GPU finishes processing all the commands prior to this Signal().
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+
+	// The list can be reused at once, its allocator once the GPU reaches the fence.
+	mCommandPool->Release(context, mCurrentFence);
+
+	mFrameStats.EndFrame();
+}
+
+void ShapesApp::SubmitBarriers(const RenderGraph::Barrier* barriers, UINT count)
+{
+	// Only imported resources so far; transients would be placed resources in a heap
+	// sized by mRenderGraph.GetHeapSize(), registered with the sink like these.
+	auto resource = [this](RenderGraph::ResourceHandle handle) -> UINT
+	{
+		if (handle == mBackBufferHandle)
+			return mSinkBackBuffers[mCurrBackBuffer];
+		if (handle == mDepthStencilHandle)
+			return mSinkDepthStencil;
+		return ~0u;
+	};
+
+	std::pmr::vector<CommandSink::Barrier> sinkBarriers(count, &mCurrFrameResource->Arena.Frame());
+	for (UINT i = 0; i < count; ++i)
+	{
+		const RenderGraph::Barrier& b = barriers[i];
+		CommandSink::Barrier& out = sinkBarriers[i];
+		out.Resource = resource(b.Resource);
+		switch (b.Type)
+		{
+		case RenderGraph::Barrier::Kind::Transition:
+			out.Type = CommandSink::Barrier::Kind::Transition;
+			out.Before = b.Before;
+			out.After = b.After;
+			break;
+		case RenderGraph::Barrier::Kind::Aliasing:
+			out.Type = CommandSink::Barrier::Kind::Aliasing;
+			out.Other = b.AliasBefore == RenderGraph::InvalidHandle ? ~0u : resource(b.AliasBefore);
+			break;
+		case RenderGraph::Barrier::Kind::UnorderedAccess:
+			out.Type = CommandSink::Barrier::Kind::UnorderedAccess;
+			break;
+		}
+	}
+
+	mSink->ResourceBarriers(sinkBarriers.data(), count);
+}
+
+void ShapesApp::ReportUploadContents()
+{
+	// Only a capture reads the data; the D3D12 sink ignores it, so this costs nothing
+	// outside one.
+	const FrameSinkBuffers& ids = mSinkFrameBuffers[mCurrFrameResourceIndex];
+	FrameResource* frame = mCurrFrameResource;
+
+	mSink->UploadContents(ids.PassCB, frame->PassCB->MappedBytes(), frame->PassCB->ByteSize());
+	if (mUseObjectDataBuffer)
+		mSink->UploadContents(ids.ObjectData, frame->ObjectDataBuffer->MappedBytes(), frame->ObjectDataBuffer->ByteSize());
+	else
+		mSink->UploadContents(ids.ObjectCB, frame->ObjectCB->MappedBytes(), frame->ObjectCB->ByteSize());
+}
+
+void ShapesApp::FinishCapture()
+{
+	std::wostringstream out;
+	if (!mCapture->Save(gCaptureFile))
+	{
+		out << L"Command capture: could not write " << gCaptureFile << L"\n";
+	}
+	else
+	{
+		// Replay the file straight away against the null sink, as the offline tool would.
+		std::string error;
+		std::vector<std::uint8_t> data = CommandReplay::Load(gCaptureFile, &error);
+
+		NullCommandSink nullSink;
+		CommandReplay::Stats stats;
+		bool ok = !data.empty() && CommandReplay::Replay(data, nullSink, stats, &error);
+
+		out << L"Command capture: " << mCapture->CapturedFrames() << L" frames, " << data.size() << L" bytes in "
+			<< gCaptureFile << L"; replay " << (ok ? L"ok" : L"failed") << L", " << stats.Commands << L" commands, "
+			<< nullSink.DrawCount() << L" draws, " << stats.Milliseconds << L" ms\n";
+		if (!ok)
+			out << L"  " << AnsiToWString(error) << L"\n";
+
+		for (UINT i = 0; i < (UINT)CommandOp::Count; ++i)
+		{
+			const CommandReplay::OpStats& op = stats.Ops[i];
+			if (op.Count > 0)
+			{
+				out << L"  " << AnsiToWString(CommandReplay::OpName((CommandOp)i)) << L": " << op.Count << L" calls, "
+					<< op.Microseconds / op.Count << L" us each\n";
+			}
+		}
+	}
+	OutputDebugString(out.str().c_str());
+
+	mStatsSink->SetNext(mCommandSink.get());
+	mCapture.reset();
+}
+
+void ShapesApp::DumpFrameStats()
+{
+	std::wostringstream out;
+	bool written = mFrameStats.WriteCsv(gFrameStatsCsvFile) && mFrameStats.WriteJson(gFrameStatsJsonFile);
+	out << L"Frame stats: " << mFrameStats.FrameCount() << L" frames " << (written ? L"written to " : L"could not be written to ")
+		<< gFrameStatsCsvFile << L" and " << gFrameStatsJsonFile << L"\n";
+
+	for (UINT i = 0; i < (UINT)FrameCounter::Count; ++i)
+	{
+		FrameStats::Summary summary = mFrameStats.GetSummary((FrameCounter)i);
+		out << L"  " << AnsiToWString(FrameStats::CounterName((FrameCounter)i)) << L": min " << summary.Min
+			<< L", mean " << summary.Mean << L", p95 " << summary.P95 << L", max " << summary.Max << L"\n";
+	}
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::SetMemoryBudgets()
+{
+	MemoryTracker& tracker = MemoryTracker::Get();
+	for (const MemoryBudget& budget : gMemoryBudgets)
+		tracker.SetBudget(budget.Tag, budget.Kind, budget.Bytes);
+
+	// May run on the upload worker; OutputDebugString is fine from any thread.
+	tracker.SetWarningFunc([](const MemoryTracker::BudgetWarning& warning)
+	{
+		std::wostringstream out;
+		out << L"Memory budget exceeded: " << AnsiToWString(MemoryTracker::TagName(warning.Tag)) << L" "
+			<< AnsiToWString(MemoryTracker::KindName(warning.Kind)) << L" at " << warning.Bytes << L" bytes, budget "
+			<< warning.Budget << L"\n";
+		OutputDebugString(out.str().c_str());
+	});
+}
+
+void ShapesApp::LogMemoryStats()
+{
+	MemoryTracker::Snapshot snapshot = MemoryTracker::Get().GetSnapshot();
+
+	std::wostringstream out;
+	out << L"Memory: " << snapshot.TotalBytes[(size_t)MemoryKind::Cpu] << L" CPU bytes, "
+		<< snapshot.TotalBytes[(size_t)MemoryKind::Gpu] << L" GPU bytes (estimated)\n";
+	for (UINT t = 0; t < (UINT)MemoryTag::Count; ++t)
+	{
+		for (UINT k = 0; k < (UINT)MemoryKind::Count; ++k)
+		{
+			const MemoryTracker::Counter& c = snapshot.Counters[t][k];
+			if (c.TotalAllocations == 0)
+				continue;
+
+			out << L"  " << AnsiToWString(MemoryTracker::TagName((MemoryTag)t)) << L" "
+				<< AnsiToWString(MemoryTracker::KindName((MemoryKind)k)) << L": " << c.Bytes << L" bytes in "
+				<< c.Allocations << L" allocations, peak " << c.PeakBytes;
+			if (c.Budget != 0)
+			{
+				out << L", budget " << c.Budget
+					<< (snapshot.OverBudget((MemoryTag)t, (MemoryKind)k) ? L" (over)" : L"");
+			}
+			out << L"\n";
+		}
+	}
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::LogFramePacerStats()
+{
+	FramePacer::Stats stats = mFramePacer.GetStats();
+
+	std::wostringstream out;
+	out << L"Frame pacing: ";
+	if (mFramePacer.IsPaced())
+		out << L"target " << stats.TargetMilliseconds << L" ms";
+	else
+		out << L"unpaced";
+	out << L", " << stats.Frames << L" frames, mean " << stats.MeanIntervalMilliseconds << L" ms, jitter "
+		<< stats.JitterMilliseconds << L" ms, max deadline error " << stats.MaxErrorMilliseconds << L" ms, "
+		<< stats.MissedFrames << L" missed; waited " << stats.SleepMilliseconds << L" ms asleep, "
+		<< stats.SpinMilliseconds << L" ms spinning; sleep estimate " << stats.SleepEstimateMilliseconds << L" ms\n";
+	OutputDebugString(out.str().c_str());
 }
 
 void ShapesApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -299,12 +768,21 @@ void ShapesApp::OnMouseDown(WPARAM btnState, int x, int y)
 	mLastMousePos.x = x;
 	mLastMousePos.y = y;
 
+	mMouseDownPos = mLastMousePos;
+	mPickPending = (btnState & MK_LBUTTON) != 0;
+
 	SetCapture(mhMainWnd);
 }
 
 void ShapesApp::OnMouseUp(WPARAM btnState, int x, int y)
 {
 	ReleaseCapture();
+
+	// Anything more than a couple of pixels of movement was an orbit, not a click.
+	if (mPickPending && abs(x - mMouseDownPos.x) <= 2 && abs(y - mMouseDownPos.y) <= 2)
+		Pick(x, y);
+
+	mPickPending = false;
 }
 
 void ShapesApp::OnMouseMove(WPARAM btnState, int x, int y)
@@ -345,6 +823,61 @@ void ShapesApp::OnKeyboardInput(const GameTimer& gt)
 		mIsWireframe = true;
 	else
 		mIsWireframe = false;
+
+	bool benchmarkKeyDown = (GetAsyncKeyState('B') & 0x8000) != 0;
+	if (benchmarkKeyDown && !mBenchmarkKeyDown)
+	{
+		RunPickingBenchmark();
+		RunObjectDataBenchmark();
+		RunRenderGraphBenchmark();
+		LogCommandPoolStats();
+		LogFrameArenaStats();
+		LogOcclusionStats();
+		RunGeometryBenchmark();
+		RunMeshletBenchmark();
+		RunSceneBenchmark();
+	}
+	mBenchmarkKeyDown = benchmarkKeyDown;
+
+	bool captureKeyDown = (GetAsyncKeyState('C') & 0x8000) != 0;
+	if (captureKeyDown && !mCaptureKeyDown && mCapture == nullptr)
+	{
+		mCapture = std::make_unique<CommandCapture>(gCaptureFrameCount, mCommandSink.get());
+		mStatsSink->SetNext(mCapture.get());
+	}
+	mCaptureKeyDown = captureKeyDown;
+
+	bool frameStatsKeyDown = (GetAsyncKeyState('F') & 0x8000) != 0;
+	if (frameStatsKeyDown && !mFrameStatsKeyDown)
+		DumpFrameStats();
+	mFrameStatsKeyDown = frameStatsKeyDown;
+
+	bool memoryKeyDown = (GetAsyncKeyState('M') & 0x8000) != 0;
+	if (memoryKeyDown && !mMemoryKeyDown)
+		LogMemoryStats();
+	mMemoryKeyDown = memoryKeyDown;
+
+	bool pacingKeyDown = (GetAsyncKeyState('P') & 0x8000) != 0;
+	if (pacingKeyDown && !mPacingKeyDown)
+	{
+		LogFramePacerStats();
+		mFramePacer.SetTargetRate(mFramePacer.IsPaced() ? 0.0 : gTargetFrameRate);
+		mFramePacer.ResetStats();
+	}
+	mPacingKeyDown = pacingKeyDown;
+
+	bool objectDataKeyDown = (GetAsyncKeyState('O') & 0x8000) != 0;
+	if (objectDataKeyDown && !mObjectDataKeyDown)
+	{
+		LogObjectDataStats();
+
+		// The other path's buffers are stale, so every frame resource needs a full update.
+		mUseObjectDataBuffer = !mUseObjectDataBuffer;
+		mObjectUploadBytesTotal = 0;
+		for (auto& e : mAllRitems)
+			e->NumFramesDirty = gNumFrameResources;
+	}
+	mObjectDataKeyDown = objectDataKeyDown;
 }
 
 void ShapesApp::UpdateCamera(const GameTimer& gt)
@@ -363,26 +896,140 @@ void ShapesApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
-void ShapesApp::UpdateObjectCBs(const GameTimer& gt)
+void ShapesApp::UpdateLods(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+	// Element (1,1) of the projection matrix is 1/tan(fovY/2).
+	float projScaleY = mProj(1, 1);
+
 	for (auto& e : mAllRitems)
 	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
+		if (e->Lod == nullptr)
+			continue;
+
+		// Every level covers the same shape, so the finest level's bounds serve for all.
+		float screenSize = LodSelector::ProjectedScreenSize(e->Lod->Levels[0].Bounds,
+			e->World, mEyePos, projScaleY);
+
+		e->LodLevel = LodSelector::SelectLevel(*e->Lod, e->LodLevel, screenSize);
+
+		// Switching level only changes the draw arguments; the object constants are untouched.
+		const SubmeshGeometry& level = e->Lod->Levels[e->LodLevel];
+		e->IndexCount = level.IndexCount;
+		e->StartIndexLocation = level.StartIndexLocation;
+		e->BaseVertexLocation = level.BaseVertexLocation;
+	}
+}
+
+void ShapesApp::UpdateOcclusion(const GameTimer& gt)
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&mView), XMLoadFloat4x4(&mProj)));
+	mOcclusionCuller.BeginFrame(viewProj);
+
+	// Occluders are rasterized straight from the CPU copies of the shared buffers.
+	for (auto& e : mAllRitems)
+	{
+		if (!e->IsOccluder)
+			continue;
+
+		const MeshGeometry* geo = e->Geo;
+		const BYTE* vertices = (const BYTE*)geo->VertexBufferCPU->GetBufferPointer() +
+			e->BaseVertexLocation * geo->VertexByteStride + offsetof(Vertex, Pos);
+		const std::uint16_t* indices = (const std::uint16_t*)geo->IndexBufferCPU->GetBufferPointer() +
+			e->StartIndexLocation;
+
+		mOcclusionCuller.AddOccluder((const XMFLOAT3*)vertices, geo->VertexByteStride,
+			indices, e->IndexCount, e->World);
+	}
+
+	mOcclusionCuller.RasterizeOccluders();
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+	for (auto& e : mAllRitems)
+		e->Visible = e->IsOccluder || mOcclusionCuller.IsVisible(e->Bounds, e->World);
+}
+
+ObjectConstants ShapesApp::MakeObjectConstants(FXMMATRIX world)
+{
+	ObjectConstants objConstants;
+	XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+	return objConstants;
+}
+
+ObjectData ShapesApp::MakeObjectData(FXMMATRIX world)
+{
+	// XMStoreFloat3x4 keeps the affine part and stores it transposed, as the shader expects.
+	ObjectData objData;
+	XMStoreFloat3x4(&objData.World, world);
+	return objData;
+}
+
+template<typename TBuffer, typename TConvert>
+UINT64 ShapesApp::WriteObjectData(const std::vector<std::unique_ptr<RenderItem>>& ritems, TBuffer& buffer,
+	TConvert convert, ThreadPool& pool)
+{
+	using TData = decltype(convert(XMMatrixIdentity()));
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+	// Each item only touches its own dirty count and its own slot, so ranges of items can
+	// run on any thread.  The render items get consecutive ObjCBIndex values, so cache line
+	// aligned chunks of items also write cache line aligned runs of slots.
+	UINT grain = ThreadPool::CacheAlignedGrain(buffer.ElementByteSize(), gObjectCBGrainSize);
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
+	std::atomic<UINT> writeCount{ 0 };
+	pool.ParallelFor((UINT)ritems.size(), grain, [&](UINT begin, UINT end, UINT slot)
+	{
+		UINT localWrites = 0;
+		for (UINT i = begin; i < end; ++i)
+		{
+			RenderItem* e = ritems[i].get();
+
+			// Only update the cbuffer data if the constants have changed.  
+			// This needs to be tracked per frame resource.
+			if (e->NumFramesDirty > 0)
+			{
+				buffer.CopyData(e->ObjCBIndex, convert(XMLoadFloat4x4(&e->World)));
+
+				// Next FrameResource need to be updated too.
+				e->NumFramesDirty--;
+				++localWrites;
+			}
 		}
+		writeCount += localWrites;
+	});
+
+	return (UINT64)writeCount * sizeof(TData);
+}
+
+void ShapesApp::UpdateObjectCBs(const GameTimer& gt)
+{
+	if (mUseObjectDataBuffer)
+	{
+		mObjectUploadBytes = WriteObjectData(mAllRitems, *mCurrFrameResource->ObjectDataBuffer,
+			MakeObjectData, ThreadPool::Get());
+		mFrameStats.Add(FrameCounter::DirtyObjects, mObjectUploadBytes / sizeof(ObjectData));
+	}
+	else
+	{
+		mObjectUploadBytes = WriteObjectData(mAllRitems, *mCurrFrameResource->ObjectCB,
+			MakeObjectConstants, ThreadPool::Get());
+		mFrameStats.Add(FrameCounter::DirtyObjects, mObjectUploadBytes / sizeof(ObjectConstants));
 	}
+
+	mObjectUploadBytesTotal += mObjectUploadBytes;
+	mFrameStats.Add(FrameCounter::UploadBytes, mObjectUploadBytes);
+}
+
+void ShapesApp::LogObjectDataStats()
+{
+	UINT bytesPerObject = mUseObjectDataBuffer ? mFrameResources[0]->ObjectDataBuffer->ElementByteSize() :
+		mFrameResources[0]->ObjectCB->ElementByteSize();
+
+	std::wostringstream out;
+	out << L"Object data: " << (mUseObjectDataBuffer ? L"3x4 structured buffer" : L"4x4 constant buffers")
+		<< L", " << bytesPerObject << L" bytes per object, "
+		<< (UINT64)bytesPerObject * mAllRitems.size() * gNumFrameResources << L" bytes over "
+		<< gNumFrameResources << L" frame resources; last update wrote " << mObjectUploadBytes
+		<< L" bytes, " << mObjectUploadBytesTotal << L" bytes since switching\n";
+	OutputDebugString(out.str().c_str());
 }
 
 void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
@@ -411,6 +1058,321 @@ void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
 
 	auto currPassCB = mCurrFrameResource->PassCB.get();
 	currPassCB->CopyData(0, mMainPassCB);
+	mFrameStats.Add(FrameCounter::UploadBytes, sizeof(PassConstants));
+}
+
+void ShapesApp::Pick(int sx, int sy)
+{
+	// Compute picking ray in view space.
+	float vx = (+2.0f * sx / mClientWidth - 1.0f) / mProj(0, 0);
+	float vy = (-2.0f * sy / mClientHeight + 1.0f) / mProj(1, 1);
+
+	// Transform the ray to world space; the scene moves it into each object's local space.
+	XMMATRIX V = XMLoadFloat4x4(&mView);
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
+
+	XMFLOAT3 origin;
+	XMFLOAT3 dir;
+	XMStoreFloat3(&origin, XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), invView));
+	XMStoreFloat3(&dir, XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView));
+
+	std::wostringstream out;
+
+	PickingScene::Hit hit;
+	if (mPickingScene.Raycast(origin, dir, &hit))
+	{
+		const TriangleHit& tri = hit.Triangle;
+		out << L"Picked render item " << hit.Instance << L" ("
+			<< std::wstring(mPickMeshNames[hit.Mesh].begin(), mPickMeshNames[hit.Mesh].end())
+			<< L"), triangle " << tri.Triangle << L", barycentrics (" << 1.0f - tri.U - tri.V
+			<< L", " << tri.U << L", " << tri.V << L"), distance " << tri.Distance << L"\n";
+	}
+	else
+	{
+		out << L"Picked nothing\n";
+	}
+
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::RunPickingBenchmark()
+{
+	const PickingScene::Stats& stats = mPickingScene.GetStats();
+
+	std::wostringstream out;
+	out << L"Picking BVH: " << stats.MeshCount << L" meshes, " << stats.TriangleCount << L" triangles, "
+		<< stats.InstanceCount << L" instances, mesh build " << stats.MeshBuildMilliseconds
+		<< L" ms, top level build " << stats.TopLevelBuildMilliseconds << L" ms\n";
+
+	for (UINT i = 0; i < mPickingScene.MeshCount(); ++i)
+	{
+		const TriangleBvh::BuildStats& mesh = mPickingScene.GetMesh(i).GetStats();
+		out << L"  " << std::wstring(mPickMeshNames[i].begin(), mPickMeshNames[i].end()) << L": "
+			<< mesh.TriangleCount << L" triangles, " << mesh.NodeCount << L" nodes, depth "
+			<< mesh.MaxDepth << L", " << mesh.Milliseconds << L" ms\n";
+	}
+
+	PickingScene::BenchmarkResult result = PickingScene::Benchmark(mPickingScene, 1 << 20);
+	out << L"Picking rays: " << result.RayCount << L" rays, " << result.HitCount << L" hits, "
+		<< result.Milliseconds << L" ms (" << result.RaysPerSecond() / 1.0e6 << L" M rays/s)\n";
+
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::RunObjectDataBenchmark()
+{
+	const UINT counts[] = { 10000, 100000, 1000000 };
+	const int repeats = 5;
+
+	ThreadPool serialPool(0);
+	ThreadPool& parallelPool = ThreadPool::Get();
+
+	for (UINT count : counts)
+	{
+		std::vector<std::unique_ptr<RenderItem>> ritems(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			ritems[i] = std::make_unique<RenderItem>();
+			ritems[i]->ObjCBIndex = i;
+			XMStoreFloat4x4(&ritems[i]->World, XMMatrixRotationY(0.001f * i) *
+				XMMatrixTranslation((float)(i % 1000), 0.0f, (float)(i / 1000)));
+		}
+
+		// Best of a few runs, with every item dirty for exactly one write per run.
+		UINT64 bytesWritten = 0;
+		auto timeWrites = [&](auto& buffer, auto convert, ThreadPool& pool)
+		{
+			double best = DBL_MAX;
+			for (int r = 0; r < repeats; ++r)
+			{
+				for (auto& e : ritems)
+					e->NumFramesDirty = 1;
+
+				auto start = std::chrono::steady_clock::now();
+				bytesWritten = WriteObjectData(ritems, buffer, convert, pool);
+				best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+			return best;
+		};
+
+		std::wostringstream out;
+		out << L"Object data update, " << count << L" items:\n";
+
+		auto runPath = [&](const wchar_t* name, auto& buffer, auto convert)
+		{
+			double serialMs = timeWrites(buffer, convert, serialPool);
+			double parallelMs = timeWrites(buffer, convert, parallelPool);
+
+			// The output must not depend on how the items were split between threads.
+			using TData = decltype(convert(XMMatrixIdentity()));
+			CpuObjectBuffer<TData> serialCopy;
+			CpuObjectBuffer<TData> parallelCopy;
+			serialCopy.Data.resize(count);
+			parallelCopy.Data.resize(count);
+			timeWrites(serialCopy, convert, serialPool);
+			timeWrites(parallelCopy, convert, parallelPool);
+			bool identical = memcmp(serialCopy.Data.data(), parallelCopy.Data.data(), count * sizeof(TData)) == 0;
+
+			out << L"  " << name << L": " << buffer.ElementByteSize() << L" bytes per object ("
+				<< (UINT64)buffer.ElementByteSize() * count << L" bytes), " << bytesWritten
+				<< L" bytes uploaded; serial " << serialMs << L" ms, " << parallelPool.SlotCount()
+				<< L" threads " << parallelMs << L" ms (" << serialMs / std::max(parallelMs, 1e-6) << L"x), "
+				<< (identical ? L"identical" : L"MISMATCH") << L"\n";
+		};
+
+		// Tagged Other, which has no budget: these are scratch buffers, not frame resources,
+		// and must not trip the FrameResources budget or leave its peak at a million objects.
+		{
+			UploadBuffer<ObjectConstants> objectCB(md3dDevice.Get(), count, true, MemoryTag::Other);
+			runPath(L"4x4 constant buffers", objectCB, MakeObjectConstants);
+		}
+		{
+			UploadBuffer<ObjectData> objectData(md3dDevice.Get(), count, false, MemoryTag::Other);
+			runPath(L"3x4 structured buffer", objectData, MakeObjectData);
+		}
+
+		OutputDebugString(out.str().c_str());
+	}
+}
+
+void ShapesApp::RunRenderGraphBenchmark()
+{
+	const RenderGraph::Stats& frame = mRenderGraph.GetStats();
+
+	std::wostringstream out;
+	out << L"Render graph: " << frame.PassCount << L" passes, " << frame.BarrierCount << L" barriers in "
+		<< frame.BatchCount << L" batches, compile " << frame.CompileMilliseconds << L" ms\n";
+
+	const UINT passCounts[] = { 32, 256, 1024 };
+	for (UINT passCount : passCounts)
+	{
+		RenderGraph::BenchmarkResult result = RenderGraph::Benchmark(passCount, 100);
+		const RenderGraph::Stats& stats = result.LastStats;
+		out << L"  synthetic " << passCount << L" passes: " << stats.CulledPassCount << L" culled, "
+			<< stats.BarrierCount << L" barriers in " << stats.BatchCount << L" batches, transients "
+			<< stats.TransientBytes / (1024 * 1024) << L" MB aliased into " << stats.HeapBytes / (1024 * 1024)
+			<< L" MB; " << result.Milliseconds / result.Iterations << L" ms per compile ("
+			<< result.CompilesPerSecond() << L" compiles/s)\n";
+	}
+
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::LogCommandPoolStats()
+{
+	CommandContextPool::Stats stats = mCommandPool->GetStats();
+
+	std::wostringstream out;
+	out << L"Command pool: " << stats.AllocatorCount << L" allocators (" << stats.InFlight << L" in flight), "
+		<< stats.ListCount << L" lists, " << stats.Acquires << L" acquires, " << stats.AllocatorsReused
+		<< L" reused, " << stats.ThreadHits << L" on the same thread; peak " << stats.PeakBytes
+		<< L" bytes per allocator, " << stats.TotalPeakBytes << L" bytes held (estimated)\n";
+
+	for (UINT i = 0; i < mCommandPool->AllocatorCount(); ++i)
+	{
+		CommandContextPool::AllocatorStats allocator = mCommandPool->GetAllocatorStats(i);
+		out << L"  allocator " << i << L": " << allocator.Uses << L" uses, " << allocator.Resets
+			<< L" resets, peak " << allocator.PeakBytes << L" bytes\n";
+	}
+
+	OutputDebugString(out.str().c_str());
+}
+
+// Counters of the last UpdateOcclusion; BeginFrame resets them.
+void ShapesApp::LogOcclusionStats()
+{
+	OcclusionCuller::Stats stats = mOcclusionCuller.GetStats();
+
+	std::wostringstream out;
+	out << L"Occlusion culling: " << stats.OccluderTriangles << L" occluder triangles, "
+		<< stats.RasterizedTriangles << L" rasterized in " << stats.RasterMilliseconds << L" ms; "
+		<< stats.Tested << L" tested in " << stats.TestMilliseconds << L" ms: " << stats.Visible << L" visible, "
+		<< stats.Occluded << L" occluded, " << stats.FrustumCulled << L" outside the frustum\n";
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::LogFrameArenaStats()
+{
+	std::wostringstream out;
+	out << L"Frame arenas:\n";
+	for (int i = 0; i < gNumFrameResources; ++i)
+	{
+		const LinearArena::Stats& last = mFrameResources[i]->Arena.GetLastFrameStats();
+		out << L"  frame resource " << i << L": " << last.Allocations << L" allocations, " << last.Bytes
+			<< L" bytes, " << last.UpstreamAllocations << L" heap calls last frame; " << last.Capacity
+			<< L" bytes held, " << last.TotalUpstreamAllocations << L" heap calls in total\n";
+	}
+
+	const UINT itemCounts[] = { 1000, 10000, 100000 };
+	for (UINT itemCount : itemCounts)
+	{
+		FrameArena::BenchmarkResult result = FrameArena::Benchmark(itemCount, 100);
+		out << L"  synthetic " << itemCount << L" item lists: heap " << result.HeapMilliseconds / result.Frames
+			<< L" ms, " << result.HeapCallsPerFrame << L" heap calls per frame; scratch arenas "
+			<< result.ArenaMilliseconds / result.Frames << L" ms, " << result.ArenaCallsPerFrame
+			<< L" heap calls per frame\n";
+	}
+
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::RunGeometryBenchmark()
+{
+	GeometryGenerator::BenchmarkResult result = GeometryGenerator::Benchmark(1000);
+
+	std::wostringstream out;
+	out << L"Geometry generator: " << result.MeshCount << L" meshes in " << result.Milliseconds << L" ms, "
+		<< result.Allocations << L" allocations (" << result.AllocationsPerMesh() << L" per mesh), "
+		<< result.Bytes / 1024 << L" KB\n";
+
+	// Vertex conversion: the batched Convert against one ConvertVertex call per vertex.
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData sphere = geoGen.CreateGeosphere(1.0f, 6);
+	const size_t vertexCount = sphere.Vertices.size();
+	std::vector<Vertex> vertices(vertexCount);
+	std::vector<CompactVertex> compact(vertexCount);
+
+	auto bestOf = [](auto convert)
+	{
+		double best = DBL_MAX;
+		for (int r = 0; r < 5; ++r)
+		{
+			auto start = std::chrono::steady_clock::now();
+			convert();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	};
+
+	double floatMs = bestOf([&]() { VertexDesc::Convert(sphere, vertices.data()); });
+	double compactMs = bestOf([&]() { CompactVertexDesc::Convert(sphere, compact.data()); });
+	double perVertexMs = bestOf([&]()
+	{
+		for (size_t i = 0; i < vertexCount; ++i)
+			compact[i] = CompactVertexDesc::ConvertVertex(sphere.Vertices[i]);
+	});
+
+	out << L"Vertex conversion, " << vertexCount << L" vertices: float " << floatMs << L" ms, half/snorm "
+		<< compactMs << L" ms batched, " << perVertexMs << L" ms one vertex at a time\n";
+	OutputDebugString(out.str().c_str());
+}
+
+// Splits a dense geosphere and grid into meshlets, checks the result with Validate and
+// counts the meshlets the cone test would cull from the current eye position.
+void ShapesApp::RunMeshletBenchmark()
+{
+	GeometryGenerator geoGen;
+	std::wostringstream out;
+
+	auto runMesh = [&](const wchar_t* name, const GeometryGenerator::MeshData& mesh)
+	{
+		auto start = std::chrono::steady_clock::now();
+		MeshletData meshlets = MeshletBuilder::Build(mesh);
+		double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::string error;
+		bool valid = MeshletBuilder::Validate(mesh, meshlets, MeshletBuilder::MaxVertices,
+			MeshletBuilder::MaxTriangles, &error);
+
+		// The meshlet index buffer must cover the mesh triangle for triangle.
+		std::vector<MeshletBuilder::uint32> indices = MeshletBuilder::BuildIndexBuffer(meshlets);
+		if (valid && indices.size() != mesh.Indices32.size())
+		{
+			valid = false;
+			error = "index buffer size does not match the source mesh";
+		}
+
+		size_t backfacing = 0;
+		for (const MeshletBounds& bounds : meshlets.Bounds)
+		{
+			if (MeshletBuilder::IsBackfacing(bounds, mEyePos))
+				++backfacing;
+		}
+
+		out << L"Meshlets, " << name << L": " << mesh.Indices32.size() / 3 << L" triangles in "
+			<< meshlets.Meshlets.size() << L" meshlets (" << meshlets.VertexIndices.size() << L" vertex references for "
+			<< mesh.Vertices.size() << L" vertices) in " << buildMs << L" ms; " << backfacing
+			<< L" backfacing from the eye; ";
+		if (valid)
+			out << L"valid\n";
+		else
+			out << L"INVALID: " << AnsiToWString(error) << L"\n";
+	};
+
+	runMesh(L"geosphere", geoGen.CreateGeosphere(1.0f, 6));
+	runMesh(L"grid", geoGen.CreateGrid(100.0f, 100.0f, 256, 256));
+	OutputDebugString(out.str().c_str());
+}
+
+void ShapesApp::RunSceneBenchmark()
+{
+	SceneFile::BenchmarkResult result = SceneFile::Benchmark(TempFilePath(gSceneBenchmarkFile), gSceneBenchmarkItems);
+
+	std::wostringstream out;
+	out << L"Scene file: " << result.ItemCount << L" items, " << result.FileBytes / 1024 << L" KB; saved in "
+		<< result.SaveMilliseconds << L" ms, mapped and validated in " << result.OpenMilliseconds
+		<< L" ms, read in " << result.ReadMilliseconds << L" ms\n";
+	OutputDebugString(out.str().c_str());
 }
 
 void ShapesApp::BuildDescriptorHeaps()
@@ -431,6 +1393,7 @@ void ShapesApp::BuildDescriptorHeaps()
 	cbvHeapDesc.NodeMask = 0;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&cbvHeapDesc,
 		IID_PPV_ARGS(&mCbvHeap)));
+	d3dUtil::TrackDescriptorHeap(mCbvHeap.Get());
 }
 
 void ShapesApp::BuildConstantBufferViews()
@@ -482,6 +1445,9 @@ void ShapesApp::BuildConstantBufferViews()
 
 		md3dDevice->CreateConstantBufferView(&cbvDesc, handle);
 	}
+
+	// Written once, so these all count towards the first frame.
+	mFrameStats.Add(FrameCounter::DescriptorsWritten, (objCount + 1) * gNumFrameResources);
 }
 
 void ShapesApp::BuildRootSignature()
@@ -493,14 +1459,19 @@ void ShapesApp::BuildRootSignature()
 	cbvTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1);
 
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[2];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
 
 	// Create root CBVs.
 	slotRootParameter[0].InitAsDescriptorTable(1, &cbvTable0);
 	slotRootParameter[1].InitAsDescriptorTable(1, &cbvTable1);
 
+	// The structured buffer object data path uses an object index root constant (b2) and
+	// a root SRV (t0) for the whole ObjectData buffer instead of a CBV per object.
+	slotRootParameter[2].InitAsConstants(1, 2);
+	slotRootParameter[3].InitAsShaderResourceView(0);
+
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(2, slotRootParameter, 0, nullptr,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter, 0, nullptr,
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 	// create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
@@ -520,111 +1491,96 @@ void ShapesApp::BuildRootSignature()
 		serializedRootSig->GetBufferPointer(),
 		serializedRootSig->GetBufferSize(),
 		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+
+	// Kept for the PSO cache, which names pipelines by it across runs.
+	mSerializedRootSignature = serializedRootSig;
 }
 
 void ShapesApp::BuildShadersAndInputLayout()
 {
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\VS.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\PS.hlsl", nullptr, "PS", "ps_5_1");
-
-	mInputLayout =
+	const D3D_SHADER_MACRO objectDataDefines[] =
 	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		"OBJECT_DATA_BUFFER", "1",
+		NULL, NULL
 	};
+
+	mShaders.Add(ASSET_NAME("standardVS"), d3dUtil::CompileShader(L"Shaders\\VS.hlsl", nullptr, "VS", "vs_5_1"));
+	mShaders.Add(ASSET_NAME("objectDataVS"), d3dUtil::CompileShader(L"Shaders\\VS.hlsl", objectDataDefines, "VS", "vs_5_1"));
+	mShaders.Add(ASSET_NAME("opaquePS"), d3dUtil::CompileShader(L"Shaders\\PS.hlsl", nullptr, "PS", "ps_5_1"));
+
+	mInputLayout = VertexDesc::InputLayout();
 }
 
 
 void ShapesApp::BuildShapeGeometry()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 0);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-
-	// We are concatenating all the geometry into one big vertex/index buffer.  So
-	// define the regions in the buffer each submesh covers.
-
-	// Cache the vertex offsets to each object in the concatenated vertex buffer.
-	UINT boxVertexOffset = 0;
-	UINT gridVertexOffset = (UINT)box.Vertices.size();
-	UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-	UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-
-	// Cache the starting index for each object in the concatenated index buffer.
-	UINT boxIndexOffset = 0;
-	UINT gridIndexOffset = (UINT)box.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-	// Define the SubmeshGeometry that cover different
-	// regions of the vertex/index buffers.
-
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = boxIndexOffset;
-	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-
-	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-
-	auto totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		sphere.Vertices.size() +
-		cylinder.Vertices.size();
-
-
-	std::vector<Vertex> vertices(totalVertexCount);
-
-	UINT k = 0;
-
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::Gold);
-	}
-
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
+	// The generated meshes are only needed until they are packed, so they all go in one
+	// arena sized from the exact mesh sizes: a single allocation for the lot.
+	const GeometryGenerator::MeshSize meshSizes[] =
 	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::ForestGreen);
-	}
-
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
+		GeometryGenerator::BoxSize(0),
+		GeometryGenerator::GridSize(60, 40),
+		GeometryGenerator::SphereSize(20, 20),
+		GeometryGenerator::CylinderSize(20, 20),
+		GeometryGenerator::SphereSize(12, 12),
+		GeometryGenerator::SphereSize(6, 6),
+		GeometryGenerator::CylinderSize(12, 4),
+		GeometryGenerator::CylinderSize(6, 1)
+	};
+	size_t meshBytes = 0;
+	for (const auto& size : meshSizes)
 	{
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::Crimson);
+		meshBytes += size.VertexCount * sizeof(GeometryGenerator::Vertex) +
+			size.IndexCount * sizeof(std::uint32_t) + 2 * alignof(std::max_align_t);
 	}
+	LinearArena meshMemory(meshBytes, MemoryTracker::Get().Resource(MemoryTag::Geometry));
 
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 0, &meshMemory);
+	GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40, &meshMemory);
+	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20, &meshMemory);
+	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, &meshMemory);
+
+	// Coarser tessellations of the sphere and cylinder, drawn when they are small on screen.
+	GeometryGenerator::MeshData sphereLod1 = geoGen.CreateSphere(0.5f, 12, 12, &meshMemory);
+	GeometryGenerator::MeshData sphereLod2 = geoGen.CreateSphere(0.5f, 6, 6, &meshMemory);
+	GeometryGenerator::MeshData cylinderLod1 = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 12, 4, &meshMemory);
+	GeometryGenerator::MeshData cylinderLod2 = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 6, 1, &meshMemory);
+
+	// We are concatenating all the geometry into one big vertex/index buffer.  The packer
+	// works out the region of the buffers each submesh covers.
+	MeshPacker packer;
+	packer.Add("box", box);
+	packer.Add("grid", grid);
+	packer.Add("sphere", sphere);
+	packer.Add("cylinder", cylinder);
+	packer.Add("sphere_lod1", sphereLod1);
+	packer.Add("sphere_lod2", sphereLod2);
+	packer.Add("cylinder_lod1", cylinderLod1);
+	packer.Add("cylinder_lod2", cylinderLod2);
+
+	// Per-mesh vertex colors, in the order the meshes were added.
+	const XMFLOAT4 meshColors[] =
 	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
-	}
+		XMFLOAT4(DirectX::Colors::Gold),
+		XMFLOAT4(DirectX::Colors::ForestGreen),
+		XMFLOAT4(DirectX::Colors::Crimson),
+		XMFLOAT4(DirectX::Colors::SteelBlue),
+		XMFLOAT4(DirectX::Colors::Crimson),
+		XMFLOAT4(DirectX::Colors::Crimson),
+		XMFLOAT4(DirectX::Colors::SteelBlue),
+		XMFLOAT4(DirectX::Colors::SteelBlue)
+	};
 
+	// Extract the vertex elements we are interested in and pack the
+	// vertices of all the meshes into one vertex buffer.
+	std::vector<Vertex> vertices = packer.PackVertices<Vertex>(
+		[&](const GeometryGenerator::Vertex& v, UINT meshIndex)
+		{
+			return VertexDesc::ConvertVertex(v, meshColors[meshIndex]);
+		});
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
+	std::vector<std::uint16_t> indices = packer.PackIndices16();
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
@@ -632,34 +1588,102 @@ void ShapesApp::BuildShapeGeometry()
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "shapeGeo";
 
-
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->CpuMemory = TrackedMemory(MemoryTag::Geometry, MemoryKind::Cpu, vbByteSize + ibByteSize);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["grid"] = gridSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
-	geo->DrawArgs["cylinder"] = cylinderSubmesh;
+	EnqueueGeometryUpload(geo.get(), vertices.data(), indices.data());
+
+	packer.FillDrawArgs(*geo);
+
+	// The packer names submeshes at run time, so these are the only names hashed at run
+	// time; the key strings live as long as the geometry.
+	for (const auto& args : geo->DrawArgs)
+		mSubmeshes.Add(AssetName{ HashAssetName(args.first.c_str()), args.first.c_str() }, args.second);
+
+	// Screen size thresholds are fractions of the viewport height.
+	LodTable sphereLods;
+	sphereLods.AddLevel(mSubmeshes[ASSET_NAME("sphere")], 0.15f);
+	sphereLods.AddLevel(mSubmeshes[ASSET_NAME("sphere_lod1")], 0.05f);
+	sphereLods.AddLevel(mSubmeshes[ASSET_NAME("sphere_lod2")], 0.0f);
+	mLodTables.Add(ASSET_NAME("sphere"), std::move(sphereLods));
 
-	mGeometries[geo->Name] = std::move(geo);
+	LodTable cylinderLods;
+	cylinderLods.AddLevel(mSubmeshes[ASSET_NAME("cylinder")], 0.3f);
+	cylinderLods.AddLevel(mSubmeshes[ASSET_NAME("cylinder_lod1")], 0.1f);
+	cylinderLods.AddLevel(mSubmeshes[ASSET_NAME("cylinder_lod2")], 0.0f);
+	mLodTables.Add(ASSET_NAME("cylinder"), std::move(cylinderLods));
+
+	mGeometries.Add(ASSET_NAME("shapeGeo"), std::move(geo));
+}
+
+void ShapesApp::BuildUploadService()
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)));
+	ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mCopyFence)));
+
+	mCopyBackend = std::make_unique<D3D12CommandBackend>(md3dDevice.Get(), mCopyFence.Get(),
+		D3D12_COMMAND_LIST_TYPE_COPY);
+
+	// Only the service's worker thread submits, so the fence value needs no lock.  A
+	// failed Signal throws on the worker; the service rethrows it from Retire in Update.
+	mUploadService = std::make_unique<UploadService>(*mCopyBackend, [this](UINT list)
+	{
+		ID3D12CommandList* cmdsLists[] = { mCopyBackend->GetList(list) };
+		mCopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+		ThrowIfFailed(mCopyQueue->Signal(mCopyFence.Get(), ++mCopyFenceValue));
+		return mCopyFenceValue;
+	});
+}
+
+void ShapesApp::EnqueueGeometryUpload(MeshGeometry* geo, const void* vertices, const void* indices)
+{
+	geo->VertexBufferGPU = d3dUtil::CreateStagedBuffer(md3dDevice.Get(),
+		vertices, geo->VertexBufferByteSize, geo->VertexBufferUploader);
+	geo->IndexBufferGPU = d3dUtil::CreateStagedBuffer(md3dDevice.Get(),
+		indices, geo->IndexBufferByteSize, geo->IndexBufferUploader);
+
+	auto copy = [this](ID3D12Resource* dest, ID3D12Resource* source, UINT64 byteSize)
+	{
+		return [this, dest, source, byteSize](UINT list)
+		{
+			mCopyBackend->GetList(list)->CopyBufferRegion(dest, 0, source, 0, byteSize);
+		};
+	};
+
+	mUploadService->Enqueue(geo->VertexBufferByteSize,
+		copy(geo->VertexBufferGPU.Get(), geo->VertexBufferUploader.Get(), geo->VertexBufferByteSize),
+		[geo]() { geo->VertexBufferUploader = nullptr; });
+
+	// Tickets complete in order, so the index buffer's covers the whole mesh.
+	UploadService::Ticket ticket = mUploadService->Enqueue(geo->IndexBufferByteSize,
+		copy(geo->IndexBufferGPU.Get(), geo->IndexBufferUploader.Get(), geo->IndexBufferByteSize),
+		[geo]() { geo->IndexBufferUploader = nullptr; });
+	mPendingGeometry.push_back({ geo, ticket });
 }
 
 void ShapesApp::BuildPSOs()
 {
+	// Compiled PSOs are kept in a pipeline library next to the executable, so later runs
+	// load them instead of compiling.
+	mPsoCache = std::make_unique<PsoCache>(md3dDevice.Get(), L"ShapesApp.psolib");
+	mPsoCache->RegisterRootSignature(mRootSignature.Get(), mSerializedRootSignature->GetBufferPointer(),
+		mSerializedRootSignature->GetBufferSize());
+
+	std::vector<std::pair<AssetName, PsoCache::Key>> psoKeys;
+
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
 	// PSO for opaque objects.
@@ -670,14 +1694,14 @@ void ShapesApp::BuildPSOs()
 
 	opaquePsoDesc.VS =
 	{
-	 reinterpret_cast<BYTE*>(mShaders["standardVS"]->GetBufferPointer()),
-	 mShaders["standardVS"]->GetBufferSize()
+	 reinterpret_cast<BYTE*>(mShaders[ASSET_NAME("standardVS")]->GetBufferPointer()),
+	 mShaders[ASSET_NAME("standardVS")]->GetBufferSize()
 	};
 
 	opaquePsoDesc.PS =
 	{
-	 reinterpret_cast<BYTE*>(mShaders["opaquePS"]->GetBufferPointer()),
-	 mShaders["opaquePS"]->GetBufferSize()
+	 reinterpret_cast<BYTE*>(mShaders[ASSET_NAME("opaquePS")]->GetBufferPointer()),
+	 mShaders[ASSET_NAME("opaquePS")]->GetBufferSize()
 	};
 
 	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
@@ -692,13 +1716,46 @@ void ShapesApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	psoKeys.push_back({ ASSET_NAME("opaque"), mPsoCache->Request(opaquePsoDesc) });
 
 	// PSO for opaque wireframe objects.
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueWireframePsoDesc = opaquePsoDesc;
 	opaqueWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&mPSOs["opaque_wireframe"])));
+	psoKeys.push_back({ ASSET_NAME("opaque_wireframe"), mPsoCache->Request(opaqueWireframePsoDesc) });
+
+	// The same two PSOs reading object data from the structured buffer.
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC objectDataPsoDesc = opaquePsoDesc;
+	objectDataPsoDesc.VS =
+	{
+	 reinterpret_cast<BYTE*>(mShaders[ASSET_NAME("objectDataVS")]->GetBufferPointer()),
+	 mShaders[ASSET_NAME("objectDataVS")]->GetBufferSize()
+	};
+	psoKeys.push_back({ ASSET_NAME("opaque_objectData"), mPsoCache->Request(objectDataPsoDesc) });
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC objectDataWireframePsoDesc = objectDataPsoDesc;
+	objectDataWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+	psoKeys.push_back({ ASSET_NAME("opaque_objectData_wireframe"), mPsoCache->Request(objectDataWireframePsoDesc) });
+
+	// Every PSO above is created at once, in parallel.
+	mPsoCache->Compile();
+	mPsoCache->SaveLibrary();
+
+	for (const auto& pso : psoKeys)
+		mPSOs.Add(pso.first, mPsoCache->Get(pso.second));
+
+	mOpaquePsos[0][0] = mPSOs.Find(ASSET_NAME("opaque"));
+	mOpaquePsos[0][1] = mPSOs.Find(ASSET_NAME("opaque_wireframe"));
+	mOpaquePsos[1][0] = mPSOs.Find(ASSET_NAME("opaque_objectData"));
+	mOpaquePsos[1][1] = mPSOs.Find(ASSET_NAME("opaque_objectData_wireframe"));
+
+	const PsoCache::Stats& stats = mPsoCache->GetStats();
+	std::wostringstream out;
+	out << L"PSO cache: " << stats.Requests << L" requests, " << stats.Entries << L" distinct, "
+		<< stats.Compiled << L" compiled, " << stats.LoadedFromLibrary << L" loaded from the library, "
+		<< stats.CompileMilliseconds << L" ms\n";
+	OutputDebugString(out.str().c_str());
 }
 
 
@@ -708,139 +1765,321 @@ void ShapesApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size()));
+			1, (UINT)mAllRitems.size(), 0, 0, (UINT)mAllRitems.size()));
 	}
 }
 
 
 
-void ShapesApp::BuildRenderItems()
+std::vector<SceneFile::Item> ShapesApp::BuildDefaultScene()
 {
-	auto boxRitem = std::make_unique<RenderItem>();
-
-	XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(0.0f, 0.5f, 0.0f));
+	const SubmeshGeometry& boxArgs = mSubmeshes[ASSET_NAME("box")];
+	const SubmeshGeometry& gridArgs = mSubmeshes[ASSET_NAME("grid")];
+	const SubmeshGeometry& cylinderArgs = mSubmeshes[ASSET_NAME("cylinder")];
+	const SubmeshGeometry& sphereArgs = mSubmeshes[ASSET_NAME("sphere")];
 
-	boxRitem->ObjCBIndex = 0;
-	boxRitem->Geo = mGeometries["shapeGeo"].get();
-	boxRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-	mAllRitems.push_back(std::move(boxRitem));
+	std::vector<SceneFile::Item> items;
+	auto add = [&](FXMMATRIX world, const AssetName& submesh, const SubmeshGeometry& args, std::uint8_t flags)
+	{
+		SceneFile::Item item;
+		XMStoreFloat4x4(&item.World, world);
+		item.Geometry = ASSET_NAME("shapeGeo");
+		item.Submesh = submesh;
+		item.Bucket = gOpaqueBucket;
+		item.Flags = flags;
+		item.BoundsCenter = args.Bounds.Center;
+		item.BoundsExtents = args.Bounds.Extents;
+		items.push_back(item);
+	};
 
-	auto box2Ritem = std::make_unique<RenderItem>();
+	add(XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(0.0f, 0.5f, 0.0f),
+		ASSET_NAME("box"), boxArgs, SceneFile::Occluder);
+	add(XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(-4.0f, 0.5f, -4.0f),
+		ASSET_NAME("box"), boxArgs, SceneFile::Occluder);
+	add(XMMatrixIdentity(), ASSET_NAME("grid"), gridArgs, 0);
 
-	XMStoreFloat4x4(&box2Ritem->World, XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(-4.0f, 0.5f, -4.0f));
+	for (int i = 0; i < 5; ++i)
+	{
+		XMMATRIX leftCylWorld = XMMatrixTranslation(-5.0f, 1.5f, -10.0f + i * 5.0f);
+		XMMATRIX rightCylWorld = XMMatrixTranslation(+5.0f, 1.5f, -10.0f + i * 5.0f);
 
-	box2Ritem->ObjCBIndex = 1;
-	box2Ritem->Geo = mGeometries["shapeGeo"].get();
-	box2Ritem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	box2Ritem->IndexCount = box2Ritem->Geo->DrawArgs["box"].IndexCount;
-	box2Ritem->StartIndexLocation = box2Ritem->Geo->DrawArgs["box"].StartIndexLocation;
-	box2Ritem->BaseVertexLocation = box2Ritem->Geo->DrawArgs["box"].BaseVertexLocation;
-	mAllRitems.push_back(std::move(box2Ritem));
+		XMMATRIX leftSphereWorld = XMMatrixTranslation(-5.0f, 3.5f, -10.0f + i * 5.0f);
+		XMMATRIX rightSphereWorld = XMMatrixTranslation(+5.0f, 3.5f, -10.0f + i * 5.0f);
 
-	auto gridRitem = std::make_unique<RenderItem>();
+		add(rightCylWorld, ASSET_NAME("cylinder"), cylinderArgs, SceneFile::UseLod);
+		add(leftCylWorld, ASSET_NAME("cylinder"), cylinderArgs, SceneFile::UseLod);
+		add(leftSphereWorld, ASSET_NAME("sphere"), sphereArgs, SceneFile::UseLod);
+		add(rightSphereWorld, ASSET_NAME("sphere"), sphereArgs, SceneFile::UseLod);
+	}
 
-	gridRitem->World = MathHelper::Identity4x4();
-	gridRitem->ObjCBIndex = 2;
-	gridRitem->Geo = mGeometries["shapeGeo"].get();
-	gridRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	return items;
+}
 
-	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+bool ShapesApp::LoadRenderItems(const SceneFile& scene, std::string* error)
+{
+	// Resolve the name table once; items then index these instead of hashing names.
+	UINT nameCount = scene.NameCount();
+	std::vector<MeshGeometry*> geometries(nameCount, nullptr);
+	std::vector<const SubmeshGeometry*> submeshes(nameCount, nullptr);
+	std::vector<const LodTable*> lods(nameCount, nullptr);
+	for (UINT i = 0; i < nameCount; ++i)
+	{
+		AssetName name = scene.GetName(i);
+		if (std::unique_ptr<MeshGeometry>* geo = mGeometries.Get(mGeometries.Find(name)))
+			geometries[i] = geo->get();
+		submeshes[i] = mSubmeshes.Get(mSubmeshes.Find(name));
+		lods[i] = mLodTables.Get(mLodTables.Find(name));
+	}
 
-	mAllRitems.push_back(std::move(gridRitem));
+	UINT count = scene.ItemCount();
+	const XMFLOAT4X4* worlds = scene.Worlds();
+	const std::uint32_t* geometryRefs = scene.Geometries();
+	const std::uint32_t* submeshRefs = scene.Submeshes();
+	const std::uint8_t* buckets = scene.Buckets();
+	const std::uint8_t* flags = scene.Flags();
+	const XMFLOAT3* boundsCenters = scene.BoundsCenters();
+	const XMFLOAT3* boundsExtents = scene.BoundsExtents();
+
+	mAllRitems.reserve(count);
+	for (UINT i = 0; i < count; ++i)
+	{
+		MeshGeometry* geo = geometries[geometryRefs[i]];
+		const SubmeshGeometry* args = submeshes[submeshRefs[i]];
+		const LodTable* lod = lods[submeshRefs[i]];
+		bool useLod = (flags[i] & SceneFile::UseLod) != 0;
+		if (geo == nullptr || args == nullptr || (useLod && lod == nullptr) || buckets[i] != gOpaqueBucket)
+		{
+			*error = "item " + std::to_string(i) + " refers to a missing asset";
+			mAllRitems.clear();
+			return false;
+		}
 
-	UINT objCBIndex = 3;
+		auto ritem = std::make_unique<RenderItem>();
+		ritem->World = worlds[i];
+		ritem->ObjCBIndex = i;
+		ritem->Geo = geo;
+		ritem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		ritem->IndexCount = args->IndexCount;
+		ritem->StartIndexLocation = args->StartIndexLocation;
+		ritem->BaseVertexLocation = args->BaseVertexLocation;
+		ritem->Bounds = BoundingBox(boundsCenters[i], boundsExtents[i]);
+		ritem->IsOccluder = (flags[i] & SceneFile::Occluder) != 0;
+		ritem->Lod = useLod ? lod : nullptr;
+		mAllRitems.push_back(std::move(ritem));
+	}
 
-	for (int i = 0; i < 5; ++i)
-	{
-		auto leftCylRitem = std::make_unique<RenderItem>();
-		auto rightCylRitem = std::make_unique<RenderItem>();
+	// All the render items are opaque.
+	for (auto& e : mAllRitems)
+		mOpaqueRitems.push_back(e.get());
+	return true;
+}
 
-		auto leftSphereRitem = std::make_unique<RenderItem>();
-		auto rightSphereRitem = std::make_unique<RenderItem>();
+bool ShapesApp::BuildRenderItems()
+{
+	auto start = std::chrono::steady_clock::now();
 
-		XMMATRIX leftCylWorld = XMMatrixTranslation(-5.0f, 1.5f, -10.0f + i * 5.0f);
-		XMMATRIX rightCylWorld = XMMatrixTranslation(+5.0f, 1.5f, -10.0f + i * 5.0f);
+	SceneFile scene;
+	std::string error;
+	std::string source = mSceneFile;
+	bool loaded = false;
 
-		XMMATRIX leftSphereWorld = XMMatrixTranslation(-5.0f, 3.5f, -10.0f + i * 5.0f);
-		XMMATRIX rightSphereWorld = XMMatrixTranslation(+5.0f, 3.5f, -10.0f + i * 5.0f);
+	// Only a file asked for on the command line is read, so the built in scene can never be
+	// shadowed by an old file.  One that does not exist yet is started from the built in
+	// scene; one that cannot be used is reported and left alone.
+	if (!mSceneFile.empty())
+	{
+		if (!std::ifstream(mSceneFile) && !SceneFile::Save(mSceneFile, BuildDefaultScene()))
+			error = "cannot write file";
+		else
+			loaded = scene.Open(mSceneFile, &error) && LoadRenderItems(scene, &error);
 
-		XMStoreFloat4x4(&leftCylRitem->World, rightCylWorld);
+		if (!loaded)
+		{
+			std::wostringstream out;
+			out << L"Scene: cannot load " << AnsiToWString(mSceneFile) << L" (" << AnsiToWString(error)
+				<< L"), using the built in scene\n";
+			OutputDebugString(out.str().c_str());
+		}
+	}
 
-		leftCylRitem->ObjCBIndex = objCBIndex++;
+	// The built in scene goes through the same validated in place reads, from memory.
+	if (!loaded)
+	{
+		source = "the built in scene";
+		loaded = scene.OpenMemory(SceneFile::Serialize(BuildDefaultScene()), &error) && LoadRenderItems(scene, &error);
+	}
 
-		leftCylRitem->Geo = mGeometries["shapeGeo"].get();
-		leftCylRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
-		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
+	std::wostringstream out;
+	if (loaded)
+		out << L"Scene: " << mAllRitems.size() << L" render items from " << AnsiToWString(source) << L" in " << milliseconds << L" ms\n";
+	else
+		out << L"Scene: cannot load " << AnsiToWString(source) << L" (" << AnsiToWString(error) << L")\n";
+	OutputDebugString(out.str().c_str());
+	return loaded;
+}
 
-		rightCylRitem->ObjCBIndex = objCBIndex++;
+void ShapesApp::BuildPickingScene()
+{
+	// The render items still hold their finest LOD here, and picking always uses it so a
+	// click hits the same triangles whatever level happens to be drawn.
+	std::unordered_map<std::string, UINT> meshIndices;
 
-		rightCylRitem->Geo = mGeometries["shapeGeo"].get();
-		rightCylRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
-		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+	for (auto& e : mAllRitems)
+	{
+		const MeshGeometry* geo = e->Geo;
+
+		auto submesh = std::find_if(geo->DrawArgs.begin(), geo->DrawArgs.end(),
+			[&](const std::pair<const std::string, SubmeshGeometry>& args)
+			{
+				return args.second.StartIndexLocation == e->StartIndexLocation &&
+					args.second.BaseVertexLocation == e->BaseVertexLocation;
+			});
+		assert(submesh != geo->DrawArgs.end());
+
+		auto found = meshIndices.find(submesh->first);
+		if (found == meshIndices.end())
+		{
+			const SubmeshGeometry& args = submesh->second;
+			const BYTE* vertices = (const BYTE*)geo->VertexBufferCPU->GetBufferPointer() +
+				args.BaseVertexLocation * geo->VertexByteStride + offsetof(Vertex, Pos);
+			const std::uint16_t* indices = (const std::uint16_t*)geo->IndexBufferCPU->GetBufferPointer() +
+				args.StartIndexLocation;
+
+			UINT mesh = mPickingScene.AddMesh((const XMFLOAT3*)vertices, geo->VertexByteStride,
+				indices, args.IndexCount);
+			found = meshIndices.emplace(submesh->first, mesh).first;
+			mPickMeshNames.push_back(submesh->first);
+		}
 
-		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
+		mPickingScene.AddInstance(found->second, e->World);
+	}
 
-		leftSphereRitem->ObjCBIndex = objCBIndex++;
-		leftSphereRitem->Geo = mGeometries["shapeGeo"].get();
-		leftSphereRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		leftSphereRitem->IndexCount = leftSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
-		leftSphereRitem->StartIndexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
-		leftSphereRitem->BaseVertexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	mPickingScene.Build();
+}
 
-		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
+void ShapesApp::BuildCommandSink()
+{
+	mCommandSink = std::make_unique<D3D12CommandSink>();
+	mStatsSink = std::make_unique<FrameStatsSink>(mFrameStats, mCommandSink.get());
+	mSink = mStatsSink.get();
 
-		rightSphereRitem->ObjCBIndex = objCBIndex++;
+	for (int i = 0; i < 2; ++i)
+	{
+		for (int j = 0; j < 2; ++j)
+			mSinkOpaquePsos[i][j] = mCommandSink->AddPipelineState(mPSOs[mOpaquePsos[i][j]].Get());
+	}
+	mSinkRootSignature = mCommandSink->AddRootSignature(mRootSignature.Get());
+	mSinkCbvHeap = mCommandSink->AddDescriptorHeap(mCbvHeap.Get(), mCbvSrvUavDescriptorSize);
 
-		rightSphereRitem->Geo = mGeometries["shapeGeo"].get();
-		rightSphereRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		rightSphereRitem->IndexCount = rightSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
-		rightSphereRitem->StartIndexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
-		rightSphereRitem->BaseVertexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	for (int i = 0; i < SwapChainBufferCount; ++i)
+	{
+		mSinkBackBuffers[i] = mCommandSink->AddResource(mSwapChainBuffer[i].Get());
+		mSinkBackBufferRtvs[i] = mCommandSink->AddRenderTarget(CD3DX12_CPU_DESCRIPTOR_HANDLE(
+			mRtvHeap->GetCPUDescriptorHandleForHeapStart(), i, mRtvDescriptorSize));
+	}
+	mSinkDepthStencil = mCommandSink->AddResource(mDepthStencilBuffer.Get());
+	mSinkDsv = mCommandSink->AddDepthStencil(DepthStencilView());
 
-		mAllRitems.push_back(std::move(leftCylRitem));
-		mAllRitems.push_back(std::move(rightCylRitem));
-		mAllRitems.push_back(std::move(leftSphereRitem));
-		mAllRitems.push_back(std::move(rightSphereRitem));
+	for (int i = 0; i < gNumFrameResources; ++i)
+	{
+		FrameResource* frame = mFrameResources[i].get();
+		mSinkFrameBuffers[i].PassCB = mCommandSink->AddResource(frame->PassCB->Resource());
+		mSinkFrameBuffers[i].ObjectCB = mCommandSink->AddResource(frame->ObjectCB->Resource());
+		mSinkFrameBuffers[i].ObjectData = mCommandSink->AddResource(frame->ObjectDataBuffer->Resource());
 	}
-	// All the render items are opaque.
-	for (auto& e : mAllRitems)
-		mOpaqueRitems.push_back(e.get());
+
+	mGeometries.ForEach([this](AssetRegistry<std::unique_ptr<MeshGeometry>>::Handle handle,
+		std::unique_ptr<MeshGeometry>& geo)
+	{
+		UINT id = mCommandSink->AddGeometry(geo.get());
+		for (auto& e : mAllRitems)
+		{
+			if (e->Geo == geo.get())
+				e->GeoSinkId = id;
+		}
+	});
 }
 
-void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void ShapesApp::UpdateSinkSwapChain()
 {
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-	// For each render item...
+	for (int i = 0; i < SwapChainBufferCount; ++i)
+		mCommandSink->SetResource(mSinkBackBuffers[i], mSwapChainBuffer[i].Get());
+	mCommandSink->SetResource(mSinkDepthStencil, mDepthStencilBuffer.Get());
+}
 
-	for (size_t i = 0; i < ritems.size(); ++i)
+void ShapesApp::BuildRenderGraph()
+{
+	mBackBufferHandle = mRenderGraph.ImportResource("BackBuffer", ResourceState::Present, ResourceState::Present);
+	mDepthStencilHandle = mRenderGraph.ImportResource("DepthStencil", ResourceState::DepthWrite, ResourceState::DepthWrite);
+
+	RenderGraph::PassHandle opaque = mRenderGraph.AddPass("Opaque", [this]()
 	{
-		auto ri = ritems[i];
-		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+		CommandSink& sink = *mSink;
+		UINT rtv = mSinkBackBufferRtvs[mCurrBackBuffer];
+
+		// Clear the back buffer and depth buffer.
+		sink.ClearRenderTarget(rtv, Colors::LightSteelBlue);
+		sink.ClearDepthStencil(mSinkDsv, 1.0f, 0);
+
+		// Specify the buffers we are going to render to.
+		sink.SetRenderTarget(rtv, mSinkDsv);
+
+		sink.SetDescriptorHeap(mSinkCbvHeap);
+		sink.SetRootSignature(mSinkRootSignature);
+
+		sink.SetDescriptorTable(1, mPassCbvOffset + mCurrFrameResourceIndex);
+
+		if (mUseObjectDataBuffer)
+			sink.SetRootShaderResource(3, mSinkFrameBuffers[mCurrFrameResourceIndex].ObjectData);
+
+		// Visible items whose geometry has arrived, gathered in the frame arena.
+		std::pmr::vector<RenderItem*> drawList(&mCurrFrameResource->Arena.Frame());
+		drawList.reserve(mOpaqueRitems.size());
+		for (RenderItem* ri : mOpaqueRitems)
+		{
+			if (ri->Visible && !IsGeometryPending(ri->Geo))
+				drawList.push_back(ri);
+		}
 
-		// Offset to the CBV in the descriptor heap for this object and for this frame resource.
+		DrawRenderItems(sink, drawList.data(), drawList.size());
+	});
+	mRenderGraph.Write(opaque, mBackBufferHandle, ResourceState::RenderTarget);
+	mRenderGraph.Write(opaque, mDepthStencilHandle, ResourceState::DepthWrite);
 
-		UINT cbvIndex = mCurrFrameResourceIndex * (UINT)mOpaqueRitems.size() + ri->ObjCBIndex;
+	mRenderGraph.Compile();
+}
 
-		auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
+bool ShapesApp::IsGeometryPending(const MeshGeometry* geo)const
+{
+	// Geometry still on the copy queue.
+	return !mPendingGeometry.empty() && std::any_of(mPendingGeometry.begin(), mPendingGeometry.end(),
+		[geo](const std::pair<const MeshGeometry*, UploadService::Ticket>& p) { return p.first == geo; });
+}
 
-		cbvHandle.Offset(cbvIndex, mCbvSrvUavDescriptorSize);
+void ShapesApp::DrawRenderItems(CommandSink& sink, RenderItem* const* ritems, size_t count)
+{
+	// For each render item...
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto ri = ritems[i];
+
+		sink.SetVertexBuffer(ri->GeoSinkId);
+		sink.SetIndexBuffer(ri->GeoSinkId);
+		sink.SetTopology(ri->PrimitiveType);
 
-		cmdList->SetGraphicsRootDescriptorTable(0, cbvHandle);
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		if (mUseObjectDataBuffer)
+		{
+			// The shader reads element ObjCBIndex of the structured buffer bound in Draw.
+			sink.SetRootConstant(2, ri->ObjCBIndex);
+		}
+		else
+		{
+			// Offset to the CBV in the descriptor heap for this object and for this frame resource.
+			sink.SetDescriptorTable(0, mCurrFrameResourceIndex * (UINT)mOpaqueRitems.size() + ri->ObjCBIndex);
+		}
+		sink.DrawIndexed(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
 	}
 }
 
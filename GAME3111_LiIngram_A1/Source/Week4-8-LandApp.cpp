@@ -9,17 +9,27 @@
  *   Hold down '1' key to view scene in wireframe mode.
  *   Hold the left mouse button down and move the mouse to rotate.
  *   Hold the right mouse button down and move the mouse to zoom in and out.
+ *   Hold 'R' to raise, 'F' to lower or 'G' to smooth the terrain under the mouse cursor.
+ *   Press 'B' to run the benchmarks; the timings go to the debug output.
  *
  *  @author Hooman Salamat
  */
 
-#include "../../Common/d3dApp.h"
-#include "../../Common/MathHelper.h"
-#include "../../Common/UploadBuffer.h"
-#include "../../Common/GeometryGenerator.h"
+#include "../Common/d3dApp.h"
+#include "../Common/MathHelper.h"
+#include "../Common/UploadBuffer.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MeshNormals.h"
+#include "../Common/MeshSimplifier.h"
+#include "../Common/MeshPacker.h"
+#include "../Common/MeshLod.h"
+#include "../Common/Waves.h"
+#include "../Common/TerrainEditor.h"
+#include "../Common/HeightQuadtree.h"
 #include "FrameResource.h"
 
 #include <iostream>
+#include <sstream>
 #include <string>
 
 using Microsoft::WRL::ComPtr;
@@ -29,6 +39,12 @@ using namespace DirectX::PackedVector;
 //step3: Our application class will then instantiate a vector of three frame resources, 
 const int gNumFrameResources = 3;
 
+// Fewest render items UpdateObjectCBs hands to one thread.
+const UINT gObjectCBGrainSize = 256;
+
+// Most edited terrain vertices uploaded in one frame; the rest wait for the next frame.
+const UINT gTerrainStagingVertexCount = 4096;
+
 // Step10: Lightweight structure stores parameters to draw a shape.  This will vary from app-to-app.
 struct RenderItem
 {
@@ -59,6 +75,19 @@ struct RenderItem
 	UINT IndexCount = 0; //Number of indices read from the index buffer for each instance.
 	UINT StartIndexLocation = 0; //The location of the first index read by the GPU from the index buffer.
 	int BaseVertexLocation = 0; //A value added to each index before reading a vertex from the vertex buffer.
+
+	// Optional LOD table.  When set, the DrawIndexedInstanced parameters above are
+	// replaced each frame by the level picked for the current camera.
+	const LodTable* Lod = nullptr;
+	UINT LodLevel = 0;
+};
+
+// One CopyBufferRegion from the frame's terrain staging buffer into the land vertex buffer.
+struct BufferCopy
+{
+	UINT64 DstOffset = 0;
+	UINT64 SrcOffset = 0;
+	UINT64 NumBytes = 0;
 };
 
 class LandApp : public D3DApp
@@ -82,14 +111,21 @@ private:
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateLods(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void UpdateWaves(const GameTimer& gt);
+	void UpdateTerrainEdits(const GameTimer& gt);
+	void RunWavesBenchmark();
+	void RunTerrainBenchmark();
+	void RunNormalsBenchmark();
 
 	void BuildDescriptorHeaps();
 	void BuildConstantBufferViews();
 	void BuildRootSignature();
 	void BuildShadersAndInputLayout();
 	void BuildLandGeometry();
+	void BuildWavesGeometry();
 	void BuildPSOs();
 
 
@@ -99,6 +135,9 @@ private:
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 	//step2
 	float GetHillsHeight(float x, float z)const;
+	XMFLOAT4 GetHillsColor(float y)const;
+
+	bool PickTerrain(int sx, int sy, XMFLOAT3& hitPosW);
 
 private:
 
@@ -115,9 +154,25 @@ private:
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	std::unordered_map<std::string, LodTable> mLodTables;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
+	// The water item's vertex buffer is swapped for the current frame's WavesVB every frame.
+	RenderItem* mWavesRitem = nullptr;
+	RenderItem* mLandRitem = nullptr;
+
+	// Full resolution land grid, kept so it can be edited at runtime.  Vertex i*n+j of the
+	// grid is vertex i*n+j of the "grid" submesh.
+	GeometryGenerator::MeshData mLandGrid;
+	std::unique_ptr<TerrainEditor> mTerrainEditor;
+
+	// Min/max height tree over mLandGrid for picking; refit as edits are uploaded.
+	std::unique_ptr<HeightQuadtree> mLandHeights;
+
+	// Recorded in UpdateTerrainEdits and executed at the start of Draw.
+	std::vector<BufferCopy> mTerrainCopies;
+
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
@@ -141,6 +196,9 @@ private:
 	UINT mPassCbvOffset = 0;
 
 	bool mIsWireframe = false;
+	bool mBenchmarkKeyDown = false;
+
+	std::unique_ptr<Waves> mWaves;
 
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
@@ -200,9 +258,13 @@ bool LandApp::Initialize()
 	// Reset the command list to prep for initialization commands.
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
+	// 128x128 water grid spaced one unit apart; dt = 0.03 s, wave speed 4, damping 0.2.
+	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
 	BuildLandGeometry();
+	BuildWavesGeometry();
 	BuildRenderItems();
 	BuildFrameResources();
 	BuildDescriptorHeaps();
@@ -238,6 +300,7 @@ void LandApp::Update(const GameTimer& gt)
 {
 	OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateLods(gt);
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -257,6 +320,8 @@ void LandApp::Update(const GameTimer& gt)
 	//only need to change when an objects world matrix changes.
 	UpdateObjectCBs(gt);
 	UpdateMainPassCB(gt);
+	UpdateWaves(gt);
+	UpdateTerrainEdits(gt);
 }
 
 void LandApp::Draw(const GameTimer& gt)
@@ -278,6 +343,24 @@ void LandApp::Draw(const GameTimer& gt)
 		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 	}
 
+	// Copy this frame's terrain edits into the land vertex buffer before anything reads it.
+	if (!mTerrainCopies.empty())
+	{
+		ID3D12Resource* landVB = mGeometries["landGeo"]->VertexBufferGPU.Get();
+		ID3D12Resource* staging = mCurrFrameResource->TerrainStagingVB->Resource();
+
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(landVB,
+			D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
+
+		for (const auto& copy : mTerrainCopies)
+			mCommandList->CopyBufferRegion(landVB, copy.DstOffset, staging, copy.SrcOffset, copy.NumBytes);
+
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(landVB,
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+
+		mTerrainCopies.clear();
+	}
+
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
@@ -396,6 +479,17 @@ void LandApp::OnKeyboardInput(const GameTimer& gt)
 		mIsWireframe = true;
 	else
 		mIsWireframe = false;
+
+	// B runs the wave solver and terrain ray cast benchmarks once per press; the timings
+	// go to the debug output.
+	bool benchmarkKeyDown = (GetAsyncKeyState('B') & 0x8000) != 0;
+	if (benchmarkKeyDown && !mBenchmarkKeyDown)
+	{
+		RunWavesBenchmark();
+		RunTerrainBenchmark();
+		RunNormalsBenchmark();
+	}
+	mBenchmarkKeyDown = benchmarkKeyDown;
 }
 
 void LandApp::UpdateCamera(const GameTimer& gt)
@@ -414,27 +508,60 @@ void LandApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
+void LandApp::UpdateLods(const GameTimer& gt)
+{
+	// Element (1,1) of the projection matrix is 1/tan(fovY/2).
+	float projScaleY = mProj(1, 1);
+
+	for (auto& e : mAllRitems)
+	{
+		if (e->Lod == nullptr)
+			continue;
+
+		float screenSize = LodSelector::ProjectedScreenSize(e->Lod->Levels[0].Bounds,
+			e->World, mEyePos, projScaleY);
+
+		e->LodLevel = LodSelector::SelectLevel(*e->Lod, e->LodLevel, screenSize);
+
+		const SubmeshGeometry& level = e->Lod->Levels[e->LodLevel];
+		e->IndexCount = level.IndexCount;
+		e->StartIndexLocation = level.StartIndexLocation;
+		e->BaseVertexLocation = level.BaseVertexLocation;
+	}
+}
+
 //step8: Update resources (cbuffers) in mCurrFrameResource
 void LandApp::UpdateObjectCBs(const GameTimer& gt)
 {
 	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for (auto& e : mAllRitems)
+
+	// Each item only touches its own dirty count and its own 256 byte slot, so ranges of
+	// items can run on any thread.
+	UINT grain = ThreadPool::CacheAlignedGrain(d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants)),
+		gObjectCBGrainSize);
+
+	ThreadPool::Get().ParallelFor((UINT)mAllRitems.size(), grain, [&](UINT begin, UINT end, UINT slot)
 	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e->NumFramesDirty > 0)
+		for (UINT i = begin; i < end; ++i)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
+			RenderItem* e = mAllRitems[i].get();
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+			// Only update the cbuffer data if the constants have changed.  
+			// This needs to be tracked per frame resource.
+			if (e->NumFramesDirty > 0)
+			{
+				XMMATRIX world = XMLoadFloat4x4(&e->World);
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+				ObjectConstants objConstants;
+				XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
+				currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+
+				// Next FrameResource need to be updated too.
+				e->NumFramesDirty--;
+			}
 		}
-	}
+	});
 }
 
 //CBVs will be set at different frequenciesthe per pass CBV only needs to be set once per
@@ -467,6 +594,203 @@ void LandApp::UpdateMainPassCB(const GameTimer& gt)
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
+void LandApp::UpdateWaves(const GameTimer& gt)
+{
+	// Every quarter second, generate a random wave.
+	static float t_base = 0.0f;
+	if ((gt.TotalTime() - t_base) >= 0.25f)
+	{
+		t_base += 0.25f;
+
+		int i = MathHelper::Rand(4, mWaves->RowCount() - 5);
+		int j = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
+
+		float r = MathHelper::RandF(0.2f, 0.5f);
+
+		mWaves->Disturb(i, j, r);
+	}
+
+	// Advance the simulation by whole fixed steps.
+	mWaves->Update(gt.DeltaTime());
+
+	// Write the new vertices straight into this frame's upload heap vertex buffer.  The
+	// frame resource fence wait in Update guarantees the GPU is no longer reading it.
+	auto currWavesVB = mCurrFrameResource->WavesVB.get();
+	mWaves->WriteVertices(currWavesVB->MappedData(), [](const XMFLOAT3& pos)
+	{
+		Vertex v;
+		v.Pos = pos;
+
+		// Crests are a little lighter than troughs.
+		float t = MathHelper::Clamp(0.5f + pos.y, 0.0f, 1.0f);
+		v.Color = XMFLOAT4(0.1f + 0.2f * t, 0.3f + 0.3f * t, 0.7f + 0.2f * t, 1.0f);
+		return v;
+	});
+
+	// Set the dynamic VB of the wave renderitem to the current frame VB.
+	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+}
+
+void LandApp::UpdateTerrainEdits(const GameTimer& gt)
+{
+	// Hold R to raise, F to lower or G to smooth the terrain under the mouse cursor.
+	bool raise = (GetAsyncKeyState('R') & 0x8000) != 0;
+	bool lower = (GetAsyncKeyState('F') & 0x8000) != 0;
+	bool smooth = (GetAsyncKeyState('G') & 0x8000) != 0;
+
+	XMFLOAT3 hitPos;
+	if ((raise || lower || smooth) && PickTerrain(mLastMousePos.x, mLastMousePos.y, hitPos))
+	{
+		const float brushRadius = 8.0f;
+		const float raiseRate = 10.0f;
+
+		if (raise)
+			mTerrainEditor->Raise(hitPos.x, hitPos.z, brushRadius, raiseRate * gt.DeltaTime());
+		if (lower)
+			mTerrainEditor->Raise(hitPos.x, hitPos.z, brushRadius, -raiseRate * gt.DeltaTime());
+		if (smooth)
+			mTerrainEditor->Smooth(hitPos.x, hitPos.z, brushRadius, MathHelper::Min(1.0f, 4.0f * gt.DeltaTime()));
+	}
+
+	if (!mTerrainEditor->IsDirty())
+		return;
+
+	std::vector<GridRegion> regions = mTerrainEditor->TakeDirtyRegions(gTerrainStagingVertexCount);
+
+	for (const GridRegion& r : regions)
+		mLandHeights->Refit(mLandGrid, r);
+
+	auto geo = mGeometries["landGeo"].get();
+	SubmeshGeometry& gridArgs = geo->DrawArgs["grid"];
+
+	// The simplified levels were built from the original heights, so once the land has been
+	// edited only the full grid is drawn.
+	if (mLandRitem->Lod != nullptr)
+	{
+		mLandRitem->Lod = nullptr;
+		mLandRitem->LodLevel = 0;
+		mLandRitem->IndexCount = gridArgs.IndexCount;
+		mLandRitem->StartIndexLocation = gridArgs.StartIndexLocation;
+		mLandRitem->BaseVertexLocation = gridArgs.BaseVertexLocation;
+	}
+
+	const UINT n = mTerrainEditor->ColumnCount();
+	Vertex* cpuVertices = reinterpret_cast<Vertex*>(geo->VertexBufferCPU->GetBufferPointer()) + gridArgs.BaseVertexLocation;
+	Vertex* staging = mCurrFrameResource->TerrainStagingVB->MappedData();
+	UINT stagingCount = 0;
+
+	XMFLOAT3 editMin = gridArgs.Bounds.Center;
+	XMFLOAT3 editMax = gridArgs.Bounds.Center;
+
+	for (const GridRegion& r : regions)
+	{
+		// A region spanning whole rows is one contiguous run of vertices; otherwise each row is.
+		bool wholeRows = r.ColBegin == 0 && r.ColEnd == n;
+		UINT runLength = wholeRows ? r.VertexCount() : r.ColEnd - r.ColBegin;
+		UINT runCount = wholeRows ? 1 : r.RowEnd - r.RowBegin;
+
+		for (UINT run = 0; run < runCount; ++run)
+		{
+			UINT first = (r.RowBegin + run) * n + r.ColBegin;
+
+			// Refresh the CPU copy, then stream the run into the write-combined staging memory
+			// in one sequential pass.
+			for (UINT k = first; k < first + runLength; ++k)
+			{
+				const XMFLOAT3& pos = mLandGrid.Vertices[k].Position;
+				cpuVertices[k].Pos = pos;
+				cpuVertices[k].Color = GetHillsColor(pos.y);
+
+				editMin.y = MathHelper::Min(editMin.y, pos.y);
+				editMax.y = MathHelper::Max(editMax.y, pos.y);
+			}
+
+			CopyMemory(staging + stagingCount, cpuVertices + first, runLength * sizeof(Vertex));
+
+			BufferCopy copy;
+			copy.DstOffset = (UINT64)(gridArgs.BaseVertexLocation + first) * sizeof(Vertex);
+			copy.SrcOffset = (UINT64)stagingCount * sizeof(Vertex);
+			copy.NumBytes = (UINT64)runLength * sizeof(Vertex);
+			mTerrainCopies.push_back(copy);
+
+			stagingCount += runLength;
+		}
+	}
+
+	// Edits only move vertices vertically, so the bounds can only grow in y.
+	BoundingBox editBox;
+	BoundingBox::CreateFromPoints(editBox, XMLoadFloat3(&editMin), XMLoadFloat3(&editMax));
+	BoundingBox::CreateMerged(gridArgs.Bounds, gridArgs.Bounds, editBox);
+}
+
+void LandApp::RunWavesBenchmark()
+{
+	const UINT sizes[] = { 256, 512, 1024, 2048 };
+	const UINT steps = 20;
+
+	for (UINT size : sizes)
+	{
+		Waves::BenchmarkResult result = Waves::Benchmark<Vertex>(size, size, steps, [](const XMFLOAT3& pos)
+		{
+			Vertex v;
+			v.Pos = pos;
+			v.Color = XMFLOAT4(0.2f, 0.45f, 0.8f, 1.0f);
+			return v;
+		});
+
+		std::wostringstream out;
+		out << L"Waves " << size << L"x" << size << L": step " << result.StepMilliseconds << L" ms ("
+			<< result.CellsPerSecond() / 1.0e6 << L" M cells/s), vertex write " << result.WriteMilliseconds << L" ms\n";
+		OutputDebugString(out.str().c_str());
+	}
+}
+
+void LandApp::RunTerrainBenchmark()
+{
+	// Sample the hills function on progressively finer grids over the same 160x160 area.
+	const UINT sizes[] = { 257, 1025, 2049 };
+	const UINT rayCount = 1 << 20;
+
+	for (UINT size : sizes)
+	{
+		float spacing = 160.0f / (size - 1);
+
+		std::vector<float> heights((size_t)size * size);
+		for (UINT i = 0; i < size; ++i)
+		{
+			for (UINT j = 0; j < size; ++j)
+				heights[(size_t)i * size + j] = GetHillsHeight(-80.0f + j * spacing, 80.0f - i * spacing);
+		}
+
+		HeightQuadtree tree(std::move(heights), size, size, -80.0f, 80.0f, spacing, spacing);
+		HeightQuadtree::BenchmarkResult result = HeightQuadtree::Benchmark(tree, rayCount);
+
+		std::wostringstream out;
+		out << L"Terrain ray casts " << size << L"x" << size << L": " << result.RayCount << L" rays, "
+			<< result.HitCount << L" hits, " << result.Milliseconds << L" ms ("
+			<< result.RaysPerSecond() / 1.0e6 << L" M rays/s), " << result.SerialMilliseconds << L" ms on one thread; "
+			<< result.Mismatches << L" of " << result.CheckedRays << L" rays differ from a test against every cell\n";
+		OutputDebugString(out.str().c_str());
+	}
+}
+
+void LandApp::RunNormalsBenchmark()
+{
+	// 1024x1024 is the million-vertex case the threaded normal pass was written for.
+	const UINT sizes[] = { 1024, 2048 };
+
+	for (UINT size : sizes)
+	{
+		MeshNormals::BenchmarkResult result = MeshNormals::Benchmark(size, size);
+
+		std::wostringstream out;
+		out << L"Normals " << size << L"x" << size << L" (" << result.VertexCount << L" vertices): general "
+			<< result.Milliseconds << L" ms (serial " << result.SerialMilliseconds << L" ms), grid "
+			<< result.GridMilliseconds << L" ms (serial " << result.GridSerialMilliseconds << L" ms)\n";
+		OutputDebugString(out.str().c_str());
+	}
+}
+
 void LandApp::BuildDescriptorHeaps()
 {
 	UINT objCount = (UINT)mOpaqueRitems.size();
@@ -586,11 +910,7 @@ void LandApp::BuildShadersAndInputLayout()
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\VS.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\PS.hlsl", nullptr, "PS", "ps_5_1");
 
-	mInputLayout =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-	};
+	mInputLayout = VertexDesc::InputLayout();
 }
 
 //step1
@@ -601,113 +921,118 @@ void LandApp::BuildLandGeometry()
 	//The MeshData structure is a simple structure nested inside GeometryGenerator that stores a vertexand index list
 
 	//GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+	mLandGrid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
 
 	//number of cells 2x(m-1)(n-1)
 	//Vij = [-0.5w+jdx, 0, 0.5=i-dz]
 
-	//
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  In addition, color the vertices based on their height so we have
-	// sandy looking beaches, grassy low hills, and snow mountain peaks.
-	//
+	// Apply the height function to the grid itself so the flat (0,1,0) normals and
+	// (1,0,0) tangents from CreateGrid can be regenerated for the displaced surface.
+	for (auto& v : mLandGrid.Vertices)
+		v.Position.y = GetHillsHeight(v.Position.x, v.Position.z);
 
-	std::vector<Vertex> vertices(grid.Vertices.size());
-	for (size_t i = 0; i < grid.Vertices.size(); ++i)
-	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos = p;
-		vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
+	MeshNormals::ComputeGridNormalsAndTangents(mLandGrid, 50, 50);
 
-		// Color the vertex based on its height.
-		if (vertices[i].Pos.y < -10.0f)
-		{
-			// Sandy beach color.
-			vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 5.0f)
-		{
-			// Light yellow-green.
-			vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 12.0f)
-		{
-			// Dark yellow-green.
-			vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 20.0f)
-		{
-			// Dark brown.
-			vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
-		}
-		else
-		{
-			// White snow.
-			vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-		}
-	}
+	// Runtime edits change mLandGrid in place; at least one whole row must fit in a frame's upload.
+	mTerrainEditor = std::make_unique<TerrainEditor>(mLandGrid, 50, 50);
+	assert(mTerrainEditor->ColumnCount() <= gTerrainStagingVertexCount);
 
+	mLandHeights = std::make_unique<HeightQuadtree>(mLandGrid, 50, 50);
 
+	// The hills have no coarser parametric form, so the lower levels of detail come from
+	// simplifying the displaced grid: a quarter, then a sixteenth of the triangles.
+	MeshSimplifier::Settings lodSettings;
+	lodSettings.TargetTriangleRatio = 0.25f;
+	MeshSimplifier::LodChain landLods = MeshSimplifier::BuildLodChain(mLandGrid, { lodSettings, lodSettings });
+
+	for (size_t i = 0; i < landLods.LevelStats.size(); ++i)
+	{
+		const auto& stats = landLods.LevelStats[i];
+		std::wostringstream out;
+		out << L"Land LOD " << i + 1 << L": " << stats.SourceTriangles << L" -> " << stats.ResultTriangles
+			<< L" triangles, max error " << stats.MaxError << L", " << stats.Milliseconds << L" ms\n";
+		OutputDebugString(out.str().c_str());
+	}
 
 	//
-	// We are concatenating all the geometry into one big vertex/index buffer.  So
-	// define the regions in the buffer each submesh covers.
+	// We are concatenating all the geometry into one big vertex/index buffer.  The packer
+	// works out the region of the buffers each level covers.
 	//
+	const char* lodNames[] = { "grid", "grid_lod1", "grid_lod2" };
 
-	// Cache the vertex offsets to each object in the concatenated vertex buffer.
-	UINT gridVertexOffset = 0;
+	MeshPacker packer;
+	for (size_t i = 0; i < landLods.Levels.size(); ++i)
+		packer.Add(lodNames[i], landLods.Levels[i]);
 
+	//
+	// Extract the vertex elements we are interested in.  In addition, color the vertices
+	// based on their height so we have sandy looking beaches, grassy low hills, and snow
+	// mountain peaks.
+	//
+	std::vector<Vertex> vertices = packer.PackVertices<Vertex>(
+		[this](const GeometryGenerator::Vertex& v, UINT meshIndex)
+	{
+		Vertex vertex;
+		vertex.Pos = v.Position;
+		vertex.Color = GetHillsColor(vertex.Pos.y);
+		return vertex;
+	});
 
-	// Cache the starting index for each object in the concatenated index buffer.
-	UINT gridIndexOffset = 0;
+	std::vector<std::uint16_t> indices = packer.PackIndices16();
 
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
-	// Define the SubmeshGeometry that cover different 
-	// regions of the vertex/index buffers.
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "landGeo";
 
-	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	//
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-	//
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-	//auto totalVertexCount = grid.Vertices.size();
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
+	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
 
-	//std::vector<Vertex> vertices(totalVertexCount);
+	packer.FillDrawArgs(*geo);
 
-	//UINT k = 0;
-	//for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-	//{
-	//	vertices[k].Pos = grid.Vertices[i].Position;
-	//	vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkOrange);
-	//}
+	// Screen size thresholds are fractions of the viewport height.
+	LodTable& landLodTable = mLodTables["grid"];
+	landLodTable.AddLevel(geo->DrawArgs["grid"], 0.6f);
+	landLodTable.AddLevel(geo->DrawArgs["grid_lod1"], 0.3f);
+	landLodTable.AddLevel(geo->DrawArgs["grid_lod2"], 0.0f);
 
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
+	mGeometries[geo->Name] = std::move(geo);
+}
 
+void LandApp::BuildWavesGeometry()
+{
+	std::vector<std::uint16_t> indices = mWaves->BuildIndices16();
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+	UINT vbByteSize = mWaves->VertexCount() * sizeof(Vertex);
+	UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "landGeo";
+	geo->Name = "waterGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	// The vertices are rewritten every frame, so there is no static vertex buffer: the
+	// render item points at the current frame resource's WavesVB instead.
+	geo->VertexBufferCPU = nullptr;
+	geo->VertexBufferGPU = nullptr;
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
@@ -716,10 +1041,14 @@ void LandApp::BuildLandGeometry()
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	geo->DrawArgs["grid"] = gridSubmesh;
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)indices.size();
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
 
+	geo->DrawArgs["grid"] = submesh;
 
-	mGeometries[geo->Name] = std::move(geo);
+	mGeometries["waterGeo"] = std::move(geo);
 }
 
 void LandApp::BuildPSOs()
@@ -773,7 +1102,7 @@ void LandApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size()));
+			1, (UINT)mAllRitems.size(), mWaves->VertexCount(), gTerrainStagingVertexCount));
 	}
 }
 
@@ -789,8 +1118,21 @@ void LandApp::BuildRenderItems()
 	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	gridRitem->Lod = &mLodTables["grid"];
+	mLandRitem = gridRitem.get();
 	mAllRitems.push_back(std::move(gridRitem));
 
+	auto wavesRitem = std::make_unique<RenderItem>();
+	wavesRitem->World = MathHelper::Identity4x4();
+	wavesRitem->ObjCBIndex = 1;
+	wavesRitem->Geo = mGeometries["waterGeo"].get();
+	wavesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	wavesRitem->IndexCount = wavesRitem->Geo->DrawArgs["grid"].IndexCount;
+	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
+	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	mWavesRitem = wavesRitem.get();
+	mAllRitems.push_back(std::move(wavesRitem));
+
 
 	// All the render items are opaque.
 	//Our application will maintain lists of render items based on how they need to be
@@ -832,4 +1174,59 @@ float LandApp::GetHillsHeight(float x, float z)const
 	return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
 }
 
+XMFLOAT4 LandApp::GetHillsColor(float y)const
+{
+	// Color the vertex based on its height so we have sandy looking beaches, grassy low
+	// hills, and snow mountain peaks.
+	if (y < -10.0f)
+	{
+		// Sandy beach color.
+		return XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+	}
+	else if (y < 5.0f)
+	{
+		// Light yellow-green.
+		return XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+	}
+	else if (y < 12.0f)
+	{
+		// Dark yellow-green.
+		return XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+	}
+	else if (y < 20.0f)
+	{
+		// Dark brown.
+		return XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+	}
+	else
+	{
+		// White snow.
+		return XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
+bool LandApp::PickTerrain(int sx, int sy, XMFLOAT3& hitPosW)
+{
+	// Compute picking ray in view space.
+	float vx = (+2.0f * sx / mClientWidth - 1.0f) / mProj(0, 0);
+	float vy = (-2.0f * sy / mClientHeight + 1.0f) / mProj(1, 1);
+
+	// Transform the ray to world space.  The land's world matrix is the identity, so this
+	// is also the grid's local space.
+	XMMATRIX V = XMLoadFloat4x4(&mView);
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
+
+	XMFLOAT3 origin;
+	XMFLOAT3 dir;
+	XMStoreFloat3(&origin, XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), invView));
+	XMStoreFloat3(&dir, XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView));
+
+	float t = 0.0f;
+	if (!mLandHeights->Raycast(origin, dir, &t))
+		return false;
+
+	hitPosW = XMFLOAT3(origin.x + t * dir.x, origin.y + t * dir.y, origin.z + t * dir.z);
+	return true;
+}
+
 
@@ -0,0 +1,187 @@
+//***************************************************************************************
+// AssetRegistryTests.cpp
+//
+// Fills an AssetRegistry with a thousand names made at run time and checks lookups by
+// name and by handle, removals, that handles to removed assets go stale and stay stale
+// once their slot is reused, that freed slots are reused before the array grows, and
+// that heavy add/remove churn keeps the name table working.  Build and run with the
+// other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "AssetRegistry.h"
+#include "TestCheck.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Registry = AssetRegistry<int>;
+	using Handle = Registry::Handle;
+
+	static_assert(ASSET_NAME("box").Hash == HashAssetName("box"), "same hash at compile time");
+	static_assert(HashAssetName("box") != HashAssetName("grid"), "different names");
+
+	// Names with run time text; AssetName only points at it, so the strings must outlive
+	// the registry.
+	struct Names
+	{
+		std::vector<std::string> Text;
+
+		explicit Names(int count, const char* prefix = "asset")
+		{
+			for(int i = 0; i < count; ++i)
+				Text.push_back(prefix + std::to_string(i));
+		}
+
+		AssetName operator[](size_t i)const
+		{
+			return AssetName{ HashAssetName(Text[i].c_str()), Text[i].c_str() };
+		}
+	};
+
+	void TestThousandNames()
+	{
+		const int count = 1000;
+		Names names(count);
+		Registry registry;
+
+		std::vector<Handle> handles;
+		for(int i = 0; i < count; ++i)
+			handles.push_back(registry.Add(names[i], i));
+		CHECK(registry.Count() == (Registry::uint32)count);
+
+		bool found = true;
+		for(int i = 0; i < count; ++i)
+		{
+			Handle h = registry.Find(names[i]);
+			found = found && h == handles[i] && registry.Get(h) != nullptr && *registry.Get(h) == i &&
+				registry[h] == i && registry[names[i]] == i && registry.GetName(h) == names.Text[i];
+		}
+		CHECK(found);
+
+		CHECK(!registry.Find(ASSET_NAME("missing")).IsValid());
+		CHECK(!Handle().IsValid());
+		CHECK(registry.Get(Handle()) == nullptr);
+		CHECK(registry.GetName(Handle()) == nullptr);
+
+		int visited = 0;
+		long long sum = 0;
+		registry.ForEach([&](Handle h, int& asset)
+		{
+			++visited;
+			sum += asset;
+			CHECK(registry.IsAlive(h));
+		});
+		CHECK(visited == count);
+		CHECK(sum == (long long)count * (count - 1) / 2);
+	}
+
+	void TestRemoveAndStaleHandles()
+	{
+		const int count = 1000;
+		Names names(count);
+		Registry registry;
+
+		std::vector<Handle> handles;
+		for(int i = 0; i < count; ++i)
+			handles.push_back(registry.Add(names[i], i));
+
+		// Remove the odd ones.
+		for(int i = 1; i < count; i += 2)
+			CHECK(registry.Remove(handles[i]));
+		CHECK(registry.Count() == (Registry::uint32)count / 2);
+
+		bool ok = true;
+		for(int i = 0; i < count; ++i)
+		{
+			bool removed = i % 2 == 1;
+			ok = ok && registry.IsAlive(handles[i]) == !removed;
+			ok = ok && (registry.Get(handles[i]) == nullptr) == removed;
+			ok = ok && registry.Find(names[i]).IsValid() == !removed;
+		}
+		CHECK(ok);
+
+		// Removing twice, or through a stale handle, does nothing.
+		CHECK(!registry.Remove(handles[1]));
+		CHECK(registry.Count() == (Registry::uint32)count / 2);
+
+		// Reusing the slots must not bring the old handles back to life.
+		Names newNames(count / 2, "new");
+		std::vector<Handle> newHandles;
+		for(int i = 0; i < count / 2; ++i)
+			newHandles.push_back(registry.Add(newNames[i], -i));
+		CHECK(registry.Count() == (Registry::uint32)count);
+
+		bool reused = true;
+		bool stale = true;
+		for(const Handle& h : newHandles)
+			reused = reused && h.Index < (Registry::uint32)count && h.Index % 2 == 1;
+		for(int i = 1; i < count; i += 2)
+		{
+			stale = stale && !registry.IsAlive(handles[i]) && registry.Get(handles[i]) == nullptr &&
+				registry.GetName(handles[i]) == nullptr;
+		}
+		CHECK(reused);
+		CHECK(stale);
+
+		// The new asset in a reused slot has the same index as the old one and a later
+		// generation.
+		Handle h = registry.Find(newNames[0]);
+		CHECK(h == newHandles[0]);
+		CHECK(*registry.Get(h) == 0);
+		bool sameIndex = false;
+		for(int i = 1; i < count; i += 2)
+		{
+			if(handles[i].Index == h.Index)
+			{
+				sameIndex = true;
+				CHECK(handles[i].Generation != h.Generation);
+			}
+		}
+		CHECK(sameIndex);
+
+		// The removed names can be registered again.
+		Handle again = registry.Add(names[1], 1001);
+		CHECK(registry.Find(names[1]) == again);
+		CHECK(again != handles[1]);
+		CHECK(registry[names[1]] == 1001);
+	}
+
+	// The same names added and removed over and over leave removed entries all through the
+	// table; Add must keep rehashing them away and Find must keep terminating.
+	void TestChurn()
+	{
+		Names names(64, "churn");
+		Registry registry;
+
+		Handle keep = registry.Add(ASSET_NAME("keep"), 7);
+		std::vector<Handle> handles(64);
+		for(int round = 0; round < 200; ++round)
+		{
+			for(int i = 0; i < 64; ++i)
+				handles[i] = registry.Add(names[i], round);
+			for(int i = 0; i < 64; ++i)
+				registry.Remove(handles[i]);
+		}
+
+		CHECK(registry.Count() == 1);
+		CHECK(registry.Find(ASSET_NAME("keep")) == keep);
+		CHECK(!registry.Find(names[0]).IsValid());
+
+		// Every slot was freed each round, so the array never grew past 65.
+		Handle last = registry.Add(names[63], 1);
+		CHECK(last.Index < 65);
+		CHECK(*registry.Get(last) == 1);
+	}
+}
+
+int main()
+{
+	TestThousandNames();
+	TestRemoveAndStaleHandles();
+	TestChurn();
+
+	return TestCheck::Result("AssetRegistryTests");
+}
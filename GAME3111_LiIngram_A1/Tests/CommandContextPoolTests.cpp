@@ -0,0 +1,206 @@
+//***************************************************************************************
+// CommandContextPoolTests.cpp
+//
+// Drives CommandContextPool against NullCommandBackend, which fails a check for every
+// allocator or list rule D3D12 would enforce, and checks the reuse the pool promises:
+// lists come back straight away, allocators only after their fence, and preferably to
+// the thread that used them last.  Build and run with the other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "CommandContextPool.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Call = NullCommandBackend::Call;
+
+	void CheckNoViolations(const NullCommandBackend& backend)
+	{
+		for(const std::string& v : backend.GetViolations())
+			std::fprintf(stderr, "  violation: %s\n", v.c_str());
+		CHECK(backend.GetViolations().empty());
+	}
+
+	void Submit(CommandContextPool& pool, NullCommandBackend& backend,
+		const CommandContextPool::Context& context, CommandContextPool::uint64 fence)
+	{
+		pool.Close(context);
+		backend.Submit(context.List, fence);
+		pool.Release(context, fence);
+	}
+
+	// The list is reusable as soon as it is released, the allocator only once its fence
+	// has completed.
+	void TestFenceGating()
+	{
+		NullCommandBackend backend;
+		CommandContextPool pool(backend);
+
+		auto first = pool.Acquire();
+		CHECK(first.Allocator == 0 && first.List == 0);
+		pool.AddRecordedBytes(first, 1000);
+		Submit(pool, backend, first, 1);
+
+		auto second = pool.Acquire();
+		CHECK(second.Allocator == 1);
+		CHECK(second.List == 0);
+		pool.AddRecordedBytes(second, 3000);
+		Submit(pool, backend, second, 2);
+
+		CHECK(pool.GetStats().InFlight == 2);
+
+		backend.SetCompletedFence(1);
+		auto third = pool.Acquire();
+		CHECK(third.Allocator == 0);
+		CHECK(third.List == 0);
+		Submit(pool, backend, third, 3);
+
+		CHECK(pool.AllocatorCount() == 2);
+		CHECK(pool.ListCount() == 1);
+
+		const auto& calls = backend.GetCalls();
+		CHECK(calls.size() == 9);
+		if(calls.size() == 9)
+		{
+			CHECK(calls[0].Type == Call::Kind::CreateAllocator && calls[0].Allocator == 0);
+			CHECK(calls[1].Type == Call::Kind::CreateList && calls[1].List == 0 && calls[1].Allocator == 0);
+			CHECK(calls[2].Type == Call::Kind::CloseList);
+			CHECK(calls[3].Type == Call::Kind::CreateAllocator && calls[3].Allocator == 1);
+			CHECK(calls[4].Type == Call::Kind::ResetList && calls[4].List == 0 && calls[4].Allocator == 1);
+			CHECK(calls[5].Type == Call::Kind::CloseList);
+			CHECK(calls[6].Type == Call::Kind::ResetAllocator && calls[6].Allocator == 0);
+			CHECK(calls[7].Type == Call::Kind::ResetList && calls[7].List == 0 && calls[7].Allocator == 0);
+			CHECK(calls[8].Type == Call::Kind::CloseList);
+		}
+
+		// Allocator 0 was reset once; its bytes start over but the peak is kept.
+		auto stats0 = pool.GetAllocatorStats(0);
+		CHECK(stats0.Uses == 2);
+		CHECK(stats0.Resets == 1);
+		CHECK(stats0.Bytes == 0);
+		CHECK(stats0.PeakBytes == 1000);
+
+		auto stats = pool.GetStats();
+		CHECK(stats.Acquires == 3);
+		CHECK(stats.AllocatorsReused == 1);
+		CHECK(stats.PeakBytes == 3000);
+		CHECK(stats.TotalPeakBytes == 4000);
+
+		CheckNoViolations(backend);
+	}
+
+	// Two threads recording every frame each keep getting their own allocator back.
+	void TestThreadAffinity()
+	{
+		NullCommandBackend backend;
+		CommandContextPool pool(backend);
+
+		const int frames = 8;
+		CommandContextPool::uint64 fence = 0;
+		for(int frame = 0; frame < frames; ++frame)
+		{
+			auto a = pool.Acquire(0);
+			auto b = pool.Acquire(1);
+			Submit(pool, backend, b, ++fence);
+			Submit(pool, backend, a, fence);
+
+			// The GPU runs a frame behind.
+			if(fence > 1)
+				backend.SetCompletedFence(fence - 1);
+		}
+
+		// Two allocators in flight per frame, two more for the frame still recording.
+		auto stats = pool.GetStats();
+		CHECK(stats.AllocatorCount == 4);
+		CHECK(stats.ListCount == 2);
+		CHECK(stats.Acquires == 2 * frames);
+		CHECK(stats.AllocatorsReused == 2 * frames - 4);
+		CHECK(stats.ThreadHits == stats.AllocatorsReused);
+
+		CheckNoViolations(backend);
+	}
+
+	// The null backend has to catch the mistakes the pool exists to prevent, or the
+	// other tests prove nothing.
+	void TestBackendCatchesViolations()
+	{
+		NullCommandBackend backend;
+		backend.CreateAllocator(0);
+		backend.CreateList(0, 0);
+		backend.CreateList(1, 0);
+		CHECK(backend.GetViolations().size() == 1);
+
+		backend.CloseList(0);
+		backend.CloseList(1);
+		backend.Submit(0, 5);
+		backend.ResetAllocator(0);
+		CHECK(backend.GetViolations().size() == 2);
+
+		backend.SetCompletedFence(5);
+		backend.ResetAllocator(0);
+		CHECK(backend.GetViolations().size() == 2);
+	}
+
+	// Several threads acquire, record and release concurrently while the main thread plays
+	// the GPU and completes fences behind them.
+	void TestConcurrentThreads()
+	{
+		NullCommandBackend backend;
+		CommandContextPool pool(backend);
+
+		const CommandContextPool::uint32 threadCount = 4;
+		const int iterations = 2000;
+
+		std::atomic<CommandContextPool::uint64> nextFence{ 0 };
+		std::atomic<CommandContextPool::uint32> running{ threadCount };
+
+		std::vector<std::thread> threads;
+		for(CommandContextPool::uint32 t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				for(int i = 0; i < iterations; ++i)
+				{
+					auto context = pool.Acquire(t);
+					pool.AddRecordedBytes(context, 64 * (t + 1));
+					Submit(pool, backend, context, ++nextFence);
+				}
+				--running;
+			});
+		}
+
+		while(running > 0)
+		{
+			CommandContextPool::uint64 fence = nextFence.load();
+			backend.SetCompletedFence(fence > 8 ? fence - 8 : 0);
+			std::this_thread::yield();
+		}
+		for(auto& thread : threads)
+			thread.join();
+
+		backend.SetCompletedFence(nextFence.load());
+		pool.Recycle();
+
+		auto stats = pool.GetStats();
+		CHECK(stats.Acquires == threadCount * iterations);
+		CHECK(stats.InFlight == 0);
+		CHECK(stats.ListCount <= threadCount);
+
+		CheckNoViolations(backend);
+	}
+}
+
+int main()
+{
+	TestFenceGating();
+	TestThreadAffinity();
+	TestBackendCatchesViolations();
+	TestConcurrentThreads();
+	return TestCheck::Result("CommandContextPoolTests");
+}
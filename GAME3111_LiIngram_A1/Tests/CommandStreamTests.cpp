@@ -0,0 +1,262 @@
+//***************************************************************************************
+// CommandStreamTests.cpp
+//
+// Records three scripted frames through a CommandCapture asked for two, and checks that
+// every frame still reaches the next sink, that replaying the capture calls exactly the
+// two captured frames again (same checksum and counts as the originals, and a capture of
+// the replay is byte for byte the same), and that NullCommandSink's checksum sees every
+// argument.  Truncated and corrupt streams must be rejected.  Build and run with the
+// other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "CommandStream.h"
+#include "TestCheck.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	using uint8 = CommandSink::uint8;
+	using uint32 = CommandSink::uint32;
+	using uint64 = CommandSink::uint64;
+
+	// Header of the stream: Magic, Version, frame count.
+	const size_t HeaderSize = 3 * sizeof(uint32);
+
+	// One frame using every command, with arguments that change from frame to frame.
+	void RecordFrame(CommandSink& sink, uint64 frame)
+	{
+		uint32 f = (uint32)frame;
+
+		sink.BeginFrame(frame);
+		sink.SetDescriptorHeap(1);
+		sink.SetRootSignature(2);
+		sink.SetViewport({ 0.0f, 0.0f, 800.0f + f, 600.0f, 0.0f, 1.0f });
+		sink.SetScissorRect({ 0, 0, 800 + (int)f, 600 });
+
+		CommandSink::Barrier barriers[2];
+		barriers[0].Resource = 7;
+		barriers[0].Before = 0;
+		barriers[0].After = 4;
+		barriers[1].Type = CommandSink::Barrier::Kind::UnorderedAccess;
+		barriers[1].Resource = 8 + f;
+		sink.ResourceBarriers(barriers, 2);
+
+		const float color[4] = { 0.1f * f, 0.2f, 0.3f, 1.0f };
+		sink.ClearRenderTarget(3, color);
+		sink.ClearDepthStencil(4, 1.0f, 0);
+		sink.SetRenderTarget(3, 4);
+
+		std::vector<uint8> upload(256 + 16 * f);
+		for(size_t i = 0; i < upload.size(); ++i)
+			upload[i] = (uint8)(i * 7 + f);
+		sink.UploadContents(5, upload.data(), (uint32)upload.size());
+
+		sink.SetPipelineState(10 + f % 2);
+		sink.SetRootShaderResource(0, 5);
+		sink.SetTopology(4);
+		for(uint32 i = 0; i < 4; ++i)
+		{
+			sink.SetVertexBuffer(i);
+			sink.SetIndexBuffer(i);
+			sink.SetRootConstant(1, i);
+			sink.SetDescriptorTable(2, i + f);
+			sink.DrawIndexed(36 + i, 1, 12 * i, -(int)i, i);
+		}
+		sink.EndFrame();
+	}
+
+	// Frames 0..2 through a capture of two; returns the stream.
+	std::vector<uint8> CaptureTwoOfThree(NullCommandSink& live)
+	{
+		CommandCapture capture(2, &live);
+		for(uint64 frame = 0; frame < 3; ++frame)
+		{
+			CHECK(capture.IsComplete() == (frame == 2));
+			RecordFrame(capture, frame);
+			CHECK(capture.CapturedFrames() == (frame < 2 ? frame + 1 : 2));
+		}
+		CHECK(capture.IsComplete());
+		return capture.GetData();
+	}
+
+	void TestRoundTrip()
+	{
+		NullCommandSink live;
+		std::vector<uint8> data = CaptureTwoOfThree(live);
+
+		// The capture passes every frame on, captured or not.
+		NullCommandSink allFrames;
+		for(uint64 frame = 0; frame < 3; ++frame)
+			RecordFrame(allFrames, frame);
+		CHECK(live.Checksum() == allFrames.Checksum());
+		CHECK(live.CommandCount() == allFrames.CommandCount());
+
+		// Replaying gives exactly the first two frames.
+		NullCommandSink original;
+		for(uint64 frame = 0; frame < 2; ++frame)
+			RecordFrame(original, frame);
+
+		NullCommandSink replayed;
+		CommandReplay::Stats stats;
+		std::string error;
+		CHECK(CommandReplay::Replay(data, replayed, stats, &error));
+		CHECK(error.empty());
+		CHECK(stats.Frames == 2);
+		CHECK(stats.FrameMilliseconds.size() == 2);
+		CHECK(stats.Commands == original.CommandCount());
+		CHECK(stats.Ops[(size_t)CommandOp::DrawIndexed].Count == 8);
+		CHECK(replayed.Checksum() == original.Checksum());
+		CHECK(replayed.CommandCount() == original.CommandCount());
+		CHECK(replayed.DrawCount() == 8);
+		CHECK(replayed.UploadBytes() == original.UploadBytes());
+		CHECK(replayed.Checksum() != live.Checksum());
+
+		// A capture of the replay is the same stream.
+		CommandCapture recapture(2);
+		CHECK(CommandReplay::Replay(data, recapture, stats));
+		CHECK(recapture.GetData() == data);
+	}
+
+	// The arguments of the commands NullCommandSink has to look at closely.
+	struct Arguments
+	{
+		CommandSink::Viewport Viewport = { 0.0f, 0.0f, 800.0f, 600.0f, 0.0f, 1.0f };
+		CommandSink::Rect Scissor = { 0, 0, 800, 600 };
+		float Color[4] = { 0.1f, 0.2f, 0.3f, 1.0f };
+		float Depth = 1.0f;
+		uint32 StartInstance = 0;
+	};
+
+	uint64 Checksum(const Arguments& a)
+	{
+		NullCommandSink sink;
+		sink.SetViewport(a.Viewport);
+		sink.SetScissorRect(a.Scissor);
+		sink.ClearRenderTarget(3, a.Color);
+		sink.ClearDepthStencil(4, a.Depth, 0);
+		sink.DrawIndexed(36, 1, 0, 0, a.StartInstance);
+		return sink.Checksum();
+	}
+
+	// Changing any one argument, float or not, changes the checksum.
+	void TestChecksumSeesEveryArgument()
+	{
+		const uint64 base = Checksum(Arguments());
+		CHECK(Checksum(Arguments()) == base);
+
+		// Differences lost by converting to an integer.
+		Arguments a;
+		a.Viewport.Width = 800.5f;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Color[0] = 0.1000001f;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Depth = 0.0f;
+		const uint64 zero = Checksum(a);
+		CHECK(zero != base);
+		a.Depth = -0.0f;
+		CHECK(Checksum(a) != zero);
+
+		a = Arguments();
+		a.Viewport.X = 10.0f;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Viewport.Y = 10.0f;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Viewport.MinDepth = 0.5f;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Viewport.MaxDepth = 0.5f;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Scissor.Left = 5;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Scissor.Top = 5;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.Color[3] = 0.5f;
+		CHECK(Checksum(a) != base);
+		a = Arguments();
+		a.StartInstance = 1;
+		CHECK(Checksum(a) != base);
+	}
+
+	void TestTruncated()
+	{
+		NullCommandSink live;
+		std::vector<uint8> data = CaptureTwoOfThree(live);
+
+		// The last frame ends in a DrawIndexed and a one byte EndFrame, so dropping two
+		// bytes cuts the draw short.
+		std::vector<uint8> truncated(data.begin(), data.end() - 2);
+		NullCommandSink sink;
+		CommandReplay::Stats stats;
+		std::string error;
+		CHECK(!CommandReplay::Replay(truncated, sink, stats, &error));
+		CHECK(error == "stream truncated");
+		CHECK(sink.DrawCount() == 7);
+
+		// Cut all through the stream: a replay never hands on more than was captured, and
+		// succeeds only where the cut falls between two commands.
+		for(size_t cut = HeaderSize + 1; cut < data.size(); cut += 97)
+		{
+			std::vector<uint8> prefix(data.begin(), data.begin() + cut);
+			NullCommandSink partial;
+			bool ok = CommandReplay::Replay(prefix, partial, stats, &error);
+			CHECK(partial.UploadBytes() <= live.UploadBytes());
+			if(ok)
+				CHECK(partial.CommandCount() < live.CommandCount());
+		}
+
+		// Header only: nothing to replay, which is not an error.
+		std::vector<uint8> header(data.begin(), data.begin() + HeaderSize);
+		NullCommandSink empty;
+		CHECK(CommandReplay::Replay(header, empty, stats));
+		CHECK(empty.CommandCount() == 0);
+
+		// Less than a header.
+		std::vector<uint8> stub(data.begin(), data.begin() + HeaderSize - 1);
+		CHECK(!CommandReplay::Replay(stub, empty, stats, &error));
+	}
+
+	void TestCorrupt()
+	{
+		NullCommandSink live;
+		std::vector<uint8> data = CaptureTwoOfThree(live);
+		CommandReplay::Stats stats;
+		std::string error;
+
+		// An unknown command.
+		std::vector<uint8> unknown = data;
+		unknown.push_back(0xff);
+		NullCommandSink sink;
+		CHECK(!CommandReplay::Replay(unknown, sink, stats, &error));
+		CHECK(error == "unknown command 255");
+
+		// A barrier count far larger than the stream must not be trusted.
+		std::vector<uint8> barriers(data.begin(), data.begin() + HeaderSize);
+		barriers.push_back((uint8)CommandOp::ResourceBarriers);
+		for(int i = 0; i < 4; ++i)
+			barriers.push_back(0xff);
+		NullCommandSink barrierSink;
+		CHECK(!CommandReplay::Replay(barriers, barrierSink, stats, &error));
+		CHECK(error == "stream truncated");
+		CHECK(barrierSink.CommandCount() == 0);
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestChecksumSeesEveryArgument();
+	TestTruncated();
+	TestCorrupt();
+
+	return TestCheck::Result("CommandStreamTests");
+}
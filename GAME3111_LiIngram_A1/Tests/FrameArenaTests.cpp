@@ -0,0 +1,250 @@
+//***************************************************************************************
+// FrameArenaTests.cpp
+//
+// Runs LinearArena and FrameArena over an upstream resource that counts its calls.
+// Checks alignment and that allocations never overlap, that a frame which spills into
+// extra blocks has them merged by Reset without the merge being counted against the next
+// frame, and that once warmed up a frame of the same size makes no upstream calls at all.
+// Also checks that every thread gets its own scratch arena, and that scratch lookups
+// never mix up two FrameArenas.  Build and run with the other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "FrameArena.h"
+#include "TestCheck.h"
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace
+{
+	using uint32 = FrameArena::uint32;
+	using uint64 = FrameArena::uint64;
+
+	// Forwards to the heap, counting calls and the bytes held.
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		uint64 Allocations = 0;
+		uint64 Deallocations = 0;
+		uint64 Held = 0;
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment)override
+		{
+			++Allocations;
+			Held += bytes;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment)override
+		{
+			++Deallocations;
+			Held -= bytes;
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	// 100 allocations of mixed sizes and alignments, about 7 KB in all, each filled with
+	// its own byte; false if any two overlap or one is misaligned.
+	bool RunFrame(LinearArena& arena)
+	{
+		struct Allocation
+		{
+			unsigned char* Data;
+			size_t Size;
+		};
+		std::vector<Allocation> allocations;
+
+		bool ok = true;
+		for(int i = 0; i < 100; ++i)
+		{
+			size_t size = 8 + (i * 37) % 120;
+			size_t alignment = (size_t)1 << (i % 8);
+			void* p = arena.allocate(size, alignment);
+			ok = ok && reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+
+			memset(p, i, size);
+			allocations.push_back({ static_cast<unsigned char*>(p), size });
+		}
+
+		for(size_t i = 0; i < allocations.size(); ++i)
+		{
+			for(size_t j = 0; j < allocations[i].Size; ++j)
+				ok = ok && allocations[i].Data[j] == (unsigned char)i;
+		}
+		return ok;
+	}
+
+	void TestSpillMergeAndWarmUp()
+	{
+		CountingResource upstream;
+		{
+			LinearArena arena(1024, &upstream);
+
+			// The first frame needs several 1 KB blocks.
+			CHECK(RunFrame(arena));
+			const LinearArena::Stats& stats = arena.GetStats();
+			CHECK(stats.Allocations == 100);
+			CHECK(stats.UpstreamAllocations > 1);
+			CHECK(stats.UpstreamAllocations == upstream.Allocations);
+			CHECK(stats.Capacity == upstream.Held);
+			uint64 firstFrameBlocks = stats.UpstreamAllocations;
+			uint64 capacity = stats.Capacity;
+
+			// Reset swaps them for one block of the same total size, and that is not
+			// the next frame's doing.
+			arena.Reset();
+			CHECK(upstream.Allocations == firstFrameBlocks + 1);
+			CHECK(upstream.Deallocations == firstFrameBlocks);
+			CHECK(stats.Capacity == capacity);
+			CHECK(stats.UpstreamAllocations == 0);
+			CHECK(stats.TotalUpstreamAllocations == firstFrameBlocks + 1);
+			CHECK(stats.Allocations == 0);
+			CHECK(stats.Bytes == 0);
+
+			// Warmed up: the same frame again fits in the merged block.
+			for(int frame = 0; frame < 10; ++frame)
+			{
+				uint64 before = upstream.Allocations;
+				CHECK(RunFrame(arena));
+				CHECK(stats.UpstreamAllocations == 0);
+				CHECK(upstream.Allocations == before);
+				CHECK(stats.Allocations == 100);
+				arena.Reset();
+				CHECK(upstream.Allocations == before);
+			}
+			CHECK(stats.TotalUpstreamAllocations == firstFrameBlocks + 1);
+			CHECK(stats.PeakBytes > 0);
+		}
+
+		// The destructor gives everything back.
+		CHECK(upstream.Held == 0);
+		CHECK(upstream.Allocations == upstream.Deallocations);
+	}
+
+	// An allocation larger than a block gets a block of its own; deallocate does nothing.
+	void TestLargeAndContainers()
+	{
+		CountingResource upstream;
+		LinearArena arena(1024, &upstream);
+
+		void* big = arena.allocate(10000, 64);
+		CHECK(reinterpret_cast<std::uintptr_t>(big) % 64 == 0);
+		CHECK(arena.GetStats().Capacity >= 10000);
+		memset(big, 1, 10000);
+
+		uint64 before = upstream.Deallocations;
+		arena.deallocate(big, 10000, 64);
+		CHECK(upstream.Deallocations == before);
+
+		std::pmr::vector<int> list(&arena);
+		for(int i = 0; i < 1000; ++i)
+			list.push_back(i);
+		CHECK(list[999] == 999);
+		CHECK(arena.GetStats().Allocations > 1);
+
+		CHECK(arena.is_equal(arena));
+		LinearArena other(1024, &upstream);
+		CHECK(!arena.is_equal(other));
+	}
+
+	// The frame arena and the calling thread's scratch arena, summed by FrameArena.
+	void TestFrameArenaWarmUp()
+	{
+		CountingResource upstream;
+		FrameArena arena(1024, 1024, &upstream);
+
+		CHECK(RunFrame(arena.Frame()));
+		CHECK(RunFrame(arena.Scratch()));
+		CHECK(arena.ScratchCount() == 1);
+		LinearArena::Stats first = arena.GetStats();
+		CHECK(first.Allocations == 200);
+		CHECK(first.UpstreamAllocations == upstream.Allocations);
+		CHECK(first.UpstreamAllocations > 2);
+
+		arena.Reset();
+		CHECK(arena.GetLastFrameStats().Allocations == 200);
+		CHECK(arena.GetLastFrameStats().UpstreamAllocations == first.UpstreamAllocations);
+		CHECK(arena.GetStats().UpstreamAllocations == 0);
+
+		for(int frame = 0; frame < 10; ++frame)
+		{
+			uint64 before = upstream.Allocations;
+			CHECK(RunFrame(arena.Frame()));
+			CHECK(RunFrame(arena.Scratch()));
+			CHECK(arena.GetStats().UpstreamAllocations == 0);
+			arena.Reset();
+			CHECK(arena.GetLastFrameStats().UpstreamAllocations == 0);
+			CHECK(upstream.Allocations == before);
+		}
+	}
+
+	void TestScratchPerThread()
+	{
+		ThreadPool pool(3);
+		FrameArena arena;
+
+		std::mutex mutex;
+		std::set<std::thread::id> threads;
+		std::set<LinearArena*> arenas;
+		bool sameArena = true;
+
+		pool.ParallelFor(10000, 16, [&](uint32 begin, uint32 end, uint32)
+		{
+			LinearArena& scratch = arena.Scratch();
+			std::pmr::vector<uint32> list(&scratch);
+			for(uint32 i = begin; i < end; ++i)
+				list.push_back(i);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			sameArena = sameArena && &scratch == &arena.Scratch();
+			threads.insert(std::this_thread::get_id());
+			arenas.insert(&scratch);
+		});
+
+		CHECK(sameArena);
+		CHECK(arenas.size() == threads.size());
+		CHECK(arena.ScratchCount() == (uint32)threads.size());
+		CHECK(arena.ScratchCount() <= pool.SlotCount());
+	}
+
+	// The calling thread caches its last scratch lookup; another arena, or a new one at
+	// the address of a destroyed one, must not get the cached answer.
+	void TestScratchCache()
+	{
+		FrameArena a;
+		FrameArena b;
+		LinearArena* scratchA = &a.Scratch();
+		LinearArena* scratchB = &b.Scratch();
+		CHECK(scratchA != scratchB);
+		CHECK(&a.Scratch() == scratchA);
+		CHECK(&b.Scratch() == scratchB);
+
+		for(int i = 0; i < 4; ++i)
+		{
+			auto c = std::make_unique<FrameArena>();
+			CHECK(&c->Scratch() != scratchB);
+			CHECK(c->ScratchCount() == 1);
+		}
+	}
+}
+
+int main()
+{
+	TestSpillMergeAndWarmUp();
+	TestLargeAndContainers();
+	TestFrameArenaWarmUp();
+	TestScratchPerThread();
+	TestScratchCache();
+
+	return TestCheck::Result("FrameArenaTests");
+}
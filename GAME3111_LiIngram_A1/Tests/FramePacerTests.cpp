@@ -0,0 +1,174 @@
+//***************************************************************************************
+// FramePacerTests.cpp
+//
+// Runs FramePacer against a fake clock: sleeps advance it by what was asked plus a fixed
+// oversleep, every read advances it by one tick so spinning terminates, and the frame's
+// work is a jump of the clock.  Checks that frames start on the deadline grid, that late
+// frames reset it, and the interval statistics.  Build and run with the other headless
+// tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "FramePacer.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	using Duration = FramePacer::Duration;
+	using std::chrono::microseconds;
+	using std::chrono::milliseconds;
+
+	struct FakeClock
+	{
+		FramePacer::TimePoint Time;
+		Duration Tick = microseconds(1);
+		Duration Oversleep = microseconds(200);
+		int Sleeps = 0;
+
+		FramePacer::Hooks Hooks()
+		{
+			FramePacer::Hooks hooks;
+			hooks.Now = [this]() { Time += Tick; return Time; };
+			hooks.Sleep = [this](Duration d) { Time += d + Oversleep; ++Sleeps; };
+			return hooks;
+		}
+	};
+
+	bool Near(double a, double b, double tolerance)
+	{
+		return std::abs(a - b) <= tolerance;
+	}
+
+	// Unpaced, the pacer only measures; feed it known intervals.
+	void TestIntervalStats()
+	{
+		FakeClock clock;
+		clock.Tick = Duration::zero();
+		FramePacer pacer(0.0, clock.Hooks());
+
+		// Intervals alternate 15 and 17 ms: mean 16, standard deviation 1.
+		pacer.WaitForNextFrame();
+		for(int i = 0; i < 1000; ++i)
+		{
+			clock.Time += milliseconds(i % 2 == 0 ? 15 : 17);
+			pacer.WaitForNextFrame();
+		}
+
+		FramePacer::Stats stats = pacer.GetStats();
+		CHECK(stats.Frames == 1001);
+		CHECK(stats.TargetMilliseconds == 0.0);
+		CHECK(Near(stats.MeanIntervalMilliseconds, 16.0, 1e-9));
+		CHECK(Near(stats.JitterMilliseconds, 1.0, 1e-9));
+		CHECK(clock.Sleeps == 0);
+
+		pacer.ResetStats();
+		CHECK(pacer.GetStats().Frames == 0);
+		CHECK(pacer.GetStats().JitterMilliseconds == 0.0);
+	}
+
+	// Jitter of a microsecond on a 16.667 ms interval.  The sum of squares minus the
+	// squared mean cancelled most of it away; the running update must not.
+	void TestSmallJitter()
+	{
+		FakeClock clock;
+		clock.Tick = Duration::zero();
+		FramePacer pacer(0.0, clock.Hooks());
+
+		pacer.WaitForNextFrame();
+		for(int i = 0; i < 100000; ++i)
+		{
+			clock.Time += milliseconds(16) + microseconds(i % 2 == 0 ? 666 : 668);
+			pacer.WaitForNextFrame();
+		}
+
+		FramePacer::Stats stats = pacer.GetStats();
+		CHECK(Near(stats.MeanIntervalMilliseconds, 16.667, 1e-9));
+		CHECK(Near(stats.JitterMilliseconds, 0.001, 1e-9));
+	}
+
+	void RunFrames(FramePacer& pacer, FakeClock& clock, int frames, Duration work)
+	{
+		for(int i = 0; i < frames; ++i)
+		{
+			pacer.WaitForNextFrame();
+			clock.Time += work;
+		}
+	}
+
+	void TestHybridHitsDeadlines()
+	{
+		FakeClock clock;
+		FramePacer pacer(100.0, clock.Hooks());
+		RunFrames(pacer, clock, 200, milliseconds(3));
+
+		// Sleeps stop early enough for the oversleep and the spin lands within a few ticks.
+		FramePacer::Stats stats = pacer.GetStats();
+		CHECK(stats.TargetMilliseconds == 10.0);
+		CHECK(stats.MissedFrames == 0);
+		CHECK(stats.MaxErrorMilliseconds < 0.01);
+		CHECK(Near(stats.MeanIntervalMilliseconds, 10.0, 0.01));
+		CHECK(stats.JitterMilliseconds < 0.01);
+		CHECK(stats.SleepMilliseconds > 0.0);
+		CHECK(stats.SpinMilliseconds > 0.0);
+
+		// The estimate has learned the 1.2 ms a 1 ms sleep really takes.
+		CHECK(Near(stats.SleepEstimateMilliseconds, 1.2, 0.05));
+	}
+
+	void TestSleepOnlyOversleeps()
+	{
+		FakeClock clock;
+		clock.Oversleep = microseconds(500);
+		FramePacer pacer(100.0, clock.Hooks());
+		pacer.SetWaitMode(FramePacer::WaitMode::SleepOnly);
+		RunFrames(pacer, clock, 50, milliseconds(3));
+
+		FramePacer::Stats stats = pacer.GetStats();
+		CHECK(stats.MissedFrames == 0);
+		CHECK(Near(stats.MaxErrorMilliseconds, 0.5, 0.01));
+		CHECK(stats.SpinMilliseconds == 0.0);
+	}
+
+	void TestSpinOnlyNeverSleeps()
+	{
+		FakeClock clock;
+		FramePacer pacer(100.0, clock.Hooks());
+		pacer.SetWaitMode(FramePacer::WaitMode::SpinOnly);
+		RunFrames(pacer, clock, 20, milliseconds(3));
+
+		FramePacer::Stats stats = pacer.GetStats();
+		CHECK(clock.Sleeps == 0);
+		CHECK(stats.MaxErrorMilliseconds < 0.01);
+	}
+
+	// A frame more than a period late starts a new grid rather than a burst of catch-up
+	// frames.
+	void TestLateFrameResetsGrid()
+	{
+		FakeClock clock;
+		FramePacer pacer(100.0, clock.Hooks());
+		RunFrames(pacer, clock, 10, milliseconds(3));
+		RunFrames(pacer, clock, 1, milliseconds(35));
+
+		pacer.ResetStats();
+		RunFrames(pacer, clock, 10, milliseconds(3));
+
+		FramePacer::Stats stats = pacer.GetStats();
+		CHECK(stats.MissedFrames == 1);
+		CHECK(Near(stats.MeanIntervalMilliseconds, 10.0, 0.01));
+	}
+}
+
+int main()
+{
+	TestIntervalStats();
+	TestSmallJitter();
+	TestHybridHitsDeadlines();
+	TestSleepOnlyOversleeps();
+	TestSpinOnlyNeverSleeps();
+	TestLateFrameResetsGrid();
+	return TestCheck::Result("FramePacerTests");
+}
@@ -0,0 +1,231 @@
+//***************************************************************************************
+// FrameStatsTests.cpp
+//
+// Feeds FrameStats known per frame values and checks the nearest rank percentiles, the
+// histogram buckets, the history once it wraps, and the JSON and CSV written from them.
+// Also runs FrameStatsSink in front of NullCommandSink and checks draws, triangles and
+// redundant state changes.  Build and run with the other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "FrameStats.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+	using uint32 = FrameStats::uint32;
+	using uint64 = FrameStats::uint64;
+
+	std::string ReadFile(const std::string& path)
+	{
+		std::ifstream fin(path);
+		std::ostringstream text;
+		text << fin.rdbuf();
+		return text.str();
+	}
+
+	std::string TempPath(const char* name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	// Draws = 1..100 in shuffled order, so the summary has to sort.
+	void FillOneToHundred(FrameStats& stats)
+	{
+		for(uint64 i = 0; i < 100; ++i)
+		{
+			stats.Add(FrameCounter::Draws, 1 + (i * 37) % 100);
+			stats.Add(FrameCounter::UploadBytes, 4096);
+			stats.EndFrame();
+		}
+	}
+
+	void TestSummary()
+	{
+		FrameStats stats;
+		FrameStats::Summary empty = stats.GetSummary(FrameCounter::Draws);
+		CHECK(empty.Min == 0 && empty.Max == 0 && empty.P99 == 0);
+
+		FillOneToHundred(stats);
+		CHECK(stats.FrameCount() == 100);
+
+		// Nearest rank over 100 sorted values: index round(p * 99).
+		FrameStats::Summary s = stats.GetSummary(FrameCounter::Draws);
+		CHECK(s.Min == 1);
+		CHECK(s.Max == 100);
+		CHECK(std::fabs(s.Mean - 50.5) < 1e-9);
+		CHECK(s.P50 == 51);
+		CHECK(s.P95 == 95);
+		CHECK(s.P99 == 99);
+
+		FrameStats::Summary constant = stats.GetSummary(FrameCounter::UploadBytes);
+		CHECK(constant.Min == 4096 && constant.P50 == 4096 && constant.Max == 4096);
+
+		// One frame: every percentile is that frame.
+		FrameStats one;
+		one.Add(FrameCounter::Triangles, 12);
+		one.EndFrame();
+		FrameStats::Summary single = one.GetSummary(FrameCounter::Triangles);
+		CHECK(single.P50 == 12 && single.P95 == 12 && single.P99 == 12);
+	}
+
+	void TestHistogram()
+	{
+		FrameStats stats;
+		FrameStats::Histogram empty = stats.GetHistogram(FrameCounter::Draws, 4);
+		CHECK(empty.Counts.size() == 4);
+		CHECK(empty.Counts[0] == 0);
+
+		// 0..99 over ten buckets of 9.9: ten values each, the maximum in the last.
+		for(uint64 i = 0; i < 100; ++i)
+		{
+			stats.Add(FrameCounter::Draws, i);
+			stats.EndFrame();
+		}
+		FrameStats::Histogram h = stats.GetHistogram(FrameCounter::Draws, 10);
+		CHECK(h.Min == 0);
+		CHECK(h.Max == 99);
+		CHECK(std::fabs(h.BucketWidth - 9.9) < 1e-9);
+		CHECK(h.Counts.size() == 10);
+		bool tens = true;
+		for(uint32 count : h.Counts)
+			tens = tens && count == 10;
+		CHECK(tens);
+
+		// Skewed: nine frames at 0 and one at 100 land in the first and last bucket.
+		FrameStats skewed;
+		for(int i = 0; i < 10; ++i)
+		{
+			skewed.Add(FrameCounter::Draws, i == 9 ? 100 : 0);
+			skewed.EndFrame();
+		}
+		FrameStats::Histogram s = skewed.GetHistogram(FrameCounter::Draws, 4);
+		CHECK(s.Counts[0] == 9 && s.Counts[1] == 0 && s.Counts[2] == 0 && s.Counts[3] == 1);
+
+		// A constant counter puts everything in the first bucket.
+		FrameStats::Histogram c = skewed.GetHistogram(FrameCounter::Triangles, 4);
+		CHECK(c.BucketWidth == 0.0);
+		CHECK(c.Counts[0] == 10);
+
+		// Zero buckets is taken as one.
+		CHECK(skewed.GetHistogram(FrameCounter::Draws, 0).Counts.size() == 1);
+	}
+
+	void TestHistoryWraps()
+	{
+		FrameStats stats(10);
+		for(uint64 i = 0; i < 25; ++i)
+		{
+			stats.Add(FrameCounter::Draws, i);
+			CHECK(stats.Current().Index == i);
+			stats.EndFrame();
+		}
+
+		CHECK(stats.FrameCount() == 10);
+		CHECK(stats.GetFrame(0).Index == 15);
+		CHECK(stats.GetFrame(0)[FrameCounter::Draws] == 15);
+		CHECK(stats.GetLastFrame().Index == 24);
+		CHECK(stats.GetLastFrame()[FrameCounter::Draws] == 24);
+		CHECK(stats.GetSummary(FrameCounter::Draws).Min == 15);
+
+		// The first frame has no previous EndFrame to time against.
+		FrameStats fresh;
+		fresh.EndFrame();
+		CHECK(fresh.GetLastFrame()[FrameCounter::FrameMicroseconds] == 0);
+	}
+
+	void TestOutput()
+	{
+		FrameStats stats;
+		FillOneToHundred(stats);
+
+		std::string json = TempPath("FrameStatsTests.json");
+		CHECK(stats.WriteJson(json));
+		std::string text = ReadFile(json);
+		CHECK(text.find("\"frames\": 100") != std::string::npos);
+		CHECK(text.find("\"Draws\": {\n      \"min\": 1, \"max\": 100, \"mean\": 50.5, \"p50\": 51, \"p95\": 95, \"p99\": 99") != std::string::npos);
+		CHECK(text.find("\"histogram\": { \"min\": 4096, \"bucketWidth\": 0, \"counts\": [100, 0,") != std::string::npos);
+		CHECK(text.find("\"FrameMicroseconds\"") != std::string::npos);
+
+		// Balanced braces, no trailing comma before a closing one.
+		int depth = 0;
+		bool balanced = true;
+		for(char ch : text)
+		{
+			depth += ch == '{' ? 1 : ch == '}' ? -1 : 0;
+			balanced = balanced && depth >= 0;
+		}
+		CHECK(balanced && depth == 0);
+		CHECK(text.find(",\n  }") == std::string::npos);
+
+		std::string csv = TempPath("FrameStatsTests.csv");
+		CHECK(stats.WriteCsv(csv));
+		std::istringstream lines(ReadFile(csv));
+		std::string header, first;
+		std::getline(lines, header);
+		std::getline(lines, first);
+		CHECK(header.rfind("Frame,Draws,Triangles,", 0) == 0);
+		CHECK(first.rfind("0,1,0,", 0) == 0);
+
+		int rows = 0;
+		for(std::string line; std::getline(lines, line);)
+			++rows;
+		CHECK(rows == 99);
+
+		std::filesystem::remove(json);
+		std::filesystem::remove(csv);
+	}
+
+	void TestSink()
+	{
+		FrameStats stats;
+		NullCommandSink null;
+		FrameStatsSink sink(stats, &null);
+
+		for(int frame = 0; frame < 2; ++frame)
+		{
+			sink.BeginFrame(frame);
+			sink.SetPipelineState(1);
+			sink.SetPipelineState(1);               // redundant
+			sink.SetTopology(FrameStatsSink::TriangleList);
+			sink.SetVertexBuffer(3);
+			sink.DrawIndexed(36, 2, 0, 0, 0);       // 12 triangles, twice
+			sink.SetVertexBuffer(3);                // redundant
+			sink.SetTopology(FrameStatsSink::TriangleStrip);
+			sink.DrawIndexed(10, 1, 0, 0, 0);       // 8 triangles
+			sink.EndFrame();
+			stats.EndFrame();
+		}
+
+		// The state is forgotten at BeginFrame, so the second frame counts the same.
+		for(uint32 i = 0; i < 2; ++i)
+		{
+			const FrameStats::Frame& f = stats.GetFrame(i);
+			CHECK(f[FrameCounter::Draws] == 2);
+			CHECK(f[FrameCounter::Triangles] == 32);
+			CHECK(f[FrameCounter::StateChanges] == 4);
+			CHECK(f[FrameCounter::RedundantStateChanges] == 2);
+		}
+
+		// Every command was passed on.
+		CHECK(null.CommandCount() == 20);
+		CHECK(null.DrawCount() == 4);
+	}
+}
+
+int main()
+{
+	TestSummary();
+	TestHistogram();
+	TestHistoryWraps();
+	TestOutput();
+	TestSink();
+
+	return TestCheck::Result("FrameStatsTests");
+}
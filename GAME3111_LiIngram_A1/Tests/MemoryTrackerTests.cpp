@@ -0,0 +1,214 @@
+//***************************************************************************************
+// MemoryTrackerTests.cpp
+//
+// Checks that a budget warning fires once per crossing: not again while the tag stays
+// over budget, again after it has come back under, never when there is no budget, and
+// exactly once when many threads cross together.  Also checks peaks and ResetPeaks,
+// snapshots, the tracking allocators and TrackedMemory.  Build and run with the other
+// headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "MemoryTracker.h"
+#include "TestCheck.h"
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using uint64 = MemoryTracker::uint64;
+
+	// Collects the warnings a tracker reports.
+	struct Warnings
+	{
+		std::mutex Mutex;
+		std::vector<MemoryTracker::BudgetWarning> List;
+
+		explicit Warnings(MemoryTracker& tracker)
+		{
+			tracker.SetWarningFunc([this](const MemoryTracker::BudgetWarning& warning)
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				List.push_back(warning);
+			});
+		}
+
+		size_t Count()
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			return List.size();
+		}
+	};
+
+	void TestOncePerCrossing()
+	{
+		MemoryTracker tracker;
+		Warnings warnings(tracker);
+		const MemoryTag tag = MemoryTag::FrameResources;
+		const MemoryKind gpu = MemoryKind::Gpu;
+		tracker.SetBudget(tag, gpu, 1000);
+
+		// Up to the budget exactly is not over it.
+		tracker.Allocate(tag, gpu, 600);
+		tracker.Allocate(tag, gpu, 400);
+		CHECK(warnings.Count() == 0);
+
+		tracker.Allocate(tag, gpu, 1);
+		CHECK(warnings.Count() == 1);
+		CHECK(warnings.List[0].Tag == tag);
+		CHECK(warnings.List[0].Kind == gpu);
+		CHECK(warnings.List[0].Bytes == 1001);
+		CHECK(warnings.List[0].Budget == 1000);
+
+		// Still over: no more warnings, however much is added.
+		tracker.Allocate(tag, gpu, 5000);
+		tracker.Free(tag, gpu, 5000);
+		tracker.Allocate(tag, gpu, 10);
+		CHECK(warnings.Count() == 1);
+		CHECK(tracker.GetSnapshot().OverBudget(tag, gpu));
+
+		// Back under, then over again: a second warning.
+		tracker.Free(tag, gpu, 600);
+		CHECK(!tracker.GetSnapshot().OverBudget(tag, gpu));
+		tracker.Allocate(tag, gpu, 600);
+		CHECK(warnings.Count() == 2);
+		CHECK(warnings.List[1].Bytes == 1011);
+
+		// Other kinds and tags have budgets of their own.
+		tracker.Allocate(tag, MemoryKind::Cpu, 5000);
+		tracker.Allocate(MemoryTag::Geometry, gpu, 5000);
+		CHECK(warnings.Count() == 2);
+
+		// No budget, no warnings; a budget set below the live bytes waits for a crossing.
+		tracker.SetBudget(tag, gpu, 0);
+		tracker.Allocate(tag, gpu, 100000);
+		CHECK(warnings.Count() == 2);
+		tracker.SetBudget(tag, gpu, 50);
+		tracker.Allocate(tag, gpu, 1);
+		CHECK(warnings.Count() == 2);
+	}
+
+	// Many threads pushing the same tag over its budget together; the bytes are added
+	// atomically, so exactly one allocation crosses.
+	void TestConcurrentCrossing()
+	{
+		MemoryTracker tracker;
+		Warnings warnings(tracker);
+		const MemoryTag tag = MemoryTag::Uploaders;
+		tracker.SetBudget(tag, MemoryKind::Gpu, 50000);
+
+		std::vector<std::thread> threads;
+		for(int t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&tracker, tag]()
+			{
+				for(int i = 0; i < 1000; ++i)
+					tracker.Allocate(tag, MemoryKind::Gpu, 10);
+			});
+		}
+		for(std::thread& thread : threads)
+			thread.join();
+
+		MemoryTracker::Snapshot snapshot = tracker.GetSnapshot();
+		CHECK(snapshot.Get(tag, MemoryKind::Gpu).Bytes == 80000);
+		CHECK(snapshot.Get(tag, MemoryKind::Gpu).Allocations == 8000);
+		CHECK(warnings.Count() == 1);
+		CHECK(warnings.List[0].Bytes > 50000 && warnings.List[0].Bytes <= 50010);
+	}
+
+	void TestPeaksAndSnapshots()
+	{
+		MemoryTracker tracker;
+		const MemoryTag tag = MemoryTag::Textures;
+
+		tracker.Allocate(tag, MemoryKind::Gpu, 3000);
+		tracker.Allocate(tag, MemoryKind::Gpu, 2000);
+		tracker.Free(tag, MemoryKind::Gpu, 3000);
+		tracker.Allocate(MemoryTag::Geometry, MemoryKind::Gpu, 500);
+		tracker.Allocate(MemoryTag::Geometry, MemoryKind::Cpu, 70);
+
+		MemoryTracker::Snapshot s = tracker.GetSnapshot();
+		const MemoryTracker::Counter& c = s.Get(tag, MemoryKind::Gpu);
+		CHECK(c.Bytes == 2000);
+		CHECK(c.PeakBytes == 5000);
+		CHECK(c.Allocations == 1);
+		CHECK(c.TotalAllocations == 2);
+		CHECK(c.Budget == 0);
+		CHECK(!s.OverBudget(tag, MemoryKind::Gpu));
+		CHECK(s.TotalBytes[(size_t)MemoryKind::Gpu] == 2500);
+		CHECK(s.TotalBytes[(size_t)MemoryKind::Cpu] == 70);
+
+		tracker.ResetPeaks();
+		CHECK(tracker.GetSnapshot().Get(tag, MemoryKind::Gpu).PeakBytes == 2000);
+		CHECK(tracker.GetSnapshot().Get(MemoryTag::Other, MemoryKind::Cpu).PeakBytes == 0);
+	}
+
+	// Containers on a tracking allocator count as CPU bytes under its tag, and warn too.
+	void TestResource()
+	{
+		MemoryTracker tracker;
+		Warnings warnings(tracker);
+		const MemoryTag tag = MemoryTag::FrameArenas;
+		tracker.SetBudget(tag, MemoryKind::Cpu, 4096);
+
+		{
+			std::pmr::vector<char> small(1000, 0, tracker.Resource(tag));
+			CHECK(tracker.GetSnapshot().Get(tag, MemoryKind::Cpu).Bytes == 1000);
+			CHECK(warnings.Count() == 0);
+
+			std::pmr::vector<char> large(8192, 0, tracker.Resource(tag));
+			CHECK(tracker.GetSnapshot().Get(tag, MemoryKind::Cpu).Bytes == 9192);
+			CHECK(warnings.Count() == 1);
+		}
+
+		MemoryTracker::Counter c = tracker.GetSnapshot().Get(tag, MemoryKind::Cpu);
+		CHECK(c.Bytes == 0);
+		CHECK(c.Allocations == 0);
+		CHECK(c.PeakBytes == 9192);
+		CHECK(tracker.Resource(tag)->is_equal(*tracker.Resource(tag)));
+		CHECK(!tracker.Resource(tag)->is_equal(*tracker.Resource(MemoryTag::Other)));
+	}
+
+	// TrackedMemory reports to the global tracker; moves hand the bytes over without
+	// counting them twice.
+	void TestTrackedMemory()
+	{
+		MemoryTracker& global = MemoryTracker::Get();
+		auto bytes = [&global]() { return global.GetSnapshot().Get(MemoryTag::Other, MemoryKind::Gpu).Bytes; };
+		uint64 before = bytes();
+
+		{
+			TrackedMemory a(MemoryTag::Other, MemoryKind::Gpu, 300);
+			CHECK(bytes() == before + 300);
+
+			TrackedMemory b(std::move(a));
+			CHECK(a.Bytes() == 0);
+			CHECK(b.Bytes() == 300);
+			CHECK(bytes() == before + 300);
+
+			TrackedMemory c(MemoryTag::Other, MemoryKind::Gpu, 50);
+			c = std::move(b);
+			CHECK(c.Bytes() == 300);
+			CHECK(bytes() == before + 300);
+
+			c.Reset();
+			CHECK(bytes() == before);
+
+			TrackedMemory none;
+			CHECK(none.Bytes() == 0);
+		}
+		CHECK(bytes() == before);
+	}
+}
+
+int main()
+{
+	TestOncePerCrossing();
+	TestConcurrentCrossing();
+	TestPeaksAndSnapshots();
+	TestResource();
+	TestTrackedMemory();
+
+	return TestCheck::Result("MemoryTrackerTests");
+}
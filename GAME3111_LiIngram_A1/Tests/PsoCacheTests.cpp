@@ -0,0 +1,184 @@
+//***************************************************************************************
+// PsoCacheTests.cpp
+//
+// Checks PsoCache's keys and deduplication without creating a single PSO: the cache is
+// built without a device or library, and only Request and Hash are exercised.  Needs the
+// Windows SDK for the D3D12 declarations, so it is not part of the Makefile; from a
+// developer command prompt in Tests:
+//
+//   cl /std:c++17 /EHsc /O2 /I..\Common PsoCacheTests.cpp ..\Common\PsoCache.cpp
+//      ..\Common\ThreadPool.cpp ..\Common\d3dUtil.cpp d3d12.lib d3dcompiler.lib
+//   PsoCacheTests.exe
+//***************************************************************************************
+
+#include "PsoCache.h"
+#include "TestCheck.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const unsigned char VertexShader[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3, 4 };
+	const unsigned char PixelShader[] = { 0x44, 0x58, 0x42, 0x43, 5, 6, 7, 8 };
+	const unsigned char RootSignatureBlob[] = { 0x44, 0x58, 0x42, 0x43, 9, 10, 11, 12 };
+
+	const D3D12_INPUT_ELEMENT_DESC InputLayout[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+	};
+
+	// The cache never calls into root signatures; distinct addresses are all it needs.
+	ID3D12RootSignature* FakeRootSignature(int i)
+	{
+		static char storage[4];
+		return reinterpret_cast<ID3D12RootSignature*>(&storage[i]);
+	}
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC MakeDesc(ID3D12RootSignature* rootSignature)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.pRootSignature = rootSignature;
+		desc.VS = { VertexShader, sizeof(VertexShader) };
+		desc.PS = { PixelShader, sizeof(PixelShader) };
+		desc.InputLayout = { InputLayout, _countof(InputLayout) };
+		desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+		desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+		desc.SampleMask = UINT_MAX;
+		desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		desc.NumRenderTargets = 1;
+		desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		desc.SampleDesc.Count = 1;
+		return desc;
+	}
+
+	// What the key covers, and what it leaves out.
+	void TestHash()
+	{
+		const PsoCache::uint64 rs = PsoCache::HashRootSignature(RootSignatureBlob, sizeof(RootSignatureBlob));
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = MakeDesc(FakeRootSignature(0));
+		PsoCache::Key key = PsoCache::Hash(desc, rs);
+
+		// Shaders and semantic names count by content, not by address.
+		std::vector<unsigned char> vsCopy(VertexShader, VertexShader + sizeof(VertexShader));
+		std::vector<char> semantic(InputLayout[1].SemanticName, InputLayout[1].SemanticName + 6);
+		D3D12_INPUT_ELEMENT_DESC layoutCopy[2] = { InputLayout[0], InputLayout[1] };
+		layoutCopy[1].SemanticName = semantic.data();
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC copy = desc;
+		copy.VS = { vsCopy.data(), vsCopy.size() };
+		copy.InputLayout = { layoutCopy, 2 };
+		CHECK(PsoCache::Hash(copy, rs) == key);
+
+		// The root signature only counts through the hash it is given.
+		copy.pRootSignature = FakeRootSignature(1);
+		CHECK(PsoCache::Hash(copy, rs) == key);
+		CHECK(PsoCache::Hash(desc, rs + 1) != key);
+
+		// Neither do formats past NumRenderTargets, nor the cached blob.
+		copy = desc;
+		copy.RTVFormats[3] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		copy.CachedPSO = { VertexShader, sizeof(VertexShader) };
+		CHECK(PsoCache::Hash(copy, rs) == key);
+
+		// Everything else does.
+		copy = desc;
+		vsCopy.back() ^= 1;
+		copy.VS = { vsCopy.data(), vsCopy.size() };
+		CHECK(PsoCache::Hash(copy, rs) != key);
+
+		copy = desc;
+		copy.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+		CHECK(PsoCache::Hash(copy, rs) != key);
+
+		copy = desc;
+		layoutCopy[1] = InputLayout[1];
+		layoutCopy[1].SemanticIndex = 1;
+		copy.InputLayout = { layoutCopy, 2 };
+		CHECK(PsoCache::Hash(copy, rs) != key);
+
+		copy = desc;
+		copy.NumRenderTargets = 2;
+		CHECK(PsoCache::Hash(copy, rs) != key);
+
+		copy = desc;
+		copy.SampleDesc.Count = 4;
+		CHECK(PsoCache::Hash(copy, rs) != key);
+	}
+
+	// A registered root signature gives the same key whatever its address, which is what
+	// lets the next run find the PSO in the library.
+	void TestRegisteredKeysAreStable()
+	{
+		PsoCache firstRun(nullptr);
+		firstRun.RegisterRootSignature(FakeRootSignature(0), RootSignatureBlob, sizeof(RootSignatureBlob));
+		PsoCache::Key first = firstRun.Request(MakeDesc(FakeRootSignature(0)));
+
+		PsoCache secondRun(nullptr);
+		secondRun.RegisterRootSignature(FakeRootSignature(2), RootSignatureBlob, sizeof(RootSignatureBlob));
+		PsoCache::Key second = secondRun.Request(MakeDesc(FakeRootSignature(2)));
+
+		CHECK(first == second);
+		CHECK(first == PsoCache::Hash(MakeDesc(nullptr),
+			PsoCache::HashRootSignature(RootSignatureBlob, sizeof(RootSignatureBlob))));
+
+		// Unregistered, the address is all there is to go on.
+		PsoCache unregistered(nullptr);
+		CHECK(unregistered.Request(MakeDesc(FakeRootSignature(0))) != first);
+	}
+
+	void TestDedup()
+	{
+		PsoCache cache(nullptr);
+		cache.RegisterRootSignature(FakeRootSignature(0), RootSignatureBlob, sizeof(RootSignatureBlob));
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC solid = MakeDesc(FakeRootSignature(0));
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC wireframe = solid;
+		wireframe.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+
+		PsoCache::Key a = cache.Request(solid);
+		PsoCache::Key b = cache.Request(wireframe);
+		PsoCache::Key c = cache.Request(solid);
+
+		CHECK(a == c);
+		CHECK(a != b);
+		CHECK(cache.EntryCount() == 2);
+		CHECK(cache.GetStats().Requests == 3);
+		CHECK(cache.GetStats().Entries == 2);
+		CHECK(cache.GetStats().HashCollisions == 0);
+		CHECK(cache.Get(a) == nullptr);
+	}
+
+	// Two root signature objects made from the same blob hash the same, so their PSOs
+	// collide on the key.  They are still different PSOs: the second one must get an entry
+	// of its own rather than the first one's.
+	void TestCollision()
+	{
+		PsoCache cache(nullptr);
+		cache.RegisterRootSignature(FakeRootSignature(0), RootSignatureBlob, sizeof(RootSignatureBlob));
+		cache.RegisterRootSignature(FakeRootSignature(1), RootSignatureBlob, sizeof(RootSignatureBlob));
+
+		PsoCache::Key a = cache.Request(MakeDesc(FakeRootSignature(0)));
+		PsoCache::Key b = cache.Request(MakeDesc(FakeRootSignature(1)));
+
+		CHECK(a != b);
+		CHECK(cache.EntryCount() == 2);
+		CHECK(cache.GetStats().HashCollisions == 1);
+
+		// Asking again finds the probed entry instead of adding a third.
+		CHECK(cache.Request(MakeDesc(FakeRootSignature(1))) == b);
+		CHECK(cache.Request(MakeDesc(FakeRootSignature(0))) == a);
+		CHECK(cache.EntryCount() == 2);
+	}
+}
+
+int main()
+{
+	TestHash();
+	TestRegisteredKeysAreStable();
+	TestDedup();
+	TestCollision();
+	return TestCheck::Result("PsoCacheTests");
+}
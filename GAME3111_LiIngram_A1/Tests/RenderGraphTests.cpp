@@ -0,0 +1,244 @@
+//***************************************************************************************
+// RenderGraphTests.cpp
+//
+// Compiles a small frame and checks what RenderGraph derived from it: which passes were
+// culled, where the transients sit in the heap, and the exact barrier batches Execute
+// hands out.  Build and run with the other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "RenderGraph.h"
+#include "TestCheck.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Barrier = RenderGraph::Barrier;
+
+	const RenderGraph::uint64 TargetBytes = 1024 * 1024;
+
+	struct Batch
+	{
+		std::string Before;    // pass executed right after the batch, empty for the final one
+		std::vector<Barrier> Barriers;
+	};
+
+	bool IsTransition(const Barrier& b, RenderGraph::ResourceHandle r, RenderGraph::States before, RenderGraph::States after)
+	{
+		return b.Type == Barrier::Kind::Transition && b.Resource == r && b.Before == before && b.After == after;
+	}
+
+	bool IsAliasing(const Barrier& b, RenderGraph::ResourceHandle r, RenderGraph::ResourceHandle before)
+	{
+		return b.Type == Barrier::Kind::Aliasing && b.Resource == r && b.AliasBefore == before;
+	}
+
+	//   shadow     writes A
+	//   debug      writes C, which nobody reads
+	//   lighting   reads A, writes B
+	//   blur       reads B, writes D
+	//   composite  reads D, writes the back buffer
+	//
+	// A is dead once blur starts, so D can take its memory.
+	void TestFrame()
+	{
+		using namespace ResourceState;
+
+		RenderGraph graph;
+		auto backBuffer = graph.ImportResource("BackBuffer", Present, Present);
+		auto a = graph.CreateTransient("A", TargetBytes);
+		auto b = graph.CreateTransient("B", TargetBytes);
+		auto c = graph.CreateTransient("C", TargetBytes);
+		auto d = graph.CreateTransient("D", TargetBytes);
+
+		std::vector<Batch> batches(1);
+		auto pass = [&](const char* name)
+		{
+			return graph.AddPass(name, [&batches, name]()
+			{
+				batches.back().Before = name;
+				batches.emplace_back();
+			});
+		};
+
+		auto shadow = pass("shadow");
+		graph.Write(shadow, a, DepthWrite);
+
+		auto debug = pass("debug");
+		graph.Write(debug, c, RenderTarget);
+
+		auto lighting = pass("lighting");
+		graph.Read(lighting, a, PixelShaderResource);
+		graph.Write(lighting, b, RenderTarget);
+
+		auto blur = pass("blur");
+		graph.Read(blur, b, PixelShaderResource);
+		graph.Write(blur, d, RenderTarget);
+
+		auto composite = pass("composite");
+		graph.Read(composite, d, PixelShaderResource);
+		graph.Write(composite, backBuffer, RenderTarget);
+
+		graph.Compile();
+
+		// Culling.
+		CHECK(!graph.IsPassCulled(shadow));
+		CHECK(graph.IsPassCulled(debug));
+		CHECK(!graph.IsPassCulled(lighting));
+		CHECK(!graph.IsPassCulled(blur));
+		CHECK(!graph.IsPassCulled(composite));
+
+		const RenderGraph::Stats& stats = graph.GetStats();
+		CHECK(stats.PassCount == 5);
+		CHECK(stats.CulledPassCount == 1);
+		CHECK(stats.TransientCount == 3);
+		CHECK(stats.TransientBytes == 3 * TargetBytes);
+
+		// Aliasing: A and D never live at the same time, B overlaps both.
+		CHECK(graph.GetHeapOffset(d) == graph.GetHeapOffset(a));
+		CHECK(graph.GetHeapOffset(b) != graph.GetHeapOffset(a));
+		CHECK(graph.GetHeapSize() == 2 * TargetBytes);
+		CHECK(stats.HeapBytes == 2 * TargetBytes);
+
+		// Transients are created in the state of their first use.
+		CHECK(graph.GetInitialState(a) == DepthWrite);
+		CHECK(graph.GetInitialState(b) == RenderTarget);
+		CHECK(graph.GetInitialState(d) == RenderTarget);
+
+		graph.Execute([&batches](const Barrier* barriers, RenderGraph::uint32 count)
+		{
+			CHECK(count > 0);
+			batches.back().Barriers.assign(barriers, barriers + count);
+		});
+
+		// One entry per live pass plus the final batch; shadow needs no barriers.
+		CHECK(batches.size() == 5);
+		if(batches.size() != 5)
+			return;
+
+		CHECK(batches[0].Before == "shadow");
+		CHECK(batches[0].Barriers.empty());
+
+		CHECK(batches[1].Before == "lighting");
+		CHECK(batches[1].Barriers.size() == 1);
+		if(batches[1].Barriers.size() == 1)
+			CHECK(IsTransition(batches[1].Barriers[0], a, DepthWrite, PixelShaderResource));
+
+		// A goes back to its creation state before D takes over its memory.
+		CHECK(batches[2].Before == "blur");
+		CHECK(batches[2].Barriers.size() == 3);
+		if(batches[2].Barriers.size() == 3)
+		{
+			CHECK(IsTransition(batches[2].Barriers[0], a, PixelShaderResource, DepthWrite));
+			CHECK(IsAliasing(batches[2].Barriers[1], d, a));
+			CHECK(IsTransition(batches[2].Barriers[2], b, RenderTarget, PixelShaderResource));
+		}
+
+		CHECK(batches[3].Before == "composite");
+		CHECK(batches[3].Barriers.size() == 3);
+		if(batches[3].Barriers.size() == 3)
+		{
+			CHECK(IsTransition(batches[3].Barriers[0], b, PixelShaderResource, RenderTarget));
+			CHECK(IsTransition(batches[3].Barriers[1], d, RenderTarget, PixelShaderResource));
+			CHECK(IsTransition(batches[3].Barriers[2], backBuffer, Present, RenderTarget));
+		}
+
+		CHECK(batches[4].Before.empty());
+		CHECK(batches[4].Barriers.size() == 2);
+		if(batches[4].Barriers.size() == 2)
+		{
+			CHECK(IsTransition(batches[4].Barriers[0], d, PixelShaderResource, RenderTarget));
+			CHECK(IsTransition(batches[4].Barriers[1], backBuffer, RenderTarget, Present));
+		}
+
+		CHECK(stats.BarrierCount == 9);
+		CHECK(stats.BatchCount == 4);
+	}
+
+	// Consecutive reads in different states become one transition to their union.
+	void TestMergedReads()
+	{
+		using namespace ResourceState;
+
+		RenderGraph graph;
+		auto backBuffer = graph.ImportResource("BackBuffer", Present, Present);
+		auto t = graph.CreateTransient("T", TargetBytes);
+
+		auto produce = graph.AddPass("produce");
+		graph.Write(produce, t, UnorderedAccess);
+
+		auto readPixel = graph.AddPass("readPixel");
+		graph.Read(readPixel, t, PixelShaderResource);
+		graph.Write(readPixel, backBuffer, RenderTarget);
+
+		auto readCompute = graph.AddPass("readCompute");
+		graph.Read(readCompute, t, NonPixelShaderResource);
+		graph.Write(readCompute, backBuffer, RenderTarget);
+
+		graph.Compile();
+
+		std::vector<std::vector<Barrier>> batches;
+		graph.Execute([&batches](const Barrier* barriers, RenderGraph::uint32 count)
+		{
+			batches.emplace_back(barriers, barriers + count);
+		});
+
+		// readPixel: T to both read states, back buffer to render target; readCompute:
+		// nothing; final: T back to UAV, back buffer to present.
+		CHECK(batches.size() == 2);
+		if(batches.size() != 2)
+			return;
+
+		CHECK(batches[0].size() == 2);
+		if(batches[0].size() == 2)
+		{
+			CHECK(IsTransition(batches[0][0], t, UnorderedAccess, PixelShaderResource | NonPixelShaderResource));
+			CHECK(IsTransition(batches[0][1], backBuffer, Present, RenderTarget));
+		}
+
+		CHECK(batches[1].size() == 2);
+		if(batches[1].size() == 2)
+		{
+			CHECK(IsTransition(batches[1][0], t, PixelShaderResource | NonPixelShaderResource, UnorderedAccess));
+			CHECK(IsTransition(batches[1][1], backBuffer, RenderTarget, Present));
+		}
+	}
+
+	// A pass with side effects survives culling, and so does everything it reads.
+	void TestSideEffects()
+	{
+		using namespace ResourceState;
+
+		RenderGraph graph;
+		auto t = graph.CreateTransient("T", TargetBytes);
+		auto readback = graph.CreateTransient("Readback", TargetBytes);
+
+		auto produce = graph.AddPass("produce");
+		graph.Write(produce, t, RenderTarget);
+
+		auto copy = graph.AddPass("copy");
+		graph.Read(copy, t, CopySource);
+		graph.Write(copy, readback, CopyDest);
+		graph.SetSideEffects(copy);
+
+		auto orphan = graph.AddPass("orphan");
+		graph.Read(orphan, t, PixelShaderResource);
+
+		graph.Compile();
+
+		CHECK(!graph.IsPassCulled(produce));
+		CHECK(!graph.IsPassCulled(copy));
+		CHECK(graph.IsPassCulled(orphan));
+		CHECK(graph.GetStats().CulledPassCount == 1);
+	}
+}
+
+int main()
+{
+	TestFrame();
+	TestMergedReads();
+	TestSideEffects();
+	return TestCheck::Result("RenderGraphTests");
+}
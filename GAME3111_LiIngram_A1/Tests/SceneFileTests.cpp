@@ -0,0 +1,242 @@
+//***************************************************************************************
+// SceneFileTests.cpp
+//
+// Round trips a small scene through Serialize and OpenMemory, and through Save and Open,
+// then corrupts the image one field at a time and checks that validation rejects each
+// one with the right error and leaves the scene empty: wrong magic, version or size,
+// array sizes that do not match the counts, misaligned and out of range offsets, name
+// text out of bounds and items referring to names past NameCount.
+//
+// SceneFile's items hold DirectXMath types, so this is not part of the Makefile; from a
+// developer command prompt in Tests:
+//
+//   cl /std:c++17 /EHsc /O2 /I..\Common SceneFileTests.cpp ..\Common\SceneFile.cpp
+//   SceneFileTests.exe
+//***************************************************************************************
+
+#include "SceneFile.h"
+#include "TestCheck.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using uint8 = SceneFile::uint8;
+	using uint32 = SceneFile::uint32;
+	using uint64 = SceneFile::uint64;
+
+	// The file header, which SceneFile keeps private; the layout is the file format.
+	// Arrays in the order the header comment of SceneFile.h lists them.
+	enum Array { Worlds, Geometries, Submeshes, Buckets, Flags, BoundsCenters, BoundsExtents, Names, NameText, ArrayCount };
+
+	struct RawHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 ItemCount;
+		uint32 NameCount;
+		uint64 FileSize;
+		uint64 Offsets[ArrayCount];
+		uint64 Sizes[ArrayCount];
+	};
+
+	RawHeader& HeaderOf(std::vector<uint8>& data)
+	{
+		return *reinterpret_cast<RawHeader*>(data.data());
+	}
+
+	// Three items over four names; "shapeGeo" is shared.
+	std::vector<SceneFile::Item> MakeItems()
+	{
+		const AssetName submeshes[] = { ASSET_NAME("box"), ASSET_NAME("sphere"), ASSET_NAME("grid") };
+		std::vector<SceneFile::Item> items(3);
+		for(uint32 i = 0; i < 3; ++i)
+		{
+			SceneFile::Item& item = items[i];
+			item.World = DirectX::XMFLOAT4X4(
+				1.0f, 0.0f, 0.0f, 0.0f,
+				0.0f, 1.0f, 0.0f, 0.0f,
+				0.0f, 0.0f, 1.0f, 0.0f,
+				(float)i, 2.0f, 3.0f, 1.0f);
+			item.Geometry = ASSET_NAME("shapeGeo");
+			item.Submesh = submeshes[i];
+			item.Bucket = (uint8)i;
+			item.Flags = i == 0 ? SceneFile::Occluder : SceneFile::UseLod;
+			item.BoundsCenter = DirectX::XMFLOAT3(0.0f, 0.5f * i, 0.0f);
+			item.BoundsExtents = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f + i);
+		}
+		return items;
+	}
+
+	void CheckScene(const SceneFile& scene)
+	{
+		CHECK(scene.IsOpen());
+		CHECK(scene.ItemCount() == 3);
+		CHECK(scene.NameCount() == 4);
+		if(scene.ItemCount() != 3 || scene.NameCount() != 4)
+			return;
+
+		std::vector<SceneFile::Item> items = MakeItems();
+		for(uint32 i = 0; i < 3; ++i)
+		{
+			CHECK(scene.Worlds()[i]._41 == (float)i);
+			CHECK(memcmp(&scene.Worlds()[i], &items[i].World, sizeof(items[i].World)) == 0);
+			CHECK(scene.GetName(scene.Geometries()[i]).Hash == HashAssetName("shapeGeo"));
+			CHECK(strcmp(scene.GetName(scene.Submeshes()[i]).Text, items[i].Submesh.Text) == 0);
+			CHECK(scene.GetName(scene.Submeshes()[i]).Hash == items[i].Submesh.Hash);
+			CHECK(scene.Buckets()[i] == i);
+			CHECK(scene.Flags()[i] == items[i].Flags);
+			CHECK(scene.BoundsCenters()[i].y == 0.5f * i);
+			CHECK(scene.BoundsExtents()[i].z == 1.0f + i);
+		}
+	}
+
+	void TestRoundTrip()
+	{
+		std::vector<uint8> data = SceneFile::Serialize(MakeItems());
+		CHECK(data.size() == HeaderOf(data).FileSize);
+
+		const RawHeader& header = HeaderOf(data);
+		CHECK(header.Magic == SceneFile::Magic);
+		CHECK(header.Version == SceneFile::Version);
+		bool aligned = true;
+		for(int a = 0; a < ArrayCount; ++a)
+			aligned = aligned && header.Offsets[a] % SceneFile::ArrayAlignment == 0;
+		CHECK(aligned);
+		CHECK(header.Sizes[Worlds] == 3 * sizeof(DirectX::XMFLOAT4X4));
+		CHECK(header.Sizes[Buckets] == 3);
+
+		SceneFile scene;
+		std::string error;
+		CHECK(scene.OpenMemory(data, &error));
+		CHECK(error.empty());
+		CheckScene(scene);
+
+		scene.Close();
+		CHECK(!scene.IsOpen());
+		CHECK(scene.ItemCount() == 0);
+
+		// The same bytes through a file.
+		std::string path = (std::filesystem::temp_directory_path() / "SceneFileTests.scene").string();
+		CHECK(SceneFile::Save(path, MakeItems()));
+		CHECK(scene.Open(path, &error));
+		CheckScene(scene);
+		scene.Close();
+		std::filesystem::remove(path);
+
+		CHECK(!scene.Open(path, &error));
+		CHECK(!error.empty());
+
+		// An empty scene is still a valid one.
+		CHECK(scene.OpenMemory(SceneFile::Serialize({}), &error));
+		CHECK(scene.ItemCount() == 0);
+		CHECK(scene.NameCount() == 0);
+	}
+
+	// Applies corrupt to a fresh image and checks it is rejected with expected.
+	template<typename Corrupt>
+	void CheckRejected(Corrupt corrupt, const char* expected)
+	{
+		std::vector<uint8> data = SceneFile::Serialize(MakeItems());
+		corrupt(data);
+
+		SceneFile scene;
+		std::string error;
+		bool opened = scene.OpenMemory(std::move(data), &error);
+		CHECK(!opened);
+		CHECK(error == expected);
+		CHECK(!scene.IsOpen());
+		CHECK(scene.ItemCount() == 0);
+		if(error != expected)
+			std::fprintf(stderr, "  expected \"%s\", got \"%s\"\n", expected, error.c_str());
+	}
+
+	void TestHeader()
+	{
+		CheckRejected([](std::vector<uint8>& d) { d.clear(); }, "not a scene file");
+		CheckRejected([](std::vector<uint8>& d) { d.resize(sizeof(RawHeader) - 1); }, "not a scene file");
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Magic ^= 1; }, "not a scene file");
+		CheckRejected([](std::vector<uint8>& d) { ++HeaderOf(d).Version; }, "unsupported scene file version");
+	}
+
+	void TestWrongSize()
+	{
+		const char* mismatch = "scene file size does not match its header";
+
+		// Cut short or with bytes appended, against the size in the header.
+		CheckRejected([](std::vector<uint8>& d) { d.resize(d.size() - 64); }, mismatch);
+		CheckRejected([](std::vector<uint8>& d) { d.push_back(0); }, mismatch);
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).FileSize += 64; }, mismatch);
+
+		// Cut short with a header that agrees: the last array no longer fits.
+		CheckRejected([](std::vector<uint8>& d)
+		{
+			d.resize((size_t)HeaderOf(d).Offsets[NameText]);
+			HeaderOf(d).FileSize = d.size();
+		}, "scene file array out of bounds");
+	}
+
+	void TestArrays()
+	{
+		const char* bounds = "scene file array out of bounds";
+
+		// Sizes that disagree with ItemCount and NameCount.
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Sizes[Worlds] += 64; }, bounds);
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Sizes[Buckets] -= 1; }, bounds);
+		CheckRejected([](std::vector<uint8>& d) { ++HeaderOf(d).ItemCount; }, bounds);
+		CheckRejected([](std::vector<uint8>& d) { ++HeaderOf(d).NameCount; }, bounds);
+
+		// Misaligned offsets.
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Offsets[Geometries] += 4; }, bounds);
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Offsets[Names] -= 8; }, bounds);
+
+		// Aligned but out of range: past the end, running over the end, and so large that
+		// offset + size wraps around.
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Offsets[Worlds] = HeaderOf(d).FileSize + 64; }, bounds);
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Offsets[NameText] = HeaderOf(d).FileSize; }, bounds);
+		CheckRejected([](std::vector<uint8>& d) { HeaderOf(d).Offsets[BoundsExtents] = ~(uint64)63; }, bounds);
+	}
+
+	void TestNames()
+	{
+		auto names = [](std::vector<uint8>& d)
+		{
+			return reinterpret_cast<SceneFile::NameEntry*>(d.data() + HeaderOf(d).Offsets[Names]);
+		};
+		auto items = [](std::vector<uint8>& d, Array array)
+		{
+			return reinterpret_cast<uint32*>(d.data() + HeaderOf(d).Offsets[array]);
+		};
+
+		// Name text past the end of the text array, or without its terminator.
+		const char* nameBounds = "scene file name out of bounds";
+		CheckRejected([&](std::vector<uint8>& d) { names(d)[3].TextOffset = (uint32)HeaderOf(d).Sizes[NameText]; }, nameBounds);
+		CheckRejected([&](std::vector<uint8>& d) { names(d)[0].Length += 1; }, nameBounds);
+		CheckRejected([&](std::vector<uint8>& d) { names(d)[1].TextOffset = ~0u; }, nameBounds);
+
+		// Items referring to names past NameCount.
+		const char* missing = "scene file item refers to a missing name";
+		CheckRejected([&](std::vector<uint8>& d) { items(d, Geometries)[1] = HeaderOf(d).NameCount; }, missing);
+		CheckRejected([&](std::vector<uint8>& d) { items(d, Submeshes)[2] = ~0u; }, missing);
+
+		// The last valid index is fine.
+		std::vector<uint8> data = SceneFile::Serialize(MakeItems());
+		items(data, Submeshes)[0] = HeaderOf(data).NameCount - 1;
+		SceneFile scene;
+		CHECK(scene.OpenMemory(std::move(data)));
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestHeader();
+	TestWrongSize();
+	TestArrays();
+	TestNames();
+
+	return TestCheck::Result("SceneFileTests");
+}
@@ -0,0 +1,40 @@
+//***************************************************************************************
+// TestCheck.h
+//
+// What the headless tests share.  CHECK reports a failed expression with its file and
+// line and carries on, so one run lists every failure; Result turns the count into the
+// exit code of main.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdio>
+
+namespace TestCheck
+{
+	inline int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline void Fail(const char* expression, const char* file, int line)
+	{
+		std::fprintf(stderr, "%s(%d): CHECK failed: %s\n", file, line, expression);
+		++Failures();
+	}
+
+	inline int Result(const char* testName)
+	{
+		if(Failures() == 0)
+		{
+			std::printf("%s: passed\n", testName);
+			return 0;
+		}
+
+		std::printf("%s: %d checks failed\n", testName, Failures());
+		return 1;
+	}
+}
+
+#define CHECK(expression) ((expression) ? (void)0 : TestCheck::Fail(#expression, __FILE__, __LINE__))
@@ -0,0 +1,181 @@
+//***************************************************************************************
+// ThreadPoolTests.cpp
+//
+// Checks that ParallelFor covers every index exactly once, and what happens when the
+// callback throws: on the calling thread or on a worker, the first exception comes back
+// out of ParallelFor, but only after every chunk still running has returned, and the pool
+// keeps working afterwards.  Build and run with the other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using uint32 = ThreadPool::uint32;
+
+	// Counts callbacks in progress, including ones leaving by an exception.
+	struct ActiveScope
+	{
+		std::atomic<int>& Active;
+		explicit ActiveScope(std::atomic<int>& active) : Active(active) { ++Active; }
+		~ActiveScope() { --Active; }
+	};
+
+	void TestCoverage(ThreadPool& pool)
+	{
+		const uint32 count = 100000;
+		std::vector<std::atomic<uint32>> visits(count);
+		std::atomic<bool> badSlot{ false };
+
+		pool.ParallelFor(count, 97, [&](uint32 begin, uint32 end, uint32 slot)
+		{
+			if(slot >= pool.SlotCount())
+				badSlot = true;
+			for(uint32 i = begin; i < end; ++i)
+				++visits[i];
+		});
+
+		bool once = true;
+		for(auto& v : visits)
+			once = once && v.load() == 1;
+		CHECK(once);
+		CHECK(!badSlot);
+	}
+
+	// The calling thread throws while helpers are still inside their chunks.  func and
+	// everything it captures live in this frame, so ParallelFor must not unwind into the
+	// catch below before they are done.
+	void TestCallerThrows(ThreadPool& pool)
+	{
+		std::atomic<int> active{ 0 };
+		std::atomic<int> helperChunks{ 0 };
+
+		bool caught = false;
+		try
+		{
+			pool.ParallelFor(64, 1, [&](uint32, uint32, uint32 slot)
+			{
+				ActiveScope scope(active);
+				if(slot == 0)
+				{
+					// Give the helpers time to pick up chunks first.
+					std::this_thread::sleep_for(std::chrono::milliseconds(5));
+					throw std::runtime_error("caller");
+				}
+
+				++helperChunks;
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			});
+		}
+		catch(const std::runtime_error& e)
+		{
+			caught = std::string(e.what()) == "caller";
+		}
+
+		CHECK(caught);
+		CHECK(active == 0);
+
+		// Chunks are not started after the failure, so most of the 64 never ran.
+		CHECK(helperChunks < 63);
+	}
+
+	// A worker throws.  Without the pool catching it this would call std::terminate.
+	void TestWorkerThrows(ThreadPool& pool)
+	{
+		std::atomic<int> active{ 0 };
+		std::atomic<bool> thrown{ false };
+
+		bool caught = false;
+		try
+		{
+			pool.ParallelFor(64, 1, [&](uint32, uint32, uint32 slot)
+			{
+				ActiveScope scope(active);
+				if(slot != 0)
+				{
+					thrown = true;
+					throw std::logic_error("worker");
+				}
+
+				// Keep the calling thread busy until a worker has failed, so the
+				// exception is sure to come from a worker.
+				auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+				while(!thrown && std::chrono::steady_clock::now() < deadline)
+					std::this_thread::yield();
+			});
+		}
+		catch(const std::logic_error& e)
+		{
+			caught = std::string(e.what()) == "worker";
+		}
+
+		CHECK(caught);
+		CHECK(thrown);
+		CHECK(active == 0);
+	}
+
+	// Every chunk throws; only one exception comes out.
+	void TestAllThrow(ThreadPool& pool)
+	{
+		int caught = 0;
+		try
+		{
+			pool.ParallelFor(1000, 1, [](uint32, uint32, uint32)
+			{
+				throw std::runtime_error("all");
+			});
+		}
+		catch(const std::runtime_error&)
+		{
+			++caught;
+		}
+		CHECK(caught == 1);
+	}
+
+	// Without workers everything runs inline and the exception passes straight through.
+	void TestInlineThrows()
+	{
+		ThreadPool serial(0);
+		CHECK(serial.SlotCount() == 1);
+
+		bool caught = false;
+		try
+		{
+			serial.ParallelFor(10, 1, [](uint32, uint32 end, uint32)
+			{
+				if(end > 5)
+					throw std::runtime_error("inline");
+			});
+		}
+		catch(const std::runtime_error&)
+		{
+			caught = true;
+		}
+		CHECK(caught);
+	}
+}
+
+int main()
+{
+	ThreadPool pool(3);
+
+	TestCoverage(pool);
+	TestCallerThrows(pool);
+	TestWorkerThrows(pool);
+	TestAllThrow(pool);
+
+	// Still usable after all of that.
+	TestCoverage(pool);
+	TestInlineThrows();
+
+	return TestCheck::Result("ThreadPoolTests");
+}
@@ -0,0 +1,218 @@
+//***************************************************************************************
+// UploadServiceTests.cpp
+//
+// Runs UploadService on NullCommandBackend with a submit function that only advances a
+// counter, and plays the copy queue by hand through SetCompletedFence.  Checks batching
+// against the byte budget, in-order tickets, readiness gated on the fence, retire
+// callbacks, and that an exception thrown on the worker comes back out of Retire and
+// WaitIdle.  Build and run with the other headless tests:
+//
+//   make -C Tests check
+//***************************************************************************************
+
+#include "UploadService.h"
+#include "TestCheck.h"
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using uint64 = UploadService::uint64;
+
+	// Submits to the null backend with increasing fences.  Only the worker calls it.
+	struct NullQueue
+	{
+		NullCommandBackend& Backend;
+		uint64 Fence = 0;
+
+		uint64 operator()(UploadService::uint32 list)
+		{
+			Backend.Submit(list, ++Fence);
+			return Fence;
+		}
+	};
+
+	void WaitForBatches(const UploadService& service, uint64 batches)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while(service.GetStats().Batches < batches && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// Holds the worker inside the first batch's record callback until Open is called, so
+	// everything enqueued meanwhile is batched deterministically.
+	class Gate
+	{
+	public:
+		UploadService::RecordFunc Record()
+		{
+			return [this](UploadService::uint32)
+			{
+				mEntered.set_value();
+				mOpen.get_future().wait();
+			};
+		}
+
+		void WaitEntered() { mEntered.get_future().wait(); }
+		void Open() { mOpen.set_value(); }
+
+	private:
+		std::promise<void> mEntered;
+		std::promise<void> mOpen;
+	};
+
+	void TestBatchingAndRetire()
+	{
+		NullCommandBackend backend;
+		NullQueue queue{ backend };
+		UploadService service(backend, std::ref(queue), 100);
+
+		CHECK(service.IsReady(0));
+
+		Gate gate;
+		UploadService::Ticket gateTicket = service.Enqueue(10, gate.Record());
+		gate.WaitEntered();
+
+		// 40 + 40 fits the 100 byte budget, a third does not.
+		std::vector<int> recorded;
+		std::vector<int> retired;
+		std::vector<UploadService::Ticket> tickets;
+		for(int i = 0; i < 5; ++i)
+		{
+			tickets.push_back(service.Enqueue(40,
+				[&recorded, i](UploadService::uint32) { recorded.push_back(i); },
+				[&retired, i]() { retired.push_back(i); }));
+		}
+		CHECK(tickets.front() == gateTicket + 1);
+		CHECK(service.LastTicket() == tickets.back());
+
+		gate.Open();
+		WaitForBatches(service, 4);
+
+		UploadService::Stats stats = service.GetStats();
+		CHECK(stats.Requests == 6);
+		CHECK(stats.Batches == 4);
+		CHECK(stats.Bytes == 210);
+		CHECK(stats.LargestBatchBytes == 80);
+		CHECK(stats.Pending == 0);
+		CHECK(stats.InFlight == 6);
+		CHECK((recorded == std::vector<int>{ 0, 1, 2, 3, 4 }));
+
+		// Nothing is ready before the copy queue gets there.
+		CHECK(!service.IsReady(gateTicket));
+		CHECK(service.Retire() == 0);
+
+		// Fence 2 covers the gate's batch and the first pair.
+		backend.SetCompletedFence(2);
+		CHECK(service.IsReady(tickets[1]));
+		CHECK(!service.IsReady(tickets[2]));
+		CHECK(service.Retire() == 2);
+		CHECK((retired == std::vector<int>{ 0, 1 }));
+
+		backend.SetCompletedFence(4);
+		service.WaitIdle();
+		CHECK(service.IsReady(tickets.back()));
+		CHECK(service.Retire() == 3);
+		CHECK((retired == std::vector<int>{ 0, 1, 2, 3, 4 }));
+		CHECK(service.GetStats().Retired == 6);
+		CHECK(!service.Failed());
+
+		CHECK(backend.GetViolations().empty());
+	}
+
+	// A request bigger than the budget still goes out, alone.
+	void TestOversizedRequest()
+	{
+		NullCommandBackend backend;
+		NullQueue queue{ backend };
+		UploadService service(backend, std::ref(queue), 100);
+
+		Gate gate;
+		service.Enqueue(10, gate.Record());
+		gate.WaitEntered();
+
+		service.Enqueue(500, [](UploadService::uint32) {});
+		service.Enqueue(20, [](UploadService::uint32) {});
+		gate.Open();
+		WaitForBatches(service, 3);
+
+		UploadService::Stats stats = service.GetStats();
+		CHECK(stats.Batches == 3);
+		CHECK(stats.LargestBatchBytes == 500);
+
+		backend.SetCompletedFence(3);
+		service.WaitIdle();
+		CHECK(backend.GetViolations().empty());
+	}
+
+	void TestSubmitThrows()
+	{
+		NullCommandBackend backend;
+		UploadService service(backend, [](UploadService::uint32) -> uint64
+		{
+			throw std::runtime_error("device removed");
+		});
+
+		bool retireRan = false;
+		service.Enqueue(16, [](UploadService::uint32) {}, [&retireRan]() { retireRan = true; });
+
+		bool caught = false;
+		try
+		{
+			service.WaitIdle();
+		}
+		catch(const std::runtime_error& e)
+		{
+			caught = std::string(e.what()) == "device removed";
+		}
+		CHECK(caught);
+		CHECK(service.Failed());
+
+		// It keeps failing rather than pretending later uploads will complete.
+		caught = false;
+		try
+		{
+			service.Retire();
+		}
+		catch(const std::runtime_error&)
+		{
+			caught = true;
+		}
+		CHECK(caught);
+		CHECK(!retireRan);
+	}
+
+	void TestRecordThrows()
+	{
+		NullCommandBackend backend;
+		NullQueue queue{ backend };
+		UploadService service(backend, std::ref(queue));
+
+		service.Enqueue(16, [](UploadService::uint32) { throw std::logic_error("bad copy"); });
+
+		bool caught = false;
+		try
+		{
+			service.WaitIdle();
+		}
+		catch(const std::logic_error&)
+		{
+			caught = true;
+		}
+		CHECK(caught);
+		CHECK(service.Failed());
+		CHECK(queue.Fence == 0);
+	}
+}
+
+int main()
+{
+	TestBatchingAndRetire();
+	TestOversizedRequest();
+	TestSubmitThrows();
+	TestRecordThrows();
+	return TestCheck::Result("UploadServiceTests");
+}
@@ -0,0 +1,90 @@
+//***************************************************************************************
+// CommandReplay.cpp
+//
+// Replays a command capture written by ShapesApp ('C') against NullCommandSink and
+// prints per-command timings.  Only needs Common/CommandStream, so it builds anywhere,
+// with the headless tests:
+//
+//   make -C Tests cmdreplay
+//   Tests/build/cmdreplay ShapesApp.cmdcapture [repeat]
+//
+// With a repeat count the capture is replayed that many times and the fastest run is
+// reported, which makes before/after comparisons of the same capture less noisy.
+//***************************************************************************************
+
+#include "CommandStream.h"
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s <capture> [repeat]\n", argv[0]);
+		return 1;
+	}
+
+	int repeat = argc > 2 ? std::atoi(argv[2]) : 1;
+	if(repeat < 1)
+		repeat = 1;
+
+	std::string error;
+	std::vector<std::uint8_t> data = CommandReplay::Load(argv[1], &error);
+	if(data.empty())
+	{
+		std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+		return 1;
+	}
+
+	CommandReplay::Stats best;
+	NullCommandSink bestSink;
+	for(int i = 0; i < repeat; ++i)
+	{
+		NullCommandSink sink;
+		CommandReplay::Stats stats;
+		if(!CommandReplay::Replay(data, sink, stats, &error))
+		{
+			std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+			return 1;
+		}
+
+		if(i == 0 || stats.Milliseconds < best.Milliseconds)
+		{
+			best = stats;
+			bestSink = sink;
+		}
+	}
+
+	double frameMin = 0.0, frameMax = 0.0, frameSum = 0.0;
+	for(size_t i = 0; i < best.FrameMilliseconds.size(); ++i)
+	{
+		double ms = best.FrameMilliseconds[i];
+		frameMin = i == 0 ? ms : (ms < frameMin ? ms : frameMin);
+		frameMax = ms > frameMax ? ms : frameMax;
+		frameSum += ms;
+	}
+
+	std::printf("%s: %zu bytes, %u frames, %llu commands, %llu draws, %llu upload bytes\n", argv[1],
+		data.size(), best.Frames, (unsigned long long)best.Commands,
+		(unsigned long long)bestSink.DrawCount(), (unsigned long long)bestSink.UploadBytes());
+	std::printf("replay: %.3f ms (best of %d), checksum %016llx\n", best.Milliseconds, repeat,
+		(unsigned long long)bestSink.Checksum());
+	if(best.Frames > 0)
+	{
+		std::printf("frame: min %.4f ms, avg %.4f ms, max %.4f ms\n", frameMin,
+			frameSum / best.FrameMilliseconds.size(), frameMax);
+	}
+
+	std::printf("\n%-24s %10s %12s %10s\n", "command", "count", "total us", "us each");
+	for(size_t i = 0; i < (size_t)CommandOp::Count; ++i)
+	{
+		const CommandReplay::OpStats& op = best.Ops[i];
+		if(op.Count == 0)
+			continue;
+
+		std::printf("%-24s %10llu %12.1f %10.4f\n", CommandReplay::OpName((CommandOp)i),
+			(unsigned long long)op.Count, op.Microseconds, op.Microseconds / op.Count);
+	}
+
+	return 0;
+}